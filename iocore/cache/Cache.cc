@@ -47,6 +47,9 @@ static size_t DEFAULT_RAM_CACHE_MULTIPLIER = 10; // I.e. 10x 1MB per 1GB of disk
 // This is the oldest version number that is still usable.
 static short int const CACHE_DB_MAJOR_VERSION_COMPATIBLE = 21;
 
+// When CacheProcessor::start_internal ran, for the startup phase stats.
+static ink_hrtime cache_start_time = 0;
+
 #define DOCACHE_CLEAR_DYN_STAT(x) \
 do { \
 	RecSetRawStatSum(rsb, x, 0); \
@@ -60,6 +63,8 @@ int64_t cache_config_ram_cache_size = AUTO_SIZE_RAM_CACHE;
 int cache_config_ram_cache_algorithm = 0;
 int cache_config_ram_cache_compress = 0;
 int cache_config_ram_cache_compress_percent = 90;
+int cache_config_ram_cache_compress_dict_size = 65536;
+int cache_config_tier_promote_hits = 3;
 int cache_config_ram_cache_use_seen_filter = 0;
 int cache_config_http_max_alts = 3;
 int cache_config_dir_sync_frequency = 60;
@@ -75,10 +80,14 @@ int cache_config_hit_evacuate_size_limit = 0;
 int cache_config_force_sector_size = 0;
 int cache_config_target_fragment_size = DEFAULT_TARGET_FRAGMENT_SIZE;
 int cache_config_agg_write_backlog = AGG_SIZE * 2;
+int cache_config_agg_write_size = AGG_SIZE;
 int cache_config_enable_checksum = 0;
 int cache_config_alt_rewrite_max_size = 4096;
 int cache_config_read_while_writer = 0;
 int cache_config_mutex_retry_delay = 2;
+int cache_config_url_hash = CACHE_URL_HASH_LEGACY;
+uint64_t cache_config_url_hash_key[2] = { 0, 0 };
+uint32_t cache_config_url_hash_stamp = CACHE_URL_HASH_LEGACY;
 #ifdef HTTP_CACHE
 static int enable_cache_empty_http_doc = 0;
 /// Fix up a specific known problem with the 4.2.0 release.
@@ -132,8 +141,14 @@ struct VolInitInfo
   off_t recover_pos;
   AIOCallbackInternal vol_aio[4];
   char *vol_h_f;
+  AIOCallbackInternal *dir_aio;   // directory read, DIR_READ_SIZE per op
+  int dir_aio_count;
+  int dir_aio_pending;
+  bool dir_aio_failed;
+  char *dir_copy;                 // recovered directory, see Vol::handle_recover_write
 
   VolInitInfo()
+    : dir_aio(NULL), dir_aio_count(0), dir_aio_pending(0), dir_aio_failed(false), dir_copy(NULL)
   {
     recover_pos = 0;
     vol_h_f = (char *)ats_memalign(ats_pagesize(), 4 * STORE_BLOCK_SIZE);
@@ -146,7 +161,88 @@ struct VolInitInfo
       vol_aio[i].action = NULL;
       vol_aio[i].mutex.clear();
     }
+    for (int i = 0; i < dir_aio_count; i++) {
+      dir_aio[i].action = NULL;
+      dir_aio[i].mutex.clear();
+    }
+    delete[] dir_aio;
     free(vol_h_f);
+    if (dir_copy)
+      ats_memalign_free(dir_copy);
+  }
+};
+
+// Record the time since the cache started for a startup phase. Volumes
+// get there in any order, the stat keeps the last one.
+static void
+cache_startup_stat(int stat)
+{
+  int64_t elapsed = ink_hrtime_to_msec(ink_get_hrtime_internal() - cache_start_time);
+  int64_t current = 0;
+
+  RecGetGlobalRawStatSum(cache_rsb, stat, &current);
+  if (elapsed > current)
+    GLOBAL_CACHE_SET_DYN_STAT(stat, elapsed);
+}
+
+// Read the directory copy at @a offset in DIR_READ_SIZE pieces, all queued
+// at once so the AIO threads for the disk keep several large sequential
+// reads in flight. Vol::handle_dir_read runs once they are all back.
+static void
+vol_read_dir(Vol *d, off_t offset)
+{
+  VolInitInfo *info = d->init_info;
+  size_t dirlen = vol_dirlen(d);
+  int n = (int) ((dirlen + DIR_READ_SIZE - 1) / DIR_READ_SIZE);
+
+  info->dir_aio = new AIOCallbackInternal[n];
+  info->dir_aio_count = info->dir_aio_pending = n;
+  info->dir_aio_failed = false;
+  for (int i = 0; i < n; i++) {
+    AIOCallback *aio = &info->dir_aio[i];
+    size_t pos = (size_t) i * DIR_READ_SIZE;
+    aio->aiocb.aio_fildes = d->fd;
+    aio->aiocb.aio_buf = d->raw_dir + pos;
+    aio->aiocb.aio_nbytes = MIN((size_t) DIR_READ_SIZE, dirlen - pos);
+    aio->aiocb.aio_offset = offset + pos;
+    aio->action = d;
+    aio->thread = AIO_CALLBACK_THREAD_ANY;
+    aio->then = 0;
+  }
+  // The completions need the volume lock, which the caller holds, so none
+  // of them can run before all are queued.
+  for (int i = 0; i < n; i++)
+    ink_assert(ink_aio_read(&info->dir_aio[i]));
+}
+
+static void
+vol_online(Vol *d)
+{
+  int vol_no = ink_atomic_increment(&gnvol, 1);
+  ink_assert(!gvol[vol_no]);
+  gvol[vol_no] = d;
+  d->cache->vol_initialized(d->fd != -1);
+}
+
+// Puts a volume in service while it is still recovering. The Vol itself is
+// busy handling the recovery AIOs so this needs its own continuation.
+struct VolOnline : public Continuation
+{
+  Vol *vol;
+
+  int mainEvent(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */) {
+    if (!vol->cache->cache_read_done) {
+      eventProcessor.schedule_in(this, HRTIME_MSECONDS(5), ET_CALL);
+      return EVENT_CONT;
+    }
+    vol_online(vol);
+    mutex.clear();
+    delete this;
+    return EVENT_DONE;
+  }
+
+  VolOnline(Vol *v) : Continuation(v->mutex), vol(v) {
+    SET_HANDLER(&VolOnline::mainEvent);
   }
 };
 
@@ -223,7 +319,7 @@ cache_bytes_used(int volume)
       if (!gvol[i]->header->cycle)
           used += gvol[i]->header->write_pos - gvol[i]->start;
       else
-          used += gvol[i]->len - vol_dirlen(gvol[i]) - EVACUATION_SIZE;
+          used += gvol[i]->len - vol_dirlen(gvol[i]) - gvol[i]->evacuation_size();
     }
   }
 
@@ -614,6 +710,7 @@ CacheProcessor::start_internal(int flags)
   clear = !!(flags & PROCESSOR_RECONFIGURE) || auto_clear_flag;
   fix = !!(flags & PROCESSOR_FIX);
   start_done = 0;
+  cache_start_time = ink_get_hrtime_internal();
   int diskok = 1;
   Span *sd;
 #if TS_USE_INTERIM_CACHE == 1
@@ -743,6 +840,8 @@ CacheProcessor::start_internal(int flags)
 
         gdisks[gndisks] = new CacheDisk();
         gdisks[gndisks]->forced_volume_num = sd->forced_volume_num;
+        gdisks[gndisks]->tier = sd->tier;
+        gdisks[gndisks]->agg_size = sd->agg_size;
         if (sd->hash_base_string)
           gdisks[gndisks]->hash_base_string = ats_strdup(sd->hash_base_string);
 
@@ -963,6 +1062,15 @@ CacheProcessor::cacheInitialized()
       cacheProcessor.max_stripe_version = v->header->version;
   }
 
+  // The stripe is picked from the URL hash so every stripe must use the
+  // same one, a newly configured hash is only used once all stripes have
+  // been initialized for it.
+  cacheProcessor.stripe_url_hash = gnvol ? gvol[0]->header->url_hash : cache_config_url_hash_stamp;
+  for (i = 1; i < gnvol; i++) {
+    if (gvol[i]->header->url_hash != cacheProcessor.stripe_url_hash)
+      cacheProcessor.stripe_url_hash = CACHE_URL_HASH_MIXED;
+  }
+
 
   if (caches_ready) {
     Debug("cache_init", "CacheProcessor::cacheInitialized - caches_ready=0x%0X, gnvol=%d", (unsigned int) caches_ready,
@@ -981,6 +1089,9 @@ CacheProcessor::cacheInitialized()
           case RAM_CACHE_ALGORITHM_LRU:
             gvol[i]->ram_cache = new_RamCacheLRU();
             break;
+          case RAM_CACHE_ALGORITHM_TINYLFU:
+            gvol[i]->ram_cache = new_RamCacheTinyLFU();
+            break;
         }
       }
       // let us calculate the Size
@@ -1085,6 +1196,11 @@ CacheProcessor::cacheInitialized()
         case CACHE_COMPRESSION_LIBLZMA:
 #if ! TS_HAS_LZMA
           Fatal("lzma not available for RAM cache compression");
+#endif
+          break;
+        case CACHE_COMPRESSION_ZSTD:
+#if ! TS_HAS_ZSTD
+          Fatal("zstd not available for RAM cache compression");
 #endif
           break;
       }
@@ -1100,6 +1216,7 @@ CacheProcessor::cacheInitialized()
   }
   if (cache_init_ok) {
     // Initialize virtual cache
+    cache_startup_stat(cache_startup_online_time_stat);
     CacheProcessor::initialized = CACHE_INITIALIZED;
     CacheProcessor::cache_ready = caches_ready;
     Note("cache enabled");
@@ -1214,6 +1331,7 @@ vol_clear_init(Vol *d)
 {
   size_t dir_len = vol_dirlen(d);
   memset(d->raw_dir, 0, dir_len);
+  memset(d->dir_sync_state, DIR_SYNC_DIRTY_ALL, d->segments);
   vol_init_dir(d);
   d->header->magic = VOL_MAGIC;
   d->header->version.ink_major = CACHE_DB_MAJOR_VERSION;
@@ -1224,8 +1342,10 @@ vol_clear_init(Vol *d)
   d->header->cycle = 0;
   d->header->create_time = time(NULL);
   d->header->dirty = 0;
+  d->header->url_hash = cache_config_url_hash_stamp;
   d->sector_size = d->header->sector_size = d->disk->hw_sector_size;
   *d->footer = *d->header;
+  vol_footer_sync(d);
 
 #if TS_USE_INTERIM_CACHE == 1
   for (int i = 0; i < d->num_interim_vols; i++) {
@@ -1297,12 +1417,25 @@ Vol::init(char *s, off_t blocks, off_t dir_skip, bool clear)
   evacuate = (DLL<EvacuationBlock> *)ats_malloc(evac_len);
   memset(evacuate, 0, evac_len);
 
+  // the size of the aggregated writes, also used by recovery below
+  int64_t asize = disk->agg_size ? disk->agg_size : cache_config_agg_write_size;
+  asize = MIN(asize, MIN((int64_t)MAX_AGG_SIZE, (int64_t)len / 16));
+  agg_size = (int) ROUND_DOWN_TO_STORE_BLOCK(MAX(asize, (int64_t)AGG_SIZE));
+  agg_buffer = (char *)ats_memalign(ats_pagesize(), agg_size);
+  memset(agg_buffer, 0, agg_size);
+  agg_write_buffer = (char *)ats_memalign(ats_pagesize(), agg_size);
+  memset(agg_write_buffer, 0, agg_size);
+  agg_write_cont = new VolAggWrite(this);
+
   Debug("cache_init", "allocating %zu directory bytes for a %lld byte volume (%lf%%)",
     vol_dirlen(this), (long long)this->len, (double)vol_dirlen(this) / (double)this->len * 100.0);
   raw_dir = (char *)ats_memalign(ats_pagesize(), vol_dirlen(this));
   dir = (Dir *) (raw_dir + vol_headerlen(this));
   header = (VolHeaderFooter *) raw_dir;
   footer = (VolHeaderFooter *) (raw_dir + vol_dirlen(this) - ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter)));
+  // Neither copy on disk is known to match memory until it is written once.
+  dir_sync_state = (uint8_t *)ats_malloc(segments);
+  memset(dir_sync_state, DIR_SYNC_DIRTY_ALL, segments);
 
 #if TS_USE_INTERIM_CACHE == 1
   num_interim_vols = good_interim_disks;
@@ -1376,6 +1509,8 @@ Vol::handle_dir_clear(int event, void *data)
       return EVENT_DONE;
     }
     set_io_not_in_progress();
+    if (recovering)             // already online, recovery gave up on the data
+      return recovery_done();
     SET_HANDLER(&Vol::dir_init_done);
     dir_init_done(EVENT_IMMEDIATE, 0);
     /* mark the volume as bad */
@@ -1389,11 +1524,16 @@ Vol::handle_dir_read(int event, void *data)
   AIOCallback *op = (AIOCallback *) data;
 
   if (event == AIO_EVENT_DONE) {
-    if ((size_t) op->aio_result != (size_t) op->aiocb.aio_nbytes) {
+    if ((size_t) op->aio_result != (size_t) op->aiocb.aio_nbytes)
+      init_info->dir_aio_failed = true;
+    if (--init_info->dir_aio_pending > 0)
+      return EVENT_CONT;
+    if (init_info->dir_aio_failed) {
       clear_dir();
       return EVENT_DONE;
     }
   }
+  cache_startup_stat(cache_startup_dir_read_time_stat);
 
   if (!(header->magic == VOL_MAGIC &&  footer->magic == VOL_MAGIC &&
         CACHE_DB_MAJOR_VERSION_COMPATIBLE <= header->version.ink_major &&  header->version.ink_major <= CACHE_DB_MAJOR_VERSION
@@ -1428,10 +1568,28 @@ Vol::handle_dir_read(int event, void *data)
 int
 Vol::recover_data()
 {
+  // Serve what the directory says is safe while the data written since
+  // the last sync is scanned, see vol_recovery_safe(). New writes wait in
+  // the aggregation queue because io stays in progress until recovery_done().
+  recovering = true;
+  RecIncrGlobalRawStatSum(cache_rsb, cache_startup_recovering_stat, 1);
+  eventProcessor.schedule_imm(new VolOnline(this), ET_CALL);
   SET_HANDLER(&Vol::handle_recover_from_data);
   return handle_recover_from_data(EVENT_IMMEDIATE, 0);
 }
 
+int
+Vol::recovery_done()
+{
+  recovering = false;
+  RecIncrGlobalRawStatSum(cache_rsb, cache_startup_recovering_stat, -1);
+  cache_startup_stat(cache_startup_recovery_time_stat);
+  SET_HANDLER(&Vol::aggWrite);
+  if (agg.head)
+    return aggWrite(EVENT_NONE, 0);
+  return EVENT_DONE;
+}
+
 /*
    Philosophy:  The idea is to find the region of disk that could be
    inconsistent and remove all directory entries pointing to that potentially
@@ -1484,6 +1642,9 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
     recover_wrapped = 0;
     last_sync_serial = 0;
     last_write_serial = 0;
+    recover_agg_size = vol_footer_agg_size(this);
+    if (recover_agg_size != agg_size)
+      Note("recovering '%s' written with agg_size %d", hash_text.get(), recover_agg_size);
     recover_pos = header->last_write_pos;
     if (recover_pos >= skip + len) {
       recover_wrapped = 1;
@@ -1540,7 +1701,7 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
     if (recover_wrapped && start == io.aiocb.aio_offset) {
       doc = (Doc *) s;
       if (doc->magic != DOC_MAGIC || doc->write_serial < last_write_serial) {
-        recover_pos = skip + len - EVACUATION_SIZE;
+        recover_pos = skip + len - recover_evacuation_size();
         goto Ldone;
       }
     }
@@ -1568,7 +1729,7 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
              sync serial and less than (header->sync_serial + 2) then
              continue;
 
-             3. If the position we are recovering from is within AGG_SIZE
+             3. If the position we are recovering from is within agg_size
              from the disk end, then we can't trust this document. The
              aggregation buffer might have been larger than the remaining space
              at the end and we decided to wrap around instead of writing
@@ -1590,7 +1751,7 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
           // (doc->sync_serial < last_sync_serial) ||
           // (doc->sync_serial > header->sync_serial + 1).
           // if we are too close to the end, wrap around
-          else if (recover_pos - (e - s) > (skip + len) - AGG_SIZE) {
+          else if (recover_pos - (e - s) > (skip + len) - recover_agg_size) {
             recover_wrapped = 1;
             recover_pos = start;
             io.aiocb.aio_nbytes = RECOVERY_SIZE;
@@ -1602,10 +1763,10 @@ Vol::handle_recover_from_data(int event, void * /* data ATS_UNUSED */ )
           goto Ldone;
         } else {
           // doc->magic != DOC_MAGIC
-          // If we are in the danger zone - recover_pos is within AGG_SIZE
+          // If we are in the danger zone - recover_pos is within agg_size
           // from the end, then wrap around
           recover_pos -= e - s;
-          if (recover_pos > (skip + len) - AGG_SIZE) {
+          if (recover_pos > (skip + len) - recover_agg_size) {
             recover_wrapped = 1;
             recover_pos = start;
             io.aiocb.aio_nbytes = RECOVERY_SIZE;
@@ -1652,8 +1813,8 @@ Ldone:{
       return handle_recover_write_dir(EVENT_IMMEDIATE, 0);
     }
 
-    recover_pos += EVACUATION_SIZE;   // safely cover the max write size
-    if (recover_pos < header->write_pos && (recover_pos + EVACUATION_SIZE >= header->write_pos)) {
+    recover_pos += recover_evacuation_size();   // safely cover the max write size
+    if (recover_pos < header->write_pos && (recover_pos + recover_evacuation_size() >= header->write_pos)) {
       Debug("cache_init", "Head Pos: %" PRIu64 ", Rec Pos: %" PRIu64 ", Wrapped:%d", header->write_pos, recover_pos, recover_wrapped);
       Warning("no valid directory found while recovering '%s', clearing", hash_text.get());
       goto Lclear;
@@ -1678,37 +1839,17 @@ Ldone:{
     if (is_debug_tag_set("cache_init"))
       Note("recovery clearing offsets [%" PRIu64 ", %" PRIu64 "] sync_serial %d next %d\n",
            header->write_pos, recover_pos, header->sync_serial, next_sync_serial);
-    footer->sync_serial = header->sync_serial = next_sync_serial;
-
-    for (int i = 0; i < 3; i++) {
-      AIOCallback *aio = &(init_info->vol_aio[i]);
-      aio->aiocb.aio_fildes = fd;
-      aio->action = this;
-      aio->thread = AIO_CALLBACK_THREAD_ANY;
-      aio->then = (i < 2) ? &(init_info->vol_aio[i + 1]) : 0;
-    }
-    int footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
-    size_t dirlen = vol_dirlen(this);
-    int B = header->sync_serial & 1;
-    off_t ss = skip + (B ? dirlen : 0);
-
-    init_info->vol_aio[0].aiocb.aio_buf = raw_dir;
-    init_info->vol_aio[0].aiocb.aio_nbytes = footerlen;
-    init_info->vol_aio[0].aiocb.aio_offset = ss;
-    init_info->vol_aio[1].aiocb.aio_buf = raw_dir + footerlen;
-    init_info->vol_aio[1].aiocb.aio_nbytes = dirlen - 2 * footerlen;
-    init_info->vol_aio[1].aiocb.aio_offset = ss + footerlen;
-    init_info->vol_aio[2].aiocb.aio_buf = raw_dir + dirlen - footerlen;
-    init_info->vol_aio[2].aiocb.aio_nbytes = footerlen;
-    init_info->vol_aio[2].aiocb.aio_offset = ss + dirlen - footerlen;
-
-    SET_HANDLER(&Vol::handle_recover_write_dir);
-#if AIO_MODE == AIO_MODE_NATIVE
-    ink_assert(ink_aio_writev(init_info->vol_aio));
-#else
-    ink_assert(ink_aio_write(init_info->vol_aio));
-#endif
-    return EVENT_CONT;
+    header->sync_serial = next_sync_serial;
+    vol_footer_sync(this);
+
+    // take the copy to write while the directory can not change under us
+    free((char *) io.aiocb.aio_buf);
+    io.aiocb.aio_buf = NULL;
+    init_info->dir_copy = (char *)ats_memalign(ats_pagesize(), vol_dirlen(this));
+    memcpy(init_info->dir_copy, raw_dir, vol_dirlen(this));
+    init_info->recover_pos = 0;
+    SET_HANDLER(&Vol::handle_recover_write);
+    return handle_recover_write(EVENT_IMMEDIATE, 0);
   }
 
 Lclear:
@@ -1719,6 +1860,39 @@ Lclear:
   return EVENT_CONT;
 }
 
+/*
+   Write the recovered directory to the copy selected by the new sync
+   serial. The volume is already serving reads and the directory can change
+   while an AIO is outstanding, so what is written is the copy taken under
+   the volume lock once recovery finished, as CacheSync does, and never
+   raw_dir itself. The footer goes last so the copy is not valid until all
+   of it is on disk.
+*/
+int
+Vol::handle_recover_write(int event, void * /* data ATS_UNUSED */ )
+{
+  size_t dirlen = vol_dirlen(this);
+  size_t footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+  size_t done = init_info->recover_pos;
+
+  if (event == AIO_EVENT_DONE && !io.ok()) {
+    Warning("unable to write recovered directory '%s'", hash_text.get());
+    done = dirlen;
+  }
+  if (done < dirlen) {
+    size_t n = done < dirlen - footerlen ? MIN((size_t)RECOVERY_SIZE, dirlen - footerlen - done) : footerlen;
+    io.aiocb.aio_buf = init_info->dir_copy + done;
+    io.aiocb.aio_offset = skip + ((header->sync_serial & 1) ? dirlen : 0) + done;
+    io.aiocb.aio_nbytes = n;
+    init_info->recover_pos += n;
+    ink_assert(ink_aio_write(&io));
+    return EVENT_CONT;
+  }
+  io.aiocb.aio_buf = NULL;
+  SET_HANDLER(&Vol::handle_recover_write_dir);
+  return handle_recover_write_dir(EVENT_IMMEDIATE, 0);
+}
+
 int
 Vol::handle_recover_write_dir(int /* event ATS_UNUSED */ , void * /* data ATS_UNUSED */ )
 {
@@ -1729,8 +1903,7 @@ Vol::handle_recover_write_dir(int /* event ATS_UNUSED */ , void * /* data ATS_UN
   set_io_not_in_progress();
   scan_pos = header->write_pos;
   periodic_scan();
-  SET_HANDLER(&Vol::dir_init_done);
-  return dir_init_done(EVENT_IMMEDIATE, 0);
+  return recovery_done();
 }
 
 int
@@ -1752,8 +1925,6 @@ Vol::handle_header_read(int event, void *data)
     }
 
     io.aiocb.aio_fildes = fd;
-    io.aiocb.aio_nbytes = vol_dirlen(this);
-    io.aiocb.aio_buf = raw_dir;
     io.action = this;
     io.thread = AIO_CALLBACK_THREAD_ANY;
     io.then = 0;
@@ -1763,8 +1934,7 @@ Vol::handle_header_read(int event, void *data)
       SET_HANDLER(&Vol::handle_dir_read);
       if (is_debug_tag_set("cache_init"))
         Note("using directory A for '%s'", hash_text.get());
-      io.aiocb.aio_offset = skip;
-      ink_assert(ink_aio_read(&io));
+      vol_read_dir(this, skip);
     }
     // try B
     else if (hf[2]->sync_serial == hf[3]->sync_serial) {
@@ -1772,8 +1942,7 @@ Vol::handle_header_read(int event, void *data)
       SET_HANDLER(&Vol::handle_dir_read);
       if (is_debug_tag_set("cache_init"))
         Note("using directory B for '%s'", hash_text.get());
-      io.aiocb.aio_offset = skip + vol_dirlen(this);
-      ink_assert(ink_aio_read(&io));
+      vol_read_dir(this, skip + vol_dirlen(this));
     } else {
       Note("no good directory, clearing '%s'", hash_text.get());
       clear_dir();
@@ -1794,14 +1963,8 @@ Vol::dir_init_done(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */ )
     eventProcessor.schedule_in(this, HRTIME_MSECONDS(5), ET_CALL);
     return EVENT_CONT;
   } else {
-    int vol_no = ink_atomic_increment(&gnvol, 1);
-    ink_assert(!gvol[vol_no]);
-    gvol[vol_no] = this;
     SET_HANDLER(&Vol::aggWrite);
-    if (fd == -1)
-      cache->vol_initialized(0);
-    else
-      cache->vol_initialized(1);
+    vol_online(this);
     return EVENT_DONE;
   }
 }
@@ -1895,7 +2058,7 @@ InterimCacheVol::handle_recover_from_data(int event, void *data)
     if (recover_wrapped && start == io.aiocb.aio_offset) {
       doc = (Doc *) s;
       if (doc->magic != DOC_MAGIC || doc->write_serial < last_write_serial) {
-        recover_pos = skip + len - EVACUATION_SIZE;
+        recover_pos = skip + len - evacuation_size();
         goto Ldone;
       }
     }
@@ -1914,7 +2077,7 @@ InterimCacheVol::handle_recover_from_data(int event, void *data)
             s += round_to_approx_size(doc->len);
             continue;
 
-          } else if (recover_pos - (e - s) > (skip + len) - AGG_SIZE) {
+          } else if (recover_pos - (e - s) > (skip + len) - agg_size) {
             recover_wrapped = 1;
             recover_pos = start;
             io.aiocb.aio_nbytes = RECOVERY_SIZE;
@@ -1926,7 +2089,7 @@ InterimCacheVol::handle_recover_from_data(int event, void *data)
 
         } else {
           recover_pos -= e - s;
-          if (recover_pos > (skip + len) - AGG_SIZE) {
+          if (recover_pos > (skip + len) - agg_size) {
             recover_wrapped = 1;
             recover_pos = start;
             io.aiocb.aio_nbytes = RECOVERY_SIZE;
@@ -1970,8 +2133,8 @@ Ldone: {
       goto Lfinish;
     }
 
-    recover_pos += EVACUATION_SIZE;
-    if (recover_pos < header->write_pos && (recover_pos + EVACUATION_SIZE >= header->write_pos)) {
+    recover_pos += evacuation_size();
+    if (recover_pos < header->write_pos && (recover_pos + evacuation_size() >= header->write_pos)) {
       Debug("cache_init", "Head Pos: %" PRIu64 ", Rec Pos: %" PRIu64 ", Wrapped:%d", header->write_pos, recover_pos, recover_wrapped);
       Warning("no valid directory found while recovering '%s', clearing", hash_text.get());
       goto Lclear;
@@ -2038,8 +2201,9 @@ cmprtable(const void *aa, const void *bb) {
   return 0;
 }
 
-void
-build_vol_hash_table(CacheHostRecord *cp)
+// Build the hash table for the vols of @a tier, or all the vols if @a tier is negative.
+static void
+build_tier_hash_table(CacheHostRecord *cp, int tier, unsigned short **table)
 {
   int num_vols = cp->num_vols;
   unsigned int *mapping = (unsigned int *)ats_malloc(sizeof(unsigned int) * num_vols);
@@ -2053,7 +2217,7 @@ build_vol_hash_table(CacheHostRecord *cp)
   uint64_t used = 0;
   // initialize number of elements per vol
   for (int i = 0; i < num_vols; i++) {
-    if (DISK_BAD(cp->vols[i]->disk)) {
+    if (DISK_BAD(cp->vols[i]->disk) || (tier >= 0 && cp->vols[i]->disk->tier != tier)) {
       bad_vols++;
       continue;
     }
@@ -2066,10 +2230,10 @@ build_vol_hash_table(CacheHostRecord *cp)
 
   if (!num_vols) {
     // all the disks are corrupt,
-    if (cp->vol_hash_table) {
-      new_Freer(cp->vol_hash_table, CACHE_MEM_FREE_TIMEOUT);
+    if (*table) {
+      new_Freer(*table, CACHE_MEM_FREE_TIMEOUT);
     }
-    cp->vol_hash_table = NULL;
+    *table = NULL;
     ats_free(mapping);
     ats_free(p);
     return;
@@ -2129,7 +2293,7 @@ build_vol_hash_table(CacheHostRecord *cp)
     Debug("cache_init", "build_vol_hash_table index %d mapped to %d requested %d got %d", i, mapping[i], forvol[i], gotvol[i]);
   }
   // install new table
-  if (0 != (old_table = ink_atomic_swap(&(cp->vol_hash_table), ttable)))
+  if (0 != (old_table = ink_atomic_swap(table, ttable)))
     new_Freer(old_table, CACHE_MEM_FREE_TIMEOUT);
   ats_free(mapping);
   ats_free(p);
@@ -2140,6 +2304,35 @@ build_vol_hash_table(CacheHostRecord *cp)
   ats_free(rtable);
 }
 
+/*
+   When the record has vols in both tiers, objects are written to the slow
+   vols and the fast vols hold copies of the hot ones. Otherwise all the
+   vols are used alike.
+*/
+void
+build_vol_hash_table(CacheHostRecord *cp)
+{
+  bool fast = false, slow = false;
+
+  for (int i = 0; i < cp->num_vols; i++) {
+    if (DISK_BAD(cp->vols[i]->disk))
+      continue;
+    if (cp->vols[i]->disk->tier == STORE_TIER_FAST)
+      fast = true;
+    else
+      slow = true;
+  }
+  if (fast && slow) {
+    build_tier_hash_table(cp, STORE_TIER_SLOW, &cp->vol_hash_table);
+    build_tier_hash_table(cp, STORE_TIER_FAST, &cp->fast_vol_hash_table);
+  } else {
+    unsigned short *old_table = ink_atomic_swap(&cp->fast_vol_hash_table, (unsigned short *)NULL);
+    if (old_table)
+      new_Freer(old_table, CACHE_MEM_FREE_TIMEOUT);
+    build_tier_hash_table(cp, -1, &cp->vol_hash_table);
+  }
+}
+
 void
 Cache::vol_initialized(bool result) {
   if (result)
@@ -2554,6 +2747,12 @@ CacheVC::handleReadDone(int event, Event *e)
           okay = 0;
         }
       }
+      // keep the marshalled head of a hot object, see CacheVC::openReadStartHead
+      if (tier_vol && !f.tier_fast && okay && vio.op == VIO::READ && *read_key == first_key && doc->first_key == first_key &&
+          doc->single_fragment()) {
+        promote_buf = new_IOBufferData(iobuffer_size_to_index(doc->len, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+        memcpy(promote_buf->data(), doc, doc->len);
+      }
 #if TS_USE_INTERIM_CACHE == 1
     ink_assert(vol->num_interim_vols >= good_interim_disks);
     if (mts && !f.doc_from_ram_cache) {
@@ -2733,9 +2932,15 @@ LinterimRead:
   if (dir_agg_buf_valid(vol, &dir)) {
     int agg_offset = vol_offset(vol, &dir) - vol->header->write_pos;
     buf = new_IOBufferData(iobuffer_size_to_index(io.aiocb.aio_nbytes, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
-    ink_assert((agg_offset + io.aiocb.aio_nbytes) <= (unsigned) vol->agg_buf_pos);
+    char *agg = vol->agg_write_buffer + agg_offset;
+    if (agg_offset >= vol->agg_write_len) {
+      // not in the write in progress
+      agg_offset -= vol->agg_write_len;
+      agg = vol->agg_buffer + agg_offset;
+      ink_assert((agg_offset + io.aiocb.aio_nbytes) <= (unsigned) vol->agg_buf_pos);
+    } else
+      ink_assert((agg_offset + io.aiocb.aio_nbytes) <= (unsigned) vol->agg_write_len);
     char *doc = buf->data();
-    char *agg = vol->agg_buffer + agg_offset;
     memcpy(doc, agg, io.aiocb.aio_nbytes);
     io.aio_result = io.aiocb.aio_nbytes;
     SET_HANDLER(&CacheVC::handleReadDone);
@@ -2786,7 +2991,8 @@ Cache::lookup(Continuation *cont, CacheKey *key, CacheFragType type, char const*
     return ACTION_RESULT_DONE;
   }
 
-  Vol *vol = key_to_vol(key, hostname, host_len);
+  Vol *slow_vol;
+  Vol *vol = key_to_read_vol(key, hostname, host_len, &slow_vol);
   ProxyMutex *mutex = cont->mutex;
   CacheVC *c = new_CacheVC(cont);
   SET_CONTINUATION_HANDLER(c, &CacheVC::openReadStartHead);
@@ -2797,6 +3003,8 @@ Cache::lookup(Continuation *cont, CacheKey *key, CacheFragType type, char const*
   c->frag_type = type;
   c->f.lookup = 1;
   c->vol = vol;
+  c->tier_vol = slow_vol;
+  c->f.tier_fast = slow_vol != NULL;
   c->last_collision = NULL;
 
   if (c->handleEvent(EVENT_INTERVAL, 0) == EVENT_CONT)
@@ -2917,6 +3125,7 @@ Cache::remove(Continuation *cont, CacheKey *key, CacheFragType type, bool /* use
   CACHE_TRY_LOCK(lock, cont->mutex, this_ethread());
   ink_assert(lock.is_locked());
   Vol *vol = key_to_vol(key, hostname, host_len);
+  tier_invalidate(key_to_vol(key, hostname, host_len, STORE_TIER_FAST), key);
   // coverity[var_decl]
   Dir result;
   dir_clear(&result);           // initialized here, set result empty so we can recognize missed lock
@@ -3382,10 +3591,11 @@ rebuild_host_table(Cache *cache)
 
 // if generic_host_rec.vols == NULL, what do we do???
 Vol *
-Cache::key_to_vol(CacheKey *key, char const* hostname, int host_len)
+Cache::key_to_vol(CacheKey *key, char const* hostname, int host_len, int tier)
 {
   uint32_t h = (key->slice32(2) >> DIR_TAG_WIDTH) % VOL_HASH_TABLE_SIZE;
-  unsigned short *hash_table = hosttable->gen_host_rec.vol_hash_table;
+  unsigned short *hash_table = tier == STORE_TIER_FAST ? hosttable->gen_host_rec.fast_vol_hash_table
+                                                       : hosttable->gen_host_rec.vol_hash_table;
   CacheHostRecord *host_rec = &hosttable->gen_host_rec;
 
   if (hosttable->m_numEntries > 0 && host_len) {
@@ -3394,6 +3604,10 @@ Cache::key_to_vol(CacheKey *key, char const* hostname, int host_len)
     if (res.record) {
       unsigned short *host_hash_table = res.record->vol_hash_table;
       if (host_hash_table) {
+        if (tier == STORE_TIER_FAST) {
+          host_hash_table = res.record->fast_vol_hash_table;
+          return host_hash_table ? res.record->vols[host_hash_table[h]] : NULL;
+        }
         if (is_debug_tag_set("cache_hosting")) {
           char format_str[50];
           snprintf(format_str, sizeof(format_str), "Volume: %%xd for host: %%.%ds", host_len);
@@ -3410,7 +3624,9 @@ Cache::key_to_vol(CacheKey *key, char const* hostname, int host_len)
       Debug("cache_hosting", format_str, host_rec, hostname);
     }
     return host_rec->vols[hash_table[h]];
-  } else
+  } else if (tier == STORE_TIER_FAST)
+    return NULL;
+  else
     return host_rec->vols[0];
 }
 
@@ -3434,6 +3650,10 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("ram_cache.bytes_used", cache_ram_cache_bytes_stat);
   REG_INT("ram_cache.hits", cache_ram_cache_hits_stat);
   REG_INT("ram_cache.misses", cache_ram_cache_misses_stat);
+  REG_INT("ram_cache.compress.backlog", cache_ram_cache_compress_backlog_stat);
+  REG_INT("ram_cache.compress.entries", cache_ram_cache_compress_entries_stat);
+  REG_INT("ram_cache.compress.bytes_in", cache_ram_cache_compress_bytes_in_stat);
+  REG_INT("ram_cache.compress.bytes_out", cache_ram_cache_compress_bytes_out_stat);
   REG_INT("pread_count", cache_pread_count_stat);
   REG_INT("percent_full", cache_percent_full_stat);
   REG_INT("lookup.active", cache_lookup_active_stat);
@@ -3477,6 +3697,29 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("hdr_marshal_bytes", cache_hdr_marshal_bytes_stat);
   REG_INT("gc_bytes_evacuated", cache_gc_bytes_evacuated_stat);
   REG_INT("gc_frags_evacuated", cache_gc_frags_evacuated_stat);
+  REG_INT("dir_sync.count", cache_dir_sync_count_stat);
+  REG_INT("dir_sync.bytes_written", cache_dir_sync_bytes_stat);
+  REG_INT("dir_sync.time_ms", cache_dir_sync_time_stat);
+  REG_INT("dir_sync.shutdown_time_ms", cache_dir_sync_shutdown_time_stat);
+  REG_INT("startup.dir_read_time_ms", cache_startup_dir_read_time_stat);
+  REG_INT("startup.online_time_ms", cache_startup_online_time_stat);
+  REG_INT("startup.recovery_time_ms", cache_startup_recovery_time_stat);
+  REG_INT("startup.volumes_recovering", cache_startup_recovering_stat);
+  REG_INT("tier.fast.hits", cache_tier_fast_hits_stat);
+  REG_INT("tier.slow.hits", cache_tier_slow_hits_stat);
+  REG_INT("tier.promotions", cache_tier_promotions_stat);
+  REG_INT("tier.promoted_bytes", cache_tier_promoted_bytes_stat);
+  REG_INT("tier.demotions", cache_tier_demotions_stat);
+  REG_INT("tier.demoted_bytes", cache_tier_demoted_bytes_stat);
+  REG_INT("tier.invalidations", cache_tier_invalidations_stat);
+  REG_INT("agg_write.count", cache_agg_writes_stat);
+  REG_INT("agg_write.bytes", cache_agg_write_bytes_stat);
+  REG_INT("evacuate.reads", cache_evacuate_reads_stat);
+  REG_INT("evacuate.read_bytes", cache_evacuate_read_bytes_stat);
+  REG_INT("evacuate.write_bytes", cache_evacuate_write_bytes_stat);
+  REG_INT("scan.bytes", cache_scan_bytes_stat);
+  REG_INT("scan.objects", cache_scan_objects_stat);
+  REG_INT("scan.pending_bytes", cache_scan_pending_bytes_stat);
 }
 
 
@@ -3494,6 +3737,7 @@ ink_cache_init(ModuleVersion v)
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_algorithm, "proxy.config.cache.ram_cache.algorithm");
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_compress, "proxy.config.cache.ram_cache.compress");
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_compress_percent, "proxy.config.cache.ram_cache.compress_percent");
+  REC_EstablishStaticConfigInt32(cache_config_ram_cache_compress_dict_size, "proxy.config.cache.ram_cache.compress_dict_size");
   REC_EstablishStaticConfigInt32(cache_config_ram_cache_use_seen_filter, "proxy.config.cache.ram_cache.use_seen_filter");
 
   REC_EstablishStaticConfigInt32(cache_config_http_max_alts, "proxy.config.cache.limits.http.max_alts");
@@ -3503,6 +3747,14 @@ ink_cache_init(ModuleVersion v)
   Debug("cache_init", "cache_config_ram_cache_cutoff = %" PRId64 " = %" PRId64 "Mb",
         cache_config_ram_cache_cutoff, cache_config_ram_cache_cutoff / (1024 * 1024));
 
+  REC_EstablishStaticConfigInt32(cache_config_tier_promote_hits, "proxy.config.cache.tier.promote_hits");
+  // the sketch counters saturate at SKETCH_MAX, a higher count would never promote
+  if (cache_config_tier_promote_hits < 1 || cache_config_tier_promote_hits > SKETCH_MAX) {
+    Warning("proxy.config.cache.tier.promote_hits = %d is out of range [1-%d]", cache_config_tier_promote_hits, SKETCH_MAX);
+    cache_config_tier_promote_hits = cache_config_tier_promote_hits < 1 ? 1 : SKETCH_MAX;
+  }
+  Debug("cache_init", "proxy.config.cache.tier.promote_hits = %d", cache_config_tier_promote_hits);
+
   REC_EstablishStaticConfigInt32(cache_config_permit_pinning, "proxy.config.cache.permit.pinning");
   Debug("cache_init", "proxy.config.cache.permit.pinning = %d", cache_config_permit_pinning);
 
@@ -3551,6 +3803,9 @@ ink_cache_init(ModuleVersion v)
   REC_EstablishStaticConfigInt32(cache_config_agg_write_backlog, "proxy.config.cache.agg_write_backlog");
   Debug("cache_init", "proxy.config.cache.agg_write_backlog = %d", cache_config_agg_write_backlog);
 
+  REC_EstablishStaticConfigInt32(cache_config_agg_write_size, "proxy.config.cache.agg_write_size");
+  Debug("cache_init", "proxy.config.cache.agg_write_size = %d", cache_config_agg_write_size);
+
   REC_EstablishStaticConfigInt32(cache_config_enable_checksum, "proxy.config.cache.enable_checksum");
   Debug("cache_init", "proxy.config.cache.enable_checksum = %d", cache_config_enable_checksum);
 
@@ -3562,6 +3817,26 @@ ink_cache_init(ModuleVersion v)
   REC_RegisterConfigUpdateFunc("proxy.config.cache.enable_read_while_writer", update_cache_config, NULL);
   Debug("cache_init", "proxy.config.cache.enable_read_while_writer = %d", cache_config_read_while_writer);
 
+  REC_EstablishStaticConfigInt32(cache_config_url_hash, "proxy.config.cache.url_hash");
+  if (cache_config_url_hash == CACHE_URL_HASH_SIP) {
+    char *key = REC_ConfigReadString("proxy.config.cache.url_hash_key");
+    ATSHash128Sip24 h;
+
+    // The key is derived from the configured string, the stripes record a
+    // fingerprint of it so a changed key is treated like a changed hash.
+    if (key) {
+      h.update(key, strlen(key));
+      ats_free(key);
+    }
+    h.final();
+    memcpy(cache_config_url_hash_key, h.get(), sizeof(cache_config_url_hash_key));
+    cache_config_url_hash_stamp = CACHE_URL_HASH_SIP |
+      (static_cast<uint32_t>(cache_config_url_hash_key[0] ^ cache_config_url_hash_key[1]) << 8);
+  } else {
+    cache_config_url_hash = CACHE_URL_HASH_LEGACY;
+  }
+  Debug("cache_init", "proxy.config.cache.url_hash = %d", cache_config_url_hash);
+
   register_cache_stats(cache_rsb, "proxy.process.cache");
 
   const char *err = NULL;
@@ -203,6 +203,7 @@ dir_bucket_loop_check(Dir *start_dir, Dir *seg)
 void
 dir_init_segment(int s, Vol *d)
 {
+  dir_segment_dirty(s, d);
   d->header->freelist[s] = 0;
   Dir *seg = dir_segment(s, d);
   int l, b;
@@ -284,6 +285,7 @@ inline void
 unlink_from_freelist(Dir *e, int s, Vol *d)
 {
   Dir *seg = dir_segment(s, d);
+  dir_segment_dirty(s, d);
   Dir *p = dir_from_offset(dir_prev(e), seg);
   if (p)
     dir_set_next(p, dir_next(e));
@@ -300,6 +302,7 @@ dir_delete_entry(Dir *e, Dir *p, int s, Vol *d)
   Dir *seg = dir_segment(s, d);
   int no = dir_next(e);
   d->header->dirty = 1;
+  dir_segment_dirty(s, d);
   if (p) {
     unsigned int fo = d->header->freelist[s];
     unsigned int eo = dir_to_offset(e, seg);
@@ -520,6 +523,7 @@ freelist_pop(int s, Vol *d)
     return NULL;
   }
   d->header->freelist[s] = dir_next(e);
+  dir_segment_dirty(s, d);
   // if the freelist if bad, punt.
   if (dir_offset(e)) {
     dir_init_segment(s, d);
@@ -581,6 +585,7 @@ dir_free_entry(Dir *e, int s, Vol *d)
   Dir *seg = dir_segment(s, d);
   unsigned int fo = d->header->freelist[s];
   unsigned int eo = dir_to_offset(e, seg);
+  dir_segment_dirty(s, d);
   dir_set_next(e, fo);
   if (fo)
     dir_set_prev(dir_from_offset(fo, seg), eo);
@@ -624,6 +629,8 @@ Lagain:
           goto Lcont;
         }
         if (dir_valid(d, e)) {
+          if (!vol_recovery_safe(d, e))
+            goto Lcont;
           DDebug("dir_probe_hit", "found %X %X vol %d bucket %d boffset %" PRId64 "", key->slice32(0), key->slice32(1), d->fd, b, dir_offset(e));
           dir_assign(result, e);
           *last_collision = e;
@@ -711,6 +718,7 @@ Lfill:
          e, key->slice32(0), d->fd, bi, e, key->slice32(1), dir_tag(e), dir_offset(e));
   CHECK_DIR(d);
   d->header->dirty = 1;
+  dir_segment_dirty(s, d);
   CACHE_INC_DIR_USED(d->mutex);
   return 1;
 }
@@ -789,6 +797,7 @@ Lfill:
          e, key->slice32(0), d->fd, bi, e, t, dir_tag(e), dir_offset(e));
   CHECK_DIR(d);
   d->header->dirty = 1;
+  dir_segment_dirty(s, d);
   return res;
 }
 
@@ -967,6 +976,38 @@ CacheSync::aio_write(int fd, char *b, int n, off_t o)
   ink_assert(ink_aio_write(&io) >= 0);
 }
 
+static inline void
+dir_sync_stat(Vol *vol, int stat, int64_t value)
+{
+  RecIncrGlobalRawStatSum(cache_rsb, stat, value);
+  RecIncrGlobalRawStatSum(vol->cache_vol->vol_rsb, stat, value);
+}
+
+// Find the next run of segments, starting at *s, with any of the @a state
+// bits set and return its byte range in the directory, rounded out to
+// whole store blocks. A run is at most SYNC_MAX_WRITE bytes.
+static bool
+dir_sync_next_run(Vol *d, uint8_t state, int *s, off_t *start, off_t *end)
+{
+  off_t seg_bytes = d->buckets * DIR_DEPTH * SIZEOF_DIR;
+  off_t body_end = vol_dirlen(d) - ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+  int first = *s, last;
+
+  while (first < d->segments && !(d->dir_sync_state[first] & state))
+    first++;
+  if (first >= d->segments) {
+    *s = first;
+    return false;
+  }
+  last = first + 1;
+  while (last < d->segments && (d->dir_sync_state[last] & state) && (last + 1 - first) * seg_bytes <= SYNC_MAX_WRITE)
+    last++;
+  *s = last;
+  *start = vol_headerlen(d) + (first * seg_bytes) / STORE_BLOCK_SIZE * STORE_BLOCK_SIZE;
+  *end = MIN(vol_headerlen(d) + ROUND_TO_STORE_BLOCK(last * seg_bytes), body_end);
+  return true;
+}
+
 uint64_t
 dir_entries_used(Vol *d)
 {
@@ -999,12 +1040,14 @@ dir_entries_used(Vol *d)
  * operation.
  */
 
+#define AGG_WRITE_SHUTDOWN_WAIT HRTIME_SECONDS(5)
+
 void
 sync_cache_dir_on_shutdown(void)
 {
   Debug("cache_dir_sync", "sync started");
-  char *buf = NULL;
-  size_t buflen = 0;
+  ink_hrtime start_time = ink_get_hrtime_internal();
+  size_t total_bytes = 0;
 
   EThread *t = (EThread *) 0xdeadbeef;
   for (int i = 0; i < gnvol; i++) {
@@ -1018,6 +1061,11 @@ sync_cache_dir_on_shutdown(void)
       Debug("cache_dir_sync", "Dir %s: ignoring -- bad disk", d->hash_text.get());
       continue;
     }
+    if (d->recovering) {
+      // the copy on disk is still the one recovery started from
+      Debug("cache_dir_sync", "Dir %s: ignoring -- recovering", d->hash_text.get());
+      continue;
+    }
     size_t dirlen = vol_dirlen(d);
     ink_assert(dirlen > 0); // make clang happy - if not > 0 the vol is seriously messed up
     if (!d->header->dirty && !d->dir_sync_in_progress) {
@@ -1031,21 +1079,40 @@ sync_cache_dir_on_shutdown(void)
     // check if we have data in the agg buffer
     // dont worry about the cachevc s in the agg queue
     // directories have not been inserted for these writes
-    if (d->agg_buf_pos) {
+    if (d->agg_write_len || d->agg_buf_pos) {
       Debug("cache_dir_sync", "Dir %s: flushing agg buffer first", d->hash_text.get());
 
-      // set write limit
-      d->header->agg_pos = d->header->write_pos + d->agg_buf_pos;
+      // an aggregated write in progress must be done before its buffer is
+      // written again, aggWriteDone can't run as the lock is not released
+      if (d->agg_write_len) {
+        ink_hrtime wait_until = ink_get_hrtime_internal() + AGG_WRITE_SHUTDOWN_WAIT;
+        while (!ink_atomic_increment(&d->agg_io.aio_result, (int64_t) 0) && ink_get_hrtime_internal() < wait_until)
+          ink_hrtime_sleep(HRTIME_MSECONDS(1));
+        if (!ink_atomic_increment(&d->agg_io.aio_result, (int64_t) 0)) {
+          Warning("Dir %s: aggregated write still in progress, not synced", d->hash_text.get());
+          continue;
+        }
+        if (!d->agg_io.ok()) {
+          int r = pwrite(d->fd, d->agg_write_buffer, d->agg_write_len,
+                         d->header->write_pos);
+          if (r != d->agg_write_len) {
+            ink_assert(!"flusing agg buffer failed");
+            continue;
+          }
+        }
+      }
 
+      // set write limit
+      d->header->agg_pos = d->agg_buf_offset() + d->agg_buf_pos;
       int r = pwrite(d->fd, d->agg_buffer, d->agg_buf_pos,
-                     d->header->write_pos);
+                     d->agg_buf_offset());
       if (r != d->agg_buf_pos) {
         ink_assert(!"flusing agg buffer failed");
         continue;
       }
       d->header->last_write_pos = d->header->write_pos;
-      d->header->write_pos += d->agg_buf_pos;
-      ink_assert(d->header->write_pos == d->header->agg_pos);
+      d->header->write_pos = d->header->agg_pos;
+      d->agg_write_len = 0;
       d->agg_buf_pos = 0;
       d->header->write_serial++;
     }
@@ -1071,19 +1138,12 @@ sync_cache_dir_on_shutdown(void)
     }
 #endif
 
-    if (buflen < dirlen) {
-      if (buf)
-        ats_memalign_free(buf);
-      buf = (char *)ats_memalign(ats_pagesize(), dirlen);
-      buflen = dirlen;
-    }
-
     if (!d->dir_sync_in_progress) {
       d->header->sync_serial++;
     } else {
       Debug("cache_dir_sync", "Periodic dir sync in progress -- overwriting");
     }
-    d->footer->sync_serial = d->header->sync_serial;
+    vol_footer_sync(d);
 
 #if TS_USE_INTERIM_CACHE == 1
     for (int j = 0; j < d->num_interim_vols; j++) {
@@ -1091,16 +1151,43 @@ sync_cache_dir_on_shutdown(void)
     }
 #endif
     CHECK_DIR(d);
-    memcpy(buf, d->raw_dir, dirlen);
-    size_t B = d->header->sync_serial & 1;
-    off_t start = d->skip + (B ? dirlen : 0);
-    B = pwrite(d->fd, buf, dirlen, start);
-    ink_assert(B == dirlen);
-    Debug("cache_dir_sync", "done syncing dir for vol %s", d->hash_text.get());
+
+    // Nothing else can run against this vol any more, so write straight
+    // from the directory: the header first, then every segment that
+    // changed since this copy was last written (including any a periodic
+    // sync did not finish), then the footer.
+    int B = d->header->sync_serial & 1;
+    off_t base = d->skip + (B ? dirlen : 0);
+    off_t footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+    off_t run_start, run_end;
+    int s = 0;
+    size_t vol_bytes = 0;
+
+    if (pwrite(d->fd, d->raw_dir, vol_headerlen(d), base) != vol_headerlen(d)) {
+      Warning("unable to write cache directory header for '%s'", d->hash_text.get());
+      continue;
+    }
+    vol_bytes += vol_headerlen(d);
+    while (dir_sync_next_run(d, DIR_SYNC_DIRTY(B) | DIR_SYNC_WRITING(B), &s, &run_start, &run_end)) {
+      ssize_t r = pwrite(d->fd, d->raw_dir + run_start, run_end - run_start, base + run_start);
+      ink_assert(r == run_end - run_start);
+      vol_bytes += run_end - run_start;
+    }
+    ssize_t r = pwrite(d->fd, d->raw_dir + dirlen - footerlen, footerlen, base + dirlen - footerlen);
+    ink_assert(r == footerlen);
+    vol_bytes += footerlen;
+    for (s = 0; s < d->segments; s++)
+      d->dir_sync_state[s] &= ~(DIR_SYNC_DIRTY(B) | DIR_SYNC_WRITING(B));
+    d->dir_sync_in_progress = 0;
+
+    dir_sync_stat(d, cache_dir_sync_bytes_stat, vol_bytes);
+    total_bytes += vol_bytes;
+    Debug("cache_dir_sync", "done syncing dir for vol %s, %zu of %zu bytes", d->hash_text.get(), vol_bytes, dirlen);
   }
-  Debug("cache_dir_sync", "sync done");
-  if (buf)
-    ats_memalign_free(buf);
+
+  ink_hrtime elapsed = ink_get_hrtime_internal() - start_time;
+  GLOBAL_CACHE_SET_DYN_STAT(cache_dir_sync_shutdown_time_stat, ink_hrtime_to_msec(elapsed));
+  Debug("cache_dir_sync", "sync done, %zu bytes in %" PRId64 " ms", total_bytes, (int64_t)ink_hrtime_to_msec(elapsed));
 }
 
 
@@ -1132,8 +1219,10 @@ Lrestart:
     // AIO Thread
     if (io.aio_result != (int64_t)io.aiocb.aio_nbytes) {
       Warning("vol write error during directory sync '%s'", gvol[vol]->hash_text.get());
-      event = EVENT_NONE;
-      goto Ldone;
+      // the segments are marked dirty again under the vol lock
+      failed = true;
+      trigger = eventProcessor.schedule_imm(this);
+      return EVENT_CONT;
     }
     trigger = eventProcessor.schedule_in(this, SYNC_DELAY);
     return EVENT_CONT;
@@ -1148,12 +1237,31 @@ Lrestart:
 
     // recompute hit_evacuate_window
     d->hit_evacuate_window = (d->data_blocks * cache_config_hit_evacuate_percent) / 100;
+    // fast tier copies invalidated while nothing else took the lock
+    tier_drain(d);
+
+    if (failed) {
+      // this copy is now torn, write everything it was missing next time
+      size_t B = d->header->sync_serial & 1;
+      for (int s = 0; s < d->segments; s++) {
+        if (d->dir_sync_state[s] & DIR_SYNC_WRITING(B))
+          d->dir_sync_state[s] = (d->dir_sync_state[s] & ~DIR_SYNC_WRITING(B)) | DIR_SYNC_DIRTY(B);
+      }
+      d->header->dirty = 1;
+      d->dir_sync_in_progress = 0;
+      failed = false;
+      event = EVENT_NONE;
+      goto Ldone;
+    }
 
-    if (DISK_BAD(d->disk))
+    if (DISK_BAD(d->disk) || d->recovering)
       goto Ldone;
 
-    int headerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
+    int headerlen = vol_headerlen(d);
+    int footerlen = ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
     size_t dirlen = vol_dirlen(d);
+    size_t B = d->header->sync_serial & 1;
+    off_t run_start, run_end;
     if (!writepos) {
       // start
       Debug("cache_dir_sync", "sync started");
@@ -1167,7 +1275,7 @@ Lrestart:
         Debug("cache_dir_sync", "Dir %s not dirty", d->hash_text.get());
         goto Ldone;
       }
-      if (d->is_io_in_progress() || d->agg_buf_pos) {
+      if (d->is_io_in_progress() || d->agg_write_len || d->agg_buf_pos) {
         Debug("cache_dir_sync", "Dir %s: waiting for agg buffer", d->hash_text.get());
         d->dir_sync_waiting = 1;
         if (!d->is_io_in_progress())
@@ -1191,37 +1299,53 @@ Lrestart:
         buflen = dirlen;
       }
       d->header->sync_serial++;
-      d->footer->sync_serial = d->header->sync_serial;
+      vol_footer_sync(d);
 #if TS_USE_INTERIM_CACHE == 1
       for (int j = 0; j < d->num_interim_vols; j++) {
           d->interim_vols[j].header->sync_serial = d->header->sync_serial;
       }
 #endif
       CHECK_DIR(d);
-      memcpy(buf, d->raw_dir, dirlen);
+      // Snapshot only the segments that changed since this copy was last
+      // written; the rest of the copy on disk already matches memory.
+      B = d->header->sync_serial & 1;
+      memcpy(buf, d->raw_dir, headerlen);
+      for (int s = 0; s < d->segments; s++) {
+        if (d->dir_sync_state[s] & DIR_SYNC_DIRTY(B))
+          d->dir_sync_state[s] = (d->dir_sync_state[s] & ~DIR_SYNC_DIRTY(B)) | DIR_SYNC_WRITING(B);
+      }
+      for (int s = 0; dir_sync_next_run(d, DIR_SYNC_WRITING(B), &s, &run_start, &run_end);)
+        memcpy(buf + run_start, d->raw_dir + run_start, run_end - run_start);
+      memcpy(buf + dirlen - footerlen, d->raw_dir + dirlen - footerlen, footerlen);
       d->dir_sync_in_progress = 1;
+      start_time = ink_get_hrtime();
+      segment = 0;
     }
-    size_t B = d->header->sync_serial & 1;
     off_t start = d->skip + (B ? dirlen : 0);
 
+    // The header goes out first and the footer last so a torn sync leaves
+    // mismatched serials and recovery falls back to the other copy.
     if (!writepos) {
       // write header
-      aio_write(d->fd, buf + writepos, headerlen, start + writepos);
+      aio_write(d->fd, buf, headerlen, start);
       writepos += headerlen;
-    } else if (writepos < (off_t)dirlen - headerlen) {
-      // write part of body
-      int l = SYNC_MAX_WRITE;
-      if (writepos + l > (off_t)dirlen - headerlen)
-        l = dirlen - headerlen - writepos;
-      aio_write(d->fd, buf + writepos, l, start + writepos);
-      writepos += l;
-    } else if (writepos < (off_t)dirlen) {
-      ink_assert(writepos == (off_t)dirlen - headerlen);
+    } else if (dir_sync_next_run(d, DIR_SYNC_WRITING(B), &segment, &run_start, &run_end)) {
+      // write a run of changed segments
+      aio_write(d->fd, buf + run_start, run_end - run_start, start + run_start);
+      writepos += run_end - run_start;
+    } else if (segment == d->segments) {
       // write footer
-      aio_write(d->fd, buf + writepos, headerlen, start + writepos);
-      writepos += headerlen;
+      aio_write(d->fd, buf + dirlen - footerlen, footerlen, start + dirlen - footerlen);
+      writepos += footerlen;
+      segment++;
     } else {
+      for (int s = 0; s < d->segments; s++)
+        d->dir_sync_state[s] &= ~DIR_SYNC_WRITING(B);
       d->dir_sync_in_progress = 0;
+      dir_sync_stat(d, cache_dir_sync_count_stat, 1);
+      dir_sync_stat(d, cache_dir_sync_bytes_stat, writepos);
+      dir_sync_stat(d, cache_dir_sync_time_stat, ink_hrtime_to_msec(ink_get_hrtime() - start_time));
+      Debug("cache_dir_sync", "Dir %s: wrote %" PRId64 " of %zu bytes", d->hash_text.get(), (int64_t)writepos, dirlen);
       goto Ldone;
     }
     return EVENT_CONT;
@@ -1449,6 +1573,49 @@ EXCLUSIVE_REGRESSION_TEST(Cache_dir) (RegressionTest *t, int /* atype ATS_UNUSED
   int s = key.slice32(0) % d->segments, i, j;
   Dir *seg = dir_segment(s, d);
 
+  // test dirty segment tracking
+  rprintf(t, "dirty segment test\n");
+  for (i = 0; i < d->segments; i++)
+    d->dir_sync_state[i] &= ~DIR_SYNC_DIRTY_ALL;
+  dir_insert(&key, d, &dir);
+  {
+    int next = 0;
+    off_t run_start, run_end;
+    off_t seg_start = (char *)seg - d->raw_dir;
+    off_t seg_end = seg_start + d->buckets * DIR_DEPTH * SIZEOF_DIR;
+    if (d->dir_sync_state[s] != DIR_SYNC_DIRTY_ALL ||
+        !dir_sync_next_run(d, DIR_SYNC_DIRTY(0), &next, &run_start, &run_end) ||
+        run_start > seg_start || run_end < seg_end || run_start % STORE_BLOCK_SIZE || run_end % STORE_BLOCK_SIZE ||
+        dir_sync_next_run(d, DIR_SYNC_DIRTY(0), &next, &run_start, &run_end))
+      ret = REGRESSION_TEST_FAILED;
+  }
+  dir_delete(&key, d, &dir);
+  for (i = 0; i < d->segments; i++)
+    d->dir_sync_state[i] |= DIR_SYNC_DIRTY_ALL;
+
+  // test that background recovery only trusts entries behind the write position
+  rprintf(t, "recovery probe test\n");
+  {
+    Dir ahead = dir, found;
+    Dir *last_collision = 0;
+    dir_set_phase(&ahead, 1);
+    dir_set_offset(&ahead, (d->header->write_pos - d->start) / CACHE_BLOCK_SIZE + 1024);
+    d->recovering = true;
+    dir_insert(&key, d, &dir);
+    if (!dir_probe(&key, d, &found, &last_collision))
+      ret = REGRESSION_TEST_FAILED;
+    dir_delete(&key, d, &dir);
+    dir_insert(&key, d, &ahead);
+    last_collision = 0;
+    if (dir_probe(&key, d, &found, &last_collision))
+      ret = REGRESSION_TEST_FAILED;
+    d->recovering = false;
+    last_collision = 0;
+    if (!dir_probe(&key, d, &found, &last_collision))
+      ret = REGRESSION_TEST_FAILED;
+    dir_delete(&key, d, &ahead);
+  }
+
   // test insert
   rprintf(t, "insert test\n", free);
   int inserted = 0;
@@ -39,14 +39,15 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheFragType type, char *
   }
   ink_assert(caches[type] == this);
 
-  Vol *vol = key_to_vol(key, hostname, host_len);
+  Vol *slow_vol;
+  Vol *vol = key_to_read_vol(key, hostname, host_len, &slow_vol);
   Dir result, *last_collision = NULL;
   ProxyMutex *mutex = cont->mutex;
   OpenDirEntry *od = NULL;
   CacheVC *c = NULL;
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
-    if (!lock.is_locked() || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
+    if (!lock.is_locked() || slow_vol || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
       c = new_CacheVC(cont);
       SET_CONTINUATION_HANDLER(c, &CacheVC::openReadStartHead);
       c->vio.op = VIO::READ;
@@ -54,6 +55,8 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheFragType type, char *
       CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
       c->first_key = c->key = c->earliest_key = *key;
       c->vol = vol;
+      c->tier_vol = slow_vol;
+      c->f.tier_fast = slow_vol != NULL;
       c->frag_type = type;
       c->od = od;
     }
@@ -63,6 +66,8 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheFragType type, char *
       CONT_SCHED_LOCK_RETRY(c);
       return &c->_action;
     }
+    if (c->f.tier_fast) // may go on to the slow vol
+      goto Lstart;
     if (c->od)
       goto Lwriter;
     c->dir = result;
@@ -86,6 +91,10 @@ Lcallreturn:
   if (c->handleEvent(AIO_EVENT_DONE, 0) == EVENT_DONE)
     return ACTION_RESULT_DONE;
   return &c->_action;
+Lstart:
+  if (c->handleEvent(EVENT_IMMEDIATE, 0) == EVENT_DONE)
+    return ACTION_RESULT_DONE;
+  return &c->_action;
 }
 
 #ifdef HTTP_CACHE
@@ -100,7 +109,8 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheHTTPHdr * request,
   }
   ink_assert(caches[type] == this);
 
-  Vol *vol = key_to_vol(key, hostname, host_len);
+  Vol *slow_vol;
+  Vol *vol = key_to_read_vol(key, hostname, host_len, &slow_vol);
   Dir result, *last_collision = NULL;
   ProxyMutex *mutex = cont->mutex;
   OpenDirEntry *od = NULL;
@@ -108,10 +118,12 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheHTTPHdr * request,
 
   {
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
-    if (!lock.is_locked() || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
+    if (!lock.is_locked() || slow_vol || (od = vol->open_read(key)) || dir_probe(key, vol, &result, &last_collision)) {
       c = new_CacheVC(cont);
       c->first_key = c->key = c->earliest_key = *key;
       c->vol = vol;
+      c->tier_vol = slow_vol;
+      c->f.tier_fast = slow_vol != NULL;
       c->vio.op = VIO::READ;
       c->base_stat = cache_read_active_stat;
       CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
@@ -127,6 +139,10 @@ Cache::open_read(Continuation * cont, CacheKey * key, CacheHTTPHdr * request,
     }
     if (!c)
       goto Lmiss;
+    if (c->f.tier_fast) { // may go on to the slow vol
+      SET_CONTINUATION_HANDLER(c, &CacheVC::openReadStartHead);
+      goto Lstart;
+    }
     if (c->od)
       goto Lwriter;
     // hit
@@ -154,6 +170,10 @@ Lcallreturn:
   if (c->handleEvent(AIO_EVENT_DONE, 0) == EVENT_DONE)
     return ACTION_RESULT_DONE;
   return &c->_action;
+Lstart:
+  if (c->handleEvent(EVENT_IMMEDIATE, 0) == EVENT_DONE)
+    return ACTION_RESULT_DONE;
+  return &c->_action;
 }
 #endif
 
@@ -950,6 +970,7 @@ Lcallreturn:
 Lsuccess:
   if (write_vc)
     CACHE_INCREMENT_DYN_STAT(cache_read_busy_success_stat);
+  CACHE_INCREMENT_DYN_STAT(vol->disk->tier == STORE_TIER_FAST ? cache_tier_fast_hits_stat : cache_tier_slow_hits_stat);
   SET_HANDLER(&CacheVC::openReadMain);
   return callcont(CACHE_EVENT_OPEN_READ);
 }
@@ -1022,6 +1043,8 @@ CacheVC::openReadStartHead(int event, Event * e)
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
     if (!lock.is_locked())
       VC_SCHED_LOCK_RETRY();
+    if (f.tier_fast && !f.tier_counted)
+      tier_read_count(this);
     if (!buf)
       goto Lread;
     if (!io.ok())
@@ -1071,8 +1094,11 @@ CacheVC::openReadStartHead(int event, Event * e)
 #else
       goto Lread;
 #endif
-    if (f.lookup)
+    if (f.lookup) {
+      if (f.tier_fast)
+        tier_read_hit(this);
       goto Lookup;
+    }
     earliest_dir = dir;
 #ifdef HTTP_CACHE
     CacheHTTPInfo *alternate_tmp;
@@ -1177,6 +1203,17 @@ CacheVC::openReadStartHead(int event, Event * e)
       f.hit_evacuate = 1;
     }
 
+    if (f.tier_fast)
+      tier_read_hit(this);
+    if (promote_buf) {
+#ifdef HTTP_CACHE
+      // other alternates would be missing from the fast tier
+      if (frag_type != CACHE_FRAG_TYPE_HTTP || vector.count() == 1)
+#endif
+        tier_copy(tier_vol, vol, &first_key, promote_buf, &dir);
+      promote_buf = NULL;
+    }
+
     first_buf = buf;
     vol->begin_read(this);
 
@@ -1208,6 +1245,10 @@ CacheVC::openReadStartHead(int event, Event * e)
     }
   }
 Ldone:
+  if (f.tier_fast) {
+    tier_read_miss(this);
+    return openReadStartHead(EVENT_IMMEDIATE, 0);
+  }
   if (!f.lookup) {
     CACHE_INCREMENT_DYN_STAT(cache_read_failure_stat);
     _action.continuation->handleEvent(CACHE_EVENT_OPEN_READ_FAILED, (void *) -err);
@@ -1219,6 +1260,7 @@ Ldone:
 Lcallreturn:
   return handleEvent(AIO_EVENT_DONE, 0); // hopefully a tail call
 Lsuccess:
+  CACHE_INCREMENT_DYN_STAT(vol->disk->tier == STORE_TIER_FAST ? cache_tier_fast_hits_stat : cache_tier_slow_hits_stat);
   SET_HANDLER(&CacheVC::openReadMain);
   return callcont(CACHE_EVENT_OPEN_READ);
 Lookup:
@@ -1228,6 +1270,7 @@ Lookup:
 Learliest:
   first_buf = buf;
   buf = NULL;
+  promote_buf = NULL;
   earliest_key = key;
   last_collision = NULL;
   SET_HANDLER(&CacheVC::openReadStartEarliest);
@@ -26,6 +26,8 @@
 #include "P_CacheTest.h"
 #include "api/ts/ts.h"
 
+#include <algorithm>
+
 CacheTestSM::CacheTestSM(RegressionTest *t) :
   RegressionSM(t),
   timeout(0),
@@ -487,3 +489,152 @@ REGRESSION_TEST(cache_disk_replacement_stability)(RegressionTest *t, int level,
   hr1.vols = 0;
   hr2.vols = 0;
 }
+
+// run -R 3 -r ram_cache
+//
+// Trace driven simulation of the RAM cache algorithms. Each request is a
+// get, and a put of an object of the recorded size when the get misses.
+// The trace is synthetic, a Zipf popularity with a scan of objects that
+// are requested only once mixed in, unless the environment variable
+// RAM_CACHE_TRACE names an access log in squid format or with one
+// "url bytes" per line.
+
+struct RamCacheTraceRecord {
+  INK_MD5 key;
+  uint32_t size;
+};
+
+static int
+ram_cache_trace_read(const char *path, RamCacheTraceRecord *trace, int max)
+{
+  FILE *fp = fopen(path, "r");
+  char line[8192];
+  int n = 0;
+
+  if (!fp)
+    return 0;
+  while (n < max && fgets(line, sizeof(line), fp)) {
+    char *field[8], *last = NULL;
+    int nfields = 0;
+    for (char *p = strtok_r(line, " \t\r\n", &last); p && nfields < 8; p = strtok_r(NULL, " \t\r\n", &last))
+      field[nfields++] = p;
+    char *url = NULL, *bytes = NULL;
+    if (nfields == 2) {
+      url = field[0];
+      bytes = field[1];
+    } else if (nfields >= 7) {
+      url = field[6];
+      bytes = field[4];
+    } else
+      continue;
+    MD5Context().hash_immediate(trace[n].key, url, strlen(url));
+    trace[n].size = MAX(1, MIN(atoi(bytes), DEFAULT_MAX_BUFFER_SIZE));
+    n++;
+  }
+  fclose(fp);
+  return n;
+}
+
+static int
+ram_cache_trace_synthetic(RamCacheTraceRecord *trace, int max)
+{
+  static int const OBJECTS = 200000;
+  static double const ALPHA = 0.8;
+  double *cdf = (double *)ats_malloc(OBJECTS * sizeof(double));
+  double sum = 0;
+  uint64_t scan = 0;
+  InkRand rng(17);
+
+  for (int i = 0; i < OBJECTS; i++) {
+    sum += 1.0 / pow(i + 1, ALPHA);
+    cdf[i] = sum;
+  }
+  for (int n = 0; n < max; n++) {
+    uint64_t id;
+    if (rng.random() % 10 == 0) {
+      id = OBJECTS + scan++;
+    } else {
+      double u = rng.drandom() * sum;
+      id = std::lower_bound(cdf, cdf + OBJECTS, u) - cdf;
+    }
+    MD5Context().hash_immediate(trace[n].key, &id, sizeof(id));
+    trace[n].size = 1024 << (trace[n].key.slice32(2) % 6);
+  }
+  ats_free(cdf);
+  return max;
+}
+
+// Returns the hit ratio. The cache is given a volume of its own, so the
+// replay never holds the lock of a real stripe, and is destroyed afterwards.
+static double
+ram_cache_replay(RegressionTest *t, RamCache *cache, const char *name, int64_t cache_size, RamCacheTraceRecord *trace, int n)
+{
+  Vol *vol = new Vol;
+  int64_t hits = 0, hit_bytes = 0, total_bytes = 0;
+  EThread *thread = this_ethread();
+
+  // the stats still go to a real volume
+  vol->cache_vol = theCache->key_to_vol(&trace[0].key, "example.com", sizeof("example.com") - 1)->cache_vol;
+  {
+    MUTEX_LOCK(lock, vol->mutex, thread);
+    cache->init(cache_size, vol);
+    for (int i = 0; i < n; i++) {
+      Ptr<IOBufferData> data;
+      total_bytes += trace[i].size;
+      if (cache->get(&trace[i].key, &data)) {
+        hits++;
+        hit_bytes += trace[i].size;
+      } else {
+        data = new_IOBufferData(iobuffer_size_to_index(trace[i].size, MAX_BUFFER_SIZE_INDEX), MEMALIGNED);
+        cache->put(&trace[i].key, data, trace[i].size);
+      }
+    }
+  }
+  delete cache;
+  delete vol;
+  rprintf(t, "RamCache %s cache size %" PRId64 "MB: hit ratio %.3f, byte hit ratio %.3f\n", name, cache_size >> 20,
+          (double)hits / n, total_bytes ? (double)hit_bytes / total_bytes : 0.0);
+  return (double)hits / n;
+}
+
+REGRESSION_TEST(ram_cache)(RegressionTest *t, int level, int *pstatus) {
+  static int const MAX_REQUESTS = 1000000;
+
+  // Only run at the highest levels.
+  if (REGRESSION_TEST_EXTENDED > level) {
+    *pstatus = REGRESSION_TEST_PASSED;
+    return;
+  }
+  if (cacheProcessor.IsCacheEnabled() != CACHE_INITIALIZED) {
+    rprintf(t, "cache not initialized");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+
+  RamCacheTraceRecord *trace = (RamCacheTraceRecord *)ats_malloc(MAX_REQUESTS * sizeof(RamCacheTraceRecord));
+  const char *path = getenv("RAM_CACHE_TRACE");
+  int n;
+  if (path) {
+    n = ram_cache_trace_read(path, trace, MAX_REQUESTS);
+    rprintf(t, "RamCache replaying %d requests from %s\n", n, path);
+  } else
+    n = ram_cache_trace_synthetic(trace, MAX_REQUESTS);
+  if (!n) {
+    rprintf(t, "no requests in the trace");
+    ats_free(trace);
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  for (int s = 26; s <= 29; s++) {
+    int64_t cache_size = 1LL << s;
+    double lru = ram_cache_replay(t, new_RamCacheLRU(), "LRU", cache_size, trace, n);
+    ram_cache_replay(t, new_RamCacheCLFUS(), "CLFUS", cache_size, trace, n);
+    double tinylfu = ram_cache_replay(t, new_RamCacheTinyLFU(), "W-TinyLFU", cache_size, trace, n);
+    // The synthetic trace is built to defeat plain LRU.
+    if (!path && tinylfu < lru)
+      *pstatus = REGRESSION_TEST_FAILED;
+  }
+  ats_free(trace);
+}
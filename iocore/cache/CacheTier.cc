@@ -0,0 +1,422 @@
+/** @file
+
+  Copying objects between the fast and the slow storage tier.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// When a host record has vols in both tiers (see build_vol_hash_table),
+// objects are written to their slow vol only.  Each key also maps to a
+// fast vol, which holds copies of hot objects:
+//
+// - reads start in the fast vol, and go on to the slow vol if it has no
+//   copy; lookups are counted in a frequency sketch kept by the fast vol,
+// - a head read from the slow vol of a key that has been looked up often
+//   enough is copied to the fast vol (promotion),
+// - a write or remove of the key deletes the fast copy before it goes
+//   ahead, and again when a write closes; if the fast vol is busy the key
+//   is queued on it and the copy is deleted by whoever takes its lock next,
+// - a hot fast copy about to be overwritten is evacuated, and copied back
+//   to the slow vol if the slow vol has lost the object (demotion).
+//
+// Copies are written through the aggregation buffer of the target vol like
+// evacuated documents, and only objects which fit in their head fragment
+// are copied, so a copy is a single directory entry.
+
+#include "P_Cache.h"
+
+#define TIER_SKETCH_MAX_WIDTH (1 << 20)
+#define TIER_DEMOTE_WINDOW_PERCENT 10 // of the fast vol ahead of the write position
+
+ClassAllocator<TierStaleKey> tierStaleKeyAllocator("tierStaleKey");
+
+static bool
+within_demote_window(Vol *vol, Dir *xdir)
+{
+  off_t oft = dir_offset(xdir) - 1;
+  off_t write_off = (vol->header->write_pos + vol->agg_size - vol->start) / CACHE_BLOCK_SIZE;
+  off_t window = vol->data_blocks * TIER_DEMOTE_WINDOW_PERCENT / 100;
+  off_t delta = oft - write_off;
+  if (delta >= 0)
+    return delta < window;
+  else
+    return -delta > (vol->data_blocks - window) && -delta < vol->data_blocks;
+}
+
+static void
+tier_delete(Vol *vol, CacheKey *key)
+{
+  ProxyMutex *mutex = vol->mutex;
+  Dir dir, *last_collision = NULL;
+
+  while (dir_probe(key, vol, &dir, &last_collision)) {
+    DDebug("cache_tier", "invalidate %X in %s", key->slice32(0), vol->hash_text.get());
+    dir_delete(key, vol, &dir);
+    last_collision = NULL;
+    CACHE_INCREMENT_DYN_STAT(cache_tier_invalidations_stat);
+  }
+}
+
+// The copy is still wanted if the target has no entry for the key, and the
+// source still has the entry it was copied from, without a writer.
+static bool
+tier_copy_valid(CacheVC *c)
+{
+  Dir dir, *last_collision = NULL;
+
+  if (dir_probe(&c->first_key, c->vol, &dir, &last_collision))
+    return false;
+  CACHE_TRY_LOCK(lock, c->tier_vol->mutex, c->mutex->thread_holding);
+  if (!lock.is_locked() || c->tier_vol->open_read(&c->first_key))
+    return false;
+  last_collision = NULL;
+  while (dir_probe(&c->first_key, c->tier_vol, &dir, &last_collision))
+    if (dir_offset(&dir) == dir_offset(&c->first_dir))
+      return true;
+  return false;
+}
+
+/*
+   A read of a key with a fast vol starts in the fast vol, with the slow vol
+   in @a slow_vol to fall back to, see tier_read_miss. The lookup is counted
+   once the read holds the lock of the fast vol, see tier_read_count.
+*/
+Vol *
+Cache::key_to_read_vol(CacheKey *key, char const* hostname, int host_len, Vol **slow_vol)
+{
+  Vol *vol = key_to_vol(key, hostname, host_len);
+  Vol *fast = key_to_vol(key, hostname, host_len, STORE_TIER_FAST);
+
+  *slow_vol = NULL;
+  if (!fast || DISK_BAD(fast->disk))
+    return vol;
+  *slow_vol = vol;
+  return fast;
+}
+
+// Called with the lock of the fast vol, before the read probes it.
+void
+tier_read_count(CacheVC *c)
+{
+  Vol *fast = c->vol;
+
+  ink_assert(fast->mutex->thread_holding == this_ethread());
+  tier_drain(fast);
+  if (!fast->tier_sketch.initialized())
+    fast->tier_sketch.init(MIN((int64_t)vol_direntries(fast), (int64_t)TIER_SKETCH_MAX_WIDTH));
+  fast->tier_sketch.touch(&c->first_key);
+  c->f.tier_hot = fast->tier_sketch.frequency(&c->first_key) >= cache_config_tier_promote_hits;
+  c->f.tier_counted = 1;
+}
+
+// Called with the lock of the fast vol, once the head in c->dir is known good.
+void
+tier_read_hit(CacheVC *c)
+{
+  Vol *fast = c->vol;
+
+  // keep it if it is about to be overwritten, see Vol::evacuateDocReadDone
+  if (c->f.tier_hot && dir_head(&c->dir) && within_demote_window(fast, &c->dir) && !evacuation_block_exists(&c->dir, fast))
+    fast->force_evacuate_head(&c->dir, 0)->f.demote = 1;
+  c->tier_vol = NULL;
+  c->f.tier_fast = 0;
+}
+
+/*
+   The fast vol has no usable copy: restart the read in the slow vol, and
+   promote the head read from there if the key is hot.
+*/
+void
+tier_read_miss(CacheVC *c)
+{
+  Vol *fast = c->vol;
+
+  DDebug("cache_tier", "read %X missed %s", c->first_key.slice32(0), fast->hash_text.get());
+  c->vol = c->tier_vol;
+  c->tier_vol = (c->f.tier_hot && !c->f.lookup) ? fast : NULL;
+  c->f.tier_fast = 0;
+  c->f.hit_evacuate = 0;
+  c->key = c->first_key;
+  c->buf = NULL;
+  c->last_collision = NULL;
+}
+
+/*
+   Copy the raw head document in @a data, read from @a dir of @a from, to
+   @a to. The caller holds the lock of @a from.
+*/
+void
+tier_copy(Vol *to, Vol *from, CacheKey *key, IOBufferData *data, Dir *dir)
+{
+  ink_assert(from->mutex->thread_holding == this_ethread());
+  if (DISK_BAD(to->disk))
+    return;
+  Vol *vol = to;
+  ProxyMutex *mutex = from->mutex;
+  CacheVC *c = new_CacheVC(from);
+  c->base_stat = cache_evacuate_active_stat;
+  CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
+  c->vol = to;
+  c->tier_vol = from;
+  c->mutex = to->mutex;
+  c->buf = data;
+  c->f.evacuator = 1;
+  c->first_key = c->key = *key;
+  c->earliest_key = zero_key;
+  c->overwrite_dir = c->first_dir = *dir;
+  SET_CONTINUATION_HANDLER(c, &CacheVC::tierCopy);
+  c->trigger = eventProcessor.schedule_imm(c, ET_CALL);
+}
+
+/*
+   Delete the copy of @a key from @a fast before a write or remove of the
+   key goes ahead, so that no read finds the old copy afterwards. This runs
+   on the thread of the writer, often with the slow vol locked, so it does
+   not wait for the fast vol: if its lock is busy the key is queued on it,
+   and every user of a fast vol calls tier_drain once it holds the lock,
+   before it looks for a copy.
+*/
+void
+tier_invalidate(Vol *fast, CacheKey *key)
+{
+  if (!fast)
+    return;
+  CACHE_TRY_LOCK(lock, fast->mutex, this_ethread());
+  if (lock.is_locked()) {
+    tier_drain(fast);
+    tier_delete(fast, key);
+    return;
+  }
+  TierStaleKey *s = tierStaleKeyAllocator.alloc();
+  s->key = *key;
+  fast->tier_stale.push(s);
+}
+
+// Delete the copies queued by tier_invalidate, with the lock of @a fast.
+void
+tier_drain(Vol *fast)
+{
+  ink_assert(fast->mutex->thread_holding == this_ethread());
+  if (fast->tier_stale.empty())
+    return;
+  SList(TierStaleKey, link) stale(fast->tier_stale.popall());
+  TierStaleKey *s;
+  while ((s = stale.pop())) {
+    tier_delete(fast, &s->key);
+    tierStaleKeyAllocator.free(s);
+  }
+}
+
+/*
+   Called for a head evacuated from @a fast with the demote flag, instead
+   of rewriting it to @a fast. The copy is dropped by CacheVC::tierCopy if
+   the slow vol still has the object.
+*/
+void
+tier_demote(Vol *fast, Doc *doc, IOBufferData *data, Dir *dir)
+{
+  tier_drain(fast);
+  // the host name is not known here, so the slow vol is ambiguous with hosting
+  if (fast->disk->tier != STORE_TIER_FAST || fast->cache->hosttable->m_numEntries > 0)
+    return;
+  if (!dir_head(dir) || !dir_compare_tag(dir, &doc->first_key) || !doc->single_fragment())
+    return;
+  if (fast->tier_sketch.frequency(&doc->first_key) < cache_config_tier_promote_hits)
+    return;
+  Vol *slow = fast->cache->key_to_vol(&doc->first_key, NULL, 0);
+  if (!slow || slow->disk->tier != STORE_TIER_SLOW)
+    return;
+  DDebug("cache_tier", "demote %X from %s to %s", doc->first_key.slice32(0), fast->hash_text.get(), slow->hash_text.get());
+  tier_copy(slow, fast, &doc->first_key, data, dir);
+}
+
+int
+CacheVC::tierCopy(int event, Event *e)
+{
+  cancel_trigger();
+  ink_assert(vol->mutex->thread_holding == this_ethread());
+  Doc *doc = (Doc *) buf->data();
+  agg_len = vol->round_to_approx_size(doc->len);
+  if (agg_len > AGG_SIZE || vol->agg_todo_size + agg_len > (uint32_t)cache_config_agg_write_backlog ||
+      !tier_copy_valid(this)) {
+    DDebug("cache_tier", "copy %X to %s dropped", first_key.slice32(0), vol->hash_text.get());
+    return free_CacheVC(this);
+  }
+  vol->agg_todo_size += agg_len;
+  SET_HANDLER(&CacheVC::tierCopyDone);
+  vol->agg.enqueue(this);
+  if (!vol->is_io_in_progress())
+    return vol->aggWrite(event, e);
+  return EVENT_CONT;
+}
+
+// Called by Vol::aggWrite once the copy is in the aggregation buffer.
+int
+CacheVC::tierCopyDone(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  ink_assert(vol->mutex->thread_holding == this_ethread());
+  tier_drain(vol);
+  dir_set_approx_size(&dir, agg_len);
+  if (tier_copy_valid(this)) {
+    DDebug("cache_tier", "copied %X to %s offset %" PRId64, first_key.slice32(0), vol->hash_text.get(), dir_offset(&dir));
+    dir_insert(&first_key, vol, &dir);
+    if (vol->disk->tier == STORE_TIER_FAST) {
+      CACHE_INCREMENT_DYN_STAT(cache_tier_promotions_stat);
+      CACHE_SUM_DYN_STAT(cache_tier_promoted_bytes_stat, agg_len);
+    } else {
+      CACHE_INCREMENT_DYN_STAT(cache_tier_demotions_stat);
+      CACHE_SUM_DYN_STAT(cache_tier_demoted_bytes_stat, agg_len);
+    }
+  }
+  return free_CacheVC(this);
+}
+
+//
+// Regression
+//
+
+struct TierRegressionInvalidate: public Continuation
+{
+  Vol *fast;
+  CacheKey key;
+  volatile int done;
+
+  int invalidate(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    tier_invalidate(fast, &key);
+    ink_atomic_swap(&done, 1);
+    return EVENT_DONE;
+  }
+
+  TierRegressionInvalidate(Vol *v, CacheKey *k)
+    : Continuation(new_ProxyMutex()), fast(v), key(*k), done(0)
+  {
+    SET_HANDLER(&TierRegressionInvalidate::invalidate);
+  }
+};
+
+// The fast vol is gvol[0], the tier of its disk does not matter here.
+EXCLUSIVE_REGRESSION_TEST(Cache_tier) (RegressionTest *t, int /* atype ATS_UNUSED */, int *status) {
+  int ret = REGRESSION_TEST_PASSED;
+
+  if ((CacheProcessor::IsCacheEnabled() != CACHE_INITIALIZED) || gnvol < 1) {
+    rprintf(t, "cache not ready/configured");
+    *status = REGRESSION_TEST_FAILED;
+    return;
+  }
+  Vol *d = gvol[0];
+  Vol *slow = gnvol > 1 ? gvol[1] : gvol[0];
+  EThread *thread = this_ethread();
+  MUTEX_TRY_LOCK(lock, d->mutex, thread);
+  ink_release_assert(lock.is_locked());
+
+  CacheKey key;
+  rand_CacheKey(&key, thread->mutex);
+  Dir dir, found, *last_collision;
+  dir_clear(&dir);
+  dir_set_phase(&dir, d->header->phase);
+  dir_set_head(&dir, true);
+  dir_set_offset(&dir, 1);
+
+  // promote: the key is hot once it has been read promote_hits times, and
+  // a miss in the fast vol then reads the slow vol and copies back
+  rprintf(t, "promote test\n");
+  {
+    Vol *vol = d;
+    ProxyMutex *mutex = d->mutex;
+    CacheVC *c = new_CacheVC(d);
+    c->base_stat = cache_read_active_stat;
+    CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
+    c->vol = d;
+    c->tier_vol = slow;
+    c->f.tier_fast = 1;
+    c->first_key = key;
+    for (int i = 0; i < cache_config_tier_promote_hits; i++) {
+      tier_read_count(c);
+      if (c->f.tier_hot != (d->tier_sketch.frequency(&key) >= cache_config_tier_promote_hits))
+        ret = REGRESSION_TEST_FAILED;
+    }
+    if (!c->f.tier_hot)
+      ret = REGRESSION_TEST_FAILED;
+    tier_read_miss(c);
+    if (c->vol != slow || c->tier_vol != d || c->f.tier_fast)
+      ret = REGRESSION_TEST_FAILED;
+    c->vol = d; // where it was counted active
+    free_CacheVC(c);
+  }
+
+  // demote: only copies about to be overwritten are kept
+  rprintf(t, "demote window test\n");
+  {
+    off_t write_off = (d->header->write_pos + d->agg_size - d->start) / CACHE_BLOCK_SIZE;
+    Dir ahead = dir, behind = dir;
+    dir_set_offset(&ahead, write_off + 2);
+    if (!within_demote_window(d, &ahead))
+      ret = REGRESSION_TEST_FAILED;
+    if (write_off > d->data_blocks / 2) {
+      dir_set_offset(&behind, write_off - d->data_blocks / 2);
+      if (within_demote_window(d, &behind))
+        ret = REGRESSION_TEST_FAILED;
+    }
+  }
+
+  // invalidate with the fast vol free
+  rprintf(t, "invalidate test\n");
+  dir_insert(&key, d, &dir);
+  tier_invalidate(d, &key);
+  last_collision = NULL;
+  if (dir_probe(&key, d, &found, &last_collision))
+    ret = REGRESSION_TEST_FAILED;
+
+  // invalidate from another thread while the fast vol is busy, the copy
+  // stays until the next user of the fast vol drains the queue
+  EThread *other = NULL;
+  for (int i = 0; i < eventProcessor.n_ethreads && !other; i++)
+    if (eventProcessor.all_ethreads[i] != thread && eventProcessor.all_ethreads[i]->tt == REGULAR)
+      other = eventProcessor.all_ethreads[i];
+  if (other) {
+    rprintf(t, "busy invalidate test\n");
+    dir_insert(&key, d, &dir);
+    TierRegressionInvalidate *inv = new TierRegressionInvalidate(d, &key);
+    other->schedule_imm(inv);
+    ink_hrtime timeout = ink_get_hrtime_internal() + HRTIME_SECONDS(5);
+    while (!inv->done && ink_get_hrtime_internal() < timeout)
+      ink_hrtime_sleep(HRTIME_MSECONDS(1));
+    if (!inv->done) {
+      rprintf(t, "busy invalidate timed out\n");
+      ret = REGRESSION_TEST_FAILED;
+    } else {
+      last_collision = NULL;
+      if (!dir_probe(&key, d, &found, &last_collision) || d->tier_stale.empty())
+        ret = REGRESSION_TEST_FAILED;
+      tier_drain(d);
+      last_collision = NULL;
+      if (dir_probe(&key, d, &found, &last_collision) || !d->tier_stale.empty())
+        ret = REGRESSION_TEST_FAILED;
+      delete inv;
+    }
+    last_collision = NULL;
+    while (dir_probe(&key, d, &found, &last_collision)) {
+      dir_delete(&key, d, &found);
+      last_collision = NULL;
+    }
+  }
+
+  *status = ret;
+}
@@ -28,6 +28,16 @@
 #define SCAN_BUF_SIZE      RECOVERY_SIZE
 #define SCAN_WRITER_LOCK_MAX_RETRY 5
 
+// A parallel scan reads each vol with a CacheVC of its own. They all have
+// the mutex of the caller, which serializes the callbacks and the updates
+// of this state, shared by them.
+struct CacheScanState
+{
+  Action action;  // returned to the caller
+  int pending;    // vols still being scanned
+  void *result;   // of the first vol which failed
+};
+
 Action *
 Cache::scan(Continuation * cont, char *hostname, int host_len, int KB_per_second)
 {
@@ -87,6 +97,81 @@ Ldone:
   return free_CacheVC(this);
 }
 
+Action *
+Cache::scan_parallel(Continuation *cont, char *hostname, int host_len, int KB_per_second)
+{
+  Debug("cache_scan_truss", "inside scan_parallel");
+  if (!CacheProcessor::IsCacheReady(CACHE_FRAG_TYPE_HTTP)) {
+    cont->handleEvent(CACHE_EVENT_SCAN_FAILED, 0);
+    return ACTION_RESULT_DONE;
+  }
+
+  CacheHostRecord *rec = &hosttable->gen_host_rec;
+  if (host_len) {
+    CacheHostResult res;
+    hosttable->Match(hostname, host_len, &res);
+    if (res.record)
+      rec = res.record;
+  }
+  CacheScanState *state = new CacheScanState;
+  state->action = cont;
+  state->pending = rec->num_vols;
+  state->result = NULL;
+  if (!state->pending) {
+    cont->handleEvent(CACHE_EVENT_SCAN, &state->action);
+    cont->handleEvent(CACHE_EVENT_SCAN_DONE, NULL);
+    delete state;
+    return ACTION_RESULT_DONE;
+  }
+  // each vol gets its share of the rate
+  int msec_delay = KB_per_second > 0 ? (int) ((int64_t) SCAN_BUF_SIZE * rec->num_vols / KB_per_second) : 0;
+  for (int i = 0; i < rec->num_vols; i++) {
+    CacheVC *c = new_CacheVC(cont);
+    c->vol = rec->vols[i];
+    c->scan_state = state;
+    c->base_stat = cache_scan_active_stat;
+    c->buf = new_IOBufferData(BUFFER_SIZE_FOR_XMALLOC(SCAN_BUF_SIZE), MEMALIGNED);
+    c->scan_msec_delay = msec_delay;
+    c->offset = 0;
+    c->fragment = 0;
+    SET_CONTINUATION_HANDLER(c, &CacheVC::scanObject);
+    eventProcessor.schedule_imm(c, ET_CALL);
+  }
+  cont->handleEvent(CACHE_EVENT_SCAN, &state->action);
+  return &state->action;
+}
+
+// The vol of @a c is done, or the parallel scan was cancelled.
+static int
+scan_vol_done(CacheVC *c, void *result)
+{
+  CacheScanState *state = c->scan_state;
+  Vol *vol = c->vol;
+  ProxyMutex *mutex = c->mutex;
+
+  CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, -(int64_t) c->scan_pending);
+  c->scan_pending = 0;
+  c->scan_state = NULL;
+  if (result && !state->result)
+    state->result = result;
+  if (!--state->pending) {
+    if (!state->action.cancelled)
+      state->action.continuation->handleEvent(CACHE_EVENT_SCAN_DONE, state->result);
+    delete state;
+  }
+  return free_CacheVC(c);
+}
+
+// Issue the read set up by scanObject, once the rate allows it.
+int
+CacheVC::scanRead(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+{
+  Debug("cache_scan_truss", "inside %p:scanRead", this);
+  SET_HANDLER(&CacheVC::scanObject);
+  ink_assert(ink_aio_read(&io) >= 0);
+  return EVENT_CONT;
+}
+
 /* Next block with some data in it in this partition.  Returns end of partition if no more
  * locations.
  *
@@ -164,8 +249,12 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
 
   cancel_trigger();
   set_io_not_in_progress();
-  if (_action.cancelled)
+  if (scan_state && scan_state->action.cancelled)
+    return scan_vol_done(this, NULL);
+  if (_action.cancelled) {
+    CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, -(int64_t) scan_pending);
     return free_CacheVC(this);
+  }
 
   CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
   if (!lock.is_locked()) {
@@ -177,6 +266,8 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   if (!fragment) {               // initialize for first read
     fragment = 1;
     scan_vol_map = make_vol_map(vol);
+    scan_pending = vol->skip + vol->len - vol_offset_to_offset(vol, 0);
+    CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, scan_pending);
     io.aiocb.aio_offset = next_in_map(vol, scan_vol_map, vol_offset_to_offset(vol, 0));
     if (io.aiocb.aio_offset >= (off_t)(vol->skip + vol->len))
       goto Ldone;
@@ -268,6 +359,7 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
           continue;
       }
       earliest_key = key;
+      CACHE_INCREMENT_DYN_STAT(cache_scan_objects_stat);
       int result1 = _action.continuation->handleEvent(CACHE_EVENT_SCAN_OBJECT, vector.get(i));
       switch (result1) {
       case CACHE_SCAN_RESULT_CONTINUE:
@@ -347,6 +439,10 @@ CacheVC::scanObject(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
   }
 
   if (io.aiocb.aio_offset >= vol->skip + vol->len) {
+    if (scan_state)
+      goto Ldone;
+    CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, -(int64_t) scan_pending);
+    scan_pending = 0;
     SET_HANDLER(&CacheVC::scanVol);
     eventProcessor.schedule_in(this, HRTIME_MSECONDS(scan_msec_delay));
     return EVENT_CONT;
@@ -357,6 +453,18 @@ Lread:
   if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(vol->skip + vol->len))
     io.aiocb.aio_nbytes = vol->skip + vol->len - io.aiocb.aio_offset;
   offset = 0;
+  {
+    // whatever is before the read has been scanned or skipped
+    off_t pending = vol->skip + vol->len - io.aiocb.aio_offset;
+    CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, pending - scan_pending);
+    CACHE_SUM_DYN_STAT(cache_scan_bytes_stat, io.aiocb.aio_nbytes);
+    scan_pending = pending;
+  }
+  if (scan_state && scan_msec_delay) {
+    SET_HANDLER(&CacheVC::scanRead);
+    eventProcessor.schedule_in(this, HRTIME_MSECONDS(scan_msec_delay));
+    return EVENT_CONT;
+  }
   ink_assert(ink_aio_read(&io) >= 0);
   Debug("cache_scan_truss", "read %p:scanObject %" PRId64 " %zu", this,
         (int64_t)io.aiocb.aio_offset, (size_t)io.aiocb.aio_nbytes);
@@ -364,11 +472,20 @@ Lread:
 
 Ldone:
    Debug("cache_scan_truss", "done %p:scanObject", this);
+  if (scan_state)
+    return scan_vol_done(this, result);
+  CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, -(int64_t) scan_pending);
   _action.continuation->handleEvent(CACHE_EVENT_SCAN_DONE, result);
+  return free_CacheVC(this);
 #ifdef HTTP_CACHE
 Lcancel:
-#endif
+  if (scan_state) {
+    scan_state->action.cancelled = 1;
+    return scan_vol_done(this, NULL);
+  }
+  CACHE_SUM_DYN_STAT(cache_scan_pending_bytes_stat, -(int64_t) scan_pending);
   return free_CacheVC(this);
+#endif
 }
 
 int
@@ -188,7 +188,7 @@ CacheVC::handleWrite(int event, Event */* e ATS_UNUSED */)
   vol->agg_todo_size += agg_len;
   bool agg_error =
     (agg_len > AGG_SIZE || header_len + sizeofDoc > MAX_FRAG_SIZE ||
-     (!f.readers && (vol->agg_todo_size > cache_config_agg_write_backlog + AGG_SIZE) && write_len));
+     (!f.readers && (vol->agg_todo_size > cache_config_agg_write_backlog + vol->agg_size) && write_len));
 #ifdef CACHE_AGG_FAIL_RATE
   agg_error = agg_error || ((uint32_t) mutex->thread_holding->generator.random() <
                             (uint32_t) (UINT_MAX * CACHE_AGG_FAIL_RATE));
@@ -271,9 +271,9 @@ Vol::scan_for_pinned_documents()
 {
   if (cache_config_permit_pinning) {
     // we can't evacuate anything between header->write_pos and
-    // header->write_pos + AGG_SIZE.
-    int ps = offset_to_vol_offset(this, header->write_pos + AGG_SIZE);
-    int pe = offset_to_vol_offset(this, header->write_pos + 2 * EVACUATION_SIZE + (len / PIN_SCAN_EVERY));
+    // header->write_pos + agg_size.
+    int ps = offset_to_vol_offset(this, header->write_pos + agg_size);
+    int pe = offset_to_vol_offset(this, header->write_pos + 2 * evacuation_size() + (len / PIN_SCAN_EVERY));
     int vol_end_offset = offset_to_vol_offset(this, len + skip);
     int before_end_of_vol = pe < vol_end_offset;
     DDebug("cache_evac", "scan %d %d", ps, pe);
@@ -297,6 +297,18 @@ Vol::scan_for_pinned_documents()
   }
 }
 
+VolAggWrite::VolAggWrite(Vol *v)
+  : Continuation(v->mutex), vol(v)
+{
+  SET_HANDLER(&VolAggWrite::handle_write_done);
+}
+
+int
+VolAggWrite::handle_write_done(int event, Event *e)
+{
+  return vol->aggWriteDone(event, e);
+}
+
 /* NOTE:: This state can be called by an AIO thread, so DON'T DON'T
    DON'T schedule any events on this thread using VC_SCHED_XXX or
    mutex->thread_holding->schedule_xxx_local(). ALWAYS use
@@ -311,40 +323,55 @@ Vol::aggWriteDone(int event, Event *e)
   // retaking the current mutex recursively is a NOOP
   CACHE_TRY_LOCK(lock, dir_sync_waiting ? cacheDirSync->mutex : mutex, mutex->thread_holding);
   if (!lock.is_locked()) {
-    eventProcessor.schedule_in(this, HRTIME_MSECONDS(cache_config_mutex_retry_delay));
+    eventProcessor.schedule_in(agg_write_cont, HRTIME_MSECONDS(cache_config_mutex_retry_delay));
     return EVENT_CONT;
   }
-  if (io.ok()) {
-    header->last_write_pos = header->write_pos;
-    header->write_pos += io.aiocb.aio_nbytes;
-    ink_assert(header->write_pos >= start);
-    DDebug("cache_agg", "Dir %s, Write: %" PRIu64 ", last Write: %" PRIu64 "\n",
-          hash_text.get(), header->write_pos, header->last_write_pos);
-    ink_assert(header->write_pos == header->agg_pos);
-    if (header->write_pos + EVACUATION_SIZE > scan_pos)
-      periodic_scan();
-    agg_buf_pos = 0;
-    header->write_serial++;
-  } else {
+  if (!agg_io.ok()) {
     // delete all the directory entries that we inserted
-    // for fragments is this aggregation buffer
+    // for fragments is this aggregation buffer, heads are
+    // also under the first key
     Debug("cache_disk_error", "Write error on disk %s\n \
               write range : [%" PRIu64 " - %" PRIu64 " bytes]  [%" PRIu64 " - %" PRIu64 " blocks] \n",
-          hash_text.get(), (uint64_t)io.aiocb.aio_offset,
-          (uint64_t)io.aiocb.aio_offset + io.aiocb.aio_nbytes,
-          (uint64_t)io.aiocb.aio_offset / CACHE_BLOCK_SIZE,
-          (uint64_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) / CACHE_BLOCK_SIZE);
+          hash_text.get(), (uint64_t)agg_io.aiocb.aio_offset,
+          (uint64_t)agg_io.aiocb.aio_offset + agg_io.aiocb.aio_nbytes,
+          (uint64_t)agg_io.aiocb.aio_offset / CACHE_BLOCK_SIZE,
+          (uint64_t)(agg_io.aiocb.aio_offset + agg_io.aiocb.aio_nbytes) / CACHE_BLOCK_SIZE);
     Dir del_dir;
     dir_clear(&del_dir);
-    for (int done = 0; done < agg_buf_pos;) {
-      Doc *doc = (Doc *) (agg_buffer + done);
-      dir_set_offset(&del_dir, header->write_pos + done);
+    for (int done = 0; done < agg_write_len;) {
+      Doc *doc = (Doc *) (agg_write_buffer + done);
+      dir_set_offset(&del_dir, offset_to_vol_offset(this, header->write_pos + done));
       dir_delete(&doc->key, this, &del_dir);
+      if (doc->hlen)
+        dir_delete(&doc->first_key, this, &del_dir);
       done += round_to_approx_size(doc->len);
     }
-    agg_buf_pos = 0;
+    // the sync writers in this buffer fail, and don't insert their head
+    CacheVC *n = NULL;
+    for (CacheVC *c = sync.head; c; c = n) {
+      n = (CacheVC *) c->link.next;
+      off_t o = vol_offset(this, &c->dir);
+      if (o >= header->write_pos && o < header->write_pos + agg_write_len) {
+        sync.remove(c);
+        c->io.aio_result = AIO_SOFT_FAILURE;
+        c->initial_thread->schedule_imm_signal(c, AIO_EVENT_DONE);
+      }
+    }
   }
-  set_io_not_in_progress();
+  // The range is skipped even if the write failed, the documents
+  // aggregated meanwhile have been placed after it. Nothing is left
+  // pointing into it.
+  header->last_write_pos = header->write_pos;
+  header->write_pos += agg_write_len;
+  ink_assert(header->write_pos >= start);
+  DDebug("cache_agg", "Dir %s, Write: %" PRIu64 ", last Write: %" PRIu64 "\n",
+        hash_text.get(), header->write_pos, header->last_write_pos);
+  ink_assert(header->write_pos == header->agg_pos);
+  if (header->write_pos + evacuation_size() > scan_pos)
+    periodic_scan();
+  agg_write_len = 0;
+  if (agg_io.ok())
+    header->write_serial++;
   // callback ready sync CacheVCs
   CacheVC *c = 0;
   while ((c = sync.dequeue())) {
@@ -359,7 +386,8 @@ Vol::aggWriteDone(int event, Event *e)
     dir_sync_waiting = 0;
     cacheDirSync->handleEvent(EVENT_IMMEDIATE, 0);
   }
-  if (agg.head || sync.head)
+  // an evacuation read in progress calls aggWrite when it is done
+  if ((agg.head || sync.head || agg_buf_pos) && !is_io_in_progress())
     return aggWrite(event, e);
   return EVENT_CONT;
 }
@@ -578,8 +606,8 @@ evacuate_fragments(CacheKey *key, CacheKey *earliest_key, int force, Vol *vol)
   return i;
 }
 
-int
-Vol::evacuateWrite(CacheVC *evacuator, int event, Event *e)
+void
+Vol::evacuateWrite(CacheVC *evacuator)
 {
   // push to front of aggregation write list, so it is written first
 
@@ -592,33 +620,28 @@ Vol::evacuateWrite(CacheVC *evacuator, int event, Event *e)
     after = cur;
   ink_assert(evacuator->agg_len <= AGG_SIZE);
   agg.insert(evacuator, after);
-  return aggWrite(event, e);
 }
 
-int
-Vol::evacuateDocReadDone(int event, Event *e)
+// Queue @a evacuator, holding a document read from the vol, for writing,
+// or drop it if the document need not be kept.
+void
+Vol::evacuate_doc(CacheVC *evacuator)
 {
-  cancel_trigger();
-  if (event != AIO_EVENT_DONE)
-    return EVENT_DONE;
-  ink_assert(is_io_in_progress());
-  set_io_not_in_progress();
-  ink_assert(mutex->thread_holding == this_ethread());
-  Doc *doc = (Doc *) doc_evacuator->buf->data();
+  Doc *doc = (Doc *) evacuator->buf->data();
   CacheKey next_key;
   EvacuationBlock *b = NULL;
   if (doc->magic != DOC_MAGIC) {
     Debug("cache_evac", "DOC magic: %X %d",
-          (int) dir_tag(&doc_evacuator->overwrite_dir), (int) dir_offset(&doc_evacuator->overwrite_dir));
+          (int) dir_tag(&evacuator->overwrite_dir), (int) dir_offset(&evacuator->overwrite_dir));
     ink_assert(doc->magic == DOC_MAGIC);
     goto Ldone;
   }
   DDebug("cache_evac", "evacuateDocReadDone %X offset %d",
-        (int) doc->key.slice32(0), (int) dir_offset(&doc_evacuator->overwrite_dir));
+        (int) doc->key.slice32(0), (int) dir_offset(&evacuator->overwrite_dir));
 
-  b = evacuate[dir_evac_bucket(&doc_evacuator->overwrite_dir)].head;
+  b = evacuate[dir_evac_bucket(&evacuator->overwrite_dir)].head;
   while (b) {
-    if (dir_offset(&b->dir) == dir_offset(&doc_evacuator->overwrite_dir))
+    if (dir_offset(&b->dir) == dir_offset(&evacuator->overwrite_dir))
       break;
     b = b->link.next;
   }
@@ -626,30 +649,35 @@ Vol::evacuateDocReadDone(int event, Event *e)
     goto Ldone;
   if ((b->f.pinned && !b->readers) && doc->pinned < (uint32_t) (ink_get_based_hrtime() / HRTIME_SECOND))
     goto Ldone;
+  // a hot copy in the fast tier, move it to the slow tier rather than keep it here
+  if (b->f.demote && !b->f.pinned && !b->readers) {
+    tier_demote(this, doc, evacuator->buf, &b->dir);
+    goto Ldone;
+  }
 
   if (dir_head(&b->dir) && b->f.evacuate_head) {
     ink_assert(!b->evac_frags.key.fold());
     // if its a head (vector), evacuation is real simple...we just
     // need to write this vector down and overwrite the directory entry.
     if (dir_compare_tag(&b->dir, &doc->first_key)) {
-      doc_evacuator->key = doc->first_key;
+      evacuator->key = doc->first_key;
       b->evac_frags.key = doc->first_key;
       DDebug("cache_evac", "evacuating vector %X offset %d",
-            (int) doc->first_key.slice32(0), (int) dir_offset(&doc_evacuator->overwrite_dir));
+            (int) doc->first_key.slice32(0), (int) dir_offset(&evacuator->overwrite_dir));
       b->f.unused = 57;
     } else {
       // if its an earliest fragment (alternate) evacuation, things get
       // a little tricky. We have to propagate the earliest key to the next
       // fragments for this alternate. The last fragment to be evacuated
       // fixes up the lookaside buffer.
-      doc_evacuator->key = doc->key;
-      doc_evacuator->earliest_key = doc->key;
+      evacuator->key = doc->key;
+      evacuator->earliest_key = doc->key;
       b->evac_frags.key = doc->key;
       b->evac_frags.earliest_key = doc->key;
-      b->earliest_evacuator = doc_evacuator;
+      b->earliest_evacuator = evacuator;
       DDebug("cache_evac", "evacuating earliest %X %X evac: %p offset: %d",
             (int) b->evac_frags.key.slice32(0), (int) doc->key.slice32(0),
-            doc_evacuator, (int) dir_offset(&doc_evacuator->overwrite_dir));
+            evacuator, (int) dir_offset(&evacuator->overwrite_dir));
       b->f.unused = 67;
     }
   } else {
@@ -660,8 +688,8 @@ Vol::evacuateDocReadDone(int event, Event *e)
       b->f.unused = 77;
       goto Ldone;
     }
-    doc_evacuator->key = ek->key;
-    doc_evacuator->earliest_key = ek->earliest_key;
+    evacuator->key = ek->key;
+    evacuator->earliest_key = ek->earliest_key;
     DDebug("cache_evac", "evacuateDocReadDone key: %X earliest: %X",
           (int) ek->key.slice32(0), (int) ek->earliest_key.slice32(0));
     b->f.unused = 87;
@@ -672,15 +700,45 @@ Vol::evacuateDocReadDone(int event, Event *e)
   // Cache::open_write).
   if (!dir_head(&b->dir) || !dir_compare_tag(&b->dir, &doc->first_key)) {
     next_CacheKey(&next_key, &doc->key);
-    evacuate_fragments(&next_key, &doc_evacuator->earliest_key, !b->readers, this);
+    evacuate_fragments(&next_key, &evacuator->earliest_key, !b->readers, this);
   }
-  return evacuateWrite(doc_evacuator, event, e);
+  evacuateWrite(evacuator);
+  return;
 Ldone:
-  free_CacheVC(doc_evacuator);
-  doc_evacuator = 0;
+  free_CacheVC(evacuator);
+}
+
+
+int
+Vol::evacuateDocReadDone(int event, Event *e)
+{
+  cancel_trigger();
+  if (event != AIO_EVENT_DONE)
+    return EVENT_DONE;
+  ink_assert(is_io_in_progress());
+  set_io_not_in_progress();
+  ink_assert(mutex->thread_holding == this_ethread());
+  if (!io.ok()) {
+    Debug("cache_evac", "evacuation read of %d bytes at %" PRId64 " failed", (int) io.aiocb.aio_nbytes, (int64_t) evac_batch_offset);
+    evac_batch_count = 0;
+  }
+  for (int i = 0; i < evac_batch_count; i++) {
+    off_t o = vol_offset(this, &evac_batch[i]) - evac_batch_offset;
+    int n = MIN((off_t) dir_approx_size(&evac_batch[i]), (off_t) io.aiocb.aio_nbytes - o);
+    CacheVC *evacuator = new_DocEvacuator(n, this);
+    evacuator->overwrite_dir = evac_batch[i];
+    memcpy(evacuator->buf->data(), evac_buffer + o, n);
+    evacuate_doc(evacuator);
+  }
+  evac_batch_count = 0;
   return aggWrite(event, e);
 }
 
+/*
+   Read the lowest document to be evacuated in the range, together with
+   the following ones within agg_size bytes, so the region ahead of the
+   write position is read in large sequential reads.
+*/
 int
 Vol::evac_range(off_t low, off_t high, int evac_phase)
 {
@@ -703,19 +761,50 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
         }
     }
     if (first) {
+      off_t read_start = vol_offset(this, &first->dir);
+      off_t read_limit = MIN(read_start + agg_size, skip + len);
+      off_t read_end = MIN(read_start + (off_t) dir_approx_size(&first->dir), read_limit);
       first->f.done = 1;
+      evac_batch[0] = first->dir;
+      evac_batch_count = 1;
+      off_t le = MIN(e, offset_to_vol_offset(this, read_limit));
+      int lei = dir_offset_evac_bucket(le);
+      // add the next lowest document as long as it ends within the limit
+      while (evac_batch_count < EVAC_BATCH_MAX) {
+        EvacuationBlock *next = 0;
+        int64_t next_offset = INT64_MAX;
+        for (int j = i; j <= lei; j++) {
+          for (b = evacuate[j].head; b; b = b->link.next) {
+            int64_t offset = dir_offset(&b->dir);
+            if (offset > first_offset && offset < le && offset < next_offset && !b->f.done &&
+                dir_phase(&b->dir) == evac_phase) {
+              next = b;
+              next_offset = offset;
+            }
+          }
+        }
+        if (!next || vol_offset(this, &next->dir) + (off_t) dir_approx_size(&next->dir) > read_limit)
+          break;
+        next->f.done = 1;
+        evac_batch[evac_batch_count++] = next->dir;
+        read_end = MAX(read_end, vol_offset(this, &next->dir) + (off_t) dir_approx_size(&next->dir));
+      }
+      if (!evac_buffer)
+        evac_buffer = (char *)ats_memalign(ats_pagesize(), agg_size);
+      evac_batch_offset = read_start;
       io.aiocb.aio_fildes = fd;
-      io.aiocb.aio_nbytes = dir_approx_size(&first->dir);
-      io.aiocb.aio_offset = vol_offset(this, &first->dir);
-      if ((off_t)(io.aiocb.aio_offset + io.aiocb.aio_nbytes) > (off_t)(skip + len))
-        io.aiocb.aio_nbytes = skip + len - io.aiocb.aio_offset;
-      doc_evacuator = new_DocEvacuator(io.aiocb.aio_nbytes, this);
-      doc_evacuator->overwrite_dir = first->dir;
-
-      io.aiocb.aio_buf = doc_evacuator->buf->data();
+      io.aiocb.aio_nbytes = read_end - read_start;
+      io.aiocb.aio_offset = read_start;
+      io.aiocb.aio_buf = evac_buffer;
       io.action = this;
       io.thread = AIO_CALLBACK_THREAD_ANY;
-      DDebug("cache_evac", "evac_range evacuating %X %d", (int)dir_tag(&first->dir), (int)dir_offset(&first->dir));
+      {
+        Vol *vol = this;
+        CACHE_INCREMENT_DYN_STAT(cache_evacuate_reads_stat);
+        CACHE_SUM_DYN_STAT(cache_evacuate_read_bytes_stat, io.aiocb.aio_nbytes);
+      }
+      DDebug("cache_evac", "evac_range evacuating %X %d, %d documents", (int)dir_tag(&first->dir), (int)dir_offset(&first->dir),
+             evac_batch_count);
       SET_HANDLER(&Vol::evacuateDocReadDone);
       ink_assert(ink_aio_read(&io) >= 0);
       return -1;
@@ -724,12 +813,11 @@ Vol::evac_range(off_t low, off_t high, int evac_phase)
   return 0;
 }
 
-
 static int
 agg_copy(char *p, CacheVC *vc)
 {
   Vol *vol = vc->vol;
-  off_t o = vol->header->write_pos + vol->agg_buf_pos;
+  off_t o = vol->agg_buf_offset() + vol->agg_buf_pos;
 
   if (!vc->f.evacuator) {
     Doc *doc = (Doc *) p;
@@ -865,6 +953,8 @@ agg_copy(char *p, CacheVC *vc)
       ink_assert(mutex->thread_holding == this_ethread());
       CACHE_DEBUG_INCREMENT_DYN_STAT(cache_gc_frags_evacuated_stat);
       CACHE_DEBUG_SUM_DYN_STAT(cache_gc_bytes_evacuated_stat, l);
+      if (!vc->tier_vol) // not a copy between tiers
+        CACHE_SUM_DYN_STAT(cache_evacuate_write_bytes_stat, l);
     }
 
     doc->sync_serial = vc->vol->header->sync_serial;
@@ -969,17 +1059,22 @@ Vol::aggWrite(int event, void */* e ATS_UNUSED */)
 
   cancel_trigger();
 
+  // a dir sync is waiting for the write in progress, hold new documents
+  // back so it does not have to wait for the standby buffer as well
+  if (dir_sync_waiting && agg_write_len)
+    return EVENT_CONT;
+
 Lagain:
   // calculate length of aggregated write
   for (c = (CacheVC *) agg.head; c;) {
     int writelen = c->agg_len;
     // [amc] this is checked multiple places, on here was it strictly less.
     ink_assert(writelen <= AGG_SIZE);
-    if (agg_buf_pos + writelen > AGG_SIZE ||
-        header->write_pos + agg_buf_pos + writelen > (skip + len))
+    if (agg_buf_pos + writelen > agg_size ||
+        agg_buf_offset() + agg_buf_pos + writelen > (skip + len))
       break;
     DDebug("agg_read", "copying: %d, %" PRIu64 ", key: %d",
-          agg_buf_pos, header->write_pos + agg_buf_pos, c->first_key.slice32(0));
+          agg_buf_pos, agg_buf_offset() + agg_buf_pos, c->first_key.slice32(0));
     int wrotelen = agg_copy(agg_buffer + agg_buf_pos, c);
     ink_assert(writelen == wrotelen);
     agg_todo_size -= writelen;
@@ -1002,6 +1097,9 @@ Lagain:
   if (!agg_buf_pos) {
     if (!agg.head && !sync.head) // nothing to get
       return EVENT_CONT;
+    // wrap, or write the sync marker, after the write in progress
+    if (agg_write_len)
+      return EVENT_CONT;
     if (header->write_pos == start) {
       // write aggregation too long, bad bad, punt on everything.
       Note("write aggregation exceeds vol size");
@@ -1024,16 +1122,20 @@ Lagain:
   }
 
   // evacuate space
-  off_t end = header->write_pos + agg_buf_pos + EVACUATION_SIZE;
-  if (evac_range(header->write_pos, end, !header->phase) < 0)
+  off_t end = agg_buf_offset() + agg_buf_pos + evacuation_size();
+  if (evac_range(agg_buf_offset(), end, !header->phase) < 0)
     goto Lwait;
   if (end > skip + len)
     if (evac_range(start, start + (end - (skip + len)), header->phase) < 0)
       goto Lwait;
 
+  // keep filling the buffer until the write in progress is done
+  if (agg_write_len)
+    goto Lwait;
+
   // if agg.head, then we are near the end of the disk, so
   // write down the aggregation in whatever size it is.
-  if (agg_buf_pos < AGG_HIGH_WATER && !agg.head && !sync.head && !dir_sync_waiting)
+  if (agg_buf_pos < agg_size / 2 && !agg.head && !sync.head && !dir_sync_waiting)
     goto Lwait;
 
   // write sync marker
@@ -1049,22 +1151,36 @@ Lagain:
     d->write_serial = header->write_serial;
   }
 
+  // swap the buffers, new documents go to the other one while this is written
+  {
+    char *full = agg_buffer;
+    agg_buffer = agg_write_buffer;
+    agg_write_buffer = full;
+    agg_write_len = agg_buf_pos;
+    agg_buf_pos = 0;
+  }
+
   // set write limit
-  header->agg_pos = header->write_pos + agg_buf_pos;
+  header->agg_pos = header->write_pos + agg_write_len;
 
-  io.aiocb.aio_fildes = fd;
-  io.aiocb.aio_offset = header->write_pos;
-  io.aiocb.aio_buf = agg_buffer;
-  io.aiocb.aio_nbytes = agg_buf_pos;
-  io.action = this;
+  {
+    Vol *vol = this;
+    CACHE_INCREMENT_DYN_STAT(cache_agg_writes_stat);
+    CACHE_SUM_DYN_STAT(cache_agg_write_bytes_stat, agg_write_len);
+  }
+  agg_io.aiocb.aio_fildes = fd;
+  agg_io.aiocb.aio_offset = header->write_pos;
+  agg_io.aiocb.aio_buf = agg_write_buffer;
+  agg_io.aiocb.aio_nbytes = agg_write_len;
+  agg_io.aio_result = 0; // until done, see sync_cache_dir_on_shutdown
+  agg_io.action = agg_write_cont;
   /*
     Callback on AIO thread so that we can issue a new write ASAP
     as all writes are serialized in the volume.  This is not necessary
     for reads proceed independently.
    */
-  io.thread = AIO_CALLBACK_THREAD_AIO;
-  SET_HANDLER(&Vol::aggWriteDone);
-  ink_aio_write(&io);
+  agg_io.thread = AIO_CALLBACK_THREAD_AIO;
+  ink_aio_write(&agg_io);
 
 Lwait:
   int ret = EVENT_CONT;
@@ -1090,6 +1206,9 @@ CacheVC::openWriteCloseDir(int /* event ATS_UNUSED */, Event */* e ATS_UNUSED */
       ink_assert(!is_io_in_progress());
       VC_SCHED_LOCK_RETRY();
     }
+    // a copy may have been promoted while this was being written
+    if (closed > 0)
+      tier_invalidate(tier_vol, &first_key);
     vol->close_write(this);
     if (closed < 0 && fragment)
       dir_delete(&earliest_key, vol, &earliest_dir);
@@ -1634,6 +1753,8 @@ Cache::open_write(Continuation *cont, CacheKey *key, CacheFragType frag_type,
   c->base_stat = cache_write_active_stat;
   c->vol = key_to_vol(key, hostname, host_len);
   Vol *vol = c->vol;
+  c->tier_vol = key_to_vol(key, hostname, host_len, STORE_TIER_FAST);
+  tier_invalidate(c->tier_vol, key);
   CACHE_INCREMENT_DYN_STAT(c->base_stat + CACHE_STAT_ACTIVE);
   c->first_key = c->key = *key;
   c->frag_type = frag_type;
@@ -1714,6 +1835,8 @@ Cache::open_write(Continuation *cont, CacheKey *key, CacheHTTPInfo *info, time_t
   c->frag_type = CACHE_FRAG_TYPE_HTTP;
   c->vol = key_to_vol(key, hostname, host_len);
   Vol *vol = c->vol;
+  c->tier_vol = key_to_vol(key, hostname, host_len, STORE_TIER_FAST);
+  tier_invalidate(c->tier_vol, key);
   c->info = info;
   if (c->info && (uintptr_t) info != CACHE_ALLOW_MULTIPLE_WRITES) {
     /*
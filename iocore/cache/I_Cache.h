@@ -45,11 +45,13 @@
 
 #define RAM_CACHE_ALGORITHM_CLFUS        0
 #define RAM_CACHE_ALGORITHM_LRU          1
+#define RAM_CACHE_ALGORITHM_TINYLFU      2
 
 #define CACHE_COMPRESSION_NONE           0
 #define CACHE_COMPRESSION_FASTLZ         1
 #define CACHE_COMPRESSION_LIBZ           2
 #define CACHE_COMPRESSION_LIBLZMA        3
+#define CACHE_COMPRESSION_ZSTD           4
 
 struct CacheVC;
 struct CacheDisk;
@@ -69,6 +71,7 @@ struct CacheProcessor:public Processor
   CacheProcessor()
     : min_stripe_version(CACHE_DB_MAJOR_VERSION, CACHE_DB_MINOR_VERSION)
     , max_stripe_version(CACHE_DB_MAJOR_VERSION, CACHE_DB_MINOR_VERSION)
+    , stripe_url_hash(CACHE_URL_HASH_LEGACY)
     , cb_after_init(0)
   {}
 
@@ -107,6 +110,15 @@ struct CacheProcessor:public Processor
                             bool rm_user_agents = true, bool rm_link = false,
                             char *hostname = 0, int host_len = 0);
   Action *scan(Continuation *cont, char *hostname = 0, int host_len = 0, int KB_per_second = SCAN_KB_PER_SECOND);
+  /**
+    Scan all the vols at the same time, with the events of scan().
+    The callbacks are serialized by the mutex of @a cont, and
+    CACHE_EVENT_SCAN_DONE is sent once all the vols are done. The reads
+    of all the vols together are limited to @a KB_per_second, 0 for no
+    limit. The data of CACHE_EVENT_SCAN is the returned action.
+  */
+  Action *scan_parallel(Continuation *cont, char *hostname = 0, int host_len = 0,
+                        int KB_per_second = SCAN_KB_PER_SECOND);
 #ifdef HTTP_CACHE
   Action *lookup(Continuation *cont, URL *url, bool cluster_cache_local, bool local_only = false,
                  CacheFragType frag_type = CACHE_FRAG_TYPE_HTTP);
@@ -189,6 +201,8 @@ struct CacheProcessor:public Processor
   
   VersionNumber min_stripe_version;
   VersionNumber max_stripe_version;
+  /// URL hash shared by all stripes, @c CACHE_URL_HASH_MIXED if they differ.
+  uint32_t stripe_url_hash;
 
   CALLBACK_FUNC cb_after_init;
 };
@@ -41,6 +41,12 @@
 
 #define CACHE_DB_FDS                128
 
+// URL hash a stripe was initialized for (VolHeaderFooter::url_hash). The
+// low byte is the hash type, the rest is a fingerprint of the hash key.
+#define CACHE_URL_HASH_LEGACY       0   // MMH, or MD5 for stripes before version 23
+#define CACHE_URL_HASH_SIP          1   // SipHash-2-4-128
+#define CACHE_URL_HASH_MIXED        0xFFFFFFFF
+
 // opcodes
 #define CACHE_OPEN_READ			1
 #define CACHE_OPEN_READ_BUFFER		2
@@ -37,6 +37,11 @@
 #define STORE_BLOCK_SHIFT      13
 #define DEFAULT_HW_SECTOR_SIZE 512
 
+// Storage tiers, see storage.config. Objects are written to the slow tier
+// and copied to the fast tier when they are hot.
+#define STORE_TIER_SLOW        0
+#define STORE_TIER_FAST        1
+
 enum span_error_t
 {
   SPAN_ERROR_OK,
@@ -77,6 +82,8 @@ struct Span
   unsigned alignment;
   span_diskid_t disk_id;
   int forced_volume_num;  ///< Force span in to specific volume.
+  int tier;               ///< Storage tier of the span.
+  int64_t agg_size;       ///< Size of the aggregated writes, 0 for the default.
 private:
   bool is_mmapable_internal;
 public:
@@ -130,6 +137,10 @@ public:
   void hash_base_string_set(char const* s);
   /// Set the volume number.
   void volume_number_set(int n);
+  /// Set the storage tier.
+  void tier_set(int t);
+  /// Set the size of the aggregated writes.
+  void agg_size_set(int64_t s);
 
   Span()
     : blocks(0)
@@ -137,6 +148,8 @@ public:
     , hw_sector_size(DEFAULT_HW_SECTOR_SIZE)
     , alignment(0)
     , forced_volume_num(-1)
+    , tier(STORE_TIER_SLOW)
+    , agg_size(0)
     , is_mmapable_internal(false)
     , file_pathname(false)
   {
@@ -241,6 +254,8 @@ struct Store
   /// Additional configuration key values.
   static char const VOLUME_KEY[];
   static char const HASH_BASE_STRING_KEY[];
+  static char const TIER_KEY[];
+  static char const AGG_SIZE_KEY[];
 };
 
 // store either free or in the cache, can be stolen for reconfiguration
@@ -54,6 +54,15 @@ struct CacheVC;
 
 #define SYNC_MAX_WRITE                  (2 * 1024 * 1024)
 #define SYNC_DELAY                      HRTIME_MSECONDS(500)
+
+// Per segment directory sync state (Vol::dir_sync_state). The directory
+// is stored twice on disk (copies A and B, alternating by sync_serial) so
+// a segment is tracked separately for each copy: dirty if it changed since
+// it was last written to that copy, writing while a sync of that copy is
+// in flight.
+#define DIR_SYNC_DIRTY(_copy)           (1 << (_copy))
+#define DIR_SYNC_WRITING(_copy)         (4 << (_copy))
+#define DIR_SYNC_DIRTY_ALL              (DIR_SYNC_DIRTY(0) | DIR_SYNC_DIRTY(1))
 #define DO_NOT_REMOVE_THIS              0
 
 // Debugging Options
@@ -301,12 +310,16 @@ struct CacheSync: public Continuation
   char *buf;
   size_t buflen;
   off_t writepos;
+  int segment;                  // next segment to write
+  bool failed;                  // a write of the current vol failed
+  ink_hrtime start_time;
   AIOCallbackInternal io;
   Event *trigger;
   int mainEvent(int event, Event *e);
   void aio_write(int fd, char *b, int n, off_t o);
 
-  CacheSync():Continuation(new_ProxyMutex()), vol(0), buf(0), buflen(0), writepos(0), trigger(0)
+  CacheSync():Continuation(new_ProxyMutex()), vol(0), buf(0), buflen(0), writepos(0), segment(0), failed(false),
+              start_time(0), trigger(0)
   {
     SET_HANDLER(&CacheSync::mainEvent);
   }
@@ -106,6 +106,8 @@ struct CacheDisk: public Continuation
 
   // Extra configuration values
   int forced_volume_num; ///< Volume number for this disk.
+  int tier; ///< Storage tier of this disk.
+  int64_t agg_size; ///< Size of the aggregated writes to this disk, 0 for the default.
   ats_scoped_str hash_base_string; ///< Base string for hash seed.
  
   CacheDisk()
@@ -113,7 +115,7 @@ struct CacheDisk: public Continuation
       path(NULL), header_len(0), len(0), start(0), skip(0),
       num_usable_blocks(0), fd(-1), free_space(0), wasted_space(0),
       disk_vols(NULL), free_blocks(NULL), num_errors(0), cleared(0),
-      forced_volume_num(-1)
+      forced_volume_num(-1), tier(STORE_TIER_SLOW), agg_size(0)
   { }
 
    ~CacheDisk();
@@ -43,6 +43,7 @@ struct CacheHostRecord
   {
     ats_free(vols);
     ats_free(vol_hash_table);
+    ats_free(fast_vol_hash_table);
     ats_free(cp);
   }
 
@@ -52,12 +53,13 @@ struct CacheHostRecord
   volatile int num_vols;
   int num_initialized;
   unsigned short *vol_hash_table;
+  unsigned short *fast_vol_hash_table; ///< Fast tier vols, if the record has both tiers.
   CacheVol **cp;
   int num_cachevols;
 
   CacheHostRecord():
     type(CACHE_NONE_TYPE), vols(NULL), good_num_vols(0), num_vols(0),
-    num_initialized(0), vol_hash_table(0), cp(NULL), num_cachevols(0)
+    num_initialized(0), vol_hash_table(0), fast_vol_hash_table(0), cp(NULL), num_cachevols(0)
   { }
 
 };
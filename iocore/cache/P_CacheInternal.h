@@ -119,6 +119,10 @@ enum
   cache_direntries_used_stat,
   cache_ram_cache_hits_stat,
   cache_ram_cache_misses_stat,
+  cache_ram_cache_compress_backlog_stat,
+  cache_ram_cache_compress_entries_stat,
+  cache_ram_cache_compress_bytes_in_stat,
+  cache_ram_cache_compress_bytes_out_stat,
   cache_pread_count_stat,
   cache_percent_full_stat,
   cache_lookup_active_stat,
@@ -160,6 +164,29 @@ enum
   cache_hdr_vector_marshal_stat,
   cache_hdr_marshal_stat,
   cache_hdr_marshal_bytes_stat,
+  cache_dir_sync_count_stat,
+  cache_dir_sync_bytes_stat,
+  cache_dir_sync_time_stat,
+  cache_dir_sync_shutdown_time_stat,
+  cache_startup_dir_read_time_stat,
+  cache_startup_online_time_stat,
+  cache_startup_recovery_time_stat,
+  cache_startup_recovering_stat,
+  cache_tier_fast_hits_stat,
+  cache_tier_slow_hits_stat,
+  cache_tier_promotions_stat,
+  cache_tier_promoted_bytes_stat,
+  cache_tier_demotions_stat,
+  cache_tier_demoted_bytes_stat,
+  cache_tier_invalidations_stat,
+  cache_agg_writes_stat,
+  cache_agg_write_bytes_stat,
+  cache_evacuate_reads_stat,
+  cache_evacuate_read_bytes_stat,
+  cache_evacuate_write_bytes_stat,
+  cache_scan_bytes_stat,
+  cache_scan_objects_stat,
+  cache_scan_pending_bytes_stat,
   cache_stat_count
 };
 
@@ -221,17 +248,24 @@ extern int cache_config_alt_rewrite_max_size;
 extern int cache_config_read_while_writer;
 extern int cache_clustering_enabled;
 extern int cache_config_agg_write_backlog;
+extern int cache_config_agg_write_size;
 extern int cache_config_ram_cache_compress;
 extern int cache_config_ram_cache_compress_percent;
+extern int cache_config_ram_cache_compress_dict_size;
+extern int cache_config_tier_promote_hits;
 extern int cache_config_ram_cache_use_seen_filter;
 extern int cache_config_hit_evacuate_percent;
 extern int cache_config_hit_evacuate_size_limit;
 extern int cache_config_force_sector_size;
 extern int cache_config_target_fragment_size;
 extern int cache_config_mutex_retry_delay;
+extern int cache_config_url_hash;
+extern uint64_t cache_config_url_hash_key[2];
+extern uint32_t cache_config_url_hash_stamp;
 #if TS_USE_INTERIM_CACHE == 1
 extern int good_interim_disks;
 #endif
+struct CacheScanState;
 // CacheVC
 struct CacheVC: public CacheVConnection
 {
@@ -335,6 +369,7 @@ struct CacheVC: public CacheVConnection
   int scanUpdateDone(int event, Event *e);
   int scanOpenWrite(int event, Event *e);
   int scanRemoveDone(int event, Event *e);
+  int scanRead(int event, Event *e);
 
   int is_io_in_progress()
   {
@@ -351,6 +386,9 @@ struct CacheVC: public CacheVConnection
   int evacuateDocDone(int event, Event *e);
   int evacuateReadHead(int event, Event *e);
 
+  int tierCopy(int event, Event *e);
+  int tierCopyDone(int event, Event *e);
+
   void cancel_trigger();
   virtual int64_t get_object_size();
 #ifdef HTTP_CACHE
@@ -405,6 +443,7 @@ struct CacheVC: public CacheVConnection
   Ptr<IOBufferData> first_buf;
   Ptr<IOBufferBlock> blocks; // data available to write
   Ptr<IOBufferBlock> writer_buf;
+  Ptr<IOBufferData> promote_buf; // raw head to copy to the fast tier
 
   OpenDirEntry *od;
   AIOCallbackInternal io;
@@ -436,6 +475,7 @@ struct CacheVC: public CacheVConnection
   uint32_t agg_len;       // for communicating with aggWrite
   uint32_t write_serial;  // serial of the final write for SYNC
   Vol *vol;
+  Vol *tier_vol;        // the vol in the other tier, see CacheTier.cc
   Dir *last_collision;
   Event *trigger;
   CacheKey *read_key;
@@ -491,6 +531,9 @@ struct CacheVC: public CacheVConnection
       unsigned int readers:1;
       unsigned int doc_from_ram_cache:1;
       unsigned int hit_evacuate:1;
+      unsigned int tier_fast:1; // reading the fast vol, tier_vol is the slow vol
+      unsigned int tier_counted:1; // the read was counted by tier_read_count
+      unsigned int tier_hot:1;
 #if TS_USE_INTERIM_CACHE == 1
       unsigned int read_from_interim:1;
       unsigned int write_into_interim:1;
@@ -508,6 +551,8 @@ struct CacheVC: public CacheVConnection
   // BTF fix to handle objects that overlapped over two different reads,
   // this is how much we need to back up the buffer to get the start of the overlapping object.
   off_t scan_fix_buffer_offset;
+  CacheScanState *scan_state;     // of a parallel scan, see Cache::scan_parallel
+  off_t scan_pending;             // bytes of the vol left to scan
   //end region C
 };
 
@@ -544,6 +589,13 @@ int cache_write(CacheVC *, CacheHTTPInfoVector *);
 int get_alternate_index(CacheHTTPInfoVector *cache_vector, CacheKey key);
 #endif
 CacheVC *new_DocEvacuator(int nbytes, Vol *d);
+void tier_copy(Vol *to, Vol *from, CacheKey *key, IOBufferData *data, Dir *dir);
+void tier_read_count(CacheVC *c);
+void tier_read_hit(CacheVC *c);
+void tier_read_miss(CacheVC *c);
+void tier_invalidate(Vol *fast, CacheKey *key);
+void tier_drain(Vol *fast);
+void tier_demote(Vol *fast, Doc *doc, IOBufferData *data, Dir *dir);
 
 // inline Functions
 
@@ -625,6 +677,7 @@ free_CacheVC(CacheVC *cont)
   cont->first_buf.clear();
   cont->blocks.clear();
   cont->writer_buf.clear();
+  cont->promote_buf.clear();
   cont->alternate_index = CACHE_ALT_INDEX_DEFAULT;
   if (cont->scan_vol_map)
     ats_free(cont->scan_vol_map);
@@ -1034,6 +1087,7 @@ struct Cache
                             bool user_agents = true, bool link = false,
                             char *hostname = 0, int host_len = 0);
   Action *scan(Continuation *cont, char *hostname = 0, int host_len = 0, int KB_per_second = 2500);
+  Action *scan_parallel(Continuation *cont, char *hostname = 0, int host_len = 0, int KB_per_second = 2500);
 
 #ifdef HTTP_CACHE
   Action *lookup(Continuation *cont, URL *url, CacheFragType type);
@@ -1059,7 +1113,8 @@ struct Cache
 
   int open_done();
 
-  Vol *key_to_vol(CacheKey *key, char const* hostname, int host_len);
+  Vol *key_to_vol(CacheKey *key, char const* hostname, int host_len, int tier = STORE_TIER_SLOW);
+  Vol *key_to_read_vol(CacheKey *key, char const* hostname, int host_len, Vol **slow_vol);
 
   Cache()
     : cache_read_done(0), total_good_nvol(0), total_nvol(0), ready(CACHE_INITIALIZING), cache_size(0),  // in store block size
@@ -1337,6 +1392,12 @@ CacheProcessor::scan(Continuation *cont, char *hostname, int host_len, int KB_pe
   return caches[CACHE_FRAG_TYPE_HTTP]->scan(cont, hostname, host_len, KB_per_second);
 }
 
+TS_INLINE Action *
+CacheProcessor::scan_parallel(Continuation *cont, char *hostname, int host_len, int KB_per_second)
+{
+  return caches[CACHE_FRAG_TYPE_HTTP]->scan_parallel(cont, hostname, host_len, KB_per_second);
+}
+
 TS_INLINE int
 CacheProcessor::IsCacheEnabled()
 {
@@ -0,0 +1,82 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_CACHE_SKETCH_H__
+#define _P_CACHE_SKETCH_H__
+
+#include "libts.h"
+
+#define SKETCH_DEPTH 4 // one row per 32 bits of the key
+#define SKETCH_MAX 15 // counters saturate, as if they were 4 bits
+#define SKETCH_SAMPLE_FACTOR 10 // age after this many increments per counter
+
+// Count-min sketch of how often keys have been seen recently. All the
+// counters are halved periodically, so the estimates follow changes in
+// popularity. Not thread safe, the owner provides the locking.
+struct CacheSketch
+{
+  uint8_t *counters;
+  uint32_t mask;
+  int64_t adds;
+  int64_t reset;
+
+  bool initialized() const { return counters != NULL; }
+
+  // @a width is rounded up to a power of 2.
+  void init(int64_t width) {
+    int64_t w = 1;
+    while (w < width)
+      w <<= 1;
+    ats_free(counters);
+    mask = (uint32_t)w - 1;
+    adds = 0;
+    reset = w * SKETCH_SAMPLE_FACTOR;
+    counters = (uint8_t *)ats_malloc(SKETCH_DEPTH * w);
+    memset(counters, 0, SKETCH_DEPTH * w);
+  }
+
+  void touch(INK_MD5 *key) {
+    for (int i = 0; i < SKETCH_DEPTH; i++) {
+      uint8_t *c = &counters[(i * ((int64_t)mask + 1)) + (key->slice32(i) & mask)];
+      if (*c < SKETCH_MAX)
+        (*c)++;
+    }
+    if (++adds >= reset) {
+      for (int64_t i = 0; i < SKETCH_DEPTH * ((int64_t)mask + 1); i++)
+        counters[i] >>= 1;
+      adds /= 2;
+    }
+  }
+
+  int frequency(INK_MD5 *key) const {
+    int f = SKETCH_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; i++)
+      f = MIN(f, (int)counters[(i * ((int64_t)mask + 1)) + (key->slice32(i) & mask)]);
+    return f;
+  }
+
+  CacheSketch(): counters(NULL), mask(0), adds(0), reset(0) { }
+  ~CacheSketch() { ats_free(counters); }
+};
+
+#endif /* _P_CACHE_SKETCH_H__ */
@@ -36,8 +36,8 @@
 #define VOL_MAGIC                      0xF1D0F00D
 #define START_BLOCKS                    16      // 8k, STORE_BLOCK_SIZE
 #define START_POS                       ((off_t)START_BLOCKS * CACHE_BLOCK_SIZE)
-#define AGG_SIZE                        (4 * 1024 * 1024) // 4MB
-#define AGG_HIGH_WATER                  (AGG_SIZE / 2) // 2MB
+#define AGG_SIZE                        (4 * 1024 * 1024) // 4MB, default and minimum, see Vol::agg_size
+#define MAX_AGG_SIZE                    (256 * 1024 * 1024) // 256MB
 #define EVACUATION_SIZE                 (2 * AGG_SIZE)  // 8MB
 #define MAX_VOL_SIZE                   ((off_t)512 * 1024 * 1024 * 1024 * 1024)
 #define STORE_BLOCKS_PER_CACHE_BLOCK    (STORE_BLOCK_SIZE / CACHE_BLOCK_SIZE)
@@ -51,8 +51,10 @@
 #define LOOKASIDE_SIZE                  256
 #define EVACUATION_BUCKET_SIZE          (2 * EVACUATION_SIZE) // 16MB
 #define RECOVERY_SIZE                   EVACUATION_SIZE // 8MB
+#define DIR_READ_SIZE                   (16 * 1024 * 1024) // 16MB
 #define AIO_NOT_IN_PROGRESS             0
 #define AIO_AGG_WRITE_IN_PROGRESS       -1
+#define EVAC_BATCH_MAX                  64      // documents read together by Vol::evac_range
 #define AUTO_SIZE_RAM_CACHE             -1      // 1-1 with directory size
 #define DEFAULT_TARGET_FRAGMENT_SIZE    (1048576 - sizeofDoc) // 1MB
 
@@ -105,7 +107,7 @@ struct VolHeaderFooter
   time_t create_time;
   off_t write_pos;
   off_t last_write_pos;
-  off_t agg_pos;
+  off_t agg_pos;                  // in the footer, the agg_size of the vol, see vol_footer_sync
   uint32_t generation;            // token generation (vary), this cannot be 0
   uint32_t phase;
   uint32_t cycle;
@@ -113,7 +115,7 @@ struct VolHeaderFooter
   uint32_t write_serial;
   uint32_t dirty;
   uint32_t sector_size;
-  uint32_t unused;                // pad out to 8 byte boundary
+  uint32_t url_hash;              // CACHE_URL_HASH_* this stripe was initialized for, 0 in older stripes
 #if TS_USE_INTERIM_CACHE == 1
   InterimVolHeaderFooter interim_header[8];
 #endif
@@ -128,6 +130,13 @@ struct EvacuationKey
   CryptoHash earliest_key;
 };
 
+// Key of a copy to delete from a fast tier vol, see tier_invalidate
+struct TierStaleKey
+{
+  CacheKey key;
+  SLINK(TierStaleKey, link);
+};
+
 struct EvacuationBlock
 {
   union
@@ -138,7 +147,8 @@ struct EvacuationBlock
       unsigned int done:1;              // has been evacuated
       unsigned int pinned:1;            // check pinning timeout
       unsigned int evacuate_head:1;     // check pinning timeout
-      unsigned int unused:29;
+      unsigned int demote:1;            // hot copy in the fast tier, see CacheTier.cc
+      unsigned int unused:28;
     } f;
   };
 
@@ -354,6 +364,8 @@ struct InterimCacheVol: public Continuation
   char *agg_buffer;
   int agg_todo_size;
   int agg_buf_pos;
+  int agg_size;       // always AGG_SIZE, the interim cache has a single buffer
+  int agg_write_len;  // always 0
   uint32_t sector_size;
   int fd;
   CacheDisk *disk;
@@ -372,6 +384,9 @@ struct InterimCacheVol: public Continuation
   void set_io_not_in_progress() {
     io.aiocb.aio_fildes = AIO_NOT_IN_PROGRESS;
   }
+  int evacuation_size() {
+    return 2 * agg_size;
+  }
 
   int aggWrite(int event, void *e);
   int aggWriteDone(int event, void *e);
@@ -400,6 +415,8 @@ struct InterimCacheVol: public Continuation
 
     agg_todo_size = 0;
     agg_buf_pos = 0;
+    agg_size = AGG_SIZE;
+    agg_write_len = 0;
 
     agg_buffer = (char *) ats_memalign(sysconf(_SC_PAGESIZE), AGG_SIZE);
     memset(agg_buffer, 0, AGG_SIZE);
@@ -414,6 +431,17 @@ void dir_clean_interimvol(InterimCacheVol *d);
 
 #endif
 
+// Called back for the aggregated writes of a vol, which complete
+// independently of the evacuation reads using the vol itself.
+struct VolAggWrite: public Continuation
+{
+  Vol *vol;
+
+  int handle_write_done(int event, Event *e);
+
+  VolAggWrite(Vol *v);
+};
+
 struct Vol: public Continuation
 {
   char *path;
@@ -425,6 +453,7 @@ struct Vol: public Continuation
   Dir *dir;
   VolHeaderFooter *header;
   VolHeaderFooter *footer;
+  uint8_t *dir_sync_state;  // per segment, see DIR_SYNC_DIRTY
   int segments;
   off_t buckets;
   off_t recover_pos;
@@ -440,9 +469,16 @@ struct Vol: public Continuation
   Queue<CacheVC, Continuation::Link_link> agg;
   Queue<CacheVC, Continuation::Link_link> stat_cache_vcs;
   Queue<CacheVC, Continuation::Link_link> sync;
+  // Documents are aggregated in agg_buffer while agg_write_buffer, which
+  // follows it on disk, is being written through agg_io.
   char *agg_buffer;
+  char *agg_write_buffer;
+  int agg_size;             // of each buffer, see Vol::init
   int agg_todo_size;
   int agg_buf_pos;
+  int agg_write_len;        // of the write in progress, 0 if none
+  AIOCallbackInternal agg_io;
+  VolAggWrite *agg_write_cont;
 
   Event *trigger;
 
@@ -451,7 +487,11 @@ struct Vol: public Continuation
   int evacuate_size;
   DLL<EvacuationBlock> *evacuate;
   DLL<EvacuationBlock> lookaside[LOOKASIDE_SIZE];
-  CacheVC *doc_evacuator;
+  // the documents of the evacuation read in progress, see Vol::evac_range
+  char *evac_buffer;
+  off_t evac_batch_offset;
+  int evac_batch_count;
+  Dir evac_batch[EVAC_BATCH_MAX];
 
   VolInitInfo *init_info;
 
@@ -461,7 +501,9 @@ struct Vol: public Continuation
   uint32_t last_sync_serial;
   uint32_t last_write_serial;
   uint32_t sector_size;
+  int recover_agg_size;     // of the writes being recovered, see vol_footer_agg_size
   bool recover_wrapped;
+  bool recovering;          // online, but still scanning for data written after the last sync
   bool dir_sync_waiting;
   bool dir_sync_in_progress;
   bool writing_end_marker;
@@ -470,6 +512,9 @@ struct Vol: public Continuation
   int64_t first_fragment_offset;
   Ptr<IOBufferData> first_fragment_data;
 
+  CacheSketch tier_sketch;  // lookups of the keys of this fast tier vol
+  ASLL(TierStaleKey, link) tier_stale; // copies to delete once the lock is held, see tier_drain
+
 #if TS_USE_INTERIM_CACHE == 1
   int num_interim_vols;
   InterimCacheVol interim_vols[8];
@@ -510,6 +555,7 @@ struct Vol: public Continuation
   void cancel_trigger();
 
   int recover_data();
+  int recovery_done();
 
   int open_write(CacheVC *cont, int allow_if_writers, int max_writers);
   int open_write_lock(CacheVC *cont, int allow_if_writers, int max_writers);
@@ -531,6 +577,7 @@ struct Vol: public Continuation
   int handle_dir_clear(int event, void *data);
   int handle_dir_read(int event, void *data);
   int handle_recover_from_data(int event, void *data);
+  int handle_recover_write(int event, void *data);
   int handle_recover_write_dir(int event, void *data);
   int handle_header_read(int event, void *data);
 
@@ -564,10 +611,24 @@ struct Vol: public Continuation
   int aggWriteDone(int event, Event *e);
   int aggWrite(int event, void *e);
   void agg_wrap();
+  // where the documents being aggregated will be written
+  off_t agg_buf_offset()
+  {
+    return header->write_pos + agg_write_len;
+  }
+  int evacuation_size()
+  {
+    return 2 * agg_size;
+  }
+  int recover_evacuation_size()
+  {
+    return 2 * recover_agg_size;
+  }
 
-  int evacuateWrite(CacheVC *evacuator, int event, Event *e);
+  void evacuateWrite(CacheVC *evacuator);
   int evacuateDocReadDone(int event, Event *e);
   int evacuateDoc(int event, Event *e);
+  void evacuate_doc(CacheVC *evacuator);
 
   int evac_range(off_t start, off_t end, int evac_phase);
   void periodic_scan();
@@ -580,18 +641,22 @@ struct Vol: public Continuation
 
   Vol()
     : Continuation(new_ProxyMutex()), path(NULL), fd(-1),
-      dir(0), buckets(0), recover_pos(0), prev_recover_pos(0), scan_pos(0), skip(0), start(0),
-      len(0), data_blocks(0), hit_evacuate_window(0), agg_todo_size(0), agg_buf_pos(0), trigger(0),
-      evacuate_size(0), disk(NULL), last_sync_serial(0), last_write_serial(0), recover_wrapped(false),
-      dir_sync_waiting(0), dir_sync_in_progress(0), writing_end_marker(0) {
+      dir(0), dir_sync_state(0), buckets(0), recover_pos(0), prev_recover_pos(0), scan_pos(0), skip(0), start(0),
+      len(0), data_blocks(0), hit_evacuate_window(0), agg_buffer(0), agg_write_buffer(0), agg_size(AGG_SIZE),
+      agg_todo_size(0), agg_buf_pos(0), agg_write_len(0), agg_write_cont(0), trigger(0), evacuate_size(0),
+      evac_buffer(0), evac_batch_offset(0), evac_batch_count(0), disk(NULL), last_sync_serial(0),
+      last_write_serial(0), recover_agg_size(AGG_SIZE), recover_wrapped(false), recovering(false), dir_sync_waiting(0),
+      dir_sync_in_progress(0), writing_end_marker(0) {
     open_dir.mutex = mutex;
-    agg_buffer = (char *)ats_memalign(ats_pagesize(), AGG_SIZE);
-    memset(agg_buffer, 0, AGG_SIZE);
     SET_HANDLER(&Vol::aggWrite);
   }
 
   ~Vol() {
     ats_memalign_free(agg_buffer);
+    ats_memalign_free(agg_write_buffer);
+    ats_memalign_free(evac_buffer);
+    delete agg_write_cont;
+    ats_free(dir_sync_state);
   }
 };
 
@@ -655,6 +720,7 @@ extern volatile int gnvol;
 extern ClassAllocator<OpenDirEntry> openDirEntryAllocator;
 extern ClassAllocator<EvacuationBlock> evacuationBlockAllocator;
 extern ClassAllocator<EvacuationKey> evacuationKeyAllocator;
+extern ClassAllocator<TierStaleKey> tierStaleKeyAllocator;
 extern unsigned short *vol_hash_table;
 
 // inline Functions
@@ -672,24 +738,55 @@ vol_dirlen(Vol *d)
     ROUND_TO_STORE_BLOCK(sizeof(VolHeaderFooter));
 }
 
+/*
+   Only the magic and sync_serial of the footer are checked, the rest is the
+   copy of the header made when the vol was cleared. Its agg_pos is used to
+   record the agg_size the directory was written with, so that recovery
+   looks for the writes made since with the right size even if it has been
+   reconfigured. Older footers still have the agg_pos of an empty vol.
+*/
+TS_INLINE void
+vol_footer_sync(Vol *d)
+{
+  d->footer->sync_serial = d->header->sync_serial;
+  d->footer->agg_pos = d->agg_size;
+}
+
+TS_INLINE int
+vol_footer_agg_size(Vol *d)
+{
+  off_t s = d->footer->agg_pos;
+  if (s == d->start || s < AGG_SIZE || s > INT_MAX || s != (off_t)ROUND_DOWN_TO_STORE_BLOCK(s))
+    return d->agg_size;
+  return (int)s;
+}
+
 TS_INLINE int
 vol_direntries(Vol *d)
 {
   return d->buckets * DIR_DEPTH * d->segments;
 }
 
+// Note that segment @a s of the directory has to be written by the next
+// sync of either copy.
+TS_INLINE void
+dir_segment_dirty(int s, Vol *d)
+{
+  d->dir_sync_state[s] |= DIR_SYNC_DIRTY_ALL;
+}
+
 #if TS_USE_INTERIM_CACHE == 1
 #define vol_out_of_phase_valid(d, e)            \
     (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start) / CACHE_BLOCK_SIZE))
 
 #define vol_out_of_phase_agg_valid(d, e)        \
-    (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + AGG_SIZE) / CACHE_BLOCK_SIZE))
+    (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + d->agg_size) / CACHE_BLOCK_SIZE))
 
 #define vol_out_of_phase_write_valid(d, e)      \
-    (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + AGG_SIZE) / CACHE_BLOCK_SIZE))
+    (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + d->agg_size) / CACHE_BLOCK_SIZE))
 
 #define vol_in_phase_valid(d, e)                \
-    (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE))
+    (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_write_len + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE))
 
 #define vol_offset_to_offset(d, pos)            \
     (d->start + pos * CACHE_BLOCK_SIZE - CACHE_BLOCK_SIZE)
@@ -704,7 +801,7 @@ vol_direntries(Vol *d)
     ((d)->start + (off_t) ((off_t)dir_offset(e) * CACHE_BLOCK_SIZE) - CACHE_BLOCK_SIZE)
 
 #define vol_in_phase_agg_buf_valid(d, e)        \
-    ((vol_offset(d, e) >= d->header->write_pos) && vol_offset(d, e) < (d->header->write_pos + d->agg_buf_pos))
+    ((vol_offset(d, e) >= d->header->write_pos) && vol_offset(d, e) < (d->header->write_pos + d->agg_write_len + d->agg_buf_pos))
 
 #define vol_transistor_range_valid(d, e)    \
   ((d->header->agg_pos + d->transistor_range_threshold < d->start + d->len) ? \
@@ -724,7 +821,7 @@ vol_out_of_phase_valid(Vol *d, Dir *e)
 TS_INLINE int
 vol_out_of_phase_agg_valid(Vol *d, Dir *e)
 {
-  return (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + AGG_SIZE) / CACHE_BLOCK_SIZE));
+  return (dir_offset(e) - 1 >= ((d->header->agg_pos - d->start + d->agg_size) / CACHE_BLOCK_SIZE));
 }
 
 TS_INLINE int
@@ -736,7 +833,7 @@ vol_out_of_phase_write_valid(Vol *d, Dir *e)
 TS_INLINE int
 vol_in_phase_valid(Vol *d, Dir *e)
 {
-  return (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE));
+  return (dir_offset(e) - 1 < ((d->header->write_pos + d->agg_write_len + d->agg_buf_pos - d->start) / CACHE_BLOCK_SIZE));
 }
 
 TS_INLINE off_t
@@ -766,7 +863,8 @@ vol_dir_segment(Vol *d, int s)
 TS_INLINE int
 vol_in_phase_agg_buf_valid(Vol *d, Dir *e)
 {
-  return (vol_offset(d, e) >= d->header->write_pos && vol_offset(d, e) < (d->header->write_pos + d->agg_buf_pos));
+  return (vol_offset(d, e) >= d->header->write_pos &&
+          vol_offset(d, e) < (d->header->write_pos + d->agg_write_len + d->agg_buf_pos));
 }
 #endif
 // length of the partition not including the offset of location 0.
@@ -776,6 +874,20 @@ vol_relative_length(Vol *v, off_t start_offset)
    return (v->len + v->skip) - start_offset;
 }
 
+// While a volume recovers in the background only entries written in the
+// current phase behind the write position of the last directory sync are
+// trusted. Anything ahead of it may have been overwritten after that sync
+// and is treated as a miss until the scan is done. If the scan wraps the
+// whole volume is suspect. Reads still check the document key, which
+// covers a post sync burst that wraps before the scan gets there.
+TS_INLINE bool
+vol_recovery_safe(Vol *d, Dir *e)
+{
+  if (!d->recovering)
+    return true;
+  return !d->recover_wrapped && dir_phase(e) == d->header->phase && vol_offset(d, e) < d->header->write_pos;
+}
+
 TS_INLINE uint32_t
 Doc::prefix_len()
 {
@@ -863,7 +975,7 @@ TS_INLINE int
 Vol::within_hit_evacuate_window(Dir *xdir)
 {
   off_t oft = dir_offset(xdir) - 1;
-  off_t write_off = (header->write_pos + AGG_SIZE - start) / CACHE_BLOCK_SIZE;
+  off_t write_off = (header->write_pos + agg_size - start) / CACHE_BLOCK_SIZE;
   off_t delta = oft - write_off;
   if (delta >= 0)
     return delta < hit_evacuate_window;
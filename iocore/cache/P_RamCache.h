@@ -40,5 +40,6 @@ struct RamCache {
 
 RamCache *new_RamCacheLRU();
 RamCache *new_RamCacheCLFUS();
+RamCache *new_RamCacheTinyLFU();
 
 #endif /* _P_RAM_CACHE_H__ */
@@ -32,12 +32,20 @@
 #if TS_HAS_LZMA
 #include <lzma.h>
 #endif
+#if TS_HAS_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
 
 #define REQUIRED_COMPRESSION 0.9 // must get to this size or declared incompressible
 #define REQUIRED_SHRINK 0.8 // must get to this size or keep orignal buffer (with padding)
 #define HISTORY_HYSTERIA 10 // extra temporary history
 #define ENTRY_OVERHEAD 256 // per-entry overhead to consider when computing cache value/size
 #define LZMA_BASE_MEMLIMIT (64 * 1024 * 1024)
+#define COMPRESS_BATCH 16 // entries compressed per trip through the volume lock
+#define ZSTD_LEVEL 3
+#define ZSTD_SAMPLE_SIZE (16 * 1024) // bytes of an entry used to train the dictionary
+#define ZSTD_SAMPLE_FACTOR 64 // sample bytes per byte of dictionary
 //#define CHECK_ACOUNTING 1 // very expensive double checking of all sizes
 
 #define REQUEUE_HITS(_h) ((_h) ? 1 : 0)
@@ -66,6 +74,88 @@ struct RamCacheCLFUSEntry {
   Ptr<IOBufferData> data;
 };
 
+#if TS_HAS_ZSTD
+// Dictionary trained on the first entries a RAM cache compresses. It is
+// built once and never replaced, so entries compressed with it can always
+// be decompressed.
+struct RamCacheCLFUSDict {
+  ink_mutex mutex; // protects the samples
+  char *samples;
+  size_t *sample_sizes;
+  size_t samples_len;
+  size_t samples_max;
+  unsigned nsamples;
+  bool done; // trained, failed or disabled, no more samples
+  // Set under the volume lock once trained.
+  ZSTD_CDict *cdict;
+  ZSTD_DDict *ddict;
+  unsigned id;
+
+  RamCacheCLFUSDict(): samples(0), sample_sizes(0), samples_len(0), samples_max(0), nsamples(0), done(false),
+                       cdict(0), ddict(0), id(0) {
+    ink_mutex_init(&mutex, "RamCacheCLFUSDict");
+  }
+  ~RamCacheCLFUSDict() {
+    ats_free(samples);
+    ats_free(sample_sizes);
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+    ink_mutex_destroy(&mutex);
+  }
+};
+
+// The (de)compression contexts are kept per thread, and shared by all the RAM
+// caches, so there are at most two for each thread and they go away with it.
+static ink_thread_key zstd_cctx_key;
+static ink_thread_key zstd_dctx_key;
+static pthread_once_t zstd_ctx_once = PTHREAD_ONCE_INIT;
+
+static void
+free_zstd_cctx(void *cctx)
+{
+  ZSTD_freeCCtx((ZSTD_CCtx *)cctx);
+}
+
+static void
+free_zstd_dctx(void *dctx)
+{
+  ZSTD_freeDCtx((ZSTD_DCtx *)dctx);
+}
+
+static void
+init_zstd_ctx_keys()
+{
+  ink_thread_key_create(&zstd_cctx_key, free_zstd_cctx);
+  ink_thread_key_create(&zstd_dctx_key, free_zstd_dctx);
+}
+
+static ZSTD_CCtx *
+zstd_thread_cctx()
+{
+  pthread_once(&zstd_ctx_once, init_zstd_ctx_keys);
+  ZSTD_CCtx *cctx = (ZSTD_CCtx *)ink_thread_getspecific(zstd_cctx_key);
+  if (!cctx) {
+    cctx = ZSTD_createCCtx();
+    ink_thread_setspecific(zstd_cctx_key, cctx);
+  }
+  return cctx;
+}
+
+static ZSTD_DCtx *
+zstd_thread_dctx()
+{
+  pthread_once(&zstd_ctx_once, init_zstd_ctx_keys);
+  ZSTD_DCtx *dctx = (ZSTD_DCtx *)ink_thread_getspecific(zstd_dctx_key);
+  if (!dctx) {
+    dctx = ZSTD_createDCtx();
+    ink_thread_setspecific(zstd_dctx_key, dctx);
+  }
+  return dctx;
+}
+#endif
+
+class RamCacheCLFUSCompressor;
+
 struct RamCacheCLFUS : public RamCache {
   int64_t max_bytes;
   int64_t bytes;
@@ -88,6 +178,13 @@ struct RamCacheCLFUS : public RamCache {
   uint16_t *seen;
   int ncompressed;
   RamCacheCLFUSEntry *compressed; // first uncompressed lru[0] entry
+  int64_t compress_backlog; // last value added to the backlog stat
+  RamCacheCLFUSCompressor **compressors;
+  int ncompressors;
+#if TS_HAS_ZSTD
+  RamCacheCLFUSDict dict;
+  void add_sample(EThread *thread, IOBufferData *data, uint32_t len);
+#endif
   void compress_entries(EThread *thread, int do_at_most = INT_MAX);
   void resize_hashtable();
   void victimize(RamCacheCLFUSEntry *e);
@@ -96,21 +193,38 @@ struct RamCacheCLFUS : public RamCache {
   void requeue_victims(RamCacheCLFUS *c, Que(RamCacheCLFUSEntry, lru_link) &victims);
   void tick(); // move CLOCK on history
   RamCacheCLFUS(): max_bytes(0), bytes(0), objects(0), vol(0), history(0), ibuckets(0), nbuckets(0), bucket(0),
-              seen(0), ncompressed(0), compressed(0) { }
+              seen(0), ncompressed(0), compressed(0), compress_backlog(0), compressors(0), ncompressors(0)
+  { }
+  ~RamCacheCLFUS();
 };
 
+// One of these runs on every task thread for each RAM cache, so the
+// entries of a single large RAM cache are compressed in parallel.
+// A worker has a mutex of its own, so the RAM cache can stop it safely.
 class RamCacheCLFUSCompressor : public Continuation {
 public:
   RamCacheCLFUS *rc;
+  Event *event;
   int mainEvent(int event, Event *e);
 
   RamCacheCLFUSCompressor(RamCacheCLFUS *arc)
-    : rc(arc)
+    : Continuation(new_ProxyMutex()), rc(arc), event(0)
   { 
     SET_HANDLER(&RamCacheCLFUSCompressor::mainEvent); 
   }
 };
 
+// An entry being compressed outside the volume lock.
+struct RamCacheCLFUSCompressJob {
+  RamCacheCLFUSEntry *e;
+  Ptr<IOBufferData> data; // keeps the source alive, and identifies the entry afterwards
+  INK_MD5 key;
+  uint32_t len;
+  char *b;
+  uint32_t l;
+  bool failed;
+};
+
 int
 RamCacheCLFUSCompressor::mainEvent(int /* event ATS_UNUSED */, Event *e)
 {
@@ -128,6 +242,11 @@ RamCacheCLFUSCompressor::mainEvent(int /* event ATS_UNUSED */, Event *e)
     case CACHE_COMPRESSION_LIBLZMA:
 #if ! TS_HAS_LZMA
       Warning("lzma not available for RAM cache compression");
+#endif
+      break;
+    case CACHE_COMPRESSION_ZSTD:
+#if ! TS_HAS_ZSTD
+      Warning("zstd not available for RAM cache compression");
 #endif
       break;
   }
@@ -180,7 +299,43 @@ RamCacheCLFUS::init(int64_t abytes, Vol *avol)
   if (!max_bytes)
     return;
   resize_hashtable();
-  eventProcessor.schedule_every(new RamCacheCLFUSCompressor(this), HRTIME_SECOND, ET_TASK);
+#if TS_HAS_ZSTD
+  dict.samples_max = (size_t)cache_config_ram_cache_compress_dict_size * ZSTD_SAMPLE_FACTOR;
+  dict.done = !dict.samples_max;
+#endif
+  int ntasks = eventProcessor.n_threads_for_type[ET_TASK];
+  ncompressors = MAX(ntasks, 1);
+  compressors = (RamCacheCLFUSCompressor **)ats_malloc(ncompressors * sizeof(RamCacheCLFUSCompressor *));
+  for (int i = 0; i < ncompressors; i++) {
+    RamCacheCLFUSCompressor *c = new RamCacheCLFUSCompressor(this);
+    compressors[i] = c;
+    if (!ntasks)
+      c->event = eventProcessor.schedule_every(c, HRTIME_SECOND, ET_TASK);
+    else
+      c->event = eventProcessor.eventthread[ET_TASK][i]->schedule_every(c, HRTIME_SECOND);
+  }
+}
+
+// Only the RAM cache simulation (the ram_cache regression test) destroys a RAM
+// cache, the volume is not in use any more.
+RamCacheCLFUS::~RamCacheCLFUS()
+{
+  EThread *thread = this_ethread();
+  // a worker may be running, wait for it before cancelling its event
+  for (int i = 0; i < ncompressors; i++) {
+    RamCacheCLFUSCompressor *c = compressors[i];
+    Ptr<ProxyMutex> m = c->mutex;
+    MUTEX_TAKE_LOCK(m, thread);
+    c->event->cancel(c);
+    MUTEX_UNTAKE_LOCK(m, thread);
+    delete c;
+  }
+  ats_free(compressors);
+  for (int i = 0; i < nbuckets; i++)
+    while (bucket[i].head)
+      destroy(bucket[i].head);
+  ats_free(bucket);
+  ats_free(seen);
 }
 
 #ifdef CHECK_ACOUNTING
@@ -241,6 +396,21 @@ RamCacheCLFUS::get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1,
                 goto Lfailed;
               break;
             }
+#endif
+#if TS_HAS_ZSTD
+            case CACHE_COMPRESSION_ZSTD: {
+              size_t l;
+              ZSTD_DCtx *zstd_dctx = zstd_thread_dctx();
+              if (ZSTD_getDictID_fromFrame(e->data->data(), e->compressed_len)) {
+                if (!dict.ddict)
+                  goto Lfailed;
+                l = ZSTD_decompress_usingDDict(zstd_dctx, b, e->len, e->data->data(), e->compressed_len, dict.ddict);
+              } else
+                l = ZSTD_decompressDCtx(zstd_dctx, b, e->len, e->data->data(), e->compressed_len);
+              if (ZSTD_isError(l) || l != e->len)
+                goto Lfailed;
+              break;
+            }
 #endif
           }
           IOBufferData *data = new_xmalloc_IOBufferData(b, e->len);
@@ -352,133 +522,246 @@ RamCacheCLFUS::destroy(RamCacheCLFUSEntry *e)
   return ret;
 }
 
-void
-RamCacheCLFUS::compress_entries(EThread *thread, int do_at_most)
+// Compress one entry into a new buffer, without the volume lock.
+static void
+compress_job(int ctype, RamCacheCLFUSCompressJob &j, void *cdict)
 {
-  if (!cache_config_ram_cache_compress)
-    return;
-  ink_assert(vol != 0);
-  MUTEX_TAKE_LOCK(vol->mutex, thread);
-  if (!compressed) {
-    compressed = lru[0].head;
-    ncompressed = 0;
+  uint32_t l = 0;
+  switch (ctype) {
+    default: j.failed = true; return;
+    case CACHE_COMPRESSION_FASTLZ: l = (uint32_t)((double)j.len * 1.05 + 66); break;
+#if TS_HAS_LIBZ
+    case CACHE_COMPRESSION_LIBZ: l = (uint32_t)compressBound(j.len); break;
+#endif
+#if TS_HAS_LZMA
+    case CACHE_COMPRESSION_LIBLZMA: l = j.len; break;
+#endif
+#if TS_HAS_ZSTD
+    case CACHE_COMPRESSION_ZSTD: l = (uint32_t)ZSTD_compressBound(j.len); break;
+#endif
   }
-  float target = (cache_config_ram_cache_compress_percent / 100.0) * objects;
-  int n = 0;
-  char *b = 0, *bb = 0;
-  while (compressed && target > ncompressed) {
-    RamCacheCLFUSEntry *e = compressed;
-    if (e->flag_bits.incompressible || e->flag_bits.compressed)
-      goto Lcontinue;
-    n++;
-    if (do_at_most < n)
+  j.b = (char*)ats_malloc(l);
+  switch (ctype) {
+    case CACHE_COMPRESSION_FASTLZ:
+      if (j.len < 16 || (l = fastlz_compress(j.data->data(), j.len, j.b)) <= 0)
+        j.failed = true;
       break;
-    {
-      e->compressed_len = e->size;
-      uint32_t l = 0;
-      int ctype = cache_config_ram_cache_compress;
-      switch (ctype) {
-        default: goto Lcontinue;
-        case CACHE_COMPRESSION_FASTLZ: l = (uint32_t)((double)e->len * 1.05 + 66); break;
 #if TS_HAS_LIBZ
-        case CACHE_COMPRESSION_LIBZ: l = (uint32_t)compressBound(e->len); break;
+    case CACHE_COMPRESSION_LIBZ: {
+      uLongf ll = l;
+      if ((Z_OK != compress((Bytef*)j.b, &ll, (Bytef*)j.data->data(), j.len)))
+        j.failed = true;
+      l = (int)ll;
+      break;
+    }
 #endif
 #if TS_HAS_LZMA
-        case CACHE_COMPRESSION_LIBLZMA: l = e->len; break;
+    case CACHE_COMPRESSION_LIBLZMA: {
+      size_t pos = 0, ll = l;
+      if (LZMA_OK != lzma_easy_buffer_encode(LZMA_PRESET_DEFAULT, LZMA_CHECK_NONE, NULL,
+                                             (uint8_t*)j.data->data(), j.len, (uint8_t*)j.b, &pos, ll))
+        j.failed = true;
+      l = (int)pos;
+      break;
+    }
+#endif
+#if TS_HAS_ZSTD
+    case CACHE_COMPRESSION_ZSTD: {
+      size_t ll;
+      ZSTD_CCtx *zstd_cctx = zstd_thread_cctx();
+      if (cdict)
+        ll = ZSTD_compress_usingCDict(zstd_cctx, j.b, l, j.data->data(), j.len, (ZSTD_CDict*)cdict);
+      else
+        ll = ZSTD_compressCCtx(zstd_cctx, j.b, l, j.data->data(), j.len, ZSTD_LEVEL);
+      if (ZSTD_isError(ll))
+        j.failed = true;
+      l = (uint32_t)ll;
+      break;
+    }
 #endif
+  }
+  j.l = l;
+}
+
+#if TS_HAS_ZSTD
+// Keep the start of an entry as a training sample. The worker that fills
+// the sample buffer trains the dictionary, without any lock, and then
+// publishes it under the volume lock.
+void
+RamCacheCLFUS::add_sample(EThread *thread, IOBufferData *data, uint32_t len)
+{
+  size_t n = MIN(len, (uint32_t)ZSTD_SAMPLE_SIZE);
+
+  ink_mutex_acquire(&dict.mutex);
+  if (dict.done) {
+    ink_mutex_release(&dict.mutex);
+    return;
+  }
+  if (!dict.samples) {
+    dict.samples = (char*)ats_malloc(dict.samples_max);
+    dict.sample_sizes = (size_t*)ats_malloc(sizeof(size_t) * (dict.samples_max / 64 + 1));
+  }
+  n = MIN(n, dict.samples_max - dict.samples_len);
+  if (n < 64) { // keep small objects from exhausting sample_sizes
+    ink_mutex_release(&dict.mutex);
+    return;
+  }
+  memcpy(dict.samples + dict.samples_len, data->data(), n);
+  dict.samples_len += n;
+  dict.sample_sizes[dict.nsamples++] = n;
+  if (dict.samples_len + 64 <= dict.samples_max) {
+    ink_mutex_release(&dict.mutex);
+    return;
+  }
+  dict.done = true;
+  ink_mutex_release(&dict.mutex);
+
+  size_t dict_size = cache_config_ram_cache_compress_dict_size;
+  char *buf = (char*)ats_malloc(dict_size);
+  size_t l = ZDICT_trainFromBuffer(buf, dict_size, dict.samples, dict.sample_sizes, dict.nsamples);
+  if (ZDICT_isError(l)) {
+    Debug("ram_cache", "unable to train compression dictionary: %s", ZDICT_getErrorName(l));
+  } else {
+    ZSTD_CDict *cdict = ZSTD_createCDict(buf, l, ZSTD_LEVEL);
+    ZSTD_DDict *ddict = ZSTD_createDDict(buf, l);
+    MUTEX_TAKE_LOCK(vol->mutex, thread);
+    dict.id = ZDICT_getDictID(buf, l);
+    dict.ddict = ddict;
+    dict.cdict = cdict;
+    MUTEX_UNTAKE_LOCK(vol->mutex, thread);
+    Debug("ram_cache", "trained %zu byte compression dictionary %u from %u samples", l, dict.id, dict.nsamples);
+  }
+  ats_free(buf);
+  ats_free(dict.samples);
+  ats_free(dict.sample_sizes);
+  dict.samples = 0;
+  dict.sample_sizes = 0;
+}
+#endif
+
+/*
+   Entries are claimed in batches from the compressed cursor under the
+   volume lock, compressed with the lock released and then installed
+   under the lock again if they have not changed in the meantime. Every
+   task thread runs a worker for each RAM cache so batches of the same
+   cache are compressed in parallel.
+*/
+void
+RamCacheCLFUS::compress_entries(EThread *thread, int do_at_most)
+{
+  int ctype = cache_config_ram_cache_compress;
+  if (!ctype)
+    return;
+  ink_assert(vol != 0);
+  RamCacheCLFUSCompressJob job[COMPRESS_BATCH];
+  int n = 0;
+  MUTEX_TAKE_LOCK(vol->mutex, thread);
+  while (n < do_at_most) {
+    if (!compressed) {
+      compressed = lru[0].head;
+      ncompressed = 0;
+    }
+    float target = (cache_config_ram_cache_compress_percent / 100.0) * objects;
+    int njobs = 0;
+    while (compressed && target > ncompressed && njobs < COMPRESS_BATCH && n < do_at_most) {
+      RamCacheCLFUSEntry *e = compressed;
+      if (!e->flag_bits.incompressible && !e->flag_bits.compressed) {
+        RamCacheCLFUSCompressJob &j = job[njobs++];
+        e->compressed_len = e->size;
+        j.e = e;
+        j.data = e->data;
+        j.key = e->key;
+        j.len = e->len;
+        j.b = 0;
+        j.l = 0;
+        j.failed = false;
+        n++;
       }
-      // store transient data for lock release
-      Ptr<IOBufferData> edata = e->data;
-      uint32_t elen = e->len;
-      INK_MD5 key = e->key;
-      MUTEX_UNTAKE_LOCK(vol->mutex, thread);
-      b = (char*)ats_malloc(l);
-      bool failed = false;
-      switch (ctype) {
-        default: goto Lfailed;
-        case CACHE_COMPRESSION_FASTLZ:
-          if (e->len < 16) goto Lfailed;
-          if ((l = fastlz_compress(edata->data(), elen, b)) <= 0)
-            failed = true;
-          break;
-#if TS_HAS_LIBZ
-        case CACHE_COMPRESSION_LIBZ: {
-          uLongf ll = l;
-          if ((Z_OK != compress((Bytef*)b, &ll, (Bytef*)edata->data(), elen)))
-            failed = true;
-          l = (int)ll;
-          break;
-        }
+      if (!e->lru_link.next)
+        break;
+      compressed = e->lru_link.next;
+      ncompressed++;
+    }
+    int64_t backlog = target > ncompressed ? (int64_t)(target - ncompressed) : 0;
+    CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_compress_backlog_stat, backlog - compress_backlog);
+    compress_backlog = backlog;
+    if (!njobs)
+      break;
+    void *cdict = NULL;
+#if TS_HAS_ZSTD
+    cdict = dict.cdict;
 #endif
-#if TS_HAS_LZMA
-        case CACHE_COMPRESSION_LIBLZMA: {
-          size_t pos = 0, ll = l;
-          if (LZMA_OK != lzma_easy_buffer_encode(LZMA_PRESET_DEFAULT, LZMA_CHECK_NONE, NULL,
-                                                 (uint8_t*)edata->data(), elen, (uint8_t*)b, &pos, ll))
-            failed = true;
-          l = (int)pos;
-          break;
-        }
+    MUTEX_UNTAKE_LOCK(vol->mutex, thread);
+    for (int i = 0; i < njobs; i++) {
+      compress_job(ctype, job[i], cdict);
+#if TS_HAS_ZSTD
+      if (ctype == CACHE_COMPRESSION_ZSTD && !dict.done)
+        add_sample(thread, job[i].data, job[i].len);
 #endif
+    }
+    MUTEX_TAKE_LOCK(vol->mutex, thread);
+    for (int i = 0; i < njobs; i++) {
+      RamCacheCLFUSCompressJob &j = job[i];
+      // see if the entry is still around
+      uint32_t bi = j.key.slice32(3) % nbuckets;
+      RamCacheCLFUSEntry *e = bucket[bi].head;
+      while (e) {
+        if (e->key == j.key && e->data == j.data) break;
+        e = e->hash_link.next;
       }
-      MUTEX_TAKE_LOCK(vol->mutex, thread);
-      // see if the entry is till around
-      {
-        uint32_t i = key.slice32(3) % nbuckets;
-        RamCacheCLFUSEntry *ee = bucket[i].head;
-        while (ee) {
-          if (ee->key == key && ee->data == edata) break;
-          ee = ee->hash_link.next;
-        }
-        if (!ee || ee != e) {
-          e = compressed;
-          goto Lcontinue;
-        }
-        if (failed)
-          goto Lfailed;
+      if (!e || e != j.e) {
+        ats_free(j.b);
+        j.data = NULL;
+        continue;
       }
+      uint32_t l = j.l;
+      if (j.failed)
+        goto Lfailed;
       if (l > REQUIRED_COMPRESSION * e->len)
         e->flag_bits.incompressible = true;
       if (l > REQUIRED_SHRINK * e->size)
         goto Lfailed;
-      if (l < e->len) {
-        e->flag_bits.compressed = cache_config_ram_cache_compress;
-        bb = (char*)ats_malloc(l);
-        memcpy(bb, b, l);
-        ats_free(b);
-        e->compressed_len = l;
-        int64_t delta = ((int64_t)l) - (int64_t)e->size;
-        bytes += delta;
-        CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, delta);
-        e->size = l;
-      } else {
-        ats_free(b);
-        e->flag_bits.compressed = 0;
-        bb = (char*)ats_malloc(e->len);
-        memcpy(bb, e->data->data(), e->len);
-        int64_t delta = ((int64_t)e->len) - (int64_t)e->size;
-        bytes += delta;
-        CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, delta);
-        e->size = e->len;
-        l = e->len;
+      {
+        char *bb;
+        if (l < e->len) {
+          e->flag_bits.compressed = ctype;
+          bb = (char*)ats_malloc(l);
+          memcpy(bb, j.b, l);
+          ats_free(j.b);
+          e->compressed_len = l;
+          int64_t delta = ((int64_t)l) - (int64_t)e->size;
+          bytes += delta;
+          CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, delta);
+          CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_compress_entries_stat, 1);
+          CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_compress_bytes_in_stat, e->len);
+          CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_compress_bytes_out_stat, l);
+          e->size = l;
+        } else {
+          ats_free(j.b);
+          e->flag_bits.compressed = 0;
+          bb = (char*)ats_malloc(e->len);
+          memcpy(bb, e->data->data(), e->len);
+          int64_t delta = ((int64_t)e->len) - (int64_t)e->size;
+          bytes += delta;
+          CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, delta);
+          e->size = e->len;
+          l = e->len;
+        }
+        e->data = new_xmalloc_IOBufferData(bb, l);
+        e->data->_mem_type = DEFAULT_ALLOC;
+        check_accounting(this);
       }
-      e->data = new_xmalloc_IOBufferData(bb, l);
-      e->data->_mem_type = DEFAULT_ALLOC;
-      check_accounting(this);
+      goto Ldone;
+    Lfailed:
+      ats_free(j.b);
+      e->flag_bits.incompressible = 1;
+    Ldone:
+      j.data = NULL;
+      DDebug("ram_cache", "compress %X %d %d %d %d %d %d %d",
+             e->key.slice32(3), e->auxkey1, e->auxkey2,
+             e->flag_bits.incompressible, e->flag_bits.compressed,
+             e->len, e->compressed_len, ncompressed);
     }
-    goto Lcontinue;
-  Lfailed:
-    ats_free(b);
-    e->flag_bits.incompressible = 1;
-  Lcontinue:;
-    DDebug("ram_cache", "compress %X %d %d %d %d %d %d %d",
-           e->key.slice32(3), e->auxkey1, e->auxkey2,
-           e->flag_bits.incompressible, e->flag_bits.compressed,
-           e->len, e->compressed_len, ncompressed);
-    if (!e->lru_link.next)
-      break;
-    compressed = e->lru_link.next;
-    ncompressed++;
   }
   MUTEX_UNTAKE_LOCK(vol->mutex, thread);
   return;
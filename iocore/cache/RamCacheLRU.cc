@@ -56,6 +56,7 @@ struct RamCacheLRU: public RamCache {
   RamCacheLRUEntry *remove(RamCacheLRUEntry *e);
 
   RamCacheLRU():bytes(0), objects(0), seen(0), bucket(0), nbuckets(0), ibuckets(0), vol(NULL) {}
+  ~RamCacheLRU();
 };
 
 ClassAllocator<RamCacheLRUEntry> ramCacheLRUEntryAllocator("RamCacheLRUEntry");
@@ -100,6 +101,16 @@ RamCacheLRU::init(int64_t abytes, Vol *avol) {
   resize_hashtable();
 }
 
+// Only the RAM cache simulation (the ram_cache regression test) destroys a RAM
+// cache.
+RamCacheLRU::~RamCacheLRU() {
+  for (int i = 0; i < nbuckets; i++)
+    while (bucket[i].head)
+      remove(bucket[i].head);
+  ats_free(bucket);
+  ats_free(seen);
+}
+
 int
 RamCacheLRU::get(INK_MD5 * key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1, uint32_t auxkey2) {
   if (!max_bytes)
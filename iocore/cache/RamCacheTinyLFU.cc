@@ -0,0 +1,296 @@
+/** @file
+
+  RAM cache with the W-TinyLFU replacement policy (ram_cache.algorithm 2)
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// Window TinyLFU (W-TinyLFU) replacement policy.
+//
+// New objects enter a small LRU admission window.  Objects leaving the
+// window compete with the eviction victim of the main cache, and are only
+// admitted if they have been accessed more often, as estimated by a
+// count-min sketch of recent history.  The main cache is a segmented LRU:
+// objects hit while on probation are promoted to the protected segment.
+// The sketch is aged by halving all the counters periodically, so the
+// frequencies follow changes in popularity.  A flood of one-hit wonders
+// churns only the window, never the main cache.
+
+#include "P_Cache.h"
+
+#define WINDOW_PERCENT 1 // of the bytes, for the admission window
+#define PROTECTED_PERCENT 80 // of the bytes of the main cache
+#define SKETCH_MIN_WIDTH 1024
+
+enum {
+  TINYLFU_WINDOW,
+  TINYLFU_PROBATION,
+  TINYLFU_PROTECTED,
+  TINYLFU_SEGMENTS
+};
+
+struct RamCacheTinyLFUEntry {
+  INK_MD5 key;
+  uint32_t auxkey1;
+  uint32_t auxkey2;
+  uint32_t size;
+  int segment;
+  LINK(RamCacheTinyLFUEntry, lru_link);
+  LINK(RamCacheTinyLFUEntry, hash_link);
+  Ptr<IOBufferData> data;
+};
+
+struct RamCacheTinyLFU: public RamCache {
+  int64_t max_bytes;
+  int64_t objects;
+
+  // returns 1 on found/stored, 0 on not found/stored, if provided auxkey1 and auxkey2 must match
+  int get(INK_MD5 *key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1 = 0, uint32_t auxkey2 = 0);
+  int put(INK_MD5 *key, IOBufferData *data, uint32_t len, bool copy = false, uint32_t auxkey1 = 0, uint32_t auxkey2 = 0);
+  int fixup(INK_MD5 *key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2);
+
+  void init(int64_t max_bytes, Vol *vol);
+
+  // private
+  Que(RamCacheTinyLFUEntry, lru_link) lru[TINYLFU_SEGMENTS];
+  int64_t bytes[TINYLFU_SEGMENTS];
+  int64_t max_window;
+  int64_t max_protected;
+  DList(RamCacheTinyLFUEntry, hash_link) *bucket;
+  int nbuckets;
+  int ibuckets;
+  Vol *vol; // for stats
+
+  CacheSketch sketch;
+
+  void resize_hashtable();
+  void move(RamCacheTinyLFUEntry *e, int segment);
+  void admit();
+  RamCacheTinyLFUEntry *remove(RamCacheTinyLFUEntry *e);
+
+  int64_t main_bytes() { return bytes[TINYLFU_PROBATION] + bytes[TINYLFU_PROTECTED]; }
+
+  RamCacheTinyLFU(): max_bytes(0), objects(0), max_window(0), max_protected(0), bucket(0), nbuckets(0), ibuckets(0),
+                     vol(NULL) {
+    memset(bytes, 0, sizeof(bytes));
+  }
+  ~RamCacheTinyLFU();
+};
+
+ClassAllocator<RamCacheTinyLFUEntry> ramCacheTinyLFUEntryAllocator("RamCacheTinyLFUEntry");
+
+static const int bucket_sizes[] = {
+  127, 251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 131071, 262139,
+  524287, 1048573, 2097143, 4194301, 8388593, 16777213, 33554393, 67108859,
+  134217689, 268435399, 536870909
+};
+
+void RamCacheTinyLFU::resize_hashtable() {
+  int anbuckets = bucket_sizes[ibuckets];
+  DDebug("ram_cache", "resize hashtable %d", anbuckets);
+  int64_t s = anbuckets * sizeof(DList(RamCacheTinyLFUEntry, hash_link));
+  DList(RamCacheTinyLFUEntry, hash_link) *new_bucket = (DList(RamCacheTinyLFUEntry, hash_link) *)ats_malloc(s);
+  memset(new_bucket, 0, s);
+  if (bucket) {
+    for (int64_t i = 0; i < nbuckets; i++) {
+      RamCacheTinyLFUEntry *e = 0;
+      while ((e = bucket[i].pop()))
+        new_bucket[e->key.slice32(3) % anbuckets].push(e);
+    }
+    ats_free(bucket);
+  }
+  bucket = new_bucket;
+  nbuckets = anbuckets;
+}
+
+void
+RamCacheTinyLFU::init(int64_t abytes, Vol *avol) {
+  vol = avol;
+  max_bytes = abytes;
+  DDebug("ram_cache", "initializing ram_cache %" PRId64 " bytes", abytes);
+  if (!max_bytes)
+    return;
+  max_window = max_bytes * WINDOW_PERCENT / 100;
+  max_protected = (max_bytes - max_window) * PROTECTED_PERCENT / 100;
+  resize_hashtable();
+  // Enough counters to track several times as many objects as fit.
+  sketch.init(MIN(MAX(4 * max_bytes / cache_config_min_average_object_size, (int64_t)SKETCH_MIN_WIDTH), (int64_t)1 << 26));
+}
+
+// Only the RAM cache simulation (the ram_cache regression test) destroys a RAM
+// cache.
+RamCacheTinyLFU::~RamCacheTinyLFU() {
+  for (int i = 0; i < nbuckets; i++)
+    while (bucket[i].head)
+      remove(bucket[i].head);
+  ats_free(bucket);
+}
+
+void
+RamCacheTinyLFU::move(RamCacheTinyLFUEntry *e, int segment) {
+  lru[e->segment].remove(e);
+  bytes[e->segment] -= e->size;
+  e->segment = segment;
+  lru[segment].enqueue(e);
+  bytes[segment] += e->size;
+}
+
+RamCacheTinyLFUEntry *
+RamCacheTinyLFU::remove(RamCacheTinyLFUEntry *e) {
+  RamCacheTinyLFUEntry *ret = e->hash_link.next;
+  uint32_t b = e->key.slice32(3) % nbuckets;
+  bucket[b].remove(e);
+  lru[e->segment].remove(e);
+  bytes[e->segment] -= e->size;
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, -(int64_t)e->size);
+  DDebug("ram_cache", "put %X %d %d FREED", e->key.slice32(3), e->auxkey1, e->auxkey2);
+  e->data = NULL;
+  THREAD_FREE(e, ramCacheTinyLFUEntryAllocator, this_thread());
+  objects--;
+  return ret;
+}
+
+// Move objects out of the window into the main cache, when they are
+// more popular than what they would replace.
+void
+RamCacheTinyLFU::admit() {
+  while (bytes[TINYLFU_WINDOW] > max_window) {
+    RamCacheTinyLFUEntry *candidate = lru[TINYLFU_WINDOW].head;
+    int f = sketch.frequency(&candidate->key);
+    bool admitted = true;
+    while (main_bytes() + candidate->size > max_bytes - max_window) {
+      RamCacheTinyLFUEntry *victim = lru[TINYLFU_PROBATION].head;
+      if (!victim)
+        victim = lru[TINYLFU_PROTECTED].head;
+      if (!victim)
+        break;
+      if (f <= sketch.frequency(&victim->key)) {
+        admitted = false;
+        break;
+      }
+      remove(victim);
+    }
+    if (admitted) {
+      DDebug("ram_cache", "put %X %d %d ADMITTED", candidate->key.slice32(3), candidate->auxkey1, candidate->auxkey2);
+      move(candidate, TINYLFU_PROBATION);
+    } else {
+      DDebug("ram_cache", "put %X %d %d REJECTED", candidate->key.slice32(3), candidate->auxkey1, candidate->auxkey2);
+      remove(candidate);
+    }
+  }
+  // an object larger than the main cache
+  while (main_bytes() > max_bytes - max_window && lru[TINYLFU_PROBATION].head)
+    remove(lru[TINYLFU_PROBATION].head);
+}
+
+int
+RamCacheTinyLFU::get(INK_MD5 * key, Ptr<IOBufferData> *ret_data, uint32_t auxkey1, uint32_t auxkey2) {
+  if (!max_bytes)
+    return 0;
+  sketch.touch(key);
+  uint32_t i = key->slice32(3) % nbuckets;
+  RamCacheTinyLFUEntry *e = bucket[i].head;
+  while (e) {
+    if (e->key == *key && e->auxkey1 == auxkey1 && e->auxkey2 == auxkey2) {
+      switch (e->segment) {
+        case TINYLFU_WINDOW:
+        case TINYLFU_PROTECTED:
+          move(e, e->segment);
+          break;
+        case TINYLFU_PROBATION:
+          move(e, TINYLFU_PROTECTED);
+          while (bytes[TINYLFU_PROTECTED] > max_protected)
+            move(lru[TINYLFU_PROTECTED].head, TINYLFU_PROBATION);
+          break;
+      }
+      (*ret_data) = e->data;
+      DDebug("ram_cache", "get %X %d %d HIT", key->slice32(3), auxkey1, auxkey2);
+      CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_hits_stat, 1);
+      return 1;
+    }
+    e = e->hash_link.next;
+  }
+  DDebug("ram_cache", "get %X %d %d MISS", key->slice32(3), auxkey1, auxkey2);
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_misses_stat, 1);
+  return 0;
+}
+
+// ignore 'copy' since we don't touch the data
+int RamCacheTinyLFU::put(INK_MD5 *key, IOBufferData *data, uint32_t len, bool, uint32_t auxkey1, uint32_t auxkey2) {
+  if (!max_bytes)
+    return 0;
+  uint32_t i = key->slice32(3) % nbuckets;
+  RamCacheTinyLFUEntry *e = bucket[i].head;
+  while (e) {
+    if (e->key == *key) {
+      if (e->auxkey1 == auxkey1 && e->auxkey2 == auxkey2) {
+        move(e, e->segment);
+        return 1;
+      } else { // discard when aux keys conflict
+        e = remove(e);
+        continue;
+      }
+    }
+    e = e->hash_link.next;
+  }
+  uint32_t size = data->block_size();
+  if (size > max_bytes - max_window) {
+    DDebug("ram_cache", "put %X %d %d len %d TOO LARGE", key->slice32(3), auxkey1, auxkey2, len);
+    return 0;
+  }
+  e = THREAD_ALLOC(ramCacheTinyLFUEntryAllocator, this_ethread());
+  e->key = *key;
+  e->auxkey1 = auxkey1;
+  e->auxkey2 = auxkey2;
+  e->size = size;
+  e->segment = TINYLFU_WINDOW;
+  e->data = data;
+  bucket[i].push(e);
+  lru[TINYLFU_WINDOW].enqueue(e);
+  bytes[TINYLFU_WINDOW] += size;
+  objects++;
+  CACHE_SUM_DYN_STAT_THREAD(cache_ram_cache_bytes_stat, size);
+  DDebug("ram_cache", "put %X %d %d len %d INSERTED", key->slice32(3), auxkey1, auxkey2, len);
+  admit();
+  if (objects > nbuckets) {
+    ++ibuckets;
+    resize_hashtable();
+  }
+  return 1;
+}
+
+int RamCacheTinyLFU::fixup(INK_MD5 * key, uint32_t old_auxkey1, uint32_t old_auxkey2, uint32_t new_auxkey1, uint32_t new_auxkey2) {
+  if (!max_bytes)
+    return 0;
+  uint32_t i = key->slice32(3) % nbuckets;
+  RamCacheTinyLFUEntry *e = bucket[i].head;
+  while (e) {
+    if (e->key == *key && e->auxkey1 == old_auxkey1 && e->auxkey2 == old_auxkey2) {
+      e->auxkey1 = new_auxkey1;
+      e->auxkey2 = new_auxkey2;
+      return 1;
+    }
+    e = e->hash_link.next;
+  }
+  return 0;
+}
+
+RamCache *new_RamCacheTinyLFU() {
+  return new RamCacheTinyLFU;
+}
@@ -35,6 +35,8 @@
 
 char const Store::VOLUME_KEY[] = "volume";
 char const Store::HASH_BASE_STRING_KEY[] = "id";
+char const Store::TIER_KEY[] = "tier";
+char const Store::AGG_SIZE_KEY[] = "agg_size";
 
 static span_error_t
 make_span_error(int error)
@@ -239,6 +241,18 @@ Span::volume_number_set(int n)
   forced_volume_num = n;
 }
 
+void
+Span::tier_set(int t)
+{
+  tier = t;
+}
+
+void
+Span::agg_size_set(int64_t s)
+{
+  agg_size = s;
+}
+
 void
 Store::delete_all()
 {
@@ -347,6 +361,8 @@ Store::read_config()
 
     int64_t size = -1;
     int volume_num = -1;
+    int tier = STORE_TIER_SLOW;
+    int64_t agg_size = 0;
     char const* e;
     while (0 != (e = tokens.getNext())) {
       if (ParseRules::is_digit(*e)) {
@@ -366,13 +382,31 @@ Store::read_config()
           err = "error parsing volume number";
           goto Lfail;
         }
+      } else if (0 == strncasecmp(TIER_KEY, e, sizeof(TIER_KEY)-1)) {
+        e += sizeof(TIER_KEY) - 1;
+        if ('=' == *e) ++e;
+        if (0 == strcasecmp(e, "fast")) {
+          tier = STORE_TIER_FAST;
+        } else if (0 == strcasecmp(e, "slow")) {
+          tier = STORE_TIER_SLOW;
+        } else {
+          err = "error parsing tier";
+          goto Lfail;
+        }
+      } else if (0 == strncasecmp(AGG_SIZE_KEY, e, sizeof(AGG_SIZE_KEY)-1)) {
+        e += sizeof(AGG_SIZE_KEY) - 1;
+        if ('=' == *e) ++e;
+        if (!*e || !ParseRules::is_digit(*e) || 0 >= (agg_size = ink_atoi64(e))) {
+          err = "error parsing agg_size";
+          goto Lfail;
+        }
       }
     }
 
     char *pp = Layout::get()->relative(path);
     ns = new Span;
-    Debug("cache_init", "Store::read_config - ns = new Span; ns->init(\"%s\",%" PRId64 "), forced volume=%d%s%s",
-          pp, size, volume_num, seed ? " id=" : "", seed ? seed : "");
+    Debug("cache_init", "Store::read_config - ns = new Span; ns->init(\"%s\",%" PRId64 "), forced volume=%d%s%s%s",
+          pp, size, volume_num, seed ? " id=" : "", seed ? seed : "", tier == STORE_TIER_FAST ? " tier=fast" : "");
     if ((err = ns->init(pp, size))) {
       RecSignalWarning(REC_SIGNAL_SYSTEM_ERROR, "could not initialize storage \"%s\" [%s]", pp, err);
       Debug("cache_init", "Store::read_config - could not initialize storage \"%s\" [%s]", pp, err);
@@ -386,6 +420,8 @@ Store::read_config()
     // Set side values if present.
     if (seed) ns->hash_base_string_set(seed);
     if (volume_num > 0) ns->volume_number_set(volume_num);
+    ns->tier_set(tier);
+    if (agg_size > 0) ns->agg_size_set(agg_size);
 
     // new Span
     {
@@ -139,7 +139,7 @@ SplitDNSConfig::startup()
 
   //startup just check gsplit_dns_enabled
   REC_ReadConfigInt32(gsplit_dns_enabled, "proxy.config.dns.splitDNS.enabled");
-  splitDNSUpdate = new ConfigUpdateHandler<SplitDNSConfig>();
+  splitDNSUpdate = new ConfigUpdateHandler<SplitDNSConfig>(&ET_TASK);
   splitDNSUpdate->attach("proxy.config.cache.splitdns.filename");
 }
 
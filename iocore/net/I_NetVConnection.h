@@ -447,6 +447,26 @@ public:
    */
   virtual void trapWriteBufferEmpty(int event = VC_EVENT_WRITE_READY);
 
+  /** Returns true if this connection can move data with splice_to(). */
+  virtual bool splice_capable() const { return false; }
+
+  /** Move the data read from this connection to @a target in the kernel.
+
+      Both connections must have their IO set up: the read VIO of this
+      connection and the write VIO of @a target, writing from a reader of
+      the buffer the read VIO fills.  Once the data already in that buffer
+      is written, the data read is spliced through a pipe to the socket of
+      @a target instead, never reaching the buffer.  The VIOs are updated
+      and signalled as usual, but the buffer stays empty.
+
+      The link is dropped by a new do_io_read() on this connection, a new
+      do_io_write() on @a target, or closing either.
+
+      @return false if the connections can not be spliced, in which case
+      the data keeps moving through the buffer.
+   */
+  virtual bool splice_to(NetVConnection * /* target ATS_UNUSED */) { return false; }
+
   /** Returns local sockaddr storage. */
   sockaddr const* get_local_addr();
 
@@ -111,6 +111,9 @@ register_net_stats()
   RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.inactivity_cop_lock_acquire_failure",
                      RECD_INT, RECP_PERSISTENT, (int) inactivity_cop_lock_acquire_failure_stat,
                      RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS, "proxy.process.net.spliced_bytes",
+                     RECD_INT, RECP_PERSISTENT, (int) net_spliced_bytes_stat, RecRawStatSyncSum);
 }
 
 void
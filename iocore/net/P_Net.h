@@ -51,6 +51,7 @@ enum Net_Stats
   socks_connections_unsuccessful_stat,
   socks_connections_currently_open_stat,
   inactivity_cop_lock_acquire_failure_stat,
+  net_spliced_bytes_stat,
   Net_Stat_Count
 };
 
@@ -88,6 +88,11 @@ public:
   {
     return sslHandShakeComplete;
   };
+  // the data has to go through the SSL library
+  virtual bool splice_capable() const
+  {
+    return false;
+  };
   void setSSLHandShakeComplete(bool state)
   {
     sslHandShakeComplete = state;
@@ -156,6 +156,10 @@ extern int http_accept_port_number;
 #define ACCEPT_PERIOD                             -HRTIME_MSECONDS(4)
 #define NET_THROTTLE_DELAY                        50    /* mseconds */
 
+// pipes kept by each NetHandler for splicing, and how much goes through one at a time
+#define NET_SPLICE_PIPE_POOL                      64
+#define NET_SPLICE_PIPE_BYTES                     (64 * 1024)
+
 #define PRINT_IP(x) ((uint8_t*)&(x))[0],((uint8_t*)&(x))[1], ((uint8_t*)&(x))[2],((uint8_t*)&(x))[3]
 
 
@@ -196,11 +200,20 @@ public:
   time_t sec;
   int cycles;
 
+  // empty pipes of spliced connections, reused by the next ones
+  int splice_pipes[NET_SPLICE_PIPE_POOL][2];
+  int n_splice_pipes;
+
   int startNetEvent(int event, Event * data);
   int mainNetEvent(int event, Event * data);
   int mainNetEventExt(int event, Event * data);
   void process_enabled_list(NetHandler *);
 
+  /// Get a non blocking pipe for splicing into @a fds, false if none can be created.
+  bool get_splice_pipe(int fds[2]);
+  /// Give back a pipe, which is kept for reuse if @a empty, closed otherwise.
+  void put_splice_pipe(int fds[2], bool empty);
+
   NetHandler();
 };
 
@@ -107,6 +107,9 @@ public:
 
   virtual bool get_data(int id, void *data);
 
+  virtual bool splice_capable() const;
+  virtual bool splice_to(NetVConnection *target);
+
   virtual Action *send_OOB(Continuation *cont, char *buf, int len);
   virtual void cancel_OOB();
 
@@ -236,6 +239,16 @@ public:
   OOB_callback *oob_ptr;
   bool from_accept_thread;
 
+  // Splicing, see splice_to(): the connection read from points to the one
+  // written to, which owns the pipe and counts the bytes waiting in it.
+  UnixNetVConnection *splice_target;
+  UnixNetVConnection *splice_source;
+  int splice_pipe[2];
+  int64_t splice_pipe_bytes;
+
+  void clear_splice_target();
+  void clear_splice_source();
+
   int startEvent(int event, Event *e);
   int acceptEvent(int event, Event *e);
   int mainEvent(int event, Event *e);
@@ -235,11 +235,49 @@ initialize_thread_for_net(EThread *thread)
 
 // NetHandler method definitions
 
-NetHandler::NetHandler():Continuation(NULL), trigger_event(0)
+NetHandler::NetHandler():Continuation(NULL), trigger_event(0), n_splice_pipes(0)
 {
   SET_HANDLER((NetContHandler) & NetHandler::startNetEvent);
 }
 
+bool
+NetHandler::get_splice_pipe(int fds[2])
+{
+  if (n_splice_pipes > 0) {
+    n_splice_pipes--;
+    fds[0] = splice_pipes[n_splice_pipes][0];
+    fds[1] = splice_pipes[n_splice_pipes][1];
+    return true;
+  }
+#if HAVE_PIPE2
+  if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    return false;
+#else
+  if (pipe(fds) < 0)
+    return false;
+  for (int i = 0; i < 2; i++) {
+    safe_nonblocking(fds[i]);
+    fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+#endif
+  return true;
+}
+
+void
+NetHandler::put_splice_pipe(int fds[2], bool empty)
+{
+  if (empty && n_splice_pipes < NET_SPLICE_PIPE_POOL) {
+    splice_pipes[n_splice_pipes][0] = fds[0];
+    splice_pipes[n_splice_pipes][1] = fds[1];
+    n_splice_pipes++;
+  } else {
+    // data left in the pipe belongs to a connection which is gone
+    close(fds[0]);
+    close(fds[1]);
+  }
+  fds[0] = fds[1] = NO_FD;
+}
+
 //
 // Initialization here, in the thread in which we will be executing
 // from now on.
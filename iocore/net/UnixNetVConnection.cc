@@ -124,6 +124,8 @@ close_UnixNetVConnection(UnixNetVConnection *vc, EThread *t)
     nh->write_enable_list.remove(vc);
     vc->write.in_enabled_list = 0;
   }
+  vc->clear_splice_target();
+  vc->clear_splice_source();
   vc->free(t);
 }
 
@@ -198,6 +200,154 @@ write_signal_error(NetHandler *nh, UnixNetVConnection *vc, int lerrno)
   return write_signal_done(VC_EVENT_ERROR, nh, vc);
 }
 
+#if HAVE_SPLICE
+//
+// Splice the data read from a UnixNetVConnection into the pipe of its
+// splice_target, see UnixNetVConnection::splice_to().  Returns false if
+// the data has to go through the buffer instead.
+//
+static bool
+read_from_net_spliced(NetHandler *nh, UnixNetVConnection *vc, EThread *thread, int64_t ntodo, ProxyMutex *locked)
+{
+  NetState *s = &vc->read;
+  ProxyMutex *mutex = thread->mutex;
+  UnixNetVConnection *target = vc->splice_target;
+
+  if (target->closed || target->write.vio.op != VIO::WRITE) {
+    vc->clear_splice_target();
+    return false;
+  }
+  // wait for the target to write what was spliced so far
+  if (target->splice_pipe_bytes > 0) {
+    nh->read_ready_list.remove(vc);
+    return true;
+  }
+  // the data already in the buffer (e.g. the headers) is written first
+  int64_t towrite = target->write.vio.ntodo();
+  if (towrite <= 0 || target->write.vio.buffer.reader()->is_read_avail_more_than(0))
+    return false;
+  if (target->splice_pipe[0] == NO_FD && !nh->get_splice_pipe(target->splice_pipe)) {
+    vc->clear_splice_target();
+    return false;
+  }
+
+  int64_t toread = MIN(MIN(ntodo, towrite), NET_SPLICE_PIPE_BYTES);
+  int64_t r;
+  do {
+    r = splice(vc->con.fd, NULL, target->splice_pipe[1], NULL, toread, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    r = -errno;
+  NET_DEBUG_COUNT_DYN_STAT(net_calls_to_read_stat, 1);
+
+  if (r <= 0) {
+    if (r == -EAGAIN || r == -ENOTCONN) {
+      NET_DEBUG_COUNT_DYN_STAT(net_calls_to_read_nodata_stat, 1);
+      vc->read.triggered = 0;
+      nh->read_ready_list.remove(vc);
+      return true;
+    }
+    vc->read.triggered = 0;
+    if (!r || r == -ECONNRESET) {
+      nh->read_ready_list.remove(vc);
+      read_signal_done(VC_EVENT_EOS, nh, vc);
+      return true;
+    }
+    read_signal_error(nh, vc, (int)-r);
+    return true;
+  }
+  NET_SUM_DYN_STAT(net_read_bytes_stat, r);
+  NET_SUM_DYN_STAT(net_spliced_bytes_stat, r);
+
+  target->splice_pipe_bytes += r;
+  s->vio.ndone += r;
+  net_activity(vc, thread);
+  write_reschedule(nh, target);
+
+  if (s->vio.ntodo() <= 0) {
+    read_signal_done(VC_EVENT_READ_COMPLETE, nh, vc);
+    return true;
+  }
+  if (read_signal_and_update(VC_EVENT_READ_READY, vc) != EVENT_CONT)
+    return true;
+  // change of lock... don't look at shared variables!
+  if (locked != s->vio.mutex.m_ptr) {
+    read_reschedule(nh, vc);
+    return true;
+  }
+  if (s->vio.ntodo() <= 0 || !s->enabled) {
+    read_disable(nh, vc);
+    return true;
+  }
+  // rescheduled by write_to_net_spliced() once the pipe is empty
+  if (vc->splice_target && vc->splice_target->splice_pipe_bytes > 0)
+    nh->read_ready_list.remove(vc);
+  else
+    read_reschedule(nh, vc);
+  return true;
+}
+
+//
+// Write the data spliced into the pipe of a UnixNetVConnection.
+//
+static void
+write_to_net_spliced(NetHandler *nh, UnixNetVConnection *vc, EThread *thread, int64_t ntodo, ProxyMutex *locked)
+{
+  NetState *s = &vc->write;
+  ProxyMutex *mutex = thread->mutex;
+  int64_t towrite = MIN(ntodo, vc->splice_pipe_bytes);
+  int64_t r;
+
+  do {
+    r = splice(vc->splice_pipe[0], NULL, vc->con.fd, NULL, towrite, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    r = -errno;
+  NET_DEBUG_COUNT_DYN_STAT(net_calls_to_write_stat, 1);
+
+  if (r <= 0) {
+    if (r == -EAGAIN || r == -ENOTCONN) {
+      NET_DEBUG_COUNT_DYN_STAT(net_calls_to_write_nodata_stat, 1);
+      vc->write.triggered = 0;
+      write_reschedule(nh, vc);
+      return;
+    }
+    vc->write.triggered = 0;
+    if (!r || r == -ECONNRESET) {
+      write_signal_done(VC_EVENT_EOS, nh, vc);
+      return;
+    }
+    write_signal_error(nh, vc, (int)-r);
+    return;
+  }
+  NET_SUM_DYN_STAT(net_write_bytes_stat, r);
+
+  vc->splice_pipe_bytes -= r;
+  s->vio.ndone += r;
+  net_activity(vc, thread);
+  // the source waits for the pipe to be empty, see read_from_net_spliced()
+  if (!vc->splice_pipe_bytes && vc->splice_source)
+    read_reschedule(nh, vc->splice_source);
+
+  if (s->vio.ntodo() <= 0) {
+    write_signal_done(VC_EVENT_WRITE_COMPLETE, nh, vc);
+    return;
+  }
+  if (write_signal_and_update(VC_EVENT_WRITE_READY, vc) != EVENT_CONT)
+    return;
+  // change of lock... don't look at shared variables!
+  if (locked != s->vio.mutex.m_ptr) {
+    write_reschedule(nh, vc);
+    return;
+  }
+  if (!vc->splice_pipe_bytes) {
+    write_disable(nh, vc);
+    return;
+  }
+  write_reschedule(nh, vc);
+}
+#endif
+
 // Read the data for a UnixNetVConnection.
 // Rescheduling the UnixNetVConnection by moving the VC
 // onto or off of the ready_list.
@@ -230,6 +380,10 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     read_disable(nh, vc);
     return;
   }
+#if HAVE_SPLICE
+  if (vc->splice_target && read_from_net_spliced(nh, vc, thread, ntodo, lock.get_mutex()))
+    return;
+#endif
   int64_t toread = buf.writer()->write_avail();
   if (toread > ntodo)
     toread = ntodo;
@@ -407,6 +561,12 @@ write_to_net_io(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     write_disable(nh, vc);
     return;
   }
+#if HAVE_SPLICE
+  if (vc->splice_pipe_bytes > 0) {
+    write_to_net_spliced(nh, vc, thread, ntodo, lock.get_mutex());
+    return;
+  }
+#endif
 
   MIOBufferAccessor & buf = s->vio.buffer;
   ink_assert(buf.writer());
@@ -548,10 +708,68 @@ UnixNetVConnection::get_data(int id, void *data)
   }
 }
 
+bool
+UnixNetVConnection::splice_capable() const
+{
+#if HAVE_SPLICE
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool
+UnixNetVConnection::splice_to(NetVConnection *target)
+{
+  if (!splice_capable() || !target->splice_capable())
+    return false;
+  UnixNetVConnection *t = static_cast<UnixNetVConnection *>(target);
+
+  // the pipe is only touched by the NetHandler of both
+  if (t == this || closed || t->closed || t->thread != thread || t->nh != nh)
+    return false;
+  if (splice_target || t->splice_source)
+    return false;
+  if (read.vio.op != VIO::READ || t->write.vio.op != VIO::WRITE ||
+      !read.vio.buffer.writer() || !t->write.vio.buffer.reader() ||
+      t->write.vio.buffer.reader()->mbuf != read.vio.buffer.writer())
+    return false;
+
+  Debug("iocore_net", "splice %p (fd %d) to %p (fd %d)", this, con.fd, t, t->con.fd);
+  splice_target = t;
+  t->splice_source = this;
+  return true;
+}
+
+void
+UnixNetVConnection::clear_splice_target()
+{
+  if (splice_target) {
+    splice_target->splice_source = NULL;
+    splice_target = NULL;
+  }
+}
+
+// The data left in the pipe is written unless the write VIO is replaced
+// or the connection closed.
+void
+UnixNetVConnection::clear_splice_source()
+{
+  if (splice_source) {
+    splice_source->splice_target = NULL;
+    splice_source = NULL;
+  }
+  if (splice_pipe[0] != NO_FD) {
+    nh->put_splice_pipe(splice_pipe, splice_pipe_bytes == 0);
+    splice_pipe_bytes = 0;
+  }
+}
+
 VIO *
 UnixNetVConnection::do_io_read(Continuation *c, int64_t nbytes, MIOBuffer *buf)
 {
   ink_assert(!closed);
+  clear_splice_target();
   read.vio.op = VIO::READ;
   read.vio.mutex = c->mutex;
   read.vio._cont = c;
@@ -573,6 +791,7 @@ VIO *
 UnixNetVConnection::do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *reader, bool owner)
 {
   ink_assert(!closed);
+  clear_splice_source();
   write.vio.op = VIO::WRITE;
   write.vio.mutex = c->mutex;
   write.vio._cont = c;
@@ -812,8 +1031,9 @@ UnixNetVConnection::UnixNetVConnection()
 #endif
     active_timeout(NULL), nh(NULL),
     id(0), flags(0), recursion(0), submit_time(0), oob_ptr(0),
-    from_accept_thread(false)
+    from_accept_thread(false), splice_target(NULL), splice_source(NULL), splice_pipe_bytes(0)
 {
+  splice_pipe[0] = splice_pipe[1] = NO_FD;
   memset(&local_addr, 0, sizeof local_addr);
   memset(&server_addr, 0, sizeof server_addr);
   SET_HANDLER((NetVConnHandler) & UnixNetVConnection::startEvent);
@@ -1198,6 +1418,7 @@ UnixNetVConnection::free(EThread *t)
   write.triggered = 0;
   options.reset();
   closed = 0;
+  ink_assert(!splice_target && !splice_source && splice_pipe[0] == NO_FD);
   ink_assert(!read.ready_link.prev && !read.ready_link.next);
   ink_assert(!read.enable_link.next);
   ink_assert(!write.ready_link.prev && !write.ready_link.next);
@@ -33,6 +33,67 @@ https://github.com/floodyberry/siphash
     x3 ^= x0; \
     x2 = ROTL64(x2,32);
 
+// Absorb @a len bytes of @a data, whole blocks are compressed and any
+// remainder is kept in @a block_buffer for the next call.
+static inline void
+sip24_update(uint64_t & v0, uint64_t & v1, uint64_t & v2, uint64_t & v3, unsigned char *block_buffer,
+             uint8_t & block_buffer_len, const void *data, size_t len)
+{
+  size_t i, blocks;
+  unsigned char *m;
+  uint64_t mi;
+  uint8_t block_off = 0;
+
+  m = (unsigned char *) data;
+
+  if (len + block_buffer_len < SIP_BLOCK_SIZE) {
+    memcpy(block_buffer + block_buffer_len, m, len);
+    block_buffer_len += len;
+  } else {
+    if (block_buffer_len > 0) {
+      block_off = SIP_BLOCK_SIZE - block_buffer_len;
+      memcpy(block_buffer + block_buffer_len, m, block_off);
+
+      mi = U8TO64_LE(block_buffer);
+      v3 ^= mi;
+      SIPCOMPRESS(v0, v1, v2, v3);
+      SIPCOMPRESS(v0, v1, v2, v3);
+      v0 ^= mi;
+    }
+
+    for (i = block_off, blocks = ((len - block_off) & ~(SIP_BLOCK_SIZE - 1)); i < blocks; i += SIP_BLOCK_SIZE) {
+      mi = U8TO64_LE(m + i);
+      v3 ^= mi;
+      SIPCOMPRESS(v0, v1, v2, v3);
+      SIPCOMPRESS(v0, v1, v2, v3);
+      v0 ^= mi;
+    }
+
+    block_buffer_len = (len - block_off) & (SIP_BLOCK_SIZE - 1);
+    memcpy(block_buffer, m + block_off + blocks, block_buffer_len);
+  }
+}
+
+// Compress the final (padded) block.
+static inline void
+sip24_last_block(uint64_t & v0, uint64_t & v1, uint64_t & v2, uint64_t & v3, const unsigned char *block_buffer,
+                 uint8_t block_buffer_len, size_t total_len)
+{
+  uint64_t last7;
+  int i;
+
+  last7 = (uint64_t) (total_len & 0xff) << 56;
+
+  for (i = block_buffer_len - 1; i >= 0; i--) {
+    last7 |= (uint64_t) block_buffer[i] << (i * 8);
+  }
+
+  v3 ^= last7;
+  SIPCOMPRESS(v0, v1, v2, v3);
+  SIPCOMPRESS(v0, v1, v2, v3);
+  v0 ^= last7;
+}
+
 ATSHash64Sip24::ATSHash64Sip24(void)
 {
   k0 = 0;
@@ -57,61 +118,17 @@ ATSHash64Sip24::ATSHash64Sip24(uint64_t key0, uint64_t key1)
 void
 ATSHash64Sip24::update(const void *data, size_t len)
 {
-  size_t i, blocks;
-  unsigned char *m;
-  uint64_t mi;
-  uint8_t block_off = 0;
-
   if (!finalized) {
-    m = (unsigned char *) data;
     total_len += len;
-
-    if (len + block_buffer_len < SIP_BLOCK_SIZE) {
-      memcpy(block_buffer + block_buffer_len, m, len);
-      block_buffer_len += len;
-    } else {
-      if (block_buffer_len > 0) {
-        block_off = SIP_BLOCK_SIZE - block_buffer_len;
-        memcpy(block_buffer + block_buffer_len, m, block_off);
-
-        mi = U8TO64_LE(block_buffer);
-        v3 ^= mi;
-        SIPCOMPRESS(v0, v1, v2, v3);
-        SIPCOMPRESS(v0, v1, v2, v3);
-        v0 ^= mi;
-      }
-
-      for (i = block_off, blocks = ((len - block_off) & ~(SIP_BLOCK_SIZE - 1)); i < blocks; i += SIP_BLOCK_SIZE) {
-        mi = U8TO64_LE(m + i);
-        v3 ^= mi;
-        SIPCOMPRESS(v0, v1, v2, v3);
-        SIPCOMPRESS(v0, v1, v2, v3);
-        v0 ^= mi;
-      }
-
-      block_buffer_len = (len - block_off) & (SIP_BLOCK_SIZE - 1);
-      memcpy(block_buffer, m + block_off + blocks, block_buffer_len);
-    }
+    sip24_update(v0, v1, v2, v3, block_buffer, block_buffer_len, data, len);
   }
 }
 
 void
 ATSHash64Sip24::final(void)
 {
-  uint64_t last7;
-  int i;
-
   if (!finalized) {
-    last7 = (uint64_t) (total_len & 0xff) << 56;
-
-    for (i = block_buffer_len - 1; i >= 0; i--) {
-      last7 |= (uint64_t) block_buffer[i] << (i * 8);
-    }
-
-    v3 ^= last7;
-    SIPCOMPRESS(v0, v1, v2, v3);
-    SIPCOMPRESS(v0, v1, v2, v3);
-    v0 ^= last7;
+    sip24_last_block(v0, v1, v2, v3, block_buffer, block_buffer_len, total_len);
     v2 ^= 0xff;
     SIPCOMPRESS(v0, v1, v2, v3);
     SIPCOMPRESS(v0, v1, v2, v3);
@@ -143,3 +160,97 @@ ATSHash64Sip24::clear(void)
   total_len = 0;
   block_buffer_len = 0;
 }
+
+ATSHash128Sip24::ATSHash128Sip24(void)
+{
+  k0 = 0;
+  k1 = 0;
+  this->clear();
+}
+
+ATSHash128Sip24::ATSHash128Sip24(const unsigned char key[16])
+{
+  k0 = U8TO64_LE(key);
+  k1 = U8TO64_LE(key + sizeof(k0));
+  this->clear();
+}
+
+ATSHash128Sip24::ATSHash128Sip24(uint64_t key0, uint64_t key1)
+{
+  k0 = key0;
+  k1 = key1;
+  this->clear();
+}
+
+void
+ATSHash128Sip24::update(const void *data, size_t len)
+{
+  if (!finalized) {
+    total_len += len;
+    sip24_update(v0, v1, v2, v3, block_buffer, block_buffer_len, data, len);
+  }
+}
+
+void
+ATSHash128Sip24::final(void)
+{
+  if (!finalized) {
+    sip24_last_block(v0, v1, v2, v3, block_buffer, block_buffer_len, total_len);
+    v2 ^= 0xee;
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    hfinal[0] = v0 ^ v1 ^ v2 ^ v3;
+    v1 ^= 0xdd;
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    SIPCOMPRESS(v0, v1, v2, v3);
+    hfinal[1] = v0 ^ v1 ^ v2 ^ v3;
+    finalized = true;
+  }
+}
+
+const void *
+ATSHash128Sip24::get(void) const
+{
+  if (finalized) {
+    return hfinal;
+  } else {
+    return NULL;
+  }
+}
+
+size_t
+ATSHash128Sip24::size(void) const
+{
+  return sizeof(hfinal);
+}
+
+void
+ATSHash128Sip24::clear(void)
+{
+  v0 = k0 ^ 0x736f6d6570736575ull;
+  v1 = k1 ^ 0x646f72616e646f6dull ^ 0xee;
+  v2 = k0 ^ 0x6c7967656e657261ull;
+  v3 = k1 ^ 0x7465646279746573ull;
+  finalized = false;
+  total_len = 0;
+  block_buffer_len = 0;
+}
+
+bool
+SipContext::update(void const* data, int length)
+{
+  _hash.update(data, length);
+  return true;
+}
+
+bool
+SipContext::finalize(CryptoHash& hash)
+{
+  _hash.final();
+  memcpy(hash.u8, _hash.get(), sizeof(hash.u8));
+  return true;
+}
@@ -23,6 +23,8 @@
 #define __HASH_SIP_H__
 
 #include "Hash.h"
+#include "ink_code.h"
+#include "CryptoHash.h"
 #include <stdint.h>
 
 /*
@@ -50,4 +52,44 @@ private:
   bool finalized;
 };
 
+/*
+  The 128 bit output variant of SipHash-2-4.
+ */
+
+struct ATSHash128Sip24:ATSHash
+{
+  ATSHash128Sip24(void);
+  ATSHash128Sip24(const unsigned char key[16]);
+  ATSHash128Sip24(uint64_t key0, uint64_t key1);
+  void update(const void *data, size_t len);
+  void final(void);
+  const void *get(void) const;
+  size_t size(void) const;
+  void clear(void);
+
+private:
+  unsigned char block_buffer[8];
+  uint8_t block_buffer_len;
+  uint64_t k0, k1, v0, v1, v2, v3, hfinal[2];
+  size_t total_len;
+  bool finalized;
+};
+
+/*
+  Crypto hash context for SipHash-2-4-128, the same shape as MD5Context
+  and MMHContext so it can be used for cache keys.
+ */
+
+class SipContext : public CryptoContext
+{
+protected:
+  ATSHash128Sip24 _hash;
+public:
+  SipContext(uint64_t key0 = 0, uint64_t key1 = 0) : _hash(key0, key1) { }
+  /// Update the hash with @a data of @a length bytes.
+  virtual bool update(void const* data, int length);
+  /// Finalize and extract the @a hash.
+  virtual bool finalize(CryptoHash& hash);
+};
+
 #endif
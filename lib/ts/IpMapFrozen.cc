@@ -0,0 +1,199 @@
+# include "IpMapFrozen.h"
+# include "ink_memory.h"
+
+/** @file
+
+    Read only, lookup optimized snapshot of an @c IpMap.
+
+    @section license License
+
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+ */
+
+namespace {
+  /// Number of elements in the IPv4 direct index.
+  size_t const IP4_INDEX_SIZE = (1 << 16) + 1;
+
+  inline uint64_t
+  load_be64(uint8_t const* p) {
+    uint64_t zret = 0;
+    for ( int i = 0 ; i < 8 ; ++i ) zret = (zret << 8) | p[i];
+    return zret;
+  }
+}
+
+IpMapFrozen::IpMapFrozen()
+  : _n4(0), _min4(0), _max4(0), _data4(0), _index4(0)
+  , _n6(0), _min6(0), _max6(0), _data6(0)
+{
+}
+
+IpMapFrozen::~IpMapFrozen() {
+  this->clear();
+}
+
+IpMapFrozen&
+IpMapFrozen::clear() {
+  ats_free(_min4);
+  ats_free(_max4);
+  ats_free(_data4);
+  ats_free(_index4);
+  ats_free(_min6);
+  ats_free(_max6);
+  ats_free(_data6);
+  _min4 = _max4 = 0;
+  _data4 = _data6 = 0;
+  _index4 = 0;
+  _min6 = _max6 = 0;
+  _n4 = _n6 = 0;
+  return *this;
+}
+
+IpMapFrozen::Ip6Key
+IpMapFrozen::key6(in6_addr const& addr) {
+  Ip6Key zret;
+  zret._hi = load_be64(addr.s6_addr);
+  zret._lo = load_be64(addr.s6_addr + 8);
+  return zret;
+}
+
+IpMapFrozen&
+IpMapFrozen::freeze(IpMap const& map) {
+  size_t n4 = 0, n6 = 0;
+
+  this->clear();
+
+  for ( IpMap::iterator spot(map.begin()), limit(map.end()) ; spot != limit ; ++spot ) {
+    if (ats_is_ip4(spot->min())) ++n4;
+    else ++n6;
+  }
+
+  if (n4) {
+    _min4 = static_cast<uint32_t*>(ats_malloc(n4 * sizeof(*_min4)));
+    _max4 = static_cast<uint32_t*>(ats_malloc(n4 * sizeof(*_max4)));
+    _data4 = static_cast<void**>(ats_malloc(n4 * sizeof(*_data4)));
+  }
+  if (n6) {
+    _min6 = static_cast<Ip6Key*>(ats_malloc(n6 * sizeof(*_min6)));
+    _max6 = static_cast<Ip6Key*>(ats_malloc(n6 * sizeof(*_max6)));
+    _data6 = static_cast<void**>(ats_malloc(n6 * sizeof(*_data6)));
+  }
+
+  // The map keeps its ranges disjoint and in ascending order, so they
+  // can be copied directly.
+  for ( IpMap::iterator spot(map.begin()), limit(map.end()) ; spot != limit ; ++spot ) {
+    if (ats_is_ip4(spot->min())) {
+      _min4[_n4] = ntohl(ats_ip4_addr_cast(spot->min()));
+      _max4[_n4] = ntohl(ats_ip4_addr_cast(spot->max()));
+      _data4[_n4] = spot->data();
+      ink_assert(_n4 == 0 || _max4[_n4-1] < _min4[_n4]);
+      ++_n4;
+    } else {
+      _min6[_n6] = key6(ats_ip6_addr_cast(spot->min()));
+      _max6[_n6] = key6(ats_ip6_addr_cast(spot->max()));
+      _data6[_n6] = spot->data();
+      ++_n6;
+    }
+  }
+
+  if (_n4 >= IP4_INDEX_THRESHOLD) {
+    size_t idx = 0;
+    _index4 = static_cast<uint32_t*>(ats_malloc(IP4_INDEX_SIZE * sizeof(*_index4)));
+    for ( size_t prefix = 0 ; prefix < IP4_INDEX_SIZE ; ++prefix ) {
+      uint64_t base = static_cast<uint64_t>(prefix) << 16;
+      while (idx < _n4 && _max4[idx] < base) ++idx;
+      _index4[prefix] = static_cast<uint32_t>(idx < _n4 ? idx : _n4 - 1);
+    }
+  }
+
+  return *this;
+}
+
+bool
+IpMapFrozen::find4(uint32_t addr, void** ptr) const {
+  uint32_t const* base;
+  size_t n;
+
+  if (0 == _n4) return false;
+
+  if (_index4) {
+    // Any range containing @a addr lies between the first range that
+    // reaches this /16 and the first range that reaches the next one.
+    uint32_t const* idx = _index4 + (addr >> 16);
+    base = _min4 + idx[0];
+    n = idx[1] - idx[0] + 1;
+  } else {
+    base = _min4;
+    n = _n4;
+  }
+
+  // Branchless search for the last range with a minimum <= @a addr.
+  while (n > 1) {
+    size_t half = n / 2;
+    base = (base[half] <= addr) ? base + half : base;
+    n -= half;
+  }
+
+  size_t i = base - _min4;
+  if (*base <= addr && addr <= _max4[i]) {
+    if (ptr) *ptr = _data4[i];
+    return true;
+  }
+  return false;
+}
+
+bool
+IpMapFrozen::find6(in6_addr const& addr, void** ptr) const {
+  if (0 == _n6) return false;
+
+  Ip6Key key = key6(addr);
+  Ip6Key const* base = _min6;
+  size_t n = _n6;
+
+  while (n > 1) {
+    size_t half = n / 2;
+    Ip6Key const& m = base[half];
+    bool le = (m._hi < key._hi) | ((m._hi == key._hi) & (m._lo <= key._lo));
+    base = le ? base + half : base;
+    n -= half;
+  }
+
+  size_t i = base - _min6;
+  Ip6Key const& min = *base;
+  Ip6Key const& max = _max6[i];
+  if (((min._hi < key._hi) || (min._hi == key._hi && min._lo <= key._lo)) &&
+      ((key._hi < max._hi) || (key._hi == max._hi && key._lo <= max._lo))) {
+    if (ptr) *ptr = _data6[i];
+    return true;
+  }
+  return false;
+}
+
+bool
+IpMapFrozen::contains(sockaddr const* target, void** ptr) const {
+  if (ats_is_ip4(target)) return this->find4(ntohl(ats_ip4_addr_cast(target)), ptr);
+  else if (ats_is_ip6(target)) return this->find6(ats_ip6_addr_cast(target), ptr);
+  return false;
+}
+
+size_t
+IpMapFrozen::getMemorySize() const {
+  return _n4 * (sizeof(*_min4) + sizeof(*_max4) + sizeof(*_data4))
+    + (_index4 ? IP4_INDEX_SIZE * sizeof(*_index4) : 0)
+    + _n6 * (sizeof(*_min6) + sizeof(*_max6) + sizeof(*_data6))
+    ;
+}
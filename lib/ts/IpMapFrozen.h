@@ -0,0 +1,168 @@
+# if ! defined(TS_IP_MAP_FROZEN_HEADER)
+# define TS_IP_MAP_FROZEN_HEADER
+
+# include "ink_platform.h"
+# include "ink_defs.h"
+# include <ts/ink_inet.h>
+# include <ts/IpMap.h>
+
+/** @file
+
+    Read only, lookup optimized snapshot of an @c IpMap.
+
+    @section license License
+
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/** Frozen (immutable) copy of an @c IpMap.
+
+    An @c IpMap is optimized for arbitrary marking and unmarking which
+    requires a tree of individually allocated nodes. Most clients build
+    the map once when configuration is loaded and then only search it.
+    This class is constructed from a finished @c IpMap and stores the
+    ranges in flat, sorted arrays (structure of arrays) which are much
+    smaller and much friendlier to the cache.
+
+    IPv4 ranges cost 16 bytes each, IPv6 ranges 40 bytes. Lookup is a
+    branchless binary search. For large IPv4 tables a direct index on
+    the top 16 bits of the address is added which reduces the search
+    to the (typically tiny) set of ranges that overlap the /16 of the
+    target.
+
+    The client data is copied from the source map so the frozen map is
+    valid only as long as that data is. The source map can be modified
+    or destroyed after @c freeze without affecting this object.
+*/
+class IpMapFrozen {
+public:
+  typedef IpMapFrozen self; ///< Self reference type.
+
+  /// Number of IPv4 ranges at which the /16 direct index is built.
+  static size_t const IP4_INDEX_THRESHOLD = 1024;
+
+  IpMapFrozen(); ///< Default constructor.
+  ~IpMapFrozen(); ///< Destructor.
+
+  /** Load the contents of @a map.
+      Any previous contents are discarded.
+      @return This object.
+  */
+  self& freeze(
+    IpMap const& map ///< Source map.
+  );
+
+  /// Remove all ranges.
+  /// @return This object.
+  self& clear();
+
+  /** Test for membership.
+
+      @return @c true if the address is in the map, @c false if not.
+      If the address is in the map and @a ptr is not @c NULL, @c *ptr
+      is set to the client data for the address.
+  */
+  bool contains(
+    sockaddr const* target, ///< Search target (network order).
+    void **ptr = 0 ///< Client data return.
+  ) const;
+
+  /** Test for membership.
+      @note Convenience overload for IPv4.
+  */
+  bool contains(
+    in_addr_t target, ///< Search target (network order).
+    void **ptr = 0 ///< Client data return.
+  ) const;
+
+  /** Test for membership.
+      @note Convenience overload for @c IpEndpoint.
+  */
+  bool contains(
+    IpEndpoint const* target, ///< Search target (network order).
+    void **ptr = 0 ///< Client data return.
+  ) const;
+
+  /** Test for membership.
+      @note Convenience overload for @c IpAddr.
+  */
+  bool contains(
+    IpAddr const& target, ///< Search target (network order).
+    void **ptr = 0 ///< Client data return.
+  ) const;
+
+  /// @return Number of distinct ranges in the map.
+  size_t getCount() const;
+
+  /// @return Number of bytes of memory used by the range tables.
+  size_t getMemorySize() const;
+
+protected:
+  /// IPv6 address as a pair of host order integers for fast comparison.
+  struct Ip6Key {
+    uint64_t _hi; ///< Most significant 64 bits.
+    uint64_t _lo; ///< Least significant 64 bits.
+  };
+
+  /// Search the IPv4 table for @a addr (host order).
+  bool find4(uint32_t addr, void** ptr) const;
+  /// Search the IPv6 table for @a addr (network order).
+  bool find6(in6_addr const& addr, void** ptr) const;
+
+  /// Convert a network order IPv6 address to a key.
+  static Ip6Key key6(in6_addr const& addr);
+
+  size_t _n4; ///< Number of IPv4 ranges.
+  uint32_t* _min4; ///< Range minimums (host order).
+  uint32_t* _max4; ///< Range maximums (host order).
+  void** _data4; ///< Client data.
+  /** Direct index on the top 16 bits of an IPv4 address.
+      Element @a i is the index of the first range that ends at or
+      after the address <tt>i << 16</tt>. The table has 65537
+      elements so that element @a i + 1 is always valid.
+  */
+  uint32_t* _index4;
+
+  size_t _n6; ///< Number of IPv6 ranges.
+  Ip6Key* _min6; ///< Range minimums.
+  Ip6Key* _max6; ///< Range maximums.
+  void** _data6; ///< Client data.
+};
+
+inline bool
+IpMapFrozen::contains(in_addr_t target, void** ptr) const {
+  return this->find4(ntohl(target), ptr);
+}
+
+inline bool
+IpMapFrozen::contains(IpEndpoint const* target, void** ptr) const {
+  return this->contains(&target->sa, ptr);
+}
+
+inline bool
+IpMapFrozen::contains(IpAddr const& addr, void** ptr) const {
+  if (addr.isIp4()) return this->find4(ntohl(addr._addr._ip4), ptr);
+  else if (addr.isIp6()) return this->find6(addr._addr._ip6, ptr);
+  return false;
+}
+
+inline size_t
+IpMapFrozen::getCount() const {
+  return _n4 + _n6;
+}
+
+# endif // TS_IP_MAP_FROZEN_HEADER
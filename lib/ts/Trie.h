@@ -27,8 +27,22 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "List.h"
 
+/*
+  The trie is path compressed (a radix tree): each node carries the
+  run of key bytes that leads to it from its parent, so chains of
+  single child nodes are collapsed into one node. Children are kept in
+  an adaptive structure. Up to @c N_SMALL_CHILDREN children are stored
+  as a short array of key bytes searched with a single SIMD compare,
+  larger fan out switches to a direct 256 entry index. A node costs
+  roughly 64 bytes plus its label instead of a full 2KB child table.
+*/
+
 // Note that you should provide the class to use here, but we'll store
 // pointers to such objects internally.
 template<typename T>
@@ -51,9 +65,13 @@ public:
 
   bool Empty() const { return m_value_list.empty(); }
 
+  // Number of bytes allocated for nodes, child tables and labels.
+  size_t MemoryUsage() const { return sizeof(*this) + _MemoryUsage(&m_root); }
+
   virtual ~Trie() { Clear(); }
 
 private:
+  static const int N_SMALL_CHILDREN = 16;
   static const int N_NODE_CHILDREN = 256;
 
   class Node
@@ -67,21 +85,36 @@ private:
       value = NULL;
       occupied = false;
       rank = 0;
-      ink_zero(children);
+      label = NULL;
+      label_len = 0;
+      n_children = 0;
+      capacity = 0;
+      children = NULL;
+      ink_zero(keys);
     }
 
     void Print(const char *debug_tag) const;
-    inline Node* GetChild(char index) const { return children[static_cast<unsigned char>(index)]; }
-    inline Node* AllocateChild(char index) {
-      Node * &child = children[static_cast<unsigned char>(index)];
-      ink_assert(child == NULL);
-      child = static_cast<Node*>(ats_malloc(sizeof(Node)));
-      child->Clear();
-      return child;
-    }
+    inline Node* GetChild(char index) const;
+    inline void SetChild(char index, Node *child);
+    inline Node* AllocateChild(const char *key, int key_len);
+    inline int NumChildren() const { return n_children; }
+    inline Node* ChildAt(int idx) const;
+    // Split this node's label at @a offset, returns the new parent.
+    Node* Split(int offset);
+    void Free();
+
+    char *label;    // Key bytes on the edge from the parent to this node.
+    int label_len;
 
   private:
-    Node *children[N_NODE_CHILDREN];
+    void _AddChild(unsigned char index, Node *child);
+
+    // Number of children; the child table is the direct index when
+    // this is larger than N_SMALL_CHILDREN.
+    int n_children;
+    int capacity;
+    Node **children;
+    unsigned char keys[N_SMALL_CHILDREN];
   };
 
   Node m_root;
@@ -89,6 +122,7 @@ private:
 
   void _CheckArgs(const char *key, int &key_len) const;
   void _Clear(Node *node);
+  size_t _MemoryUsage(const Node *node) const;
 
   // make copy-constructor and assignment operator private
   // till we properly implement them
@@ -96,6 +130,134 @@ private:
   Trie &operator =(const Trie<T> &rhs) { return *this; }
 };
 
+template<typename T>
+inline typename Trie<T>::Node*
+Trie<T>::Node::GetChild(char index) const
+{
+  unsigned char c = static_cast<unsigned char>(index);
+
+  if (n_children > N_SMALL_CHILDREN) {
+    return children[c];
+  }
+#if defined(__SSE2__)
+  __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(index), _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys)));
+  int mask = _mm_movemask_epi8(cmp) & ((1 << n_children) - 1);
+  return mask ? children[__builtin_ctz(mask)] : NULL;
+#else
+  for (int i = 0; i < n_children; ++i) {
+    if (keys[i] == c) {
+      return children[i];
+    }
+  }
+  return NULL;
+#endif
+}
+
+template<typename T>
+inline typename Trie<T>::Node*
+Trie<T>::Node::ChildAt(int idx) const
+{
+  if (n_children > N_SMALL_CHILDREN) {
+    // Direct index, skip the empty slots.
+    for (int i = 0; i < N_NODE_CHILDREN; ++i) {
+      if (children[i] && idx-- == 0) {
+        return children[i];
+      }
+    }
+    return NULL;
+  }
+  return children[idx];
+}
+
+template<typename T>
+inline void
+Trie<T>::Node::SetChild(char index, Node *child)
+{
+  unsigned char c = static_cast<unsigned char>(index);
+
+  if (n_children > N_SMALL_CHILDREN) {
+    ink_assert(children[c] != NULL);
+    children[c] = child;
+    return;
+  }
+  for (int i = 0; i < n_children; ++i) {
+    if (keys[i] == c) {
+      children[i] = child;
+      return;
+    }
+  }
+  ink_assert(!"Trie::Node::SetChild on missing child");
+}
+
+template<typename T>
+void
+Trie<T>::Node::_AddChild(unsigned char index, Node *child)
+{
+  if (n_children < N_SMALL_CHILDREN) {
+    if (n_children == capacity) {
+      capacity = capacity ? capacity * 2 : 2;
+      children = static_cast<Node**>(ats_realloc(children, capacity * sizeof(Node*)));
+    }
+    keys[n_children] = index;
+    children[n_children] = child;
+  } else {
+    if (n_children == N_SMALL_CHILDREN) {
+      // Grow into the direct index.
+      Node **index_table = static_cast<Node**>(ats_malloc(N_NODE_CHILDREN * sizeof(Node*)));
+      memset(index_table, 0, N_NODE_CHILDREN * sizeof(Node*));
+      for (int i = 0; i < n_children; ++i) {
+        index_table[keys[i]] = children[i];
+      }
+      ats_free(children);
+      children = index_table;
+      capacity = N_NODE_CHILDREN;
+    }
+    ink_assert(children[index] == NULL);
+    children[index] = child;
+  }
+  ++n_children;
+}
+
+template<typename T>
+inline typename Trie<T>::Node*
+Trie<T>::Node::AllocateChild(const char *key, int key_len)
+{
+  ink_assert(key_len > 0 && GetChild(key[0]) == NULL);
+  Node *child = static_cast<Node*>(ats_malloc(sizeof(Node)));
+  child->Clear();
+  child->label = static_cast<char*>(ats_malloc(key_len));
+  memcpy(child->label, key, key_len);
+  child->label_len = key_len;
+  _AddChild(static_cast<unsigned char>(key[0]), child);
+  return child;
+}
+
+template<typename T>
+typename Trie<T>::Node*
+Trie<T>::Node::Split(int offset)
+{
+  ink_assert(offset > 0 && offset < label_len);
+  Node *parent = static_cast<Node*>(ats_malloc(sizeof(Node)));
+  char *tail = static_cast<char*>(ats_malloc(label_len - offset));
+
+  parent->Clear();
+  parent->label = label;
+  parent->label_len = offset;
+  memcpy(tail, label + offset, label_len - offset);
+  label = tail;
+  label_len -= offset;
+  parent->_AddChild(static_cast<unsigned char>(label[0]), this);
+  return parent;
+}
+
+template<typename T>
+void
+Trie<T>::Node::Free()
+{
+  ats_free(label);
+  ats_free(children);
+}
+
 template<typename T>
 void
 Trie<T>::_CheckArgs(const char *key, int &key_len) const
@@ -130,15 +292,24 @@ Trie<T>::Insert(const char *key, T* value, int rank, int key_len /* = -1 */)
 
     next_node = curr_node->GetChild(key[i]);
     if (!next_node) {
-      while (i < key_len) {
-        Debug("Trie::Insert", "Creating child node for char %c (%d)", key[i], key[i]);
-        curr_node = curr_node->AllocateChild(key[i]);
-        ++i;
-      }
+      Debug("Trie::Insert", "Creating child node for \"%.*s\"", key_len - i, key + i);
+      curr_node = curr_node->AllocateChild(key + i, key_len - i);
       break;
     }
+
+    // Match as much of the edge label as possible.
+    int n = 1;
+    while (n < next_node->label_len && i + n < key_len && next_node->label[n] == key[i + n]) {
+      ++n;
+    }
+    if (n < next_node->label_len) {
+      Debug("Trie::Insert", "Splitting node \"%.*s\" at %d", next_node->label_len, next_node->label, n);
+      Node *split_node = next_node->Split(n);
+      curr_node->SetChild(key[i], split_node);
+      next_node = split_node;
+    }
     curr_node = next_node;
-    ++i;
+    i += n;
   }
 
   if (curr_node->occupied) {
@@ -178,7 +349,14 @@ Trie<T>::Search(const char *key, int key_len /* = -1 */) const
       break;
     }
     curr_node = curr_node->GetChild(key[i]);
-    ++i;
+    if (curr_node) {
+      // The first label byte matched the child selection, check the rest.
+      int len = curr_node->label_len;
+      if (i + len > key_len || memcmp(curr_node->label + 1, key + i + 1, len - 1) != 0) {
+        break;
+      }
+      i += len;
+    }
   }
 
   if (found_node) {
@@ -196,13 +374,36 @@ Trie<T>::_Clear(Node *node)
 {
   Node *child;
 
-  for (int i = 0; i < N_NODE_CHILDREN; ++i) {
-    child = node->GetChild(i);
-    if (child) {
-      _Clear(child);
-      ats_free(child);
+  for (int i = 0, n = node->NumChildren(); i < n; ++i) {
+    child = node->ChildAt(i);
+    _Clear(child);
+    child->Free();
+    ats_free(child);
+  }
+}
+
+template<typename T>
+size_t
+Trie<T>::_MemoryUsage(const Node *node) const
+{
+  size_t zret = 0;
+  int n = node->NumChildren();
+
+  if (n > N_SMALL_CHILDREN) {
+    zret += N_NODE_CHILDREN * sizeof(Node*);
+  } else if (n > 0) {
+    // Small child tables grow by doubling.
+    int capacity = 2;
+    while (capacity < n) {
+      capacity *= 2;
     }
+    zret += capacity * sizeof(Node*);
   }
+  for (int i = 0; i < n; ++i) {
+    const Node *child = node->ChildAt(i);
+    zret += sizeof(Node) + child->label_len + _MemoryUsage(child);
+  }
+  return zret;
 }
 
 template<typename T>
@@ -214,6 +415,7 @@ Trie<T>::Clear()
     delete iter;
 
   _Clear(&m_root);
+  m_root.Free();
   m_root.Clear();
 }
 
@@ -236,10 +438,9 @@ Trie<T>::Node::Print(const char *debug_tag) const
     Debug(debug_tag, "Node is not occupied");
   }
 
-  for (int i = 0; i < N_NODE_CHILDREN; ++i) {
-    if (GetChild(i)) {
-      Debug(debug_tag, "Node has child for char %c", static_cast<char>(i));
-    }
+  for (int i = 0; i < n_children; ++i) {
+    const Node *child = ChildAt(i);
+    Debug(debug_tag, "Node has child for \"%.*s\"", child->label_len, child->label);
   }
 }
 
@@ -0,0 +1,151 @@
+/** @file
+
+  Consistency test and benchmark for IpMapFrozen.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "IpMap.h"
+#include "IpMapFrozen.h"
+#include "ink_rand.h"
+#include "ink_hrtime.h"
+
+static int const N_RANGES = 200000;
+static int const N_LOOKUPS = 2000000;
+
+static void
+random_ip6(InkRand& rng, IpEndpoint& ip)
+{
+  uint64_t hi = rng.random(), lo = rng.random();
+  ats_ip6_set(&ip, in6addr_any);
+  // Keep the ranges clustered in a /32 so lookups actually hit.
+  hi = (hi & 0xFFFFFFFFULL) | 0x20010db800000000ULL;
+  for (int i = 0; i < 8; ++i) {
+    ip.sin6.sin6_addr.s6_addr[i] = (hi >> (56 - 8 * i)) & 0xFF;
+    ip.sin6.sin6_addr.s6_addr[8 + i] = (lo >> (56 - 8 * i)) & 0xFF;
+  }
+}
+
+static void
+check_consistency(IpMap& map, IpMapFrozen& frozen, InkRand& rng)
+{
+  for (int i = 0; i < N_LOOKUPS / 10; ++i) {
+    in_addr_t a = htonl(static_cast<uint32_t>(rng.random()));
+    void *m1 = 0, *m2 = 0;
+    bool r1 = map.contains(a, &m1);
+    bool r2 = frozen.contains(a, &m2);
+    ink_release_assert(r1 == r2 && m1 == m2);
+
+    IpEndpoint ip6;
+    random_ip6(rng, ip6);
+    m1 = m2 = 0;
+    r1 = map.contains(&ip6, &m1);
+    r2 = frozen.contains(&ip6, &m2);
+    ink_release_assert(r1 == r2 && m1 == m2);
+  }
+
+  // Check the edges of every IPv4 range.
+  for (IpMap::iterator spot(map.begin()), limit(map.end()); spot != limit; ++spot) {
+    void *m = 0;
+    if (!ats_is_ip4(spot->min()))
+      continue;
+    uint32_t min = ntohl(ats_ip4_addr_cast(spot->min()));
+    uint32_t max = ntohl(ats_ip4_addr_cast(spot->max()));
+    ink_release_assert(frozen.contains(htonl(min), &m) && m == spot->data());
+    ink_release_assert(frozen.contains(htonl(max), &m) && m == spot->data());
+    if (min > 0)
+      ink_release_assert(map.contains(htonl(min - 1)) == frozen.contains(htonl(min - 1)));
+    if (max < 0xFFFFFFFF)
+      ink_release_assert(map.contains(htonl(max + 1)) == frozen.contains(htonl(max + 1)));
+  }
+}
+
+static void
+bench(IpMap& map, IpMapFrozen& frozen, in_addr_t *targets)
+{
+  int hits = 0;
+  ink_hrtime start, t_map, t_frozen;
+
+  start = ink_get_hrtime_internal();
+  for (int i = 0; i < N_LOOKUPS; ++i)
+    hits += map.contains(targets[i]);
+  t_map = ink_get_hrtime_internal() - start;
+
+  start = ink_get_hrtime_internal();
+  for (int i = 0; i < N_LOOKUPS; ++i)
+    hits -= frozen.contains(targets[i]);
+  t_frozen = ink_get_hrtime_internal() - start;
+
+  ink_release_assert(hits == 0);
+  printf("  IpMap       : %7.1f ns/lookup\n", static_cast<double>(t_map) / N_LOOKUPS);
+  printf("  IpMapFrozen : %7.1f ns/lookup\n", static_cast<double>(t_frozen) / N_LOOKUPS);
+}
+
+int
+main(int /* argc ATS_UNUSED */, char * /* argv ATS_UNUSED */ [])
+{
+  InkRand rng(0x1A2B3C4D);
+  IpMap map;
+  IpMapFrozen frozen;
+  in_addr_t *targets = static_cast<in_addr_t*>(ats_malloc(N_LOOKUPS * sizeof(in_addr_t)));
+
+  // Small table (no direct index) first, then the large one.
+  for (int pass = 0; pass < 2; ++pass) {
+    int n = pass ? N_RANGES : static_cast<int>(IpMapFrozen::IP4_INDEX_THRESHOLD / 2);
+
+    // Build the map in ascending address order, the way a sorted block
+    // list is loaded. Range widths and gaps are random.
+    map.clear();
+    uint32_t step = 0xFFFFFFFFU / n;
+    for (int i = 0; i < n; ++i) {
+      uint32_t min = i * step + static_cast<uint32_t>(rng.random() % (step / 2));
+      uint32_t max = min + static_cast<uint32_t>(rng.random() % (step / 2));
+      map.mark(htonl(min), htonl(max), reinterpret_cast<void*>(static_cast<intptr_t>(1 + (i % 7))));
+    }
+    IpEndpoint min6, max6;
+    random_ip6(rng, min6);
+    memset(min6.sin6.sin6_addr.s6_addr + 4, 0, 12);
+    for (int i = 0; i < n; ++i) {
+      // Every other /64 in the prefix, each a single range.
+      uint32_t net = htonl(2 * i);
+      memcpy(min6.sin6.sin6_addr.s6_addr + 4, &net, sizeof(net));
+      max6 = min6;
+      memset(max6.sin6.sin6_addr.s6_addr + 8, 0xFF, 8);
+      map.mark(&min6, &max6, reinterpret_cast<void*>(static_cast<intptr_t>(1 + (i % 5))));
+    }
+
+    frozen.freeze(map);
+    ink_release_assert(frozen.getCount() == map.getCount());
+    check_consistency(map, frozen, rng);
+
+    for (int i = 0; i < N_LOOKUPS; ++i)
+      targets[i] = htonl(static_cast<uint32_t>(rng.random()));
+
+    printf("%d ranges, %zu bytes frozen (%.1f bytes/range)\n", static_cast<int>(map.getCount()), frozen.getMemorySize(),
+           static_cast<double>(frozen.getMemorySize()) / frozen.getCount());
+    bench(map, frozen, targets);
+  }
+
+  ats_free(targets);
+  printf("test_IpMapFrozen PASSED\n");
+  return 0;
+}
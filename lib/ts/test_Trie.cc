@@ -0,0 +1,168 @@
+/** @file
+
+  Test and benchmark for the Trie template.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+#include "libts.h"
+#include "Trie.h"
+
+struct Item
+{
+  Item(int id) : _id(id) {}
+  void Print() { printf("%d\n", _id); }
+  int _id;
+  LINK(Item, link);
+};
+
+static const char *tlds[] = { "com", "net", "org", "io", "co.uk", "de", "jp" };
+static const char *words[] = { "video", "img", "static", "api", "cdn", "www", "mail", "shop", "news", "m" };
+
+// Wildcard certificate names are stored reversed, see SSLCertLookup.
+static std::string
+reversed_domain(InkRand &rng)
+{
+  char buffer[128];
+  std::string name;
+
+  snprintf(buffer, sizeof(buffer), "%s%u.%s.", words[rng.random() % countof(words)],
+           static_cast<unsigned>(rng.random() % 100000), tlds[rng.random() % countof(tlds)]);
+  name = buffer;
+  return std::string(name.rbegin(), name.rend());
+}
+
+static std::string
+remap_path(InkRand &rng)
+{
+  char buffer[128];
+
+  snprintf(buffer, sizeof(buffer), "/%s/%u/%s/", words[rng.random() % countof(words)],
+           static_cast<unsigned>(rng.random() % 1000), words[rng.random() % countof(words)]);
+  return buffer;
+}
+
+// Reference search: lowest rank among the keys that prefix @a query, deepest on ties.
+static int
+brute_search(const std::vector<std::string> &keys, const std::string &query)
+{
+  int found = -1;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i].size() <= query.size() && 0 == query.compare(0, keys[i].size(), keys[i])) {
+      if (found < 0 || static_cast<int>(i) <= found) {
+        found = static_cast<int>(i);
+      }
+    }
+  }
+  return found;
+}
+
+static void
+test_basic()
+{
+  Trie<Item> trie;
+  Item dup(5);
+
+  ink_release_assert(trie.Empty());
+  ink_release_assert(trie.Insert("abc", new Item(2), 2));
+  ink_release_assert(trie.Insert("abd", new Item(1), 1));
+  ink_release_assert(trie.Insert("ab", new Item(3), 3));
+  ink_release_assert(trie.Insert("", new Item(4), 1000));
+  ink_release_assert(!trie.Insert("abd", &dup, 5));
+  ink_release_assert(trie.Search("abc")->_id == 2);
+  ink_release_assert(trie.Search("abdxyz")->_id == 1);
+  ink_release_assert(trie.Search("abx")->_id == 3);
+  ink_release_assert(trie.Search("a")->_id == 4);
+  ink_release_assert(trie.Search("abc", 2)->_id == 3);
+
+  // Force a node into the direct index.
+  for (int c = 0; c < 256; ++c) {
+    char key[2] = { 'x', static_cast<char>(c) };
+    ink_release_assert(trie.Insert(key, new Item(100 + c), 100 + c, 2));
+  }
+  for (int c = 0; c < 256; ++c) {
+    char key[3] = { 'x', static_cast<char>(c), 'q' };
+    ink_release_assert(trie.Search(key, 3)->_id == 100 + c);
+  }
+  trie.Clear();
+  ink_release_assert(trie.Empty());
+}
+
+static void
+bench(const char *name, std::string (*generate)(InkRand &), int n)
+{
+  InkRand rng(13);
+  std::vector<std::string> keys;
+  std::vector<std::string> queries;
+  std::set<std::string> prefixes;
+  std::set<std::string> unique;
+  Trie<Item> trie;
+
+  while (static_cast<int>(keys.size()) < n) {
+    std::string key = generate(rng);
+    if (unique.insert(key).second) {
+      keys.push_back(key);
+    }
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ink_release_assert(trie.Insert(keys[i].data(), new Item(i), i, keys[i].size()));
+    for (size_t len = 1; len <= keys[i].size(); ++len) {
+      prefixes.insert(keys[i].substr(0, len));
+    }
+  }
+  for (int i = 0; i < 100000; ++i) {
+    queries.push_back(generate(rng) + "tail");
+  }
+
+  for (int i = 0; i < 2000; ++i) {
+    Item *item = trie.Search(queries[i].data(), queries[i].size());
+    ink_release_assert((item ? item->_id : -1) == brute_search(keys, queries[i]));
+  }
+
+  int hits = 0;
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int pass = 0; pass < 10; ++pass) {
+    for (size_t i = 0; i < queries.size(); ++i) {
+      hits += trie.Search(queries[i].data(), queries[i].size()) != NULL;
+    }
+  }
+  ink_hrtime elapsed = ink_get_hrtime_internal() - start;
+
+  // Each uncompressed node carried a full child table.
+  size_t uncompressed = (prefixes.size() + 1) * (256 * sizeof(void *) + sizeof(void *) + 2 * sizeof(int));
+  printf("%s: %d keys, %zu bytes (%zu bytes uncompressed), %.1f ns/search, %d hits\n", name, n, trie.MemoryUsage(), uncompressed,
+         static_cast<double>(elapsed) / (10 * queries.size()), hits);
+}
+
+int
+main(int /* argc ATS_UNUSED */, char ** /* argv ATS_UNUSED */)
+{
+  diags = new Diags(NULL, NULL);
+
+  test_basic();
+  bench("wildcard certs", reversed_domain, 20000);
+  bench("remap paths", remap_path, 20000);
+
+  printf("test_Trie PASSED\n");
+  return 0;
+}
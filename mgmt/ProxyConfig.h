@@ -34,6 +34,7 @@
 #include "libts.h"
 #include "ProcessManager.h"
 #include "I_EventSystem.h"
+#include "I_Tasks.h"
 
 class ProxyMutex;
 
@@ -107,15 +108,19 @@ struct ConfigUpdateContinuation : public Continuation
 };
 
 template <typename UpdateClass> int
-ConfigScheduleUpdate(ProxyMutex * mutex) {
-  eventProcessor.schedule_imm(new ConfigUpdateContinuation<UpdateClass>(mutex), ET_CALL);
+ConfigScheduleUpdate(ProxyMutex * mutex, EventType etype = ET_CALL) {
+  eventProcessor.schedule_imm(new ConfigUpdateContinuation<UpdateClass>(mutex), etype);
   return 0;
 }
 
 template <typename UpdateClass>
 struct ConfigUpdateHandler
 {
-  ConfigUpdateHandler() : mutex(new_ProxyMutex()) {
+  // Configurations which are expensive to rebuild (e.g. the ControlMatcher
+  // tables) pass &ET_TASK, so that reading and compiling the new tables does
+  // not stall an event thread. It is read when an update is scheduled, as
+  // the handlers are created before the task threads are started.
+  ConfigUpdateHandler(const EventType * etype = NULL) : mutex(new_ProxyMutex()), etype(etype) {
   }
 
   ~ConfigUpdateHandler() {
@@ -132,10 +137,11 @@ private:
     ConfigUpdateHandler * self = static_cast<ConfigUpdateHandler *>(cookie);
 
     Debug("config", "%s(%s)", __PRETTY_FUNCTION__, name);
-    return ConfigScheduleUpdate<UpdateClass>(self->mutex);
+    return ConfigScheduleUpdate<UpdateClass>(self->mutex, self->etype ? *self->etype : ET_CALL);
   }
 
   Ptr<ProxyMutex> mutex;
+  const EventType * etype;
 };
 
 extern ConfigProcessor configProcessor;
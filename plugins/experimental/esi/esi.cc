@@ -48,6 +48,7 @@
 #include "Stats.h"
 #include "HttpDataFetcherImpl.h"
 #include "FailureInfo.h"
+#include "NodeListCache.h"
 using std::string;
 using std::list;
 using namespace EsiLib;
@@ -59,6 +60,8 @@ struct OptionInfo
   bool private_response;
   bool disable_gzip_output;
   bool first_byte_flush;
+  NodeListCache *parse_cache; // parsed documents by URL; NULL if disabled
+  int include_deadline; // msec to wait for includes once the document is read; 0 to wait for ever
 };
 
 static HandlerManager *gHandlerManager = NULL;
@@ -79,6 +82,10 @@ static HandlerManager *gHandlerManager = NULL;
 #define HTTP_VALUE_PRIVATE_EXPIRES "-1"
 #define HTTP_VALUE_PRIVATE_CC      "max-age=0, private"
 
+// sent to the transformation when the include deadline passes; kept
+// below the event ids the data fetcher hands out
+#define ESI_EVENT_INCLUDE_DEADLINE 9000
+
 enum DataType { DATA_TYPE_RAW_ESI = 0, DATA_TYPE_GZIPPED_ESI = 1, DATA_TYPE_PACKED_ESI = 2 };
 static const char *DATA_TYPE_NAMES_[] = {
   "RAW_ESI",
@@ -111,6 +118,12 @@ struct ContData
   DataType input_type;
   string packed_node_list;
   string gzipped_data;
+  string parse_cache_key;
+  string parse_cache_etag;
+  string cached_node_list;
+  bool parse_cache_hit;
+  TSCont deadline_contp;
+  TSAction deadline_action; // NULL unless the deadline is pending
   char debug_tag[32];
   bool gzip_output;
   bool initialized;
@@ -128,7 +141,7 @@ struct ContData
       esi_vars(NULL), data_fetcher(NULL), esi_proc(NULL), esi_gzip(NULL), esi_gunzip(NULL),  
       contp(contptr), txnp(tx), request_url(NULL),
       input_type(DATA_TYPE_RAW_ESI), packed_node_list(""),
-      gzipped_data(""), gzip_output(false),
+      gzipped_data(""), parse_cache_hit(false), deadline_contp(NULL), deadline_action(NULL), gzip_output(false),
       initialized(false), xform_closed(false),
       intercept_header(false), cache_txn(false), head_only(false)
       , os_response_cacheable(true)
@@ -143,6 +156,8 @@ struct ContData
 
   void getServerState();
 
+  void getParseCacheState(TSMBuffer bufp, TSMLoc hdr_loc);
+
   void checkXformStatus();
 
   bool init();
@@ -249,6 +264,18 @@ ContData::init()
     esi_gzip = new EsiGzip(createDebugTag(GZIP_DEBUG_TAG, contp, gzip_tag), &TSDebug, &TSError);
     esi_gunzip = new EsiGunzip(createDebugTag(GUNZIP_DEBUG_TAG, contp, gunzip_tag), &TSDebug, &TSError);
 
+    if (parse_cache_hit) {
+      // start the includes now; the document itself is only drained
+      if (esi_proc->usePackedNodeList(cached_node_list) == EsiProcessor::UNPACK_FAILURE) {
+        TSError("[%s] Could not use node list from parse cache for URL [%s]; parsing document",
+                 __FUNCTION__, request_url);
+        option_info->parse_cache->erase(parse_cache_key);
+        parse_cache_hit = false;
+        esi_proc->start();
+      }
+      cached_node_list.clear();
+    }
+
     TSDebug(debug_tag, "[%s] Set input data type to [%s]", __FUNCTION__,
              DATA_TYPE_NAMES_[input_type]);
 
@@ -468,9 +495,43 @@ ContData::getServerState() {
     fillPostHeader(bufp, hdr_loc);
   }
 
+  if (option_info->parse_cache && request_url && !head_only) {
+    getParseCacheState(bufp, hdr_loc);
+  }
+
   TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
 }
 
+void
+ContData::getParseCacheState(TSMBuffer bufp, TSMLoc hdr_loc) {
+  // only a strong ETag tells us the document is byte for byte the one
+  // we parsed; a weak one or a Last-Modified date doesn't
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG);
+  if (!field_loc) {
+    TSDebug(DEBUG_TAG, "[%s] No ETag in response for URL [%s]; not using parse cache",
+             __FUNCTION__, request_url);
+    return;
+  }
+  int value_len;
+  const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, -1, &value_len);
+  if (value && (value_len > 1) && (value[0] == 'W') && (value[1] == '/')) {
+    TSDebug(DEBUG_TAG, "[%s] Weak ETag in response for URL [%s]; not using parse cache",
+             __FUNCTION__, request_url);
+  } else if (value && value_len) {
+    parse_cache_key.assign(request_url);
+    parse_cache_etag.assign(value, value_len);
+    if (option_info->parse_cache->get(parse_cache_key, parse_cache_etag, cached_node_list)) {
+      TSDebug(DEBUG_TAG, "[%s] Found node list of size %d for URL [%s] in parse cache",
+               __FUNCTION__, (int) cached_node_list.size(), request_url);
+      parse_cache_hit = true;
+      Stats::increment(Stats::N_PARSE_CACHE_HITS);
+    } else {
+      Stats::increment(Stats::N_PARSE_CACHE_MISSES);
+    }
+  }
+  TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+}
+
 ContData::~ContData()
 {
   TSDebug(debug_tag, "[%s] Destroying continuation data", __FUNCTION__);
@@ -486,6 +547,12 @@ ContData::~ContData()
   if (esi_vars) {
     delete esi_vars;
   }
+  if (deadline_action) {
+    TSActionCancel(deadline_action);
+  }
+  if (deadline_contp) {
+    TSContDestroy(deadline_contp);
+  }
   if (data_fetcher) {
     delete data_fetcher;
   }
@@ -611,6 +678,18 @@ cacheNodeList(ContData *cont_data) {
                   cont_data->contp, NO_CALLBACK, event_ids);
 }
 
+static int
+deadlineHandler(TSCont contp, TSEvent /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */)
+{
+  TSCont xform_contp = static_cast<TSCont>(TSContDataGet(contp));
+  ContData *cont_data = static_cast<ContData *>(TSContDataGet(xform_contp));
+
+  // the action is spent, whatever the transformation does with the event
+  cont_data->deadline_action = NULL;
+  TSContCall(xform_contp, static_cast<TSEvent>(ESI_EVENT_INCLUDE_DEADLINE), NULL);
+  return 0;
+}
+
 static int
 transformData(TSCont contp)
 {
@@ -668,7 +747,9 @@ transformData(TSCont contp)
         // Now start extraction
         while (block != NULL) {
           data = TSIOBufferBlockReadStart(block, cont_data->input_reader, &data_len);
-          if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
+          if (cont_data->parse_cache_hit) {
+            // already have the node list; nothing to parse
+          } else if (cont_data->input_type == DATA_TYPE_RAW_ESI) {
             cont_data->esi_proc->addParseData(data, data_len);
           } else if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
             string udata = "";
@@ -706,7 +787,9 @@ transformData(TSCont contp)
   }
   if (process_input_complete) {
     TSDebug(cont_data->debug_tag, "[%s] Completed reading input...", __FUNCTION__);
-    if (cont_data->input_type == DATA_TYPE_PACKED_ESI) {
+    if (cont_data->parse_cache_hit) {
+      TSDebug(cont_data->debug_tag, "[%s] Used node list from parse cache", __FUNCTION__);
+    } else if (cont_data->input_type == DATA_TYPE_PACKED_ESI) {
       TSDebug(DEBUG_TAG, "[%s] Going to use packed node list of size %d",
                __FUNCTION__, (int) cont_data->packed_node_list.size());
       if (cont_data->esi_proc->usePackedNodeList(cont_data->packed_node_list) == EsiProcessor::UNPACK_FAILURE) {
@@ -718,7 +801,7 @@ transformData(TSCont contp)
       }
     }
 
-    if (cont_data->input_type != DATA_TYPE_PACKED_ESI) {
+    if ((cont_data->input_type != DATA_TYPE_PACKED_ESI) && !cont_data->parse_cache_hit) {
       bool gunzip_complete = true;
       if (cont_data->input_type == DATA_TYPE_GZIPPED_ESI) {
         gunzip_complete = cont_data->esi_gunzip->stream_finish(); 
@@ -729,10 +812,26 @@ transformData(TSCont contp)
         {
           cacheNodeList(cont_data);
         }
+        if (!cont_data->parse_cache_key.empty()) {
+          string packed_node_list;
+          cont_data->esi_proc->packNodeList(packed_node_list, false);
+          cont_data->option_info->parse_cache->put(cont_data->parse_cache_key, cont_data->parse_cache_etag,
+                                                   packed_node_list);
+        }
       }
     }
 
     cont_data->curr_state = ContData::FETCHING_DATA;
+    if (cont_data->option_info->include_deadline && !cont_data->data_fetcher->isFetchComplete()) {
+      TSDebug(cont_data->debug_tag, "[%s] Will wait at most %d ms for includes", __FUNCTION__,
+               cont_data->option_info->include_deadline);
+      if (!cont_data->deadline_contp) {
+        cont_data->deadline_contp = TSContCreate(deadlineHandler, TSContMutexGet(contp));
+        TSContDataSet(cont_data->deadline_contp, contp);
+      }
+      cont_data->deadline_action = TSContSchedule(cont_data->deadline_contp, cont_data->option_info->include_deadline,
+                                                  TS_THREAD_POOL_DEFAULT);
+    }
     if (!input_vio_buf_null) {
       TSContCall(TSVIOContGet(cont_data->input_vio), TS_EVENT_VCONN_WRITE_COMPLETE,
                   cont_data->input_vio);
@@ -905,7 +1004,7 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
   // we need these later, but declaring now avoid compiler warning w.r.t. goto
   bool process_event = true;
   const char *cont_debug_tag;
-  bool shutdown, is_fetch_event;
+  bool shutdown, is_fetch_event, is_deadline_event;
 
   if (!cont_data->initialized) {
     if (!cont_data->init()) {
@@ -920,7 +1019,7 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
   cont_data->checkXformStatus();
 
   is_fetch_event = cont_data->data_fetcher->isFetchEvent(event);
-
+  is_deadline_event = (event == static_cast<TSEvent>(ESI_EVENT_INCLUDE_DEADLINE));
 
   if (cont_data->xform_closed) {
     TSDebug(cont_debug_tag, "[%s] Transformation closed. Post-processing...", __FUNCTION__);
@@ -928,6 +1027,10 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
       TSDebug(cont_debug_tag, "[%s] Processing is complete, not processing current event %d",
                __FUNCTION__, event);
       process_event = false;
+      if (is_fetch_event) {
+        // a response which arrived after the deadline; let the fetcher drop it
+        cont_data->data_fetcher->handleFetchEvent(event, edata);
+      }
     } else if (cont_data->curr_state == ContData::READING_ESI_DOC) {
       TSDebug(cont_debug_tag, "[%s] Parsing is incomplete, will force end of input",
                __FUNCTION__);
@@ -941,7 +1044,7 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
         cont_data->curr_state = ContData::PROCESSING_COMPLETE;
         process_event = false;
       } else {
-        if (is_fetch_event) {
+        if (is_fetch_event || is_deadline_event) {
           TSDebug(cont_debug_tag, "[%s] Going to process received data",
                    __FUNCTION__);
         } else {
@@ -989,7 +1092,14 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
       break;
 
     default:
-      if (is_fetch_event) {
+      if (is_deadline_event) {
+        if (cont_data->curr_state == ContData::FETCHING_DATA) {
+          TSDebug(cont_debug_tag, "[%s] Include deadline passed; %d requests still pending",
+                   __FUNCTION__, cont_data->data_fetcher->getNumPendingRequests());
+          cont_data->data_fetcher->timeoutPendingRequests();
+          transformData(contp);
+        }
+      } else if (is_fetch_event) {
         TSDebug(cont_debug_tag, "[%s] Handling fetch event %d...", __FUNCTION__, event);
         if (cont_data->data_fetcher->handleFetchEvent(event, edata)) {
           if ((cont_data->curr_state == ContData::FETCHING_DATA) ||
@@ -1015,9 +1125,12 @@ transformHandler(TSCont contp, TSEvent event, void *edata)
 
   TSDebug(cont_data->debug_tag, "[%s] transformHandler, event: %d, curr_state: %d", __FUNCTION__, (int)event, (int)cont_data->curr_state);
 
-  shutdown = (cont_data->xform_closed && (cont_data->curr_state == ContData::PROCESSING_COMPLETE));
+  // the fetch API calls us back for every request, even those past the
+  // deadline, so we have to outlive them
+  shutdown = (cont_data->xform_closed && (cont_data->curr_state == ContData::PROCESSING_COMPLETE) &&
+              (cont_data->data_fetcher->getNumOutstandingRequests() == 0));
   if (shutdown) {
-    if (process_event && is_fetch_event) {
+    if (is_fetch_event) {
       // we need to return control to the fetch API to give up it's
       // lock on our continuation which will fail if we destroy
       // ourselves right now
@@ -1630,13 +1743,15 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
       { const_cast<char *>("disable-gzip-output"), no_argument, NULL, 'z' },
       { const_cast<char *>("first-byte-flush"), no_argument, NULL, 'b' },
       { const_cast<char *>("handler-filename"), required_argument, NULL, 'f' },
+      { const_cast<char *>("parse-cache-size"), required_argument, NULL, 'c' },
+      { const_cast<char *>("include-deadline"), required_argument, NULL, 'd' },
       { NULL, 0, NULL, 0 }
     };
 
     optarg = NULL;
     optind = opterr = optopt = 0;
     int longindex = 0;
-    while ((c = getopt_long(argc, (char * const*) argv, "npzbf:", longopts, &longindex)) != -1) {
+    while ((c = getopt_long(argc, (char * const*) argv, "npzbf:c:d:", longopts, &longindex)) != -1) {
       switch (c) {
         case 'n':
           pOptionInfo->packed_node_support = true;
@@ -1657,6 +1772,17 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
             gHandlerManager->loadObjects(handler_conf);
             break;
           }
+        case 'c':
+          {
+            long size = atol(optarg);
+            if (size > 0) {
+              pOptionInfo->parse_cache = new NodeListCache(size);
+            }
+            break;
+          }
+        case 'd':
+          pOptionInfo->include_deadline = atoi(optarg);
+          break;
         default:
           break;
       }
@@ -1679,9 +1805,11 @@ static int esiPluginInit(int argc, const char *argv[], struct OptionInfo *pOptio
   if (result == 0) {
     TSDebug(DEBUG_TAG, "[%s] Plugin started%s, " \
         "packed-node-support: %d, private-response: %d, " \
-        "disable-gzip-output: %d, first-byte-flush: %d ", __FUNCTION__, bKeySet ? " and key is set" : "",
+        "disable-gzip-output: %d, first-byte-flush: %d, parse-cache-size: %d, include-deadline: %d ",
+        __FUNCTION__, bKeySet ? " and key is set" : "",
         pOptionInfo->packed_node_support, pOptionInfo->private_response,
-        pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush);
+        pOptionInfo->disable_gzip_output, pOptionInfo->first_byte_flush,
+        pOptionInfo->parse_cache ? (int) pOptionInfo->parse_cache->maxBytes() : 0, pOptionInfo->include_deadline);
   }
 
   return result;
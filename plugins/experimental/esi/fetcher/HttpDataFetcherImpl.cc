@@ -24,6 +24,8 @@
 #include "HttpDataFetcherImpl.h"
 #include "lib/Utils.h"
 #include "lib/gzip.h"
+#include "lib/Stats.h"
+#include "ts/experimental.h"
 
 #include <arpa/inet.h>
 #include <stdlib.h>
@@ -47,7 +49,7 @@ inline void HttpDataFetcherImpl::_release(RequestData &req_data)
 
 HttpDataFetcherImpl::HttpDataFetcherImpl(TSCont contp,sockaddr const* client_addr,
                                          const char *debug_tag)
-  : _contp(contp), _n_pending_requests(0), _curr_event_id_base(FETCH_EVENT_ID_BASE),
+  : _contp(contp), _n_pending_requests(0), _n_outstanding_requests(0), _curr_event_id_base(FETCH_EVENT_ID_BASE),
     _headers_str(""),_client_addr(client_addr)
 {
   _http_parser = TSHttpParserCreate();
@@ -98,6 +100,7 @@ HttpDataFetcherImpl::addFetchRequest(const string &url, FetchedDataProcessor *ca
   event_ids.timeout_event_id = _curr_event_id_base + 2;
   _curr_event_id_base += 3;
 
+  ((insert_result.first)->second).start_time = TShrtime();
   TSFetchUrl(http_req, length, _client_addr, _contp, AFTER_BODY, event_ids);
   if (http_req != buff) {
     free(http_req);
@@ -106,9 +109,25 @@ HttpDataFetcherImpl::addFetchRequest(const string &url, FetchedDataProcessor *ca
   TSDebug(_debug_tag, "[%s] Successfully added fetch request for URL [%s]", __FUNCTION__, url.data());
   _page_entry_lookup.push_back(insert_result.first);
   ++_n_pending_requests;
+  ++_n_outstanding_requests;
   return true;
 }
 
+void
+HttpDataFetcherImpl::timeoutPendingRequests()
+{
+  for (IteratorArray::iterator iter = _page_entry_lookup.begin(); iter != _page_entry_lookup.end(); ++iter) {
+    RequestData &req_data = (*iter)->second;
+    if (!req_data.complete) {
+      TSDebug(_debug_tag, "[%s] Request for URL [%s] timed out", __FUNCTION__, (*iter)->first.c_str());
+      req_data.complete = true;
+      req_data.timed_out = true;
+      --_n_pending_requests;
+      Stats::increment(Stats::N_INCLUDE_TIMEOUTS);
+    }
+  }
+}
+
 bool
 HttpDataFetcherImpl::_isFetchEvent(TSEvent event, int &base_event_id) const
 {
@@ -135,6 +154,13 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
   const string &req_str = req_entry->first;
   RequestData &req_data = req_entry->second;
 
+  --_n_outstanding_requests;
+  if (req_data.timed_out) {
+    TSDebug(_debug_tag, "[%s] Dropping response for URL [%s] received after its deadline", __FUNCTION__,
+             req_str.c_str());
+    return true;
+  }
+
   if (req_data.complete) {
     // can only happen if there's a bug in this or fetch API code
     TSError("[%s] URL [%s] already completed; Retaining original data", __FUNCTION__, req_str.c_str());
@@ -143,6 +169,7 @@ HttpDataFetcherImpl::handleFetchEvent(TSEvent event, void *edata)
 
   --_n_pending_requests;
   req_data.complete = true;
+  Stats::increment(Stats::INCLUDE_LATENCY_MSEC, (TShrtime() - req_data.start_time) / TS_HRTIME_MSECOND);
 
   int event_id = (static_cast<int>(event) - FETCH_EVENT_ID_BASE) % 3;
   if (event_id != 0) { // failure or timeout
@@ -293,6 +320,7 @@ HttpDataFetcherImpl::clear()
     _release(iter->second);
   }
   _n_pending_requests = 0;
+  _n_outstanding_requests = 0;
   _pages.clear();
   _page_entry_lookup.clear();
   _headers_str.clear();
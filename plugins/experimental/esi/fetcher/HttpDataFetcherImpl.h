@@ -55,6 +55,16 @@ public:
 
   bool isFetchComplete() const { return (_n_pending_requests == 0); };
 
+  /** fails the requests which are still pending, e.g. when the deadline
+   * of the document has passed; their responses are dropped when they
+   * arrive */
+  void timeoutPendingRequests();
+
+  /** requests whose fetch event has not been received yet, including
+   * those timed out; the fetch API calls back our continuation for
+   * these, so it must not be destroyed before they are done */
+  int getNumOutstandingRequests() const { return _n_outstanding_requests; };
+
   DataStatus getRequestStatus(const std::string &url) const;
 
   int getNumPendingRequests() const { return _n_pending_requests; };
@@ -103,10 +113,13 @@ private:
     TSHttpStatus resp_status;
     CallbackObjectList callback_objects;
     bool complete;
+    bool timed_out;
+    TSHRTime start_time;
     TSMBuffer bufp;
     TSMLoc hdr_loc;
 
-    RequestData() : body(0), body_len(0), resp_status(TS_HTTP_STATUS_NONE), complete(false), bufp(0), hdr_loc(0) { }
+    RequestData() : body(0), body_len(0), resp_status(TS_HTTP_STATUS_NONE), complete(false), timed_out(false),
+                    start_time(0), bufp(0), hdr_loc(0) { }
   };
 
   typedef __gnu_cxx::hash_map<std::string, RequestData, EsiLib::StringHasher> UrlToContentMap;
@@ -116,6 +129,7 @@ private:
   IteratorArray _page_entry_lookup; // used to map event ids to requests
 
   int _n_pending_requests;
+  int _n_outstanding_requests;
   int _curr_event_id_base;
   TSHttpParser _http_parser;
 
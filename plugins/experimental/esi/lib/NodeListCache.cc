@@ -0,0 +1,98 @@
+/** @file
+
+  Size-bounded cache of packed ESI node lists
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "NodeListCache.h"
+
+using std::string;
+using namespace EsiLib;
+
+NodeListCache::NodeListCache(size_t max_bytes)
+  : _max_bytes(max_bytes), _bytes(0) {
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+NodeListCache::~NodeListCache() {
+  pthread_mutex_destroy(&_mutex);
+}
+
+void
+NodeListCache::_erase(EntryMap::iterator map_iter) {
+  EntryList::iterator entry = map_iter->second;
+  _bytes -= entry->key.size() + entry->packed_node_list.size();
+  _map.erase(map_iter);
+  _entries.erase(entry);
+}
+
+bool
+NodeListCache::get(const string &key, const string &etag, string &packed_node_list) {
+  bool retval = false;
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator map_iter = _map.find(key);
+  if (map_iter != _map.end()) {
+    EntryList::iterator entry = map_iter->second;
+    if (entry->etag == etag) {
+      _entries.splice(_entries.begin(), _entries, entry);
+      packed_node_list.assign(entry->packed_node_list);
+      retval = true;
+    } else {
+      // the template changed; its new version will be put shortly
+      _erase(map_iter);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+  return retval;
+}
+
+void
+NodeListCache::put(const string &key, const string &etag, const string &packed_node_list) {
+  size_t entry_size = key.size() + packed_node_list.size();
+  if (entry_size > _max_bytes) {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator map_iter = _map.find(key);
+  if (map_iter != _map.end()) {
+    _erase(map_iter);
+  }
+  while (_bytes + entry_size > _max_bytes) {
+    _erase(_map.find(_entries.back().key));
+  }
+  _entries.push_front(Entry());
+  Entry &entry = _entries.front();
+  entry.key = key;
+  entry.etag = etag;
+  entry.packed_node_list = packed_node_list;
+  _map[key] = _entries.begin();
+  _bytes += entry_size;
+  pthread_mutex_unlock(&_mutex);
+}
+
+void
+NodeListCache::erase(const string &key) {
+  pthread_mutex_lock(&_mutex);
+  EntryMap::iterator map_iter = _map.find(key);
+  if (map_iter != _map.end()) {
+    _erase(map_iter);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
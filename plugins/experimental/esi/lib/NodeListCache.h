@@ -0,0 +1,89 @@
+/** @file
+
+  Size-bounded cache of packed ESI node lists
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _ESI_NODE_LIST_CACHE_H
+
+#define _ESI_NODE_LIST_CACHE_H
+
+#include <string>
+#include <list>
+#include <pthread.h>
+#include "StringHash.h"
+
+namespace EsiLib {
+
+/** Keeps the packed node lists of parsed ESI templates, so a template which
+ * has not changed can be unpacked rather than parsed again. Entries are
+ * keyed by the template's cache key and validated against its ETag; the
+ * least recently used ones are evicted when the packed lists exceed the
+ * size limit. Shared by all transactions, so all methods lock. */
+class NodeListCache {
+
+public:
+
+  NodeListCache(size_t max_bytes);
+
+  /** copies the packed node list of key into packed_node_list, if there is
+   * one for the same etag */
+  bool get(const std::string &key, const std::string &etag, std::string &packed_node_list);
+
+  /** stores the packed node list of key, replacing any for another etag */
+  void put(const std::string &key, const std::string &etag, const std::string &packed_node_list);
+
+  void erase(const std::string &key);
+
+  size_t size() const { return _bytes; };
+
+  size_t maxBytes() const { return _max_bytes; };
+
+  int numEntries() const { return _entries.size(); };
+
+  ~NodeListCache();
+
+private:
+
+  struct Entry {
+    std::string key;
+    std::string etag;
+    std::string packed_node_list;
+  };
+
+  typedef std::list<Entry> EntryList; // most recently used first
+  typedef StringKeyHash<EntryList::iterator> EntryMap;
+
+  EntryList _entries;
+  EntryMap _map;
+  size_t _max_bytes;
+  size_t _bytes;
+  pthread_mutex_t _mutex;
+
+  void _erase(EntryMap::iterator map_iter);
+
+  NodeListCache(const NodeListCache &);
+  NodeListCache &operator=(const NodeListCache &);
+
+};
+
+};
+
+#endif // _ESI_NODE_LIST_CACHE_H
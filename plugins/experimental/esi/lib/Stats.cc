@@ -34,7 +34,11 @@ const char *STAT_NAMES[Stats::MAX_STAT_ENUM] = {
   "esi.n_includes",
   "esi.n_include_errs",
   "esi.n_spcl_includes",
-  "esi.n_spcl_include_errs"
+  "esi.n_spcl_include_errs",
+  "esi.n_parse_cache_hits",
+  "esi.n_parse_cache_misses",
+  "esi.n_include_timeouts",
+  "esi.include_latency_msec"
 };
 
 int g_stat_indices[Stats::MAX_STAT_ENUM] = {0};
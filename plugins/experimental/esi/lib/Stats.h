@@ -47,7 +47,11 @@ enum STAT { N_OS_DOCS = 0,
             N_INCLUDE_ERRS = 4,
             N_SPCL_INCLUDES = 5,
             N_SPCL_INCLUDE_ERRS = 6,
-            MAX_STAT_ENUM = 7 };
+            N_PARSE_CACHE_HITS = 7,
+            N_PARSE_CACHE_MISSES = 8,
+            N_INCLUDE_TIMEOUTS = 9,
+            INCLUDE_LATENCY_MSEC = 10,
+            MAX_STAT_ENUM = 11 };
 
 extern const char *STAT_NAMES[MAX_STAT_ENUM];
 extern int g_stat_indices[Stats::MAX_STAT_ENUM];
@@ -0,0 +1,118 @@
+/** @file
+
+  A brief file description
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <iostream>
+#include <assert.h>
+#include <string>
+
+#include "print_funcs.h"
+#include "EsiParser.h"
+#include "NodeListCache.h"
+#include "Utils.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace EsiLib;
+
+pthread_key_t threadKey;
+
+int main()
+{
+  pthread_key_create(&threadKey, NULL);
+  Utils::init(&Debug, &Error);
+
+  {
+    cout << endl << "===================== Test 1) packed node list round trip" << endl;
+    EsiParser parser("parser_test", &Debug, &Error);
+    DocNodeList node_list;
+    string input_data("foo <esi:include src=url1/> bar <esi:vars>$(HTTP_HOST)</esi:vars>");
+    assert(parser.completeParse(node_list, input_data) == true);
+    assert(node_list.size() == 4);
+
+    NodeListCache cache(4096);
+    string packed, cached;
+    node_list.pack(packed);
+    assert(cache.get("/index.html", "\"v1\"", cached) == false);
+    cache.put("/index.html", "\"v1\"", packed);
+    assert(cache.numEntries() == 1);
+    assert(cache.get("/index.html", "\"v1\"", cached) == true);
+    assert(cached == packed);
+
+    DocNodeList unpacked;
+    assert(unpacked.unpack(cached) == true);
+    assert(unpacked.size() == node_list.size());
+    DocNodeList::iterator iter1 = node_list.begin(), iter2 = unpacked.begin();
+    for (; iter1 != node_list.end(); ++iter1, ++iter2) {
+      assert(iter1->type == iter2->type);
+      assert(iter1->data_len == iter2->data_len);
+      assert(strncmp(iter1->data, iter2->data, iter1->data_len) == 0);
+    }
+  }
+
+  {
+    cout << endl << "===================== Test 2) etag mismatch" << endl;
+    NodeListCache cache(4096);
+    string cached;
+    cache.put("/index.html", "\"v1\"", "node list v1");
+    assert(cache.get("/index.html", "\"v2\"", cached) == false);
+    assert(cache.numEntries() == 0);
+    assert(cache.size() == 0);
+    cache.put("/index.html", "\"v2\"", "node list v2");
+    assert(cache.get("/index.html", "\"v2\"", cached) == true);
+    assert(cached == "node list v2");
+  }
+
+  {
+    cout << endl << "===================== Test 3) size bound and LRU eviction" << endl;
+    NodeListCache cache(100);
+    string cached, data(30, 'x');
+    cache.put("/a", "e", data);
+    cache.put("/b", "e", data);
+    cache.put("/c", "e", data);
+    assert(cache.numEntries() == 3);
+    assert(cache.size() == 3 * (2 + data.size()));
+
+    // touch /a, so /b is evicted by /d
+    assert(cache.get("/a", "e", cached) == true);
+    cache.put("/d", "e", data);
+    assert(cache.numEntries() == 3);
+    assert(cache.size() <= 100);
+    assert(cache.get("/b", "e", cached) == false);
+    assert(cache.get("/a", "e", cached) == true);
+    assert(cache.get("/c", "e", cached) == true);
+    assert(cache.get("/d", "e", cached) == true);
+
+    // larger than the whole cache
+    cache.put("/e", "e", string(200, 'y'));
+    assert(cache.get("/e", "e", cached) == false);
+    assert(cache.numEntries() == 3);
+
+    cache.erase("/a");
+    assert(cache.get("/a", "e", cached) == false);
+    assert(cache.numEntries() == 2);
+  }
+
+  cout << endl << "All tests passed!" << endl;
+  return 0;
+}
@@ -0,0 +1,1222 @@
+/** @file
+
+    Plugin to cache large objects sparsely, in blocks that are filled
+    independently by range requests to the origin.
+
+    @section license License
+
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// A single range request on a remap rule using this plugin is intercepted
+// and served from fixed size blocks of the object. Each block is a cache
+// object of its own, keyed by the URL, the strong ETag of the object, the
+// block size and the block index, so blocks are addressable and fillable
+// independently of each other. A small metadata object per URL records
+// the length, validators and content type of the object. Objects without
+// a strong ETag are served block by block from the origin, uncached.
+//
+// Blocks are looked up in order. A block missing from the cache is
+// fetched from the origin with a range request for just that block (sent
+// back through the proxy, with caching disabled for the fill transaction),
+// written to the cache and served. Only the blocks a request covers are
+// ever fetched, so seeking in a large object does not pull the whole
+// object from the origin. An origin which ignores the range and returns
+// the whole object gets its response passed through to the client.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+
+#include "ts/ts.h"
+#include "ts/remap.h"
+#include "ink_defs.h"
+
+#include <string>
+
+// Constants
+const char PLUGIN_NAME[] = "sparse_cache";
+const char FILL_HEADER[] = "X-Sparse-Cache-Fill";
+const char META_MAGIC[] = "SPARSE1";
+
+const int64_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+const int64_t MIN_BLOCK_SIZE = 64 * 1024;
+const int64_t MAX_HEADER_SIZE = 64 * 1024; // of a fill response
+const int DEFAULT_META_TTL = 3600;
+const int CLIENT_BACKLOG_BLOCKS = 2; // unsent data to buffer before we stop filling
+
+// Stats
+static int stat_block_hits;
+static int stat_block_misses;
+static int stat_fill_bytes;
+static int stat_fill_errors;
+
+struct SparseConfig
+{
+  SparseConfig()
+    : block_size(DEFAULT_BLOCK_SIZE), meta_ttl(DEFAULT_META_TTL)
+  { }
+
+  int64_t block_size;
+  int meta_ttl;
+};
+
+
+///////////////////////////////////////////////////////////////////////////
+// What we know about an object, stored in the cache as text, one field per
+// line, so that it is easy to inspect and to extend.
+struct SparseMeta
+{
+  SparseMeta()
+    : total(-1), fetched(0)
+  { }
+
+  bool valid() const { return total >= 0; }
+
+  // Only a strong ETag promises that blocks fetched at different times are
+  // slices of the same bytes, so it is the only validator blocks are keyed
+  // on. Objects without one are not cached.
+  bool cacheable() const { return !etag.empty() && etag.compare(0, 2, "W/") != 0; }
+
+  std::string serialize() const
+  {
+    char buf[64];
+    std::string out(META_MAGIC);
+
+    snprintf(buf, sizeof(buf), "\n%" PRId64 "\n%ld\n", total, static_cast<long>(fetched));
+    out.append(buf);
+    out.append(etag).append("\n");
+    out.append(last_modified).append("\n");
+    out.append(content_type).append("\n");
+
+    return out;
+  }
+
+  bool parse(const std::string& s)
+  {
+    std::string lines[6];
+    size_t pos = 0;
+
+    for (int i = 0; i < 6; ++i) {
+      size_t eol = s.find('\n', pos);
+
+      if (eol == std::string::npos) {
+        return false;
+      }
+      lines[i] = s.substr(pos, eol - pos);
+      pos = eol + 1;
+    }
+    if (lines[0] != META_MAGIC) {
+      return false;
+    }
+    total = strtoll(lines[1].c_str(), NULL, 10);
+    fetched = static_cast<time_t>(strtol(lines[2].c_str(), NULL, 10));
+    etag = lines[3];
+    last_modified = lines[4];
+    content_type = lines[5];
+
+    return total >= 0;
+  }
+
+  int64_t total;
+  time_t fetched;
+  std::string etag;
+  std::string last_modified;
+  std::string content_type;
+};
+
+
+///////////////////////////////////////////////////////////////////////////
+// A single byte range, "bytes=a-b", "bytes=a-" or "bytes=-n". Multiple
+// ranges are not handled by this plugin.
+struct ByteRange
+{
+  ByteRange()
+    : start(-1), end(-1), suffix(-1)
+  { }
+
+  bool parse(const char* value, int len)
+  {
+    std::string s(value, len);
+    const char* p;
+    char* e;
+
+    if (s.compare(0, 6, "bytes=") || s.find(',') != std::string::npos) {
+      return false;
+    }
+    p = s.c_str() + 6;
+    while (*p == ' ') {
+      ++p;
+    }
+    if (*p == '-') {
+      suffix = strtoll(p + 1, &e, 10);
+      return e != p + 1 && suffix >= 0;
+    }
+    start = strtoll(p, &e, 10);
+    if (e == p || *e != '-' || start < 0) {
+      return false;
+    }
+    p = e + 1;
+    if (*p) {
+      end = strtoll(p, &e, 10);
+      if (e == p || end < start) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Resolve against the length of the object, false if not satisfiable.
+  bool resolve(int64_t total, int64_t* first, int64_t* last) const
+  {
+    if (suffix >= 0) {
+      if (suffix == 0 || total == 0) {
+        return false;
+      }
+      *first = suffix > total ? 0 : total - suffix;
+    } else {
+      if (start >= total) {
+        return false;
+      }
+      *first = start;
+    }
+    *last = (end < 0 || end >= total) ? total - 1 : end;
+
+    return true;
+  }
+
+  int64_t start;
+  int64_t end;
+  int64_t suffix;
+};
+
+
+///////////////////////////////////////////////////////////////////////////
+// Copy everything readable from a reader to a string, and consume it.
+static int64_t
+drain_reader(TSIOBufferReader reader, std::string* out)
+{
+  int64_t total = 0;
+  TSIOBufferBlock block = TSIOBufferReaderStart(reader);
+
+  while (block) {
+    int64_t avail;
+    const char* start = TSIOBufferBlockReadStart(block, reader, &avail);
+
+    if (out) {
+      out->append(start, avail);
+    }
+    total += avail;
+    block = TSIOBufferBlockNext(block);
+  }
+  TSIOBufferReaderConsume(reader, total);
+
+  return total;
+}
+
+static std::string
+header_value(TSMBuffer bufp, TSMLoc hdr_loc, const char* name, int name_len)
+{
+  std::string value;
+  TSMLoc field = TSMimeHdrFieldFind(bufp, hdr_loc, name, name_len);
+
+  if (field) {
+    int len = 0;
+    const char* v = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field, -1, &len);
+
+    if (v && len > 0) {
+      value.assign(v, len);
+    }
+    TSHandleMLocRelease(bufp, hdr_loc, field);
+  }
+
+  return value;
+}
+
+static void
+remove_header(TSMBuffer bufp, TSMLoc hdr_loc, const char* header, int len)
+{
+  TSMLoc field = TSMimeHdrFieldFind(bufp, hdr_loc, header, len);
+
+  while (field) {
+    TSMLoc tmp = TSMimeHdrFieldNextDup(bufp, hdr_loc, field);
+
+    TSMimeHdrFieldDestroy(bufp, hdr_loc, field);
+    TSHandleMLocRelease(bufp, hdr_loc, field);
+    field = tmp;
+  }
+}
+
+static void
+add_header(TSMBuffer bufp, TSMLoc hdr_loc, const char* header, int len, const char* val, int val_len)
+{
+  TSMLoc field;
+
+  if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(bufp, hdr_loc, header, len, &field)) {
+    if (TS_SUCCESS == TSMimeHdrFieldValueStringSet(bufp, hdr_loc, field, -1, val, val_len)) {
+      TSMimeHdrFieldAppend(bufp, hdr_loc, field);
+    }
+    TSHandleMLocRelease(bufp, hdr_loc, field);
+  }
+}
+
+static TSCacheKey
+make_key(const std::string& data)
+{
+  TSCacheKey key = TSCacheKeyCreate();
+
+  TSCacheKeyDigestSet(key, data.data(), data.size());
+  return key;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Write (or replace) a single cache object. This is fire and forget, the
+// continuation owns a copy of the data and cleans up after itself.
+static int cont_cache_writer(TSCont contp, TSEvent event, void* edata);
+
+struct CacheWriter
+{
+  CacheWriter(const std::string& akey, bool areplace)
+    : key(make_key(akey)), replace(areplace), vc(NULL)
+  {
+    buf = TSIOBufferCreate();
+    reader = TSIOBufferReaderAlloc(buf);
+  }
+
+  ~CacheWriter()
+  {
+    if (vc) {
+      TSVConnAbort(vc, 1);
+    }
+    TSCacheKeyDestroy(key);
+    TSIOBufferReaderFree(reader);
+    TSIOBufferDestroy(buf);
+  }
+
+  void start()
+  {
+    TSCont contp = TSContCreate(cont_cache_writer, TSMutexCreate());
+
+    TSContDataSet(contp, this);
+    TSContSchedule(contp, 0, TS_THREAD_POOL_DEFAULT);
+  }
+
+  TSCacheKey key;
+  bool replace;
+  TSVConn vc;
+  TSIOBuffer buf;
+  TSIOBufferReader reader;
+};
+
+static int
+cont_cache_writer(TSCont contp, TSEvent event, void* edata)
+{
+  CacheWriter* w = static_cast<CacheWriter*>(TSContDataGet(contp));
+
+  switch (event) {
+  case TS_EVENT_IMMEDIATE:
+  case TS_EVENT_TIMEOUT:
+    if (w->replace) {
+      TSCacheRemove(contp, w->key);
+    } else {
+      TSCacheWrite(contp, w->key);
+    }
+    return 0;
+
+  case TS_EVENT_CACHE_REMOVE:
+  case TS_EVENT_CACHE_REMOVE_FAILED:
+    TSCacheWrite(contp, w->key);
+    return 0;
+
+  case TS_EVENT_CACHE_OPEN_WRITE:
+    w->vc = static_cast<TSVConn>(edata);
+    TSVConnWrite(w->vc, contp, w->reader, TSIOBufferReaderAvail(w->reader));
+    return 0;
+
+  case TS_EVENT_VCONN_WRITE_READY:
+    TSVIOReenable(static_cast<TSVIO>(edata));
+    return 0;
+
+  case TS_EVENT_VCONN_WRITE_COMPLETE:
+    TSVConnClose(w->vc);
+    w->vc = NULL;
+    break;
+
+  case TS_EVENT_CACHE_OPEN_WRITE_FAILED:
+    TSDebug(PLUGIN_NAME, "cache write failed");
+    break;
+
+  default:
+    TSDebug(PLUGIN_NAME, "cache write aborted, event %d", event);
+    break;
+  }
+
+  delete w;
+  TSContDestroy(contp);
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// The state of one intercepted request.
+static int cont_sparse(TSCont contp, TSEvent event, void* edata);
+
+enum SparseState {
+  STATE_READ_REQUEST,
+  STATE_META,
+  STATE_BLOCK,
+  STATE_FILL,
+  STATE_WAIT_CLIENT,
+  STATE_PASS, // relaying a response that ignored the range
+  STATE_DONE
+};
+
+struct SparseTxn
+{
+  SparseTxn(const SparseConfig* cfg, const std::string& aurl, const std::string& areq, const ByteRange& arange)
+    : config(cfg), url(aurl), origin_req(areq), range(arange), state(STATE_READ_REQUEST),
+      client_vc(NULL), client_read_vio(NULL), client_write_vio(NULL),
+      cache_vc(NULL), cache_vio(NULL), cache_action(NULL),
+      fill_vc(NULL), fill_read_vio(NULL), fill_write_vio(NULL),
+      meta_fresh(false), headers_sent(false), first_byte(0), last_byte(-1), cur_block(0), last_block(-1)
+  {
+    contp = TSContCreate(cont_sparse, TSMutexCreate());
+    TSContDataSet(contp, this);
+
+    client_req_buf = TSIOBufferCreate();
+    client_req_reader = TSIOBufferReaderAlloc(client_req_buf);
+    client_resp_buf = TSIOBufferCreate();
+    client_resp_reader = TSIOBufferReaderAlloc(client_resp_buf);
+    block_buf = TSIOBufferCreate();
+    block_reader = TSIOBufferReaderAlloc(block_buf);
+    // the cache VC stops at the water mark until the data is consumed, and
+    // we want the whole block before we consume it
+    TSIOBufferWaterMarkSet(block_buf, config->block_size + 1);
+    fill_buf = TSIOBufferCreate();
+    fill_reader = TSIOBufferReaderAlloc(fill_buf);
+    fill_resp_buf = TSIOBufferCreate();
+    fill_resp_reader = TSIOBufferReaderAlloc(fill_resp_buf);
+    memset(&client_addr, 0, sizeof(client_addr));
+  }
+
+  ~SparseTxn()
+  {
+    if (cache_action) {
+      TSActionCancel(cache_action);
+    }
+    if (cache_vc) {
+      TSVConnClose(cache_vc);
+    }
+    if (fill_vc) {
+      TSVConnAbort(fill_vc, 1);
+    }
+    if (client_vc) {
+      TSVConnClose(client_vc);
+    }
+    TSIOBufferReaderFree(client_req_reader);
+    TSIOBufferDestroy(client_req_buf);
+    TSIOBufferReaderFree(client_resp_reader);
+    TSIOBufferDestroy(client_resp_buf);
+    TSIOBufferReaderFree(block_reader);
+    TSIOBufferDestroy(block_buf);
+    TSIOBufferReaderFree(fill_reader);
+    TSIOBufferDestroy(fill_buf);
+    TSIOBufferReaderFree(fill_resp_reader);
+    TSIOBufferDestroy(fill_resp_buf);
+    TSContDestroy(contp);
+  }
+
+  std::string meta_key() const { return std::string("sparse_cache:meta:") + url; }
+
+  std::string block_key(int64_t block) const
+  {
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), ":%" PRId64 ":%" PRId64 ":", config->block_size, block);
+    return std::string("sparse_cache:block:") + meta.etag + buf + url;
+  }
+
+  int64_t block_len(int64_t block) const
+  {
+    int64_t left = meta.total - block * config->block_size;
+
+    return left < config->block_size ? left : config->block_size;
+  }
+
+  void read_meta();
+  void next_block();
+  void read_block();
+  void fill_block();
+  bool fill_done();
+  bool fill_ignored_range() const;
+  void pass_through();
+  void relay(bool eos);
+  void deliver(int64_t block);
+  void send_error(const char* status);
+  void finish();
+
+  const SparseConfig* config;
+  std::string url;
+  std::string origin_req;
+  ByteRange range;
+  struct sockaddr_storage client_addr;
+  SparseState state;
+  TSCont contp;
+
+  TSVConn client_vc;
+  TSVIO client_read_vio, client_write_vio;
+  TSIOBuffer client_req_buf, client_resp_buf;
+  TSIOBufferReader client_req_reader, client_resp_reader;
+  std::string client_req;
+
+  TSVConn cache_vc;
+  TSVIO cache_vio;
+  TSAction cache_action;
+  TSIOBuffer block_buf;
+  TSIOBufferReader block_reader;
+
+  TSVConn fill_vc;
+  TSVIO fill_read_vio, fill_write_vio;
+  TSIOBuffer fill_buf, fill_resp_buf;
+  TSIOBufferReader fill_reader, fill_resp_reader;
+  std::string fill_resp;
+
+  SparseMeta meta;
+  bool meta_fresh;
+  bool headers_sent;
+  int64_t first_byte, last_byte;
+  int64_t cur_block, last_block;
+};
+
+void
+SparseTxn::read_meta()
+{
+  TSCacheKey key = make_key(meta_key());
+
+  state = STATE_META;
+  TSAction action = TSCacheRead(contp, key);
+  if (!TSActionDone(action)) {
+    cache_action = action;
+  }
+  TSCacheKeyDestroy(key);
+}
+
+// Serve the next block of the range, from the cache if we can. Without
+// fresh metadata, the next block comes from the origin, which also tells
+// us the current length and validators of the object.
+void
+SparseTxn::next_block()
+{
+  if (!meta_fresh) {
+    if (range.suffix >= 0) {
+      cur_block = meta.valid() && meta.total > range.suffix ? (meta.total - range.suffix) / config->block_size : 0;
+    } else {
+      cur_block = range.start / config->block_size;
+    }
+    fill_block();
+    return;
+  }
+
+  if (!headers_sent) {
+    if (!range.resolve(meta.total, &first_byte, &last_byte)) {
+      send_error("416 Requested Range Not Satisfiable");
+      return;
+    }
+    cur_block = first_byte / config->block_size;
+    last_block = last_byte / config->block_size;
+  }
+
+  if (cur_block > last_block) {
+    state = STATE_DONE; // wait for the client to get the rest
+    return;
+  }
+
+  if (TSIOBufferReaderAvail(client_resp_reader) > CLIENT_BACKLOG_BLOCKS * config->block_size) {
+    state = STATE_WAIT_CLIENT;
+    return;
+  }
+
+  if (meta.cacheable()) {
+    read_block();
+  } else {
+    fill_block();
+  }
+}
+
+void
+SparseTxn::read_block()
+{
+  TSCacheKey key = make_key(block_key(cur_block));
+
+  state = STATE_BLOCK;
+  TSAction action = TSCacheRead(contp, key);
+  if (!TSActionDone(action)) {
+    cache_action = action;
+  }
+  TSCacheKeyDestroy(key);
+}
+
+// Fetch the current block from the origin, through the proxy. Caching is
+// disabled for that transaction by TSRemapDoRemap.
+void
+SparseTxn::fill_block()
+{
+  char range_hdr[128];
+  int64_t start = cur_block * config->block_size;
+
+  state = STATE_FILL;
+  TSStatIntIncrement(stat_block_misses, 1);
+  fill_vc = TSHttpConnect(reinterpret_cast<sockaddr*>(&client_addr));
+  if (!fill_vc) {
+    TSError("%s: failed to connect to internal process", PLUGIN_NAME);
+    TSStatIntIncrement(stat_fill_errors, 1);
+    send_error("502 Bad Gateway");
+    return;
+  }
+
+  snprintf(range_hdr, sizeof(range_hdr), "Range: bytes=%" PRId64 "-%" PRId64 "\r\n\r\n", start,
+           start + config->block_size - 1);
+  TSIOBufferWrite(fill_buf, origin_req.data(), origin_req.size());
+  TSIOBufferWrite(fill_buf, range_hdr, strlen(range_hdr));
+  fill_resp.clear();
+  TSDebug(PLUGIN_NAME, "fill block %" PRId64 " of %s", cur_block, url.c_str());
+
+  fill_read_vio = TSVConnRead(fill_vc, contp, fill_resp_buf, INT64_MAX);
+  fill_write_vio = TSVConnWrite(fill_vc, contp, fill_reader, TSIOBufferReaderAvail(fill_reader));
+}
+
+// Parse the response to a fill, update the metadata, and cache and serve
+// the block. Returns false if the response is unusable.
+bool
+SparseTxn::fill_done()
+{
+  TSMBuffer bufp = TSMBufferCreate();
+  TSMLoc hdr_loc = TSHttpHdrCreate(bufp);
+  TSHttpParser parser = TSHttpParserCreate();
+  const char* start = fill_resp.data();
+  const char* end = start + fill_resp.size();
+  bool ok = false;
+
+  if (TSHttpHdrParseResp(parser, bufp, hdr_loc, &start, end) == TS_PARSE_DONE) {
+    TSHttpStatus status = TSHttpHdrStatusGet(bufp, hdr_loc);
+    std::string content_range = header_value(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_RANGE, TS_MIME_LEN_CONTENT_RANGE);
+    int64_t body_len = end - start;
+    int64_t first = -1, last = -1, total = -1;
+    SparseMeta fresh;
+
+    if (status == TS_HTTP_STATUS_PARTIAL_CONTENT) {
+      if (sscanf(content_range.c_str(), "bytes %" SCNd64 "-%" SCNd64 "/%" SCNd64, &first, &last, &total) != 3) {
+        total = -1;
+      }
+    } else if (status == TS_HTTP_STATUS_OK && cur_block == 0 && body_len <= config->block_size) {
+      // the whole object fits in the first block
+      first = 0;
+      last = body_len - 1;
+      total = body_len;
+    } else if (status == TS_HTTP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+      if (sscanf(content_range.c_str(), "bytes */%" SCNd64, &total) == 1 && total >= 0) {
+        first = cur_block * config->block_size;
+        last = first - 1; // no data, but we now know the length
+      } else {
+        total = -1;
+      }
+    }
+
+    if (total >= 0) {
+      fresh.total = total;
+      fresh.fetched = time(NULL);
+      fresh.etag = header_value(bufp, hdr_loc, TS_MIME_FIELD_ETAG, TS_MIME_LEN_ETAG);
+      fresh.last_modified = header_value(bufp, hdr_loc, TS_MIME_FIELD_LAST_MODIFIED, TS_MIME_LEN_LAST_MODIFIED);
+      fresh.content_type = header_value(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_TYPE, TS_MIME_LEN_CONTENT_TYPE);
+
+      // the object must not change under a response we already started
+      if (headers_sent && (fresh.total != meta.total || fresh.etag != meta.etag ||
+                           fresh.last_modified != meta.last_modified)) {
+        TSDebug(PLUGIN_NAME, "object changed during the response: %s", url.c_str());
+      } else {
+        meta = fresh;
+        meta_fresh = true;
+
+        CacheWriter* w = new CacheWriter(meta_key(), true);
+        std::string data = meta.serialize();
+        TSIOBufferWrite(w->buf, data.data(), data.size());
+        w->start();
+
+        if (last < first) {
+          ok = true; // nothing to serve, next_block() takes care of the response
+        } else if (first == cur_block * config->block_size && last - first + 1 == block_len(cur_block) &&
+                   body_len == last - first + 1) {
+          TSIOBufferWrite(block_buf, start, body_len);
+          TSStatIntIncrement(stat_fill_bytes, body_len);
+
+          if (meta.cacheable()) {
+            w = new CacheWriter(block_key(cur_block), false);
+            TSIOBufferWrite(w->buf, start, body_len);
+            w->start();
+          }
+
+          ok = true;
+        } else {
+          TSDebug(PLUGIN_NAME, "unexpected fill response, range %" PRId64 "-%" PRId64 "/%" PRId64 " body %" PRId64,
+                  first, last, total, body_len);
+        }
+      }
+    } else {
+      TSDebug(PLUGIN_NAME, "unusable fill response, status %d", status);
+    }
+  }
+
+  TSHttpParserDestroy(parser);
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+  TSMBufferDestroy(bufp);
+
+  return ok;
+}
+
+// Whether the fill response, complete or not, is a 200, that is the origin
+// ignored the range.
+bool
+SparseTxn::fill_ignored_range() const
+{
+  int status = 0;
+
+  return sscanf(fill_resp.c_str(), "HTTP/%*d.%*d %d", &status) == 1 && status == TS_HTTP_STATUS_OK;
+}
+
+// The origin ignored the range and sent the whole object. Before anything
+// went to the client, that is still a valid answer to its request, so we
+// hand it over as it is, and relay the rest of the fill.
+void
+SparseTxn::pass_through()
+{
+  TSDebug(PLUGIN_NAME, "origin ignored the range, passing the response through: %s", url.c_str());
+  state = STATE_PASS;
+  headers_sent = true;
+  TSIOBufferWrite(client_resp_buf, fill_resp.data(), fill_resp.size());
+  fill_resp.clear();
+  // the length is only known once the fill is done, see relay()
+  client_write_vio = TSVConnWrite(client_vc, contp, client_resp_reader, INT64_MAX);
+}
+
+void
+SparseTxn::relay(bool eos)
+{
+  int64_t avail = TSIOBufferReaderAvail(fill_resp_reader);
+
+  TSIOBufferCopy(client_resp_buf, fill_resp_reader, avail, 0);
+  TSIOBufferReaderConsume(fill_resp_reader, avail);
+
+  if (eos) {
+    state = STATE_DONE;
+    TSVIONBytesSet(client_write_vio, TSVIONDoneGet(client_write_vio) + TSIOBufferReaderAvail(client_resp_reader));
+    if (TSIOBufferReaderAvail(client_resp_reader) == 0) {
+      TSVConnShutdown(client_vc, 0, 1);
+      finish();
+      return;
+    }
+  } else if (TSIOBufferReaderAvail(client_resp_reader) <= CLIENT_BACKLOG_BLOCKS * config->block_size) {
+    TSVIOReenable(fill_read_vio);
+  }
+  TSVIOReenable(client_write_vio);
+}
+
+// The block is in block_buf, send the part of it the client asked for.
+void
+SparseTxn::deliver(int64_t block)
+{
+  if (!headers_sent) {
+    if (!range.resolve(meta.total, &first_byte, &last_byte)) {
+      send_error("416 Requested Range Not Satisfiable");
+      return;
+    }
+    last_block = last_byte / config->block_size;
+    if (block != first_byte / config->block_size) {
+      // a fill to learn the length, for a suffix range
+      drain_reader(block_reader, NULL);
+      cur_block = first_byte / config->block_size;
+      next_block();
+      return;
+    }
+
+    char buf[256];
+    std::string hdrs("HTTP/1.1 206 Partial Content\r\n");
+    int64_t length = last_byte - first_byte + 1;
+
+    snprintf(buf, sizeof(buf), "Content-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64 "\r\nContent-Length: %" PRId64 "\r\n",
+             first_byte, last_byte, meta.total, length);
+    hdrs.append(buf);
+    hdrs.append("Accept-Ranges: bytes\r\n");
+    if (!meta.content_type.empty()) {
+      hdrs.append("Content-Type: ").append(meta.content_type).append("\r\n");
+    }
+    if (!meta.etag.empty()) {
+      hdrs.append("ETag: ").append(meta.etag).append("\r\n");
+    }
+    if (!meta.last_modified.empty()) {
+      hdrs.append("Last-Modified: ").append(meta.last_modified).append("\r\n");
+    }
+    hdrs.append("\r\n");
+
+    TSIOBufferWrite(client_resp_buf, hdrs.data(), hdrs.size());
+    client_write_vio = TSVConnWrite(client_vc, contp, client_resp_reader, hdrs.size() + length);
+    headers_sent = true;
+  }
+
+  int64_t block_start = block * config->block_size;
+  int64_t from = first_byte > block_start ? first_byte - block_start : 0;
+  int64_t to = last_byte < block_start + block_len(block) - 1 ? last_byte - block_start : block_len(block) - 1;
+
+  TSIOBufferCopy(client_resp_buf, block_reader, to - from + 1, from);
+  drain_reader(block_reader, NULL);
+  TSVIOReenable(client_write_vio);
+
+  cur_block = block + 1;
+  next_block();
+}
+
+void
+SparseTxn::send_error(const char* status)
+{
+  char buf[256];
+
+  if (headers_sent) {
+    // too late, all we can do is cut the response short
+    TSVConnAbort(client_vc, 1);
+    client_vc = NULL;
+    finish();
+    return;
+  }
+  if (meta.valid()) {
+    snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Range: bytes */%" PRId64 "\r\nContent-Length: 0\r\n\r\n", status,
+             meta.total);
+  } else {
+    snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Length: 0\r\n\r\n", status);
+  }
+  TSIOBufferWrite(client_resp_buf, buf, strlen(buf));
+  client_write_vio = TSVConnWrite(client_vc, contp, client_resp_reader, strlen(buf));
+  headers_sent = true;
+  state = STATE_DONE;
+}
+
+void
+SparseTxn::finish()
+{
+  state = STATE_DONE;
+  delete this;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// The continuation handling everything for an intercepted request.
+static int
+cont_sparse(TSCont contp, TSEvent event, void* edata)
+{
+  SparseTxn* txn = static_cast<SparseTxn*>(TSContDataGet(contp));
+
+  switch (event) {
+  case TS_EVENT_NET_ACCEPT:
+    txn->client_vc = static_cast<TSVConn>(edata);
+    txn->client_read_vio = TSVConnRead(txn->client_vc, contp, txn->client_req_buf, INT64_MAX);
+    return 0;
+
+  case TS_EVENT_NET_ACCEPT_FAILED:
+    txn->finish();
+    return 0;
+
+  case TS_EVENT_CACHE_OPEN_READ:
+    txn->cache_action = NULL;
+    txn->cache_vc = static_cast<TSVConn>(edata);
+    txn->cache_vio = TSVConnRead(txn->cache_vc, contp, txn->block_buf, TSVConnCacheObjectSizeGet(txn->cache_vc));
+    return 0;
+
+  case TS_EVENT_CACHE_OPEN_READ_FAILED:
+    txn->cache_action = NULL;
+    if (txn->state == STATE_META) {
+      txn->next_block();
+    } else {
+      txn->fill_block();
+    }
+    return 0;
+
+  default:
+    break;
+  }
+
+  // Events on our VIOs
+  if (!edata) {
+    TSDebug(PLUGIN_NAME, "unexpected event %d", event);
+  } else if (edata == txn->client_read_vio) {
+    if (event == TS_EVENT_VCONN_READ_READY && txn->state == STATE_READ_REQUEST) {
+      drain_reader(txn->client_req_reader, &txn->client_req);
+      if (txn->client_req.find("\r\n\r\n") != std::string::npos) {
+        txn->read_meta();
+      } else if (txn->client_req.size() > MAX_HEADER_SIZE) {
+        txn->finish();
+      } else {
+        TSVIOReenable(txn->client_read_vio);
+      }
+    } else if (event != TS_EVENT_VCONN_READ_READY) {
+      TSDebug(PLUGIN_NAME, "client went away, event %d", event);
+      txn->finish();
+    }
+  } else if (edata == txn->client_write_vio) {
+    switch (event) {
+    case TS_EVENT_VCONN_WRITE_READY:
+      if (txn->state == STATE_WAIT_CLIENT) {
+        txn->next_block();
+      } else if (txn->state == STATE_PASS) {
+        TSVIOReenable(txn->fill_read_vio);
+      }
+      break;
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+      if (txn->state == STATE_DONE) {
+        TSVConnShutdown(txn->client_vc, 0, 1);
+        txn->finish();
+      }
+      break;
+    default:
+      TSDebug(PLUGIN_NAME, "client went away, event %d", event);
+      txn->finish();
+      break;
+    }
+  } else if (edata == txn->cache_vio) {
+    switch (event) {
+    case TS_EVENT_VCONN_READ_READY:
+      TSVIOReenable(txn->cache_vio);
+      break;
+    case TS_EVENT_VCONN_READ_COMPLETE:
+    case TS_EVENT_VCONN_EOS: {
+      int64_t got = TSIOBufferReaderAvail(txn->block_reader);
+
+      TSVConnClose(txn->cache_vc);
+      txn->cache_vc = NULL;
+      txn->cache_vio = NULL;
+      if (txn->state == STATE_META) {
+        std::string data;
+
+        drain_reader(txn->block_reader, &data);
+        if (txn->meta.parse(data)) {
+          txn->meta_fresh = txn->meta.fetched + txn->config->meta_ttl > time(NULL);
+        }
+        txn->next_block();
+      } else if (got == txn->block_len(txn->cur_block)) {
+        TSStatIntIncrement(stat_block_hits, 1);
+        txn->deliver(txn->cur_block);
+      } else {
+        drain_reader(txn->block_reader, NULL);
+        txn->fill_block();
+      }
+      break;
+    }
+    default:
+      TSVConnAbort(txn->cache_vc, 1);
+      txn->cache_vc = NULL;
+      txn->cache_vio = NULL;
+      drain_reader(txn->block_reader, NULL);
+      if (txn->state == STATE_META) {
+        txn->next_block();
+      } else {
+        txn->fill_block();
+      }
+      break;
+    }
+  } else if (edata == txn->fill_read_vio || edata == txn->fill_write_vio) {
+    switch (event) {
+    case TS_EVENT_VCONN_WRITE_READY:
+      TSVIOReenable(txn->fill_write_vio);
+      break;
+    case TS_EVENT_VCONN_WRITE_COMPLETE:
+      break;
+    case TS_EVENT_VCONN_READ_READY:
+      if (txn->state == STATE_PASS) {
+        txn->relay(false);
+        break;
+      }
+      drain_reader(txn->fill_resp_reader, &txn->fill_resp);
+      if (static_cast<int64_t>(txn->fill_resp.size()) <= txn->config->block_size + MAX_HEADER_SIZE) {
+        TSVIOReenable(txn->fill_read_vio);
+      } else if (!txn->headers_sent && txn->fill_ignored_range()) {
+        txn->pass_through();
+        txn->relay(false);
+      } else {
+        TSDebug(PLUGIN_NAME, "fill response too large, the origin does not honor ranges");
+        TSVConnAbort(txn->fill_vc, 1);
+        txn->fill_vc = NULL;
+        TSStatIntIncrement(stat_fill_errors, 1);
+        txn->send_error("502 Bad Gateway");
+      }
+      break;
+    case TS_EVENT_VCONN_READ_COMPLETE:
+    case TS_EVENT_VCONN_EOS:
+      if (txn->state != STATE_PASS) {
+        drain_reader(txn->fill_resp_reader, &txn->fill_resp);
+      }
+      TSVConnClose(txn->fill_vc);
+      txn->fill_vc = NULL;
+      txn->fill_read_vio = txn->fill_write_vio = NULL;
+      if (txn->state == STATE_PASS) {
+        txn->relay(true);
+      } else if (txn->fill_done()) {
+        if (TSIOBufferReaderAvail(txn->block_reader) > 0) {
+          txn->deliver(txn->cur_block);
+        } else {
+          txn->next_block();
+        }
+      } else if (!txn->headers_sent && txn->fill_ignored_range()) {
+        txn->pass_through();
+        txn->relay(true);
+      } else {
+        TSStatIntIncrement(stat_fill_errors, 1);
+        txn->send_error("502 Bad Gateway");
+      }
+      break;
+    default:
+      TSVConnAbort(txn->fill_vc, 1);
+      txn->fill_vc = NULL;
+      txn->fill_read_vio = txn->fill_write_vio = NULL;
+      TSStatIntIncrement(stat_fill_errors, 1);
+      txn->send_error("502 Bad Gateway");
+      break;
+    }
+  } else {
+    TSDebug(PLUGIN_NAME, "unexpected event %d", event);
+  }
+
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Build the request for the fills, a copy of the client request for the
+// pristine URL, without the conditional and range headers, marked so that
+// we can recognize it when it comes back to us.
+static bool
+build_fill_request(TSHttpTxn txnp, TSMBuffer req_bufp, TSMLoc req_loc, std::string* url, std::string* out)
+{
+  TSMBuffer bufp = TSMBufferCreate();
+  TSMLoc hdr_loc = TSHttpHdrCreate(bufp);
+  TSMBuffer purl_bufp;
+  TSMLoc purl_loc, url_loc;
+  bool ok = false;
+
+  if (TS_SUCCESS == TSHttpHdrCopy(bufp, hdr_loc, req_bufp, req_loc) &&
+      TS_SUCCESS == TSHttpTxnPristineUrlGet(txnp, &purl_bufp, &purl_loc)) {
+    if (TS_SUCCESS == TSUrlClone(bufp, purl_bufp, purl_loc, &url_loc)) {
+      int len;
+      char* s = TSUrlStringGet(bufp, url_loc, &len);
+
+      url->assign(s, len);
+      TSfree(s);
+      TSHttpHdrUrlSet(bufp, hdr_loc, url_loc);
+
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_IF_RANGE, TS_MIME_LEN_IF_RANGE);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_IF_MATCH, TS_MIME_LEN_IF_MATCH);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_IF_NONE_MATCH, TS_MIME_LEN_IF_NONE_MATCH);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_IF_MODIFIED_SINCE, TS_MIME_LEN_IF_MODIFIED_SINCE);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_IF_UNMODIFIED_SINCE, TS_MIME_LEN_IF_UNMODIFIED_SINCE);
+      // the blocks must be slices of the identity encoding
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
+      remove_header(bufp, hdr_loc, TS_MIME_FIELD_CONNECTION, TS_MIME_LEN_CONNECTION);
+      add_header(bufp, hdr_loc, TS_MIME_FIELD_CONNECTION, TS_MIME_LEN_CONNECTION, "close", 5);
+      add_header(bufp, hdr_loc, FILL_HEADER, sizeof(FILL_HEADER) - 1, "1", 1);
+
+      // print everything but the final CRLF, the Range: header goes there
+      TSIOBuffer buf = TSIOBufferCreate();
+      TSIOBufferReader reader = TSIOBufferReaderAlloc(buf);
+
+      TSHttpHdrPrint(bufp, hdr_loc, buf);
+      drain_reader(reader, out);
+      TSIOBufferReaderFree(reader);
+      TSIOBufferDestroy(buf);
+      if (out->size() >= 2 && out->compare(out->size() - 2, 2, "\r\n") == 0) {
+        ok = true;
+      }
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, url_loc);
+    }
+    TSHandleMLocRelease(purl_bufp, TS_NULL_MLOC, purl_loc);
+  }
+
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+  TSMBufferDestroy(bufp);
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Initialize the plugin as a remap plugin.
+//
+TSReturnCode
+TSRemapInit(TSRemapInterface *api_info, char *errbuf, int errbuf_size)
+{
+  if (!api_info) {
+    strncpy(errbuf, "[tsremap_init] - Invalid TSRemapInterface argument", errbuf_size - 1);
+    return TS_ERROR;
+  }
+
+  if (api_info->tsremap_version < TSREMAP_VERSION) {
+    snprintf(errbuf, errbuf_size - 1, "[TSRemapInit] - Incorrect API version %ld.%ld",
+             api_info->tsremap_version >> 16, (api_info->tsremap_version & 0xffff));
+    return TS_ERROR;
+  }
+
+  stat_block_hits = TSStatCreate("plugin.sparse_cache.block_hits", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT,
+                                 TS_STAT_SYNC_COUNT);
+  stat_block_misses = TSStatCreate("plugin.sparse_cache.block_misses", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT,
+                                   TS_STAT_SYNC_COUNT);
+  stat_fill_bytes = TSStatCreate("plugin.sparse_cache.fill_bytes", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT,
+                                 TS_STAT_SYNC_SUM);
+  stat_fill_errors = TSStatCreate("plugin.sparse_cache.fill_errors", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT,
+                                  TS_STAT_SYNC_COUNT);
+
+  TSDebug(PLUGIN_NAME, "sparse cache remap is successfully initialized");
+  return TS_SUCCESS;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// One configuration per remap rule, --block-size=<bytes> and
+// --meta-ttl=<seconds>.
+//
+TSReturnCode
+TSRemapNewInstance(int argc, char* argv[], void** ih, char* errbuf, int errbuf_size)
+{
+  static const struct option longopt[] = {
+    { const_cast<char*>("block-size"), required_argument, NULL, 'b' },
+    { const_cast<char*>("meta-ttl"), required_argument, NULL, 't' },
+    { NULL, no_argument, NULL, '\0' }
+  };
+  SparseConfig* config = new SparseConfig();
+
+  // argv contains the "to" and "from" URLs. Skip the first so that the
+  // second one poses as the program name.
+  --argc;
+  ++argv;
+  optind = 0;
+
+  for (;;) {
+    int opt = getopt_long(argc, argv, "", longopt, NULL);
+
+    if (opt == -1) {
+      break;
+    }
+    switch (opt) {
+    case 'b':
+      config->block_size = strtoll(optarg, NULL, 10);
+      break;
+    case 't':
+      config->meta_ttl = atoi(optarg);
+      break;
+    default:
+      snprintf(errbuf, errbuf_size - 1, "[%s] - unknown option", PLUGIN_NAME);
+      delete config;
+      return TS_ERROR;
+    }
+  }
+
+  if (config->block_size < MIN_BLOCK_SIZE) {
+    snprintf(errbuf, errbuf_size - 1, "[%s] - block size must be at least %" PRId64, PLUGIN_NAME, MIN_BLOCK_SIZE);
+    delete config;
+    return TS_ERROR;
+  }
+
+  TSDebug(PLUGIN_NAME, "block size %" PRId64 ", metadata ttl %d", config->block_size, config->meta_ttl);
+  *ih = config;
+  return TS_SUCCESS;
+}
+
+void
+TSRemapDeleteInstance(void* ih)
+{
+  delete static_cast<SparseConfig*>(ih);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+// Intercept GET requests with a single Range:, and let our own fills
+// through to the origin, uncached.
+//
+TSRemapStatus
+TSRemapDoRemap(void* ih, TSHttpTxn txnp, TSRemapRequestInfo* /* rri */)
+{
+  SparseConfig* config = static_cast<SparseConfig*>(ih);
+  TSMBuffer bufp;
+  TSMLoc hdr_loc;
+
+  if (!config || TS_SUCCESS != TSHttpTxnClientReqGet(txnp, &bufp, &hdr_loc)) {
+    return TSREMAP_NO_REMAP;
+  }
+
+  TSMLoc fill = TSMimeHdrFieldFind(bufp, hdr_loc, FILL_HEADER, sizeof(FILL_HEADER) - 1);
+
+  if (fill) {
+    TSHandleMLocRelease(bufp, hdr_loc, fill);
+    remove_header(bufp, hdr_loc, FILL_HEADER, sizeof(FILL_HEADER) - 1);
+    if (TS_SUCCESS == TSHttpIsInternalRequest(txnp)) {
+      TSHttpTxnConfigIntSet(txnp, TS_CONFIG_HTTP_CACHE_HTTP, 0);
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+      return TSREMAP_NO_REMAP;
+    }
+  }
+
+  int method_len;
+  const char* method = TSHttpHdrMethodGet(bufp, hdr_loc, &method_len);
+  TSMLoc range_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_RANGE, TS_MIME_LEN_RANGE);
+  TSMLoc if_range = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_IF_RANGE, TS_MIME_LEN_IF_RANGE);
+  TSMLoc dup = range_loc ? TSMimeHdrFieldNextDup(bufp, hdr_loc, range_loc) : TS_NULL_MLOC;
+  ByteRange range;
+
+  if (range_loc && !dup && !if_range && method == TS_HTTP_METHOD_GET &&
+      TSMimeHdrFieldValuesCount(bufp, hdr_loc, range_loc) == 1) {
+    int len;
+    const char* value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, range_loc, -1, &len);
+    std::string url, req;
+
+    if (value && range.parse(value, len) && build_fill_request(txnp, bufp, hdr_loc, &url, &req)) {
+      SparseTxn* txn = new SparseTxn(config, url, req, range);
+      struct sockaddr const* ip = TSHttpTxnClientAddrGet(txnp);
+
+      if (ip && ip->sa_family == AF_INET6) {
+        memcpy(&txn->client_addr, ip, sizeof(sockaddr_in6));
+      } else if (ip) {
+        memcpy(&txn->client_addr, ip, sizeof(sockaddr_in));
+      }
+      TSDebug(PLUGIN_NAME, "intercepting range request for %s", url.c_str());
+      TSHttpTxnIntercept(txn->contp, txnp);
+    }
+  }
+
+  if (dup) {
+    TSHandleMLocRelease(bufp, hdr_loc, dup);
+  }
+  if (if_range) {
+    TSHandleMLocRelease(bufp, hdr_loc, if_range);
+  }
+  if (range_loc) {
+    TSHandleMLocRelease(bufp, hdr_loc, range_loc);
+  }
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+
+  return TSREMAP_NO_REMAP;
+}
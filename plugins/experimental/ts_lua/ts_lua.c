@@ -25,36 +25,49 @@
 
 #define TS_LUA_MAX_STATE_COUNT                  512
 
-static uint64_t ts_lua_http_next_id = 0;
-static uint64_t ts_lua_g_http_next_id = 0;
+static ts_lua_main_ctx_set *volatile ts_lua_main_set;
+static ts_lua_main_ctx_set *volatile ts_lua_g_main_set;
 
-static ts_lua_main_ctx *ts_lua_main_ctx_array;
-static ts_lua_main_ctx *ts_lua_g_main_ctx_array;
+static ts_lua_instance_conf *ts_lua_g_conf;
+static int ts_lua_g_argc;
+static char **ts_lua_g_argv;
+static TSCont ts_lua_g_contp;
+
+static const struct
+{
+  const char *func;
+  TSHttpHookID hook;
+} ts_lua_g_hooks[] = {
+  {TS_LUA_FUNCTION_G_SEND_REQUEST, TS_HTTP_SEND_REQUEST_HDR_HOOK},
+  {TS_LUA_FUNCTION_G_READ_RESPONSE, TS_HTTP_READ_RESPONSE_HDR_HOOK},
+  {TS_LUA_FUNCTION_G_SEND_RESPONSE, TS_HTTP_SEND_RESPONSE_HDR_HOOK},
+  {TS_LUA_FUNCTION_G_CACHE_LOOKUP_COMPLETE, TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK},
+  {TS_LUA_FUNCTION_G_READ_REQUEST, TS_HTTP_READ_REQUEST_HDR_HOOK},
+  {TS_LUA_FUNCTION_G_TXN_START, TS_HTTP_TXN_START_HOOK},
+  {TS_LUA_FUNCTION_G_PRE_REMAP, TS_HTTP_PRE_REMAP_HOOK},
+  {TS_LUA_FUNCTION_G_POST_REMAP, TS_HTTP_POST_REMAP_HOOK},
+  {TS_LUA_FUNCTION_G_SELECT_ALT, TS_HTTP_SELECT_ALT_HOOK},
+  {TS_LUA_FUNCTION_G_OS_DNS, TS_HTTP_OS_DNS_HOOK},
+  {TS_LUA_FUNCTION_G_READ_CACHE, TS_HTTP_READ_CACHE_HDR_HOOK},
+  {TS_LUA_FUNCTION_G_TXN_CLOSE, TS_HTTP_TXN_CLOSE_HOOK},
+};
 
 
 TSReturnCode
 TSRemapInit(TSRemapInterface * api_info, char *errbuf, int errbuf_size)
 {
-  int ret;
-
   if (!api_info || api_info->size < sizeof(TSRemapInterface)) {
     strncpy(errbuf, "[TSRemapInit] - Incorrect size of TSRemapInterface structure", errbuf_size - 1);
     return TS_ERROR;
   }
 
-  if (ts_lua_main_ctx_array != NULL)
+  if (ts_lua_main_set != NULL)
     return TS_SUCCESS;
 
-  ts_lua_main_ctx_array = TSmalloc(sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
-  memset(ts_lua_main_ctx_array, 0, sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
+  ts_lua_main_set = ts_lua_create_main_ctx_set(TS_LUA_MAX_STATE_COUNT, "plugin.ts_lua.remap.state");
 
-  ret = ts_lua_create_vm(ts_lua_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
-
-  if (ret) {
-    ts_lua_destroy_vm(ts_lua_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
-    TSfree(ts_lua_main_ctx_array);
+  if (ts_lua_main_set == NULL)
     return TS_ERROR;
-  }
 
   return TS_SUCCESS;
 }
@@ -95,7 +108,7 @@ TSRemapNewInstance(int argc, char *argv[], void **ih, char *errbuf, int errbuf_s
 
   ts_lua_init_instance(conf);
 
-  ret = ts_lua_add_module(conf, ts_lua_main_ctx_array, TS_LUA_MAX_STATE_COUNT, argc - 2, &argv[2]);
+  ret = ts_lua_add_module(conf, ts_lua_main_set->ctx_array, ts_lua_main_set->n, argc - 2, &argv[2]);
 
   if (ret != 0) {
     strncpy(errbuf, "[TSRemapNewInstance] ts_lua_add_module failed", errbuf_size - 1);
@@ -110,7 +123,7 @@ TSRemapNewInstance(int argc, char *argv[], void **ih, char *errbuf, int errbuf_s
 void
 TSRemapDeleteInstance(void *ih)
 {
-  ts_lua_del_module((ts_lua_instance_conf *) ih, ts_lua_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
+  ts_lua_del_module((ts_lua_instance_conf *) ih, ts_lua_main_set->ctx_array, ts_lua_main_set->n);
   ts_lua_del_instance(ih);
   TSfree(ih);
   return;
@@ -120,7 +133,6 @@ TSRemapStatus
 TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo * rri)
 {
   int ret;
-  uint64_t req_id;
 
   TSCont contp;
   lua_State *l;
@@ -131,10 +143,8 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo * rri)
   ts_lua_instance_conf *instance_conf;
 
   instance_conf = (ts_lua_instance_conf *) ih;
-  req_id = __sync_fetch_and_add(&ts_lua_http_next_id, 1);
-
 
-  main_ctx = &ts_lua_main_ctx_array[req_id % TS_LUA_MAX_STATE_COUNT];
+  main_ctx = ts_lua_get_thread_main_ctx(ts_lua_acquire_main_ctx_set(&ts_lua_main_set));
 
   TSMutexLock(main_ctx->mutexp);
 
@@ -155,6 +165,9 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo * rri)
 
   lua_getglobal(l, TS_LUA_FUNCTION_REMAP);
   if (lua_type(l, -1) != LUA_TFUNCTION) {
+    lua_pop(l, 1);
+    ts_lua_destroy_http_ctx(http_ctx);
+    TSContDestroy(contp);
     TSMutexUnlock(main_ctx->mutexp);
     return TSREMAP_NO_REMAP;
   }
@@ -175,13 +188,14 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo * rri)
     TSContDestroy(contp);
   }
 
+  ts_lua_update_main_ctx_stats(main_ctx);
   TSMutexUnlock(main_ctx->mutexp);
 
   return ret;
 }
 
 static int
-globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
+globalHookHandler(TSCont contp ATS_UNUSED, TSEvent event ATS_UNUSED, void *edata)
 {
   TSHttpTxn txnp = (TSHttpTxn) edata;
 
@@ -190,7 +204,6 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   TSMLoc url_loc;
 
   int ret;
-  uint64_t req_id;
   TSCont txn_contp;
 
   lua_State *l;
@@ -198,16 +211,12 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   ts_lua_main_ctx *main_ctx;
   ts_lua_http_ctx *http_ctx;
 
-  ts_lua_instance_conf *conf = (ts_lua_instance_conf *) TSContDataGet(contp);
-
-  req_id = __sync_fetch_and_add(&ts_lua_g_http_next_id, 1);
+  main_ctx = ts_lua_get_thread_main_ctx(ts_lua_acquire_main_ctx_set(&ts_lua_g_main_set));
 
-  main_ctx = &ts_lua_g_main_ctx_array[req_id % TS_LUA_MAX_STATE_COUNT];
-
-  TSDebug(TS_LUA_DEBUG_TAG, "[%s] req_id: %" PRId64, __FUNCTION__, req_id);
+  TSDebug(TS_LUA_DEBUG_TAG, "[%s] state: %d", __FUNCTION__, main_ctx->index);
   TSMutexLock(main_ctx->mutexp);
 
-  http_ctx = ts_lua_create_http_ctx(main_ctx, conf);
+  http_ctx = ts_lua_create_http_ctx(main_ctx, ts_lua_g_conf);
   http_ctx->txnp = txnp;
   http_ctx->remap = 0;
   http_ctx->has_hook = 0;
@@ -224,6 +233,8 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   }
 
   if (!http_ctx->client_request_hdrp) {
+    ts_lua_destroy_http_ctx(http_ctx);
+    TSMutexUnlock(main_ctx->mutexp);
     TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     return 0;
   }
@@ -284,14 +295,17 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
     break;
 
   default:
-    TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
-    return 0;
+    lua_pushnil(l);
     break;
   }
 
+  /* a reloaded script may no longer define the function of a hook */
   if (lua_type(l, -1) != LUA_TFUNCTION) {
-    TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     lua_pop(l, 1);
+    ts_lua_destroy_http_ctx(http_ctx);
+    TSContDestroy(txn_contp);
+    TSMutexUnlock(main_ctx->mutexp);
+    TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
     return 0;
   }
 
@@ -312,6 +326,7 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
     TSContDestroy(txn_contp);
   }
 
+  ts_lua_update_main_ctx_stats(main_ctx);
   TSMutexUnlock(main_ctx->mutexp);
 
   if(ret) {
@@ -323,145 +338,131 @@ globalHookHandler(TSCont contp, TSEvent event ATS_UNUSED, void *edata)
   return 0;
 }
 
-void
-TSPluginInit(int argc, const char *argv[])
+static ts_lua_main_ctx_set *
+ts_lua_load_global_set()
 {
-  int ret = 0;
-  ts_lua_g_main_ctx_array = TSmalloc(sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
-  memset(ts_lua_g_main_ctx_array, 0, sizeof(ts_lua_main_ctx) * TS_LUA_MAX_STATE_COUNT);
+  ts_lua_main_ctx_set *set;
 
-  ret = ts_lua_create_vm(ts_lua_g_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
+  set = ts_lua_create_main_ctx_set(TS_LUA_MAX_STATE_COUNT, "plugin.ts_lua.global.state");
 
-  if (ret) {
-    ts_lua_destroy_vm(ts_lua_g_main_ctx_array, TS_LUA_MAX_STATE_COUNT);
-    TSfree(ts_lua_g_main_ctx_array);
-    return;
+  if (set == NULL) {
+    TSError("[%s] could not create the lua states", __FUNCTION__);
+    return NULL;
   }
 
-  if (argc < 2) {
-    TSError("[%s] lua script file required !!", __FUNCTION__);
-    return;
+  if (ts_lua_add_module(ts_lua_g_conf, set->ctx_array, set->n, ts_lua_g_argc, ts_lua_g_argv) != 0) {
+    TSError("[%s] ts_lua_add_module failed", __FUNCTION__);
+    ts_lua_release_main_ctx_set(set);
+    return NULL;
   }
 
-  if (strlen(argv[1]) >= TS_LUA_MAX_SCRIPT_FNAME_LENGTH - 16) {
-    TSError("[%s] lua script file name too long !!", __FUNCTION__);
-    return;
-  }
+  set->conf = ts_lua_g_conf;
+  return set;
+}
 
-  ts_lua_instance_conf *conf = TSmalloc(sizeof(ts_lua_instance_conf));
-  if (!conf) {
-    TSError("[%s] TSmalloc failed !!", __FUNCTION__);
-    return;
-  }
-  memset(conf, 0, sizeof(ts_lua_instance_conf));
+static void
+ts_lua_add_global_hooks(ts_lua_main_ctx_set * set)
+{
+  static unsigned int added = 0;
+  unsigned int i;
+  lua_State *l;
 
-  sprintf(conf->script, "%s", argv[1]);
+  ts_lua_main_ctx *main_ctx;
+  ts_lua_http_ctx *http_ctx;
 
-  ts_lua_init_instance(conf);
+  //adding hook based on whether the lua global function exists.
+  main_ctx = &set->ctx_array[0];
+  __sync_fetch_and_add(&set->refcount, 1);
 
-  ret = ts_lua_add_module(conf, ts_lua_g_main_ctx_array, TS_LUA_MAX_STATE_COUNT, argc - 1, (char **) &argv[1]);
+  TSMutexLock(main_ctx->mutexp);
 
-  if (ret != 0) {
-    TSError("[%s] ts_lua_add_module failed", __FUNCTION__);
-    return;
-  }
+  http_ctx = ts_lua_create_http_ctx(main_ctx, ts_lua_g_conf);
+  l = http_ctx->lua;
 
-  TSCont global_contp = TSContCreate(globalHookHandler, NULL);
-  if (!global_contp) {
-    TSError("[%s] could not create transaction start continuation", __FUNCTION__);
-    return;
+  for (i = 0; i < sizeof(ts_lua_g_hooks) / sizeof(ts_lua_g_hooks[0]); i++) {
+    lua_getglobal(l, ts_lua_g_hooks[i].func);
+    if (lua_type(l, -1) == LUA_TFUNCTION && !(added & (1 << i))) {
+      TSHttpHookAdd(ts_lua_g_hooks[i].hook, ts_lua_g_contp);
+      TSDebug(TS_LUA_DEBUG_TAG, "%s hook added", ts_lua_g_hooks[i].func);
+      added |= 1 << i;
+    }
+    lua_pop(l, 1);
   }
-  TSContDataSet(global_contp, conf);
 
-  //adding hook based on whether the lua global function exists.
-  ts_lua_main_ctx *main_ctx = &ts_lua_g_main_ctx_array[0];
-  ts_lua_http_ctx *http_ctx = ts_lua_create_http_ctx(main_ctx, conf);
-  lua_State *l = http_ctx->lua;
-
-  lua_getglobal(l, TS_LUA_FUNCTION_G_SEND_REQUEST);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_SEND_REQUEST_HDR_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "send_request_hdr_hook added");
-  }
-  lua_pop(l, 1);
+  ts_lua_destroy_http_ctx(http_ctx);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_READ_RESPONSE);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_READ_RESPONSE_HDR_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "read_response_hdr_hook added");
-  }
-  lua_pop(l, 1);
+  TSMutexUnlock(main_ctx->mutexp);
+}
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_SEND_RESPONSE);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_SEND_RESPONSE_HDR_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "send_response_hdr_hook added");
-  }
-  lua_pop(l, 1);
+static int
+configHandler(TSCont contp ATS_UNUSED, TSEvent event ATS_UNUSED, void *edata ATS_UNUSED)
+{
+  ts_lua_main_ctx_set *set, *old;
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_CACHE_LOOKUP_COMPLETE);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "cache_lookup_complete_hook added");
-  }
-  lua_pop(l, 1);
+  TSDebug(TS_LUA_DEBUG_TAG, "[%s] reloading %s", __FUNCTION__, ts_lua_g_conf->script);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_READ_REQUEST);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "read_request_hdr_hook added");
-  }
-  lua_pop(l, 1);
+  set = ts_lua_load_global_set();
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_TXN_START);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_TXN_START_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "txn_start_hook added");
+  if (set == NULL) {
+    TSError("[%s] could not reload %s, keeping the script loaded before", __FUNCTION__, ts_lua_g_conf->script);
+    return 0;
   }
-  lua_pop(l, 1);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_PRE_REMAP);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_PRE_REMAP_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "pre_remap_hook added");
+  /* the transactions under way keep the states they started with */
+  old = ts_lua_replace_main_ctx_set(&ts_lua_g_main_set, set);
+  ts_lua_add_global_hooks(set);
+  ts_lua_release_main_ctx_set(old);
+
+  return 0;
+}
+
+void
+TSPluginInit(int argc, const char *argv[])
+{
+  int i;
+
+  if (argc < 2) {
+    TSError("[%s] lua script file required !!", __FUNCTION__);
+    return;
   }
-  lua_pop(l, 1);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_POST_REMAP);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_POST_REMAP_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "post_remap_hook added");
+  if (strlen(argv[1]) >= TS_LUA_MAX_SCRIPT_FNAME_LENGTH - 16) {
+    TSError("[%s] lua script file name too long !!", __FUNCTION__);
+    return;
   }
-  lua_pop(l, 1);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_SELECT_ALT);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_SELECT_ALT_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "select_alt_hook added");
+  ts_lua_instance_conf *conf = TSmalloc(sizeof(ts_lua_instance_conf));
+  if (!conf) {
+    TSError("[%s] TSmalloc failed !!", __FUNCTION__);
+    return;
   }
-  lua_pop(l, 1);
+  memset(conf, 0, sizeof(ts_lua_instance_conf));
+
+  sprintf(conf->script, "%s", argv[1]);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_OS_DNS);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_OS_DNS_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "os_dns_hook added");
+  ts_lua_init_instance(conf);
+
+  /* kept to load the script again on reload */
+  ts_lua_g_conf = conf;
+  ts_lua_g_argc = argc - 1;
+  ts_lua_g_argv = TSmalloc(sizeof(char *) * ts_lua_g_argc);
+  for (i = 0; i < ts_lua_g_argc; i++) {
+    ts_lua_g_argv[i] = TSstrdup(argv[i + 1]);
   }
-  lua_pop(l, 1);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_READ_CACHE);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_READ_CACHE_HDR_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "read_cache_hdr_hook added");
+  ts_lua_g_main_set = ts_lua_load_global_set();
+
+  if (ts_lua_g_main_set == NULL) {
+    return;
   }
-  lua_pop(l, 1);
 
-  lua_getglobal(l, TS_LUA_FUNCTION_G_TXN_CLOSE);
-  if (lua_type(l, -1) == LUA_TFUNCTION) {
-    TSHttpHookAdd(TS_HTTP_TXN_CLOSE_HOOK, global_contp);
-    TSDebug(TS_LUA_DEBUG_TAG, "txn_close_hook added");
+  ts_lua_g_contp = TSContCreate(globalHookHandler, NULL);
+  if (!ts_lua_g_contp) {
+    TSError("[%s] could not create transaction start continuation", __FUNCTION__);
+    return;
   }
-  lua_pop(l, 1);
 
-  ts_lua_destroy_http_ctx(http_ctx);
+  ts_lua_add_global_hooks(ts_lua_g_main_set);
 
+  TSMgmtUpdateRegister(TSContCreate(configHandler, TSMutexCreate()), TS_LUA_DEBUG_TAG);
 }
@@ -95,14 +95,29 @@ typedef struct
 } ts_lua_instance_conf;
 
 
+struct ts_lua_main_ctx_set;
+
 /* global lua state struct */
 typedef struct
 {
   lua_State *lua;
   TSMutex mutexp;
   int gref;
+  int index;
+  volatile int gc_stat;         // stat of the memory of the state, -1 until a thread uses it
+  struct ts_lua_main_ctx_set *set;
 } ts_lua_main_ctx;
 
+/* the lua states of the remap or of the global plugin */
+typedef struct ts_lua_main_ctx_set
+{
+  ts_lua_main_ctx *ctx_array;
+  int n;
+  volatile int refcount;        // held by each http and intercept ctx, and while the set is in use
+  const char *stat_prefix;
+  ts_lua_instance_conf *conf;   // of the global plugin, to clean the module up
+} ts_lua_main_ctx_set;
+
 /* lua state for http request */
 typedef struct
 {
@@ -17,6 +17,8 @@
 */
 
 
+#include <pthread.h>
+
 #include "ts_lua_util.h"
 #include "ts_lua_remap.h"
 #include "ts_lua_client_request.h"
@@ -37,6 +39,14 @@ static lua_State *ts_lua_new_state();
 static void ts_lua_init_registry(lua_State * L);
 static void ts_lua_init_globals(lua_State * L);
 static void ts_lua_inject_ts_api(lua_State * L);
+static int ts_lua_destroy_main_ctx_set_handler(TSCont contp, TSEvent event, void *edata);
+
+/* each thread runs the scripts in the state of its slot, see ts_lua_get_thread_main_ctx */
+static int ts_lua_next_thread_slot = 0;
+static __thread int ts_lua_thread_slot = -1;
+
+/* held while a set is taken from, or put into, the pointer which publishes it */
+static pthread_mutex_t ts_lua_set_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 int
@@ -78,6 +88,157 @@ ts_lua_destroy_vm(ts_lua_main_ctx * arr, int n)
   return;
 }
 
+ts_lua_main_ctx_set *
+ts_lua_create_main_ctx_set(int n, const char *stat_prefix)
+{
+  int i;
+  ts_lua_main_ctx_set *set;
+
+  set = TSmalloc(sizeof(ts_lua_main_ctx_set));
+  memset(set, 0, sizeof(ts_lua_main_ctx_set));
+
+  set->ctx_array = TSmalloc(sizeof(ts_lua_main_ctx) * n);
+  memset(set->ctx_array, 0, sizeof(ts_lua_main_ctx) * n);
+
+  set->n = n;
+  set->refcount = 1;
+  set->stat_prefix = stat_prefix;
+
+  for (i = 0; i < n; i++) {
+    set->ctx_array[i].index = i;
+    set->ctx_array[i].gc_stat = -1;
+    set->ctx_array[i].set = set;
+  }
+
+  if (ts_lua_create_vm(set->ctx_array, n)) {
+    ts_lua_destroy_vm(set->ctx_array, n);
+    TSfree(set->ctx_array);
+    TSfree(set);
+    return NULL;
+  }
+
+  return set;
+}
+
+ts_lua_main_ctx_set *
+ts_lua_acquire_main_ctx_set(ts_lua_main_ctx_set * volatile *setp)
+{
+  ts_lua_main_ctx_set *set;
+
+  /* *setp holds a reference until it is replaced, which can't happen
+     between reading it and taking ours */
+  pthread_mutex_lock(&ts_lua_set_mutex);
+  set = *setp;
+  __sync_fetch_and_add(&set->refcount, 1);
+  pthread_mutex_unlock(&ts_lua_set_mutex);
+
+  return set;
+}
+
+ts_lua_main_ctx_set *
+ts_lua_replace_main_ctx_set(ts_lua_main_ctx_set * volatile *setp, ts_lua_main_ctx_set * set)
+{
+  ts_lua_main_ctx_set *old;
+
+  pthread_mutex_lock(&ts_lua_set_mutex);
+  old = *setp;
+  *setp = set;
+  pthread_mutex_unlock(&ts_lua_set_mutex);
+
+  return old;
+}
+
+void
+ts_lua_release_main_ctx_set(ts_lua_main_ctx_set * set)
+{
+  TSCont contp;
+
+  if (__sync_sub_and_fetch(&set->refcount, 1) > 0)
+    return;
+
+  /* nothing can acquire the set any more, but the caller may still hold
+     the lock of one of its states: destroy it from another thread */
+  contp = TSContCreate(ts_lua_destroy_main_ctx_set_handler, TSMutexCreate());
+  TSContDataSet(contp, set);
+  TSContSchedule(contp, 0, TS_THREAD_POOL_TASK);
+}
+
+static int
+ts_lua_destroy_main_ctx_set_handler(TSCont contp, TSEvent event ATS_UNUSED, void *edata ATS_UNUSED)
+{
+  int i;
+  ts_lua_main_ctx_set *set;
+
+  set = (ts_lua_main_ctx_set *) TSContDataGet(contp);
+
+  TSDebug(TS_LUA_DEBUG_TAG, "[%s] destroying the %s states", __FUNCTION__, set->stat_prefix);
+
+  /* wait for the last user of each state to unlock it */
+  for (i = 0; i < set->n; i++) {
+    TSMutexLock(set->ctx_array[i].mutexp);
+    TSMutexUnlock(set->ctx_array[i].mutexp);
+  }
+
+  if (set->conf)
+    ts_lua_del_module(set->conf, set->ctx_array, set->n);
+
+  ts_lua_destroy_vm(set->ctx_array, set->n);
+  TSfree(set->ctx_array);
+  TSfree(set);
+
+  TSContDestroy(contp);
+  return 0;
+}
+
+ts_lua_main_ctx *
+ts_lua_get_thread_main_ctx(ts_lua_main_ctx_set * set)
+{
+  int slot;
+
+  /* an event thread uses the state of its index, so that event threads do
+     not share a state unless there are more of them than states */
+  slot = TSEventThreadIndexGet();
+
+  if (slot < 0) {
+    /* other threads are given slots in turn */
+    if (ts_lua_thread_slot < 0)
+      ts_lua_thread_slot = __sync_fetch_and_add(&ts_lua_next_thread_slot, 1);
+    slot = ts_lua_thread_slot;
+  }
+
+  return &set->ctx_array[slot % set->n];
+}
+
+void
+ts_lua_update_main_ctx_stats(ts_lua_main_ctx * main_ctx)
+{
+  int id;
+  char name[128];
+  lua_State *L;
+
+  /* only the states which are used get a stat, the plugin stats are few */
+  id = main_ctx->gc_stat;
+
+  if (id == -1 && __sync_bool_compare_and_swap(&main_ctx->gc_stat, -1, -2)) {
+    snprintf(name, sizeof(name), "%s.%d.gc_bytes", main_ctx->set->stat_prefix, main_ctx->index);
+
+    if (TSStatFindName(name, &id) == TS_ERROR)
+      id = TSStatCreate(name, TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+
+    if (id < 0) {
+      TSError("[%s] could not create stat %s", __FUNCTION__, name);
+      id = -3;
+    }
+
+    main_ctx->gc_stat = id;
+  }
+
+  if (id >= 0) {
+    L = main_ctx->lua;
+    TSStatIntSet(id, (TSMgmtInt) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0));
+  }
+}
+
 lua_State *
 ts_lua_new_state()
 {
@@ -418,6 +579,8 @@ ts_lua_destroy_http_ctx(ts_lua_http_ctx * http_ctx)
 
   luaL_unref(main_ctx->lua, LUA_REGISTRYINDEX, http_ctx->ref);
   TSfree(http_ctx);
+
+  ts_lua_release_main_ctx_set(main_ctx->set);
 }
 
 void
@@ -465,6 +628,9 @@ ts_lua_create_http_intercept_ctx(ts_lua_http_ctx * http_ctx)
   ictx->mctx = http_ctx->mctx;
   ictx->hctx = http_ctx;
 
+  /* the intercept may outlive the transaction */
+  __sync_fetch_and_add(&ictx->mctx->set->refcount, 1);
+
   ts_lua_set_http_intercept_ctx(ictx->lua, ictx);
 
   return ictx;
@@ -499,6 +665,8 @@ ts_lua_destroy_http_intercept_ctx(ts_lua_http_intercept_ctx * ictx)
 
   luaL_unref(main_ctx->lua, LUA_REGISTRYINDEX, ictx->ref);
   TSfree(ictx);
+
+  ts_lua_release_main_ctx_set(main_ctx->set);
   return;
 }
 
@@ -702,6 +870,7 @@ ts_lua_http_cont_handler(TSCont contp, TSEvent event, void *edata)
     break;
   }
 
+  ts_lua_update_main_ctx_stats(main_ctx);
   TSMutexUnlock(main_ctx->mutexp);
 
   if (ret) {
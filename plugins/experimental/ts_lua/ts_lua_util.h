@@ -25,6 +25,14 @@
 int ts_lua_create_vm(ts_lua_main_ctx * arr, int n);
 void ts_lua_destroy_vm(ts_lua_main_ctx * arr, int n);
 
+ts_lua_main_ctx_set *ts_lua_create_main_ctx_set(int n, const char *stat_prefix);
+ts_lua_main_ctx_set *ts_lua_acquire_main_ctx_set(ts_lua_main_ctx_set * volatile *setp);
+ts_lua_main_ctx_set *ts_lua_replace_main_ctx_set(ts_lua_main_ctx_set * volatile *setp, ts_lua_main_ctx_set * set);
+void ts_lua_release_main_ctx_set(ts_lua_main_ctx_set * set);
+
+ts_lua_main_ctx *ts_lua_get_thread_main_ctx(ts_lua_main_ctx_set * set);
+void ts_lua_update_main_ctx_stats(ts_lua_main_ctx * main_ctx);
+
 int ts_lua_add_module(ts_lua_instance_conf * conf, ts_lua_main_ctx * arr, int n, int argc, char *argv[]);
 
 int ts_lua_del_module(ts_lua_instance_conf * conf, ts_lua_main_ctx * arr, int n);
@@ -38,6 +46,7 @@ ts_lua_instance_conf *ts_lua_get_instance_conf(lua_State * L);
 void ts_lua_set_http_ctx(lua_State * L, ts_lua_http_ctx * ctx);
 ts_lua_http_ctx *ts_lua_get_http_ctx(lua_State * L);
 
+/* the http ctx takes over a reference to the set of mctx, released by ts_lua_destroy_http_ctx */
 ts_lua_http_ctx *ts_lua_create_http_ctx(ts_lua_main_ctx * mctx, ts_lua_instance_conf * conf);
 void ts_lua_destroy_http_ctx(ts_lua_http_ctx * http_ctx);
 
@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <vector>
 #include <fnmatch.h>
+#include <stdlib.h>
 
 namespace Gzip {
   using namespace std;
@@ -84,6 +85,9 @@ namespace Gzip {
     kParseEnable,
     kParseCache,
     kParseDisallow,
+    kParseBrotli,
+    kParseCompressionLevel,
+    kParseCacheCompressionLevel,
   };
 
   void Configuration::AddHostConfiguration(HostConfiguration * hc){
@@ -221,6 +225,12 @@ namespace Gzip {
             state = kParseCache;
           } else if (token == "disallow" ) {
             state = kParseDisallow;
+          } else if (token == "brotli" ) {
+            state = kParseBrotli;
+          } else if (token == "compression-level" ) {
+            state = kParseCompressionLevel;
+          } else if (token == "cache-compression-level" ) {
+            state = kParseCacheCompressionLevel;
           }
           else {
             warning("failed to interpret \"%s\" at line %zu", token.c_str(), lineno);
@@ -246,6 +256,23 @@ namespace Gzip {
           current_host_configuration->add_disallow(token);
           state = kParseStart;
           break;
+        case kParseBrotli:
+          current_host_configuration->set_brotli(token == "true");
+          state = kParseStart;
+          break;
+        case kParseCompressionLevel:
+        case kParseCacheCompressionLevel: {
+          int level = atoi(token.c_str());
+          if (level < 1 || level > 9) {
+            warning("compression level \"%s\" at line %zu is not between 1 and 9, skip", token.c_str(), lineno);
+          } else if (state == kParseCompressionLevel) {
+            current_host_configuration->set_compression_level(level);
+          } else {
+            current_host_configuration->set_cache_compression_level(level);
+          }
+          state = kParseStart;
+          break;
+        }
         }
       }
     }
@@ -37,6 +37,9 @@ namespace Gzip  {
       , enabled_(true)
       , cache_(true)
       , remove_accept_encoding_(false)
+      , brotli_(false)
+      , compression_level_(6)
+      , cache_compression_level_(9)
     {}
 
     inline bool enabled() { return enabled_; }
@@ -45,6 +48,12 @@ namespace Gzip  {
     inline void set_cache(bool x) { cache_ = x; } 
     inline bool remove_accept_encoding() { return remove_accept_encoding_; }
     inline void set_remove_accept_encoding(bool x) { remove_accept_encoding_ = x; } 
+    inline bool brotli() { return brotli_; }
+    inline void set_brotli(bool x) { brotli_ = x; }
+    inline int compression_level() { return compression_level_; }
+    inline void set_compression_level(int x) { compression_level_ = x; }
+    inline int cache_compression_level() { return cache_compression_level_; }
+    inline void set_cache_compression_level(int x) { cache_compression_level_ = x; }
     inline std::string host() { return host_; }
     void add_disallow(const std::string & disallow);
     void add_compressible_content_type(const std::string & content_type);
@@ -56,6 +65,9 @@ namespace Gzip  {
     bool enabled_;
     bool cache_;
     bool remove_accept_encoding_;
+    bool brotli_;
+    int compression_level_;
+    int cache_compression_level_; //for the responses compressed once and cached
     std::vector<std::string> compressible_content_types_;
     std::vector<std::string> disallows_;
     DISALLOW_COPY_AND_ASSIGN(HostConfiguration);
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <zlib.h>
 #include <ts/ts.h>
+#include <ts/experimental.h>
 #include "debug_macros.h"
 #include "misc.h"
 #include "configuration.h"
@@ -46,56 +47,168 @@ using namespace Gzip;
 // 0-9 based scale that GZIP does where '1' is 'Best speed' 
 // and '9' is 'Best compression'. Testing has proved level '6' 
 // to be about the best level to use in an HTTP Server. 
-
-const int ZLIB_COMPRESSION_LEVEL = 6;
+// The level is configurable per host (compression-level), and responses
+// which are cached compressed are compressed once, so they use their own,
+// higher level (cache-compression-level).
 
 int arg_idx_hooked;
 int arg_idx_host_configuration;
 int arg_idx_url_disallowed;
+int arg_idx_variant_miss;
 
 
 const char * global_hidden_header_name;
 Configuration* config = NULL;
 const char *dictionary = NULL;
 
+// plugin.gzip.* stats
+static int stat_compressed;
+static int stat_compress_usec;
+static int stat_bytes_in;
+static int stat_bytes_out;
+static int stat_stream_reuses;
+static int stat_variant_hits;
+static int stat_cpu_saved_usec;
+
+// Identity hits turned into misses to store a compressed variant, by object
+// and compression type. While one is in flight, or for a while after it
+// started, further hits are compressed on the fly instead, so a popular
+// object is refetched once rather than by every hit until the variant is
+// written. Colliding objects share a slot, which only costs a refetch.
+static const int VARIANT_SLOTS = 4096;
+static const TSHRTime VARIANT_WINDOW = 60 * TS_HRTIME_SECOND;
+
+struct VariantSlot
+{
+  uint32_t key;
+  bool in_flight;
+  TSHRTime started;
+};
+
+static VariantSlot variant_slots[VARIANT_SLOTS];
+static TSMutex variant_mutex;
+
+// deflateInit2 allocates about 400KB of state with our window and memlevel,
+// which costs more than compressing a small object. Ended streams are kept in
+// a per thread pool instead, and reset for the next transaction.
+static const int STREAM_POOL_SIZE = 16;
+
+struct StreamPool
+{
+  z_stream *streams[STREAM_POOL_SIZE];
+  int levels[STREAM_POOL_SIZE];
+  int count;
+};
+
+// one pool per window, deflate and gzip
+static __thread StreamPool stream_pools[2];
+
+static StreamPool *
+stream_pool(int compression_type)
+{
+  return &stream_pools[compression_type == COMPRESSION_TYPE_GZIP ? 1 : 0];
+}
+
+static z_stream *
+gzip_stream_get(int compression_type, int level)
+{
+  StreamPool *pool = stream_pool(compression_type);
+  z_stream *zstrm;
+  int err;
+
+  if (pool->count > 0) {
+    --pool->count;
+    zstrm = pool->streams[pool->count];
+    // streams are reset when they are pooled
+    if (pool->levels[pool->count] != level) {
+      err = deflateParams(zstrm, level, Z_DEFAULT_STRATEGY);
+      if (err != Z_OK) {
+        fatal("gzip-transform: ERROR: deflateParams (%d)!", err);
+      }
+    }
+    TSStatIntIncrement(stat_stream_reuses, 1);
+  } else {
+    zstrm = (z_stream *) TSmalloc(sizeof(z_stream));
+    zstrm->next_in = Z_NULL;
+    zstrm->avail_in = 0;
+    zstrm->total_in = 0;
+    zstrm->next_out = Z_NULL;
+    zstrm->avail_out = 0;
+    zstrm->total_out = 0;
+    zstrm->zalloc = gzip_alloc;
+    zstrm->zfree = gzip_free;
+    zstrm->opaque = (voidpf) 0;
+    zstrm->data_type = Z_ASCII;
+
+    int window_bits = (compression_type == COMPRESSION_TYPE_GZIP) ? WINDOW_BITS_GZIP : WINDOW_BITS_DEFLATE;
+
+    err = deflateInit2(zstrm, level, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
+
+    if (err != Z_OK) {
+      fatal("gzip-transform: ERROR: deflateInit (%d)!", err);
+    }
+  }
+
+  // deflateReset drops the dictionary, so it is set again for reused streams too
+  if (dictionary) {
+    err = deflateSetDictionary(zstrm, (const Bytef *) dictionary, strlen(dictionary));
+    if (err != Z_OK) {
+      fatal("gzip-transform: ERROR: deflateSetDictionary (%d)!", err);
+    }
+  }
+
+  return zstrm;
+}
+
+static void
+gzip_stream_release(z_stream * zstrm, int compression_type, int level)
+{
+  StreamPool *pool = stream_pool(compression_type);
+
+  //deflateReset/deflateEnd returnvalue ignore is intentional
+  //it would spew log on every client abort
+  if (pool->count < STREAM_POOL_SIZE && deflateReset(zstrm) == Z_OK) {
+    pool->streams[pool->count] = zstrm;
+    pool->levels[pool->count] = level;
+    ++pool->count;
+  } else {
+    deflateEnd(zstrm);
+    TSfree(zstrm);
+  }
+}
+
 static GzipData *
-gzip_data_alloc(int compression_type)
+gzip_data_alloc(int compression_type, int compression_level)
 {
   GzipData *data;
-  int err;
 
   data = (GzipData *) TSmalloc(sizeof(GzipData));
   data->downstream_vio = NULL;
   data->downstream_buffer = NULL;
   data->downstream_reader = NULL;
   data->downstream_length = 0;
+  data->total_in = 0;
+  data->compress_time = 0;
   data->state = transform_state_initialized;
   data->compression_type = compression_type;
-  data->zstrm.next_in = Z_NULL;
-  data->zstrm.avail_in = 0;
-  data->zstrm.total_in = 0;
-  data->zstrm.next_out = Z_NULL;
-  data->zstrm.avail_out = 0;
-  data->zstrm.total_out = 0;
-  data->zstrm.zalloc = gzip_alloc;
-  data->zstrm.zfree = gzip_free;
-  data->zstrm.opaque = (voidpf) 0;
-  data->zstrm.data_type = Z_ASCII;
-
-  int window_bits = (compression_type == COMPRESSION_TYPE_GZIP) ? WINDOW_BITS_GZIP : WINDOW_BITS_DEFLATE;
-
-  err = deflateInit2(&data->zstrm, ZLIB_COMPRESSION_LEVEL, Z_DEFLATED, window_bits, ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY);
-
-  if (err != Z_OK) {
-    fatal("gzip-transform: ERROR: deflateInit (%d)!", err);
-  }
-
-  if (dictionary) {
-    err = deflateSetDictionary(&data->zstrm, (const Bytef *) dictionary, strlen(dictionary));
-    if (err != Z_OK) {
-      fatal("gzip-transform: ERROR: deflateSetDictionary (%d)!", err);
+  data->compression_level = compression_level;
+  data->zstrm = NULL;
+
+#if TS_HAS_BROTLI
+  data->bstrm = NULL;
+  if (compression_type == COMPRESSION_TYPE_BROTLI) {
+    data->bstrm = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!data->bstrm) {
+      fatal("gzip-transform: ERROR: BrotliEncoderCreateInstance failed!");
     }
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_QUALITY, compression_level);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_LGWIN, BROTLI_LGWIN);
+    BrotliEncoderSetParameter(data->bstrm, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+    return data;
   }
+#endif
+
+  data->zstrm = gzip_stream_get(compression_type, compression_level);
 
   return data;
 }
@@ -106,9 +219,21 @@ gzip_data_destroy(GzipData * data)
 {
   TSReleaseAssert(data);
 
-  //deflateEnd returnvalue ignore is intentional
-  //it would spew log on every client abort
-  deflateEnd(&data->zstrm);
+  if (data->state == transform_state_finished) {
+    TSStatIntIncrement(stat_compressed, 1);
+    TSStatIntIncrement(stat_compress_usec, data->compress_time / 1000);
+    TSStatIntIncrement(stat_bytes_in, data->total_in);
+    TSStatIntIncrement(stat_bytes_out, data->downstream_length);
+  }
+
+  if (data->zstrm) {
+    gzip_stream_release(data->zstrm, data->compression_type, data->compression_level);
+  }
+#if TS_HAS_BROTLI
+  if (data->bstrm) {
+    BrotliEncoderDestroyInstance(data->bstrm);
+  }
+#endif
 
   if (data->downstream_buffer) {
     TSIOBufferDestroy(data->downstream_buffer);
@@ -130,6 +255,8 @@ gzip_content_encoding_header(TSMBuffer bufp, TSMLoc hdr_loc, const int compressi
       ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "deflate", sizeof("deflate") - 1);
     } else if (compression_type == COMPRESSION_TYPE_GZIP) {
       ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "gzip", sizeof("gzip") - 1);
+    } else if (compression_type == COMPRESSION_TYPE_BROTLI) {
+      ret = TSMimeHdrFieldValueStringInsert(bufp, hdr_loc, ce_loc, -1, "br", sizeof("br") - 1);
     }
     if (ret == TS_SUCCESS) {
       ret = TSMimeHdrFieldAppend(bufp, hdr_loc, ce_loc);
@@ -251,105 +378,140 @@ gzip_transform_init(TSCont contp, GzipData * data)
 
 
 
+//compress len bytes of in to the downstream buffer, and flush the
+//remaining output of the stream if finish is set
 static void
-gzip_transform_one(GzipData * data, TSIOBufferReader upstream_reader, int amount)
+gzip_compress(GzipData * data, const char *in, int64_t len, bool finish)
 {
   TSIOBufferBlock downstream_blkp;
-  const char *upstream_buffer;
   char *downstream_buffer;
-  int64_t upstream_length, downstream_length;
-  int err;
+  int64_t downstream_length;
+  TSHRTime start = TShrtime();
 
-  while (amount > 0) {
-    downstream_blkp = TSIOBufferReaderStart(upstream_reader);
-    if (!downstream_blkp) {
-      error("couldn't get from IOBufferBlock");
-      return;
-    }
+  data->total_in += len;
 
-    upstream_buffer = TSIOBufferBlockReadStart(downstream_blkp, upstream_reader, &upstream_length);
-    if (!upstream_buffer) {
-      error("couldn't get from TSIOBufferBlockReadStart");
-      return;
-    }
+#if TS_HAS_BROTLI
+  if (data->bstrm) {
+    const uint8_t *next_in = (const uint8_t *) in;
+    size_t avail_in = len;
+    BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
 
-    if (upstream_length > amount) {
-      upstream_length = amount;
-    }
-
-    data->zstrm.next_in = (unsigned char *) upstream_buffer;
-    data->zstrm.avail_in = upstream_length;
-
-    while (data->zstrm.avail_in > 0) {
+    for (;;) {
       downstream_blkp = TSIOBufferStart(data->downstream_buffer);
       downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
 
-      data->zstrm.next_out = (unsigned char *) downstream_buffer;
-      data->zstrm.avail_out = downstream_length;
+      uint8_t *next_out = (uint8_t *) downstream_buffer;
+      size_t avail_out = downstream_length;
 
-      err = deflate(&data->zstrm, Z_NO_FLUSH);
-
-      if (err != Z_OK)
-        warning("deflate() call failed: %d", err);
+      if (!BrotliEncoderCompressStream(data->bstrm, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) {
+        error("BrotliEncoderCompressStream() call failed");
+        break;
+      }
 
-      if (downstream_length > data->zstrm.avail_out) {
-        TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
-        data->downstream_length += (downstream_length - data->zstrm.avail_out);
+      if (downstream_length > (int64_t) avail_out) {
+        TSIOBufferProduce(data->downstream_buffer, downstream_length - avail_out);
+        data->downstream_length += (downstream_length - avail_out);
       }
 
-      if (data->zstrm.avail_out > 0) {
-        if (data->zstrm.avail_in != 0) {
-          error("gzip-transform: ERROR: avail_in is (%d): should be 0", data->zstrm.avail_in);
-        }
+      if (finish ? BrotliEncoderIsFinished(data->bstrm)
+          : (avail_in == 0 && !BrotliEncoderHasMoreOutput(data->bstrm))) {
+        break;
       }
     }
 
-    TSIOBufferReaderConsume(upstream_reader, upstream_length);
-    amount -= upstream_length;
+    data->compress_time += TShrtime() - start;
+    return;
   }
-}
+#endif
 
-static void
-gzip_transform_finish(GzipData * data)
-{
-  if (data->state == transform_state_output) {
-    TSIOBufferBlock downstream_blkp;
-    char *downstream_buffer;
-    int64_t downstream_length;
-    int err;
+  z_stream *zstrm = data->zstrm;
+  int err;
 
-    data->state = transform_state_finished;
+  zstrm->next_in = (unsigned char *) in;
+  zstrm->avail_in = len;
 
-    for (;;) {
-      downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+  while (finish || zstrm->avail_in > 0) {
+    downstream_blkp = TSIOBufferStart(data->downstream_buffer);
+    downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
 
-      downstream_buffer = TSIOBufferBlockWriteStart(downstream_blkp, &downstream_length);
-      data->zstrm.next_out = (unsigned char *) downstream_buffer;
-      data->zstrm.avail_out = downstream_length;
+    zstrm->next_out = (unsigned char *) downstream_buffer;
+    zstrm->avail_out = downstream_length;
 
-      err = deflate(&data->zstrm, Z_FINISH);
+    err = deflate(zstrm, finish ? Z_FINISH : Z_NO_FLUSH);
 
-      if (downstream_length > (int64_t) data->zstrm.avail_out) {
-        TSIOBufferProduce(data->downstream_buffer, downstream_length - data->zstrm.avail_out);
-        data->downstream_length += (downstream_length - data->zstrm.avail_out);
-      }
+    if (downstream_length > (int64_t) zstrm->avail_out) {
+      TSIOBufferProduce(data->downstream_buffer, downstream_length - zstrm->avail_out);
+      data->downstream_length += (downstream_length - zstrm->avail_out);
+    }
 
+    if (finish) {
       if (err == Z_OK) {        /* some more data to encode */
         continue;
       }
-
       if (err != Z_STREAM_END) {
         warning("deflate should report Z_STREAM_END");
       }
       break;
     }
 
-    if (data->downstream_length != (int64_t) (data->zstrm.total_out)) {
+    if (err != Z_OK)
+      warning("deflate() call failed: %d", err);
+
+    if (zstrm->avail_out > 0) {
+      if (zstrm->avail_in != 0) {
+        error("gzip-transform: ERROR: avail_in is (%d): should be 0", zstrm->avail_in);
+      }
+    }
+  }
+
+  data->compress_time += TShrtime() - start;
+}
+
+static void
+gzip_transform_one(GzipData * data, TSIOBufferReader upstream_reader, int amount)
+{
+  TSIOBufferBlock upstream_blkp;
+  const char *upstream_buffer;
+  int64_t upstream_length;
+
+  while (amount > 0) {
+    upstream_blkp = TSIOBufferReaderStart(upstream_reader);
+    if (!upstream_blkp) {
+      error("couldn't get from IOBufferBlock");
+      return;
+    }
+
+    upstream_buffer = TSIOBufferBlockReadStart(upstream_blkp, upstream_reader, &upstream_length);
+    if (!upstream_buffer) {
+      error("couldn't get from TSIOBufferBlockReadStart");
+      return;
+    }
+
+    if (upstream_length > amount) {
+      upstream_length = amount;
+    }
+
+    gzip_compress(data, upstream_buffer, upstream_length, false);
+
+    TSIOBufferReaderConsume(upstream_reader, upstream_length);
+    amount -= upstream_length;
+  }
+}
+
+static void
+gzip_transform_finish(GzipData * data)
+{
+  if (data->state == transform_state_output) {
+    data->state = transform_state_finished;
+
+    gzip_compress(data, NULL, 0, true);
+
+    if (data->zstrm && data->downstream_length != (int64_t) (data->zstrm->total_out)) {
       error("gzip-transform: ERROR: output lengths don't match (%d, %ld)", data->downstream_length,
-            data->zstrm.total_out);
+            data->zstrm->total_out);
     }
 
-    gzip_log_ratio(data->zstrm.total_in, data->downstream_length);
+    gzip_log_ratio(data->total_in, data->downstream_length);
   }
 }
 
@@ -513,6 +675,13 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configur
         compression_acceptable = 1;
         *compress_type = COMPRESSION_TYPE_GZIP;
         break;
+#if TS_HAS_BROTLI
+      } else if (host_configuration->brotli() && len == (int) sizeof("br") - 1 &&
+                 strncasecmp(value, "br", sizeof("br") - 1) == 0) {
+        compression_acceptable = 1;
+        *compress_type = COMPRESSION_TYPE_BROTLI;
+        break;
+#endif
       }
     }
 
@@ -568,7 +737,7 @@ gzip_transformable(TSHttpTxn txnp, int server, HostConfiguration * host_configur
 
 
 static void
-gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguration * hc, int compress_type)
+gzip_transform_add(TSHttpTxn txnp, int server, HostConfiguration * hc, int compress_type)
 {
   int *tmp = (int *) TSHttpTxnArgGet(txnp, arg_idx_hooked);
   if (tmp) {
@@ -580,9 +749,12 @@ gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguratio
     info("adding compression transform");
   }
 
-  TSHttpTxnUntransformedRespCache(txnp, 1);
+  //a response refetched to store its compressed variant leaves the
+  //identity alternate in the cache as it is
+  TSHttpTxnUntransformedRespCache(txnp, TSHttpTxnArgGet(txnp, arg_idx_variant_miss) ? 0 : 1);
 
-  if (!hc->cache()) {
+  //hits are compressed on the fly, only origin responses are stored compressed
+  if (!server || !hc->cache()) {
     TSHttpTxnTransformedRespCache(txnp, 0);
   } else { 
     TSHttpTxnTransformedRespCache(txnp, 1);
@@ -591,8 +763,11 @@ gzip_transform_add(TSHttpTxn txnp, int /* server ATS_UNUSED */, HostConfiguratio
   TSVConn connp;
   GzipData *data;
 
+  //cached responses are compressed once, and served many times
+  int level = hc->cache() ? hc->cache_compression_level() : hc->compression_level();
+
   connp = TSTransformCreate(gzip_transform, txnp);
-  data = gzip_data_alloc(compress_type);
+  data = gzip_data_alloc(compress_type, level);
   data->txn = txnp;
 
   TSContDataSet(connp, data);
@@ -636,10 +811,207 @@ find_host_configuration(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer bufp, TSMLoc
 
   return config->GlobalConfiguration();
 }
+//the compression type of the Content-Encoding of a response, 0 if it has
+//none, or -1 if it is encoded with something we don't produce
+static int
+content_encoding_type(TSMBuffer bufp, TSMLoc hdr_loc)
+{
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_ENCODING, TS_MIME_LEN_CONTENT_ENCODING);
+  int type = 0;
+
+  if (field_loc) {
+    int len;
+    const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, -1, &len);
+
+    type = -1;
+    if (len == (int) sizeof("gzip") - 1 && strncasecmp(value, "gzip", len) == 0) {
+      type = COMPRESSION_TYPE_GZIP;
+    } else if (len == (int) sizeof("deflate") - 1 && strncasecmp(value, "deflate", len) == 0) {
+      type = COMPRESSION_TYPE_DEFLATE;
+    } else if (len == (int) sizeof("br") - 1 && strncasecmp(value, "br", len) == 0) {
+      type = COMPRESSION_TYPE_BROTLI;
+    }
+    TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+  }
+
+  return type;
+}
+
+//the compression type the (normalized) Accept-Encoding of a request asks for, or 0
+static int
+accept_encoding_type(TSMBuffer bufp, TSMLoc hdr_loc)
+{
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
+  int type = 0;
+
+  if (field_loc) {
+    int len;
+    const char *value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, 0, &len);
+
+    if (len == (int) sizeof("gzip") - 1 && strncasecmp(value, "gzip", len) == 0) {
+      type = COMPRESSION_TYPE_GZIP;
+    } else if (len == (int) sizeof("deflate") - 1 && strncasecmp(value, "deflate", len) == 0) {
+      type = COMPRESSION_TYPE_DEFLATE;
+    } else if (len == (int) sizeof("br") - 1 && strncasecmp(value, "br", len) == 0) {
+      type = COMPRESSION_TYPE_BROTLI;
+    }
+    TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+  }
+
+  return type;
+}
+
+//the variant slot key of the object a transaction looks up, never 0
+static uint32_t
+variant_key(TSHttpTxn txnp, int compress_type)
+{
+  int url_len;
+  char *url = TSHttpTxnEffectiveUrlStringGet(txnp, &url_len);
+  uint32_t key = 2166136261U ^ (uint32_t) compress_type;
+
+  //fnv-1a
+  for (int i = 0; i < url_len; ++i) {
+    key = (key ^ (unsigned char) url[i]) * 16777619U;
+  }
+  TSfree(url);
+
+  return key ? key : 1;
+}
+
+//claims the conversion of an object into a compressed variant, unless
+//one is in flight or started within the window
+static bool
+variant_convert_begin(uint32_t key)
+{
+  VariantSlot *slot = &variant_slots[key % VARIANT_SLOTS];
+  TSHRTime now = TShrtime();
+  bool claimed = false;
+
+  TSMutexLock(variant_mutex);
+  if (slot->key != key || (!slot->in_flight && now - slot->started >= VARIANT_WINDOW)) {
+    slot->key = key;
+    slot->in_flight = true;
+    slot->started = now;
+    claimed = true;
+  }
+  TSMutexUnlock(variant_mutex);
+
+  return claimed;
+}
+
+static void
+variant_convert_end(uint32_t key)
+{
+  VariantSlot *slot = &variant_slots[key % VARIANT_SLOTS];
+
+  TSMutexLock(variant_mutex);
+  if (slot->key == key) {
+    slot->in_flight = false;
+  }
+  TSMutexUnlock(variant_mutex);
+}
+
+//a fresh hit on the identity alternate of a response which is cached
+//compressed is turned into a miss, so that the response is compressed once
+//and stored as a variant, rather than compressed again on every hit. only
+//one hit per object and window is converted, see variant_convert_begin.
+//returns 1 if the hit should be compressed on the fly.
+static int
+cache_variant_hit(TSCont contp, TSHttpTxn txnp, HostConfiguration * hc, int *compress_type)
+{
+  TSMBuffer bufp;
+  TSMLoc hdr_loc;
+  int encoding;
+
+  if (TSHttpTxnCachedRespGet(txnp, &bufp, &hdr_loc) != TS_SUCCESS) {
+    return 0;
+  }
+  encoding = content_encoding_type(bufp, hdr_loc);
+
+  if (encoding > 0) {
+    //served from a stored variant, estimate what compressing it would have cost
+    TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, TS_MIME_FIELD_CONTENT_LENGTH, TS_MIME_LEN_CONTENT_LENGTH);
+    TSMgmtInt bytes_out = TSStatIntGet(stat_bytes_out);
+
+    TSStatIntIncrement(stat_variant_hits, 1);
+    if (field_loc) {
+      int64_t length = TSMimeHdrFieldValueInt64Get(bufp, hdr_loc, field_loc, -1);
+      if (bytes_out > 0 && length > 0) {
+        TSStatIntIncrement(stat_cpu_saved_usec, length * TSStatIntGet(stat_compress_usec) / bytes_out);
+      }
+      TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+    }
+    info("compressed variant hit");
+  }
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+
+  if (encoding != 0 || !gzip_transformable(txnp, 0, hc, compress_type)) {
+    return 0;
+  }
+
+  if (!hc->cache()) {
+    return 1;
+  }
+
+  uint32_t key = variant_key(txnp, *compress_type);
+
+  if (!variant_convert_begin(key)) {
+    info("compressed variant is being fetched, compressing the hit");
+    return 1;
+  }
+  if (TSHttpTxnCacheLookupStatusSet(txnp, TS_CACHE_LOOKUP_MISS) != TS_SUCCESS) {
+    variant_convert_end(key);
+    return 1;
+  }
+
+  //the key is released when the transaction closes
+  TSHttpTxnArgSet(txnp, arg_idx_variant_miss, (void *) (uintptr_t) key);
+  TSHttpTxnHookAdd(txnp, TS_HTTP_TXN_CLOSE_HOOK, contp);
+  info("no compressed variant cached, fetching it");
+  return 0;
+}
+
+//prefer the alternate encoded the way the client asks for, so the identity
+//alternate isn't picked over a stored compressed variant
+static int
+select_alternate(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
+{
+  TSHttpAltInfo infop = (TSHttpAltInfo) edata;
+  TSMBuffer bufp;
+  TSMLoc hdr_loc;
+  int accept, encoding;
+
+  TSReleaseAssert(event == TS_EVENT_HTTP_SELECT_ALT);
+
+  if (TSHttpAltInfoClientReqGet(infop, &bufp, &hdr_loc) != TS_SUCCESS) {
+    return 0;
+  }
+  HostConfiguration * hc = find_host_configuration(NULL, bufp, hdr_loc);
+  accept = accept_encoding_type(bufp, hdr_loc);
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+
+  if (!hc->enabled() || !hc->cache() || !accept) {
+    return 0;
+  }
+
+  if (TSHttpAltInfoCachedRespGet(infop, &bufp, &hdr_loc) != TS_SUCCESS) {
+    return 0;
+  }
+  encoding = content_encoding_type(bufp, hdr_loc);
+  TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+
+  if (encoding == 0) {
+    TSHttpAltInfoQualitySet(infop, 0.5);
+  } else if (encoding != accept) {
+    TSHttpAltInfoQualitySet(infop, 0.0);
+  }
+
+  return 0;
+}
 
 
 static int
-transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
+transform_plugin(TSCont contp, TSEvent event, void *edata)
 {
   TSHttpTxn txnp = (TSHttpTxn) edata;
   int compress_type = COMPRESSION_TYPE_DEFLATE;
@@ -661,7 +1033,7 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
             TSHttpTxnArgSet(txnp, arg_idx_url_disallowed, (void *) &GZIP_ONE);
             info("url [%.*s] not allowed", url_len, url);
           } else {
-            normalize_accept_encoding(txnp, req_buf, req_loc);	
+            normalize_accept_encoding(txnp, req_buf, req_loc, TS_HAS_BROTLI && hc->brotli());	
           }
           TSfree(url);
           TSHandleMLocRelease(req_buf, TS_NULL_MLOC, req_loc);
@@ -716,7 +1088,7 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
         int allowed = !TSHttpTxnArgGet(txnp, arg_idx_url_disallowed);
         HostConfiguration * hc = (HostConfiguration*)TSHttpTxnArgGet(txnp, arg_idx_host_configuration);
         if ( hc != NULL ) { 
-          if (allowed && cache_transformable(txnp) && gzip_transformable(txnp, 0, hc, &compress_type)) {
+          if (allowed && cache_transformable(txnp) && cache_variant_hit(contp, txnp, hc, &compress_type)) {
             gzip_transform_add(txnp, 0, hc, compress_type);
           }
         }
@@ -724,6 +1096,16 @@ transform_plugin(TSCont /* contp ATS_UNUSED */, TSEvent event, void *edata)
       }
       break;
 
+    case TS_EVENT_HTTP_TXN_CLOSE:
+      {
+        uint32_t key = (uint32_t) (uintptr_t) TSHttpTxnArgGet(txnp, arg_idx_variant_miss);
+        if (key) {
+          variant_convert_end(key);
+        }
+        TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
+      }
+      break;
+
     default:
       fatal("gzip transform unknown event");
   }
@@ -783,8 +1165,20 @@ TSPluginInit(int argc, const char *argv[])
   if (TSHttpArgIndexReserve("gzip", "for storing if compression is disallowed for this txn", &arg_idx_url_disallowed) != TS_SUCCESS) {
     fatal("failed to reserve an argument index");
   }
+  if (TSHttpArgIndexReserve("gzip", "for storing the object key if a hit was turned into a miss to cache a variant", &arg_idx_variant_miss) != TS_SUCCESS) {
+    fatal("failed to reserve an argument index");
+  }
+
+  stat_compressed = TSStatCreate("plugin.gzip.compressed", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_compress_usec = TSStatCreate("plugin.gzip.compress_usec", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_bytes_in = TSStatCreate("plugin.gzip.bytes_in", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_bytes_out = TSStatCreate("plugin.gzip.bytes_out", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_stream_reuses = TSStatCreate("plugin.gzip.stream_reuses", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_variant_hits = TSStatCreate("plugin.gzip.variant_hits", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  stat_cpu_saved_usec = TSStatCreate("plugin.gzip.cpu_saved_usec", TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
 
   global_hidden_header_name = init_hidden_header_name();
+  variant_mutex = TSMutexCreate();
 
   TSCont management_contp = TSContCreate(management_update, NULL);
   //fixme: never freed. there is no shutdown event?
@@ -799,6 +1193,7 @@ TSPluginInit(int argc, const char *argv[])
   TSHttpHookAdd(TS_HTTP_READ_RESPONSE_HDR_HOOK, transform_contp);
   TSHttpHookAdd(TS_HTTP_SEND_REQUEST_HDR_HOOK, transform_contp);
   TSHttpHookAdd(TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK, transform_contp);
+  TSHttpHookAdd(TS_HTTP_SELECT_ALT_HOOK, TSContCreate(select_alternate, NULL));
 
   info("loaded");
 }
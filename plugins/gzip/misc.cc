@@ -42,18 +42,19 @@ gzip_free(voidpf /* opaque ATS_UNUSED */, voidpf address)
 }
 
 void
-normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc)
+normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLoc hdr_loc, bool brotli)
 {
   TSMLoc field = TSMimeHdrFieldFind(reqp, hdr_loc, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
   int deflate = 0;
   int gzip = 0;
+  int br = 0;
 
   //remove the accept encoding field(s), 
-  //while finding out if gzip or deflate is supported.    
+  //while finding out if brotli, gzip or deflate is supported.    
   while (field) {
     TSMLoc tmp;
 
-    if (!deflate && !gzip) {
+    if (!deflate && !gzip && !br) {
       int value_count = TSMimeHdrFieldValuesCount(reqp, hdr_loc, field);
 
       while (value_count > 0) {
@@ -67,6 +68,8 @@ normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLo
           gzip = !strncmp(val, "gzip", val_len);
         else if (val_len == (int) strlen("deflate"))
           deflate = !strncmp(val, "deflate", val_len);
+        else if (val_len == (int) strlen("br") && brotli)
+          br = !strncmp(val, "br", val_len);
       }
     }
 
@@ -77,11 +80,14 @@ normalize_accept_encoding(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer reqp, TSMLo
   }
 
   //append a new accept-encoding field in the header
-  if (deflate || gzip) {
+  if (deflate || gzip || br) {
     TSMimeHdrFieldCreate(reqp, hdr_loc, &field);
     TSMimeHdrFieldNameSet(reqp, hdr_loc, field, TS_MIME_FIELD_ACCEPT_ENCODING, TS_MIME_LEN_ACCEPT_ENCODING);
 
-    if (gzip) {
+    if (br) {
+      TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "br", strlen("br"));
+      info("normalized accept encoding to br");
+    } else if (gzip) {
       TSMimeHdrFieldValueStringInsert(reqp, hdr_loc, field, -1, "gzip", strlen("gzip"));
       info("normalized accept encoding to gzip");
     } else if (deflate) {
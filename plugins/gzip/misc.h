@@ -24,8 +24,12 @@
 #ifndef _GZIP_MISC_H_
 #define _GZIP_MISC_H_
 
+#include "ink_config.h"
 #include <zlib.h>
 #include <ts/ts.h>
+#if TS_HAS_BROTLI
+#include <brotli/encode.h>
+#endif
 #include <stdlib.h>             //exit()
 #include <stdio.h>
 
@@ -37,6 +41,8 @@ static const int WINDOW_BITS_GZIP = 31;
 //misc
 static const int COMPRESSION_TYPE_DEFLATE = 1;
 static const int COMPRESSION_TYPE_GZIP = 2;
+static const int COMPRESSION_TYPE_BROTLI = 4;
+static const int BROTLI_LGWIN = 22;
 //this one is just for txnargset/get to point to
 static const int GZIP_ONE = 1;
 static const int DICT_PATH_MAX = 512;
@@ -61,15 +67,21 @@ typedef struct
   TSIOBuffer downstream_buffer;
   TSIOBufferReader downstream_reader;
   int downstream_length;
-  z_stream zstrm;
+  z_stream *zstrm;              //taken from the stream pool, NULL for brotli
+#if TS_HAS_BROTLI
+  BrotliEncoderState *bstrm;
+#endif
+  int64_t total_in;
+  TSHRTime compress_time;
   enum transform_state state;
   int compression_type;
+  int compression_level;
 } GzipData;
 
 
 voidpf gzip_alloc(voidpf opaque, uInt items, uInt size);
 void gzip_free(voidpf opaque, voidpf address);
-void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc);
+void normalize_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, bool brotli);
 void hide_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char * hidden_header_name);
 void restore_accept_encoding(TSHttpTxn txnp, TSMBuffer reqp, TSMLoc hdr_loc, const char * hidden_header_name);
 const char * init_hidden_header_name();
@@ -59,6 +59,7 @@ Condition::initialize(Parser& p)
 {
   Statement::initialize(p);
 
+  _name = p.get_op();
   if (p.mod_exist("OR")) {
     if (p.mod_exist("AND")) {
       TSError("%s: Can't have both AND and OR in mods", PLUGIN_NAME);
@@ -85,6 +85,14 @@ public:
     return _mods & COND_LAST;
   }
 
+  // Conditions which evaluate to the same thing for every request return true, and
+  // what they evaluate to in value (without the NOT modifier). Used by RuleProgram.
+  virtual bool constant(bool* /* value ATS_UNUSED */) const { return false; }
+
+  // Conditions whose eval() is exactly the test of the matcher against append_value()
+  // return true, which lets RuleProgram scan for their regular expressions together.
+  virtual bool tests_value() const { return false; }
+
   // Setters
   virtual void set_qualifier(const std::string& q) { _qualifier = q; }
 
@@ -92,6 +100,7 @@ public:
   const Matcher* get_matcher() const { return _matcher; }
   const MatcherOps get_cond_op() const { return _cond_op; }
   const std::string get_qualifier() const { return _qualifier; }
+  const std::string& get_name() const { return _name; }
 
   // Virtual methods, has to be implemented by each conditional;
   virtual void initialize(Parser& p);
@@ -102,11 +111,13 @@ protected:
   virtual bool eval(const Resources& res) = 0;
 
   std::string _qualifier;
+  std::string _name; // As written, e.g. CLIENT-HEADER:Host
   MatcherOps _cond_op;
   Matcher* _matcher;
 
 private:
   DISALLOW_COPY_AND_ASSIGN(Condition);
+  friend class RuleProgram;
 
   CondModifiers _mods;
 };
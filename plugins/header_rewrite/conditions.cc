@@ -169,6 +169,12 @@ ConditionHeader::initialize(Parser& p)
 
   _matcher = match;
 
+  _hdr_name = get_wks_header(_qualifier, &_hdr_name_len);
+  if (NULL == _hdr_name) {
+    _hdr_name = _qualifier.c_str();
+    _hdr_name_len = _qualifier.size();
+  }
+
   require_resources(RSRC_CLIENT_REQUEST_HEADERS);
   require_resources(RSRC_CLIENT_RESPONSE_HEADERS);
   require_resources(RSRC_SERVER_REQUEST_HEADERS);
@@ -194,7 +200,7 @@ ConditionHeader::append_value(std::string& s, const Resources& res)
   }
 
   if (bufp && hdr_loc) {
-    field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, _qualifier.c_str(), _qualifier.size());
+    field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, _hdr_name, _hdr_name_len);
     TSDebug(PLUGIN_NAME, "Getting Header: %s, field_loc: %p", _qualifier.c_str(), field_loc);
     if (field_loc != NULL) {
       value = TSMimeHdrFieldValueStringGet(bufp, hdr_loc, field_loc, -1, &len);
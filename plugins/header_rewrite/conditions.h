@@ -48,6 +48,7 @@ public:
   }
 
   void append_value(std::string& s, const Resources& /* res ATS_UNUSED */) { s += "TRUE";  }
+  bool constant(bool* value) const { *value = true; return true; }
 
 protected:
   bool eval(const Resources& /* res ATS_UNUSED */) {
@@ -69,6 +70,7 @@ public:
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for ConditionFalse");
   }
   void append_value(std::string& s, const Resources& /* res ATS_UNUSED */) { s += "FALSE"; }
+  bool constant(bool* value) const { *value = false; return true; }
 
 protected:
   bool eval(const Resources& /* res ATS_UNUSED */) {
@@ -157,6 +159,7 @@ public:
   }
   void initialize(Parser& p);
   void append_value(std::string& s, const Resources& res);
+  bool tests_value() const { return true; }
 
 protected:
   bool eval(const Resources& res);
@@ -211,13 +214,14 @@ class ConditionHeader : public Condition
 {
 public:
   explicit ConditionHeader(bool client = false)
-    : _client(client)
+    : _client(client), _hdr_name(NULL), _hdr_name_len(0)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for ConditionHeader, client %d", client);
   };
 
   void initialize(Parser& p);
   void append_value(std::string& s, const Resources& res);
+  bool tests_value() const { return true; }
 
 protected:
   bool eval(const Resources& res);
@@ -226,6 +230,8 @@ private:
   DISALLOW_COPY_AND_ASSIGN(ConditionHeader);
 
   bool _client;
+  const char* _hdr_name; // _qualifier, or the same well-known string of the core
+  int _hdr_name_len;
 };
 
 // path
@@ -239,6 +245,7 @@ public:
 
   void initialize(Parser& p);
   void append_value(std::string& s, const Resources& res);
+  bool tests_value() const { return true; }
 
 protected:
   bool eval(const Resources& res);
@@ -316,6 +323,7 @@ public:
 
   void initialize(Parser& p);
   void append_value(std::string& s, const Resources& res);
+  bool tests_value() const { return true; }
 
 protected:
   bool eval(const Resources& res);
@@ -343,6 +351,7 @@ class ConditionClientIp : public Condition
 public:
   void initialize(Parser& p);
   void append_value(std::string &s, const Resources &res);
+  bool tests_value() const { return true; }
 
 protected:
   bool eval(const Resources &res);
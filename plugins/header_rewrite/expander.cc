@@ -29,89 +29,148 @@
 #include "parser.h"
 #include "expander.h"
 
-// Main expander method
-std::string
-VariableExpander::expand(const Resources& res)
+VariableExpander::VariableExpander(const std::string &source)
+  : _size(0)
 {
-  std::string result;
+  static const struct {
+    const char* name;
+    Variable var;
+  } variables[] = {
+    { "%<proto>", VAR_PROTO },
+    { "%<port>", VAR_PORT },
+    { "%<chi>", VAR_CHI },
+    { "%<cqhl>", VAR_CQHL },
+    { "%<cqhm>", VAR_CQHM },
+    { "%<cquup>", VAR_CQUUP },
+  };
+  std::string::size_type pos = 0;
+
+  while (pos < source.size()) {
+    Segment seg;
+    std::string::size_type start = source.find("%<", pos);
+    std::string::size_type end = (start == std::string::npos) ? start : source.find(">", start);
+
+    if (end == std::string::npos) {
+      start = source.size();
+    }
 
-  result.reserve(512); // TODO: Can be optimized
-  result.assign(_source);
+    if (start > pos) {
+      seg.var = VAR_NONE;
+      seg.text = source.substr(pos, start - pos);
+      _size += seg.text.size();
+      _segments.push_back(seg);
+    }
 
-  while (true) {
-    std::string::size_type start = result.find("%<");
-    if (start == std::string::npos)
+    if (end == std::string::npos) {
       break;
+    }
 
-    std::string::size_type end = result.find(">", start);
-    if (end == std::string::npos)
-      break;
+    std::string variable = source.substr(start, end - start + 1);
 
-    std::string first_part = result.substr(0, start);
-    std::string last_part = result.substr(end + 1);
+    seg.var = VAR_UNKNOWN;
+    seg.text.clear();
+    for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i) {
+      if (variable == variables[i].name) {
+        seg.var = variables[i].var;
+        break;
+      }
+    }
+    if (seg.var != VAR_UNKNOWN) {
+      _segments.push_back(seg);
+    }
+    pos = end + 1;
+  }
+}
+
+
+// Main expander method
+std::string
+VariableExpander::expand(const Resources& res) const
+{
+  std::string result;
 
-    // Now evaluate the variable
-    std::string variable = result.substr(start, end - start + 1);
+  result.reserve(_size + 64);
+  for (std::vector<Segment>::const_iterator it = _segments.begin(); it != _segments.end(); ++it) {
+    if (it->var == VAR_NONE) {
+      result.append(it->text);
+    } else {
+      append_variable(result, it->var, res);
+    }
+  }
 
-    // This will be the value to replace the "variable" section of the string with
-    std::string resolved_variable = "";
+  return result;
+}
 
-    // Initialize some stuff
-    TSMBuffer bufp;
-    TSMLoc hdr_loc;
-    TSMLoc url_loc;
 
-    if (variable == "%<proto>") {
-      // Protocol of the incoming request
-      if (TSHttpTxnPristineUrlGet(res.txnp, &bufp, &url_loc) == TS_SUCCESS) {
-        int len;
-        resolved_variable = TSUrlSchemeGet(bufp, url_loc, &len);
+void
+VariableExpander::append_variable(std::string& s, Variable var, const Resources& res) const
+{
+  // Initialize some stuff
+  TSMBuffer bufp;
+  TSMLoc hdr_loc;
+  TSMLoc url_loc;
+
+  switch (var) {
+  case VAR_PROTO:
+    // Protocol of the incoming request
+    if (TSHttpTxnPristineUrlGet(res.txnp, &bufp, &url_loc) == TS_SUCCESS) {
+      int len;
+      const char *scheme = TSUrlSchemeGet(bufp, url_loc, &len);
+
+      if (scheme && len) {
+        s.append(scheme, len);
       }
-    } else if (variable == "%<port>") {
-      // Original port of the incoming request
-      if (TSHttpTxnClientReqGet(res.txnp, &bufp, &hdr_loc) == TS_SUCCESS) {
-        if (TSHttpHdrUrlGet(bufp, hdr_loc, &url_loc) == TS_SUCCESS) {
-          std::stringstream out;
-          out << TSUrlPortGet(bufp, url_loc);
-          resolved_variable = out.str();
-          TSHandleMLocRelease(bufp, hdr_loc, url_loc);
-        }
-        TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, url_loc);
+    }
+    break;
+  case VAR_PORT:
+    // Original port of the incoming request
+    if (TSHttpTxnClientReqGet(res.txnp, &bufp, &hdr_loc) == TS_SUCCESS) {
+      if (TSHttpHdrUrlGet(bufp, hdr_loc, &url_loc) == TS_SUCCESS) {
+        std::stringstream out;
+        out << TSUrlPortGet(bufp, url_loc);
+        s += out.str();
+        TSHandleMLocRelease(bufp, hdr_loc, url_loc);
       }
-    } else if (variable == "%<chi>") {
-      // IP address of the client's host machine
-      resolved_variable = getIP(TSHttpTxnClientAddrGet(res.txnp));
-    } else if (variable == "%<cqhl>") {
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+    }
+    break;
+  case VAR_CHI:
+    // IP address of the client's host machine
+    s += getIP(TSHttpTxnClientAddrGet(res.txnp));
+    break;
+  case VAR_CQHL:
+    {
       // The client request header length; the header length in the client request to Traffic Server.
       std::stringstream out;
       out << TSHttpHdrLengthGet(res.client_bufp, res.client_hdr_loc);
-      resolved_variable = out.str();
-    } else if (variable == "%<cqhm>") {
+      s += out.str();
+    }
+    break;
+  case VAR_CQHM:
+    {
       // The HTTP method in the client request to Traffic Server: GET, POST, and so on (subset of cqtx).
       int method_len;
       const char *methodp = TSHttpHdrMethodGet(res.client_bufp, res.client_hdr_loc, &method_len);
       if (methodp && method_len) {
-        resolved_variable.assign(methodp, method_len);
+        s.append(methodp, method_len);
       }
-    } else if (variable == "%<cquup>") {
-      // The client request unmapped URL path. This field records a URL path
-      // before it is remapped (reverse proxy mode).
-      if (TSHttpTxnPristineUrlGet(res.txnp, &bufp, &url_loc) == TS_SUCCESS) {
-        int path_len;
-        const char *path = TSUrlPathGet(bufp, url_loc, &path_len);
-
-        if (path && path_len) {
-          resolved_variable.assign(path, path_len);
-        }
-        TSHandleMLocRelease(bufp, TS_NULL_MLOC, url_loc);
+    }
+    break;
+  case VAR_CQUUP:
+    // The client request unmapped URL path. This field records a URL path
+    // before it is remapped (reverse proxy mode).
+    if (TSHttpTxnPristineUrlGet(res.txnp, &bufp, &url_loc) == TS_SUCCESS) {
+      int path_len;
+      const char *path = TSUrlPathGet(bufp, url_loc, &path_len);
+
+      if (path && path_len) {
+        s.append(path, path_len);
       }
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, url_loc);
     }
-
-    // TODO(SaveTheRbtz): Can be optimized
-    result.assign(first_part);
-    result.append(resolved_variable);
-    result.append(last_part);
+    break;
+  default:
+    break;
   }
-
-  return result;
 }
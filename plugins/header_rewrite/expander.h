@@ -23,20 +23,40 @@
 #define __EXPANDER_H__ 1
 
 #include <string>
+#include <vector>
 
 #include "ts/ts.h"
 #include "resources.h"
 
+// The source string is split into literals and %<...> variables once, when the
+// expander is created, so expand() only has to resolve the variables.
 class VariableExpander {
 public:
-  VariableExpander(const std::string &source)
-    : _source(source)
-  { }
+  explicit VariableExpander(const std::string &source);
 
-  std::string expand(const Resources& res);
+  std::string expand(const Resources& res) const;
 
 private:
-  std::string _source;
+  enum Variable {
+    VAR_NONE, // A literal
+    VAR_PROTO,
+    VAR_PORT,
+    VAR_CHI,
+    VAR_CQHL,
+    VAR_CQHM,
+    VAR_CQUUP,
+    VAR_UNKNOWN // Expands to nothing
+  };
+
+  struct Segment {
+    Variable var;
+    std::string text;
+  };
+
+  void append_variable(std::string& s, Variable var, const Resources& res) const;
+
+  std::vector<Segment> _segments;
+  size_t _size;
 };
 
 
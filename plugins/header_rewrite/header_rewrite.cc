@@ -23,6 +23,7 @@
 
 #include "parser.h"
 #include "ruleset.h"
+#include "program.h"
 #include "resources.h"
 
 // Debugs
@@ -82,6 +83,7 @@ public:
 
   ResourceIDs resid(int hook) const { return _resids[hook]; }
   RuleSet* rule(int hook) const { return _rules[hook]; }
+  const RuleProgram& program(int hook) const { return _programs[hook]; }
 
   bool parse_config(const std::string fname, TSHttpHookID default_hook);
 
@@ -91,6 +93,7 @@ private:
   TSCont _cont;
   RuleSet* _rules[TS_HTTP_LAST_HOOK+1];
   ResourceIDs _resids[TS_HTTP_LAST_HOOK+1];
+  RuleProgram _programs[TS_HTTP_LAST_HOOK+1];
 };
 
 // Helper function to add a rule to the rulesets
@@ -217,6 +220,13 @@ RulesConfig::parse_config(const std::string fname, TSHttpHookID default_hook)
     }
   }
 
+  // (Re)compile the rules of each hook, including the remap "hook"
+  for (int i=TS_HTTP_READ_REQUEST_HDR_HOOK; i<=TS_HTTP_LAST_HOOK; ++i) {
+    if (_rules[i]) {
+      _programs[i].compile(_rules[i]);
+    }
+  }
+
   return true;
 }
 
@@ -254,23 +264,13 @@ cont_rewrite_headers(TSCont contp, TSEvent event, void *edata)
   }
 
   if (hook != TS_HTTP_LAST_HOOK) {
-    const RuleSet* rule = conf->rule(hook);
     Resources res(txnp, contp);
 
     // Get the resources necessary to process this event
     res.gather(conf->resid(hook), hook);
 
-    // Evaluation of all rules. This code is sort of duplicate in DoRemap as well.
-    while (rule) {
-      if (rule->eval(res)) {
-        OperModifiers rt = rule->exec(res);
-
-        if (rule->last() || (rt & OPER_LAST)) {
-          break; // Conditional break, force a break with [L]
-        }
-      }
-      rule = rule->next;
-    }
+    // Evaluation of all rules, compiled for this hook.
+    conf->program(hook).run(res);
   }
 
   TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
@@ -427,23 +427,12 @@ TSRemapDoRemap(void *ih, TSHttpTxn rh, TSRemapRequestInfo *rri)
   // Now handle the remap specific rules for the "remap hook" (which is not a real hook).
   // This is sufficiently differen than the normal cont_rewrite_headers() callback, and
   // we can't (shouldn't) schedule this as a TXN hook.
-  RuleSet* rule = conf->rule(TS_REMAP_PSEUDO_HOOK);
   Resources res(rh, rri);
 
   res.gather(RSRC_CLIENT_REQUEST_HEADERS, TS_REMAP_PSEUDO_HOOK);
-  while (rule) {
-    if (rule->eval(res)) {
-      OperModifiers rt = rule->exec(res);
-
-      if (res.changed_url == true) {
-        rval = TSREMAP_DID_REMAP;
-      }
-
-      if (rule->last() || (rt & OPER_LAST)) {
-        break; // Conditional break, force a break with [L]
-      }
-    }
-    rule = rule->next;
+  conf->program(TS_REMAP_PSEUDO_HOOK).run(res);
+  if (res.changed_url == true) {
+    rval = TSREMAP_DID_REMAP;
   }
 
   TSDebug(PLUGIN_NAME_DBG, "Returing from TSRemapDoRemap with status: %d", rval);
@@ -84,3 +84,101 @@ getPort(sockaddr const* s_sockaddr)
     break;
   }
 }
+
+
+// The MIME field names known to the core, see get_wks_header()
+static const struct {
+  const char** name;
+  int* len;
+} wks_headers[] = {
+    { &TS_MIME_FIELD_ACCEPT, &TS_MIME_LEN_ACCEPT },
+    { &TS_MIME_FIELD_ACCEPT_CHARSET, &TS_MIME_LEN_ACCEPT_CHARSET },
+    { &TS_MIME_FIELD_ACCEPT_ENCODING, &TS_MIME_LEN_ACCEPT_ENCODING },
+    { &TS_MIME_FIELD_ACCEPT_LANGUAGE, &TS_MIME_LEN_ACCEPT_LANGUAGE },
+    { &TS_MIME_FIELD_ACCEPT_RANGES, &TS_MIME_LEN_ACCEPT_RANGES },
+    { &TS_MIME_FIELD_AGE, &TS_MIME_LEN_AGE },
+    { &TS_MIME_FIELD_ALLOW, &TS_MIME_LEN_ALLOW },
+    { &TS_MIME_FIELD_APPROVED, &TS_MIME_LEN_APPROVED },
+    { &TS_MIME_FIELD_AUTHORIZATION, &TS_MIME_LEN_AUTHORIZATION },
+    { &TS_MIME_FIELD_BYTES, &TS_MIME_LEN_BYTES },
+    { &TS_MIME_FIELD_CACHE_CONTROL, &TS_MIME_LEN_CACHE_CONTROL },
+    { &TS_MIME_FIELD_CLIENT_IP, &TS_MIME_LEN_CLIENT_IP },
+    { &TS_MIME_FIELD_CONNECTION, &TS_MIME_LEN_CONNECTION },
+    { &TS_MIME_FIELD_CONTENT_BASE, &TS_MIME_LEN_CONTENT_BASE },
+    { &TS_MIME_FIELD_CONTENT_ENCODING, &TS_MIME_LEN_CONTENT_ENCODING },
+    { &TS_MIME_FIELD_CONTENT_LANGUAGE, &TS_MIME_LEN_CONTENT_LANGUAGE },
+    { &TS_MIME_FIELD_CONTENT_LENGTH, &TS_MIME_LEN_CONTENT_LENGTH },
+    { &TS_MIME_FIELD_CONTENT_LOCATION, &TS_MIME_LEN_CONTENT_LOCATION },
+    { &TS_MIME_FIELD_CONTENT_MD5, &TS_MIME_LEN_CONTENT_MD5 },
+    { &TS_MIME_FIELD_CONTENT_RANGE, &TS_MIME_LEN_CONTENT_RANGE },
+    { &TS_MIME_FIELD_CONTENT_TYPE, &TS_MIME_LEN_CONTENT_TYPE },
+    { &TS_MIME_FIELD_CONTROL, &TS_MIME_LEN_CONTROL },
+    { &TS_MIME_FIELD_COOKIE, &TS_MIME_LEN_COOKIE },
+    { &TS_MIME_FIELD_DATE, &TS_MIME_LEN_DATE },
+    { &TS_MIME_FIELD_DISTRIBUTION, &TS_MIME_LEN_DISTRIBUTION },
+    { &TS_MIME_FIELD_ETAG, &TS_MIME_LEN_ETAG },
+    { &TS_MIME_FIELD_EXPECT, &TS_MIME_LEN_EXPECT },
+    { &TS_MIME_FIELD_EXPIRES, &TS_MIME_LEN_EXPIRES },
+    { &TS_MIME_FIELD_FOLLOWUP_TO, &TS_MIME_LEN_FOLLOWUP_TO },
+    { &TS_MIME_FIELD_FROM, &TS_MIME_LEN_FROM },
+    { &TS_MIME_FIELD_HOST, &TS_MIME_LEN_HOST },
+    { &TS_MIME_FIELD_IF_MATCH, &TS_MIME_LEN_IF_MATCH },
+    { &TS_MIME_FIELD_IF_MODIFIED_SINCE, &TS_MIME_LEN_IF_MODIFIED_SINCE },
+    { &TS_MIME_FIELD_IF_NONE_MATCH, &TS_MIME_LEN_IF_NONE_MATCH },
+    { &TS_MIME_FIELD_IF_RANGE, &TS_MIME_LEN_IF_RANGE },
+    { &TS_MIME_FIELD_IF_UNMODIFIED_SINCE, &TS_MIME_LEN_IF_UNMODIFIED_SINCE },
+    { &TS_MIME_FIELD_KEEP_ALIVE, &TS_MIME_LEN_KEEP_ALIVE },
+    { &TS_MIME_FIELD_KEYWORDS, &TS_MIME_LEN_KEYWORDS },
+    { &TS_MIME_FIELD_LAST_MODIFIED, &TS_MIME_LEN_LAST_MODIFIED },
+    { &TS_MIME_FIELD_LINES, &TS_MIME_LEN_LINES },
+    { &TS_MIME_FIELD_LOCATION, &TS_MIME_LEN_LOCATION },
+    { &TS_MIME_FIELD_MAX_FORWARDS, &TS_MIME_LEN_MAX_FORWARDS },
+    { &TS_MIME_FIELD_MESSAGE_ID, &TS_MIME_LEN_MESSAGE_ID },
+    { &TS_MIME_FIELD_NEWSGROUPS, &TS_MIME_LEN_NEWSGROUPS },
+    { &TS_MIME_FIELD_ORGANIZATION, &TS_MIME_LEN_ORGANIZATION },
+    { &TS_MIME_FIELD_PATH, &TS_MIME_LEN_PATH },
+    { &TS_MIME_FIELD_PRAGMA, &TS_MIME_LEN_PRAGMA },
+    { &TS_MIME_FIELD_PROXY_AUTHENTICATE, &TS_MIME_LEN_PROXY_AUTHENTICATE },
+    { &TS_MIME_FIELD_PROXY_AUTHORIZATION, &TS_MIME_LEN_PROXY_AUTHORIZATION },
+    { &TS_MIME_FIELD_PROXY_CONNECTION, &TS_MIME_LEN_PROXY_CONNECTION },
+    { &TS_MIME_FIELD_PUBLIC, &TS_MIME_LEN_PUBLIC },
+    { &TS_MIME_FIELD_RANGE, &TS_MIME_LEN_RANGE },
+    { &TS_MIME_FIELD_REFERENCES, &TS_MIME_LEN_REFERENCES },
+    { &TS_MIME_FIELD_REFERER, &TS_MIME_LEN_REFERER },
+    { &TS_MIME_FIELD_REPLY_TO, &TS_MIME_LEN_REPLY_TO },
+    { &TS_MIME_FIELD_RETRY_AFTER, &TS_MIME_LEN_RETRY_AFTER },
+    { &TS_MIME_FIELD_SENDER, &TS_MIME_LEN_SENDER },
+    { &TS_MIME_FIELD_SERVER, &TS_MIME_LEN_SERVER },
+    { &TS_MIME_FIELD_SET_COOKIE, &TS_MIME_LEN_SET_COOKIE },
+    { &TS_MIME_FIELD_STRICT_TRANSPORT_SECURITY, &TS_MIME_LEN_STRICT_TRANSPORT_SECURITY },
+    { &TS_MIME_FIELD_SUBJECT, &TS_MIME_LEN_SUBJECT },
+    { &TS_MIME_FIELD_SUMMARY, &TS_MIME_LEN_SUMMARY },
+    { &TS_MIME_FIELD_TE, &TS_MIME_LEN_TE },
+    { &TS_MIME_FIELD_TRANSFER_ENCODING, &TS_MIME_LEN_TRANSFER_ENCODING },
+    { &TS_MIME_FIELD_UPGRADE, &TS_MIME_LEN_UPGRADE },
+    { &TS_MIME_FIELD_USER_AGENT, &TS_MIME_LEN_USER_AGENT },
+    { &TS_MIME_FIELD_VARY, &TS_MIME_LEN_VARY },
+    { &TS_MIME_FIELD_VIA, &TS_MIME_LEN_VIA },
+    { &TS_MIME_FIELD_WARNING, &TS_MIME_LEN_WARNING },
+    { &TS_MIME_FIELD_WWW_AUTHENTICATE, &TS_MIME_LEN_WWW_AUTHENTICATE },
+    { &TS_MIME_FIELD_XREF, &TS_MIME_LEN_XREF },
+    { &TS_MIME_FIELD_X_FORWARDED_FOR, &TS_MIME_LEN_X_FORWARDED_FOR },
+};
+
+// Returns the well-known string (WKS) of the core for the header name, and its length in
+// len, or NULL if it is not one. The core finds WKS names without hashing them, and uses the
+// presence bits and slot accelerators of the header for them, so this is worth doing once
+// for the header names of the rules.
+const char*
+get_wks_header(const std::string& name, int* len)
+{
+  for (size_t i = 0; i < sizeof(wks_headers) / sizeof(wks_headers[0]); ++i) {
+    if ((*wks_headers[i].len == static_cast<int>(name.size())) &&
+        (0 == strncasecmp(*wks_headers[i].name, name.data(), name.size()))) {
+      *len = *wks_headers[i].len;
+      return *wks_headers[i].name;
+    }
+  }
+
+  return NULL;
+}
@@ -31,6 +31,7 @@
 std::string getIP(sockaddr const* s_sockaddr);
 char* getIP(sockaddr const* s_sockaddr, char res[INET6_ADDRSTRLEN]);
 uint16_t getPort(sockaddr const* s_sockaddr);
+const char* get_wks_header(const std::string& name, int* len);
 
 // Memory barriers
 #if defined(__i386__)
@@ -62,6 +62,9 @@ public:
   void* get_pdata() const { return _pdata; }
   virtual void free_pdata() { TSfree(_pdata); _pdata = NULL; }
 
+  // The compiled regular expression, for string matchers of MATCH_REGULAR_EXPRESSION
+  virtual const regexHelper* get_regex() const { return NULL; }
+
 protected:
   void* _pdata;
   const MatcherOps _op;
@@ -81,6 +84,7 @@ public:
 
   // Getters / setters
   const T get() const { return _data; };
+  const regexHelper* get_regex() const { return helper.compiled() ? &helper : NULL; }
 
   void setRegex(const std::string /* data ATS_UNUSED */)
   {
@@ -53,6 +53,11 @@ OperatorHeaders::initialize(Parser& p)
   Operator::initialize(p);
 
   _header = p.get_arg();
+  _hdr_name = get_wks_header(_header, &_hdr_name_len);
+  if (NULL == _hdr_name) {
+    _hdr_name = _header.c_str();
+    _hdr_name_len = _header.size();
+  }
 
   require_resources(RSRC_SERVER_RESPONSE_HEADERS);
   require_resources(RSRC_SERVER_REQUEST_HEADERS);
@@ -80,7 +80,7 @@ class OperatorHeaders : public Operator
 {
 public:
   OperatorHeaders()
-    : _header("")
+    : _header(""), _hdr_name(NULL), _hdr_name_len(0)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for OperatorHeaders");
   }
@@ -89,6 +89,8 @@ public:
 
 protected:
   std::string _header;
+  const char* _hdr_name; // _header, or the same well-known string of the core
+  int _hdr_name_len;
 
 private:
   DISALLOW_COPY_AND_ASSIGN(OperatorHeaders);
@@ -273,12 +273,7 @@ OperatorSetRedirect::exec(const Resources& res) const
     if (res.bufp && res.hdr_loc) {
       std::string value;
 
-      _location.append_value(value, res);
-
-      if (_location.need_expansion()) {
-        VariableExpander ve(value);
-        value = ve.expand(res);
-      }
+      _location.append_expanded_value(value, res);
 
       // Replace %{PATH} to original path
       size_t pos_path = 0;
@@ -400,7 +395,7 @@ OperatorRMHeader::exec(const Resources& res) const
 
   if (res.bufp && res.hdr_loc) {
     TSDebug(PLUGIN_NAME, "OperatorRMHeader::exec() invoked on header %s", _header.c_str());
-    field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _header.c_str(), _header.size());
+    field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _hdr_name, _hdr_name_len);
     while (field_loc) {
       TSDebug(PLUGIN_NAME, "   Deleting header %s", _header.c_str());
       tmp = TSMimeHdrFieldNextDup(res.bufp, res.hdr_loc, field_loc);
@@ -426,13 +421,7 @@ OperatorAddHeader::exec(const Resources& res) const
 {
   std::string value;
 
-  _value.append_value(value, res);
-
-  if (_value.need_expansion()) {
-    VariableExpander ve(value);
-
-    value = ve.expand(res);
-  }
+  _value.append_expanded_value(value, res);
 
   // Never set an empty header (I don't think that ever makes sense?)
   if (value.empty()) {
@@ -444,7 +433,7 @@ OperatorAddHeader::exec(const Resources& res) const
     TSDebug(PLUGIN_NAME, "OperatorAddHeader::exec() invoked on header %s: %s", _header.c_str(), value.c_str());
     TSMLoc field_loc;
 
-    if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _header.c_str(), _header.size(), &field_loc)) {
+    if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _hdr_name, _hdr_name_len, &field_loc)) {
       if (TS_SUCCESS == TSMimeHdrFieldValueStringSet(res.bufp, res.hdr_loc, field_loc, -1, value.c_str(), value.size())) {
         TSDebug(PLUGIN_NAME, "   Adding header %s", _header.c_str());
         TSMimeHdrFieldAppend(res.bufp, res.hdr_loc, field_loc);
@@ -478,13 +467,13 @@ OperatorSetHeader::exec(const Resources& res) const
   }
 
   if (res.bufp && res.hdr_loc) {
-    TSMLoc field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _header.c_str(), _header.size());
+    TSMLoc field_loc = TSMimeHdrFieldFind(res.bufp, res.hdr_loc, _hdr_name, _hdr_name_len);
 
     TSDebug(PLUGIN_NAME, "OperatorSetHeader::exec() invoked on header %s: %s", _header.c_str(), value.c_str());
 
     if (!field_loc) {
       // No existing header, so create one
-      if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _header.c_str(), _header.size(), &field_loc)) {
+      if (TS_SUCCESS == TSMimeHdrFieldCreateNamed(res.bufp, res.hdr_loc, _hdr_name, _hdr_name_len, &field_loc)) {
         if (TS_SUCCESS == TSMimeHdrFieldValueStringSet(res.bufp, res.hdr_loc, field_loc, -1, value.c_str(), value.size())) {
           TSDebug(PLUGIN_NAME, "   Adding header %s", _header.c_str());
           TSMimeHdrFieldAppend(res.bufp, res.hdr_loc, field_loc);
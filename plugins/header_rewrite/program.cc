@@ -0,0 +1,347 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+// program.cc: compiling and running the rules of a hook
+//
+//
+#include <string.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "ts/ts.h"
+
+#include "program.h"
+#include "condition.h"
+
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+
+// Can the expression be put in an alternation with others, and mean the same? Anything
+// which refers to groups by number, or to the whole pattern, or could run past the end
+// of its own alternative, can't.
+static bool
+combinable(const std::string& re)
+{
+  for (std::string::size_type i = 0; i < re.size(); ++i) {
+    switch (re[i]) {
+    case '\\':
+      if (++i < re.size()) {
+        char c = re[i];
+
+        if ((c >= '0' && c <= '9') || c == 'g' || c == 'k' || c == 'Q') {
+          return false;
+        }
+      }
+      break;
+    case '(':
+      if ((i + 1 < re.size()) && (re[i + 1] == '*')) {
+        return false;
+      }
+      if ((i + 2 < re.size()) && (re[i + 1] == '?') && strchr("PR&|+-0123456789", re[i + 2])) {
+        return false;
+      }
+      // A conditional on a group number, or on recursion: (?(1)...), (?(+1)...), (?(R)...)
+      if ((i + 3 < re.size()) && (re[i + 1] == '?') && (re[i + 2] == '(') && strchr("R+-0123456789", re[i + 3])) {
+        return false;
+      }
+      break;
+    case '#': // A comment, with (?x)
+      return false;
+    default:
+      break;
+    }
+  }
+
+  return true;
+}
+
+
+void
+RuleProgram::clear()
+{
+  for (std::vector<RegexGroup>::iterator it = _groups.begin(); it != _groups.end(); ++it) {
+    pcre_free(it->regex);
+    if (it->extra) {
+      pcre_free(it->extra);
+    }
+  }
+  _groups.clear();
+  _conds.clear();
+  _rules.clear();
+  _n_regex_conds = 0;
+}
+
+
+// Add the condition list of a rule, folding the constants away where we can
+void
+RuleProgram::add_conditions(Condition* cond)
+{
+  std::vector<CondStep>::size_type first = _conds.size();
+
+  for (Condition* c = cond; c; c = static_cast<Condition*>(c->_next)) {
+    CondStep step;
+    bool value;
+
+    step.cond = c;
+    step.group = -1;
+    step.regex = NULL;
+    step.value = false;
+    step.negate = (c->_mods & COND_NOT);
+    step.or_next = (c->_mods & COND_OR);
+
+    if (c->constant(&value)) {
+      step.cond = NULL;
+      step.value = step.negate ? !value : value;
+
+      if (c->_next) {
+        if (step.value != step.or_next) {
+          continue; // TRUE [AND] or FALSE [OR], on to the next one
+        }
+        // TRUE [OR] or FALSE [AND], this decides it and the rest is never evaluated
+        _conds.push_back(step);
+        break;
+      } else if ((_conds.size() > first) && (_conds.back().or_next != step.value)) {
+        continue; // x [AND] TRUE, or x [OR] FALSE, is just x
+      }
+    }
+    _conds.push_back(step);
+  }
+}
+
+
+// Group the regular expressions of the conditions on the same value, and compile an
+// alternation of each group.
+void
+RuleProgram::combine_regexes()
+{
+  std::map<std::string, std::vector<int> > by_value;
+
+  for (std::vector<CondStep>::size_type i = 0; i < _conds.size(); ++i) {
+    Condition* c = _conds[i].cond;
+
+    if (c && c->tests_value() && (c->get_cond_op() == MATCH_REGULAR_EXPRESSION) && c->get_matcher()) {
+      const regexHelper* regex = c->get_matcher()->get_regex();
+
+      if (regex && combinable(regex->getRegexString())) {
+        _conds[i].regex = regex;
+        by_value[c->get_name()].push_back(i);
+      }
+    }
+  }
+
+  for (std::map<std::string, std::vector<int> >::iterator it = by_value.begin(); it != by_value.end(); ++it) {
+    std::vector<int>& conds = it->second;
+    std::string pattern;
+    RegexGroup group;
+    const char* error;
+    int erroffset;
+
+    if (conds.size() < 2) {
+      continue;
+    }
+
+    for (std::vector<int>::iterator c = conds.begin(); c != conds.end(); ++c) {
+      if (!pattern.empty()) {
+        pattern += '|';
+      }
+      pattern += "(?:" + _conds[*c].regex->getRegexString() + ")";
+    }
+
+    group.subject = _conds[conds[0]].cond;
+    group.regex = pcre_compile(pattern.c_str(), 0, &error, &erroffset, NULL);
+    if (NULL == group.regex) {
+      TSDebug(PLUGIN_NAME, "Could not combine the %d expressions on %%{%s}: %s", (int)conds.size(), it->first.c_str(),
+              error);
+      continue;
+    }
+    group.extra = pcre_study(group.regex, 0, &error);
+
+    for (std::vector<int>::iterator c = conds.begin(); c != conds.end(); ++c) {
+      _conds[*c].group = _groups.size();
+    }
+    _groups.push_back(group);
+    _n_regex_conds += conds.size();
+    TSDebug(PLUGIN_NAME, "Combined the %d expressions on %%{%s}", (int)conds.size(), it->first.c_str());
+  }
+}
+
+
+void
+RuleProgram::compile(const RuleSet* rules)
+{
+  clear();
+
+  for (const RuleSet* rule = rules; rule; rule = rule->next) {
+    RuleStep step;
+
+    step.rule = rule;
+    step.first = _conds.size();
+    add_conditions(rule->get_condition());
+    step.count = _conds.size() - step.first;
+
+    // All that's left is a constant, the rule always or never matches
+    if ((step.count == 1) && (NULL == _conds.back().cond)) {
+      bool always = _conds.back().value;
+
+      _conds.pop_back();
+      step.count = 0;
+      if (!always) {
+        TSDebug(PLUGIN_NAME, "Dropping a rule which never matches");
+        continue;
+      }
+    }
+    _rules.push_back(step);
+  }
+
+  combine_regexes();
+  TSDebug(PLUGIN_NAME, "Compiled %d rules, %d conditions, %d expressions in %d groups", (int)_rules.size(),
+          (int)_conds.size(), _n_regex_conds, (int)_groups.size());
+}
+
+
+// Same as Condition::do_eval() on the condition list of the rule
+bool
+RuleProgram::eval(const RuleStep& rule, GroupState* groups, const Resources& res) const
+{
+  int end = rule.first + rule.count;
+
+  for (int i = rule.first; i < end; ++i) {
+    const CondStep& step = _conds[i];
+    bool rt;
+
+    if (NULL == step.cond) {
+      rt = step.value;
+    } else {
+      if (step.group < 0) {
+        rt = step.cond->eval(res);
+      } else {
+        GroupState& g = groups[step.group];
+
+        if (g.state == GroupState::UNKNOWN) {
+          const RegexGroup& group = _groups[step.group];
+
+          g.value.clear();
+          group.subject->append_value(g.value, res);
+          // No ovector, we only want to know if there is a match
+          if (pcre_exec(group.regex, group.extra, g.value.data(), g.value.size(), 0, 0, NULL, 0) == PCRE_ERROR_NOMATCH) {
+            g.state = GroupState::NO_MATCH;
+          } else {
+            g.state = GroupState::MAYBE;
+          }
+        }
+
+        if (g.state == GroupState::NO_MATCH) {
+          rt = false;
+        } else {
+          int ovector[OVECCOUNT];
+
+          rt = (step.regex->regexMatch(g.value.data(), g.value.size(), ovector) > 0);
+        }
+      }
+      if (step.negate) {
+        rt = !rt;
+      }
+    }
+
+    if (i == end - 1) {
+      return rt;
+    }
+    if (step.or_next) {
+      if (rt) {
+        return true;
+      }
+    } else if (!rt) {
+      return false;
+    }
+  }
+
+  return true; // No conditions
+}
+
+
+static void
+delete_scratch(void* scratch)
+{
+  delete static_cast<std::vector<RuleProgram::GroupState>*>(scratch);
+}
+
+
+static void
+create_scratch_key()
+{
+  TSReleaseAssert(pthread_key_create(&scratch_key, delete_scratch) == 0);
+}
+
+
+// The group states of the calling thread. They are shared by all the programs run on
+// the thread, and keep the capacity of their values, so a run doesn't allocate.
+std::vector<RuleProgram::GroupState>&
+RuleProgram::scratch(size_t size)
+{
+  std::vector<GroupState>* groups;
+
+  pthread_once(&scratch_once, create_scratch_key);
+  groups = static_cast<std::vector<GroupState>*>(pthread_getspecific(scratch_key));
+  if (NULL == groups) {
+    groups = new std::vector<GroupState>();
+    pthread_setspecific(scratch_key, groups);
+  }
+  if (groups->size() < size) {
+    groups->resize(size);
+  }
+
+  return *groups;
+}
+
+
+int
+RuleProgram::run(const Resources& res) const
+{
+  int n_groups = _groups.size();
+  GroupState* groups = NULL;
+  int n_exec = 0;
+
+  if (n_groups > 0) {
+    groups = &scratch(n_groups)[0];
+    for (int g = 0; g < n_groups; ++g) {
+      groups[g].state = GroupState::UNKNOWN;
+    }
+  }
+
+  for (std::vector<RuleStep>::const_iterator it = _rules.begin(); it != _rules.end(); ++it) {
+    if (eval(*it, groups, res)) {
+      OperModifiers rt = it->rule->exec(res);
+
+      ++n_exec;
+      if (it->rule->last() || (rt & OPER_LAST)) {
+        break; // Conditional break, force a break with [L]
+      }
+
+      // The operators may have changed the values we scanned
+      for (int g = 0; g < n_groups; ++g) {
+        groups[g].state = GroupState::UNKNOWN;
+      }
+    }
+  }
+
+  return n_exec;
+}
@@ -0,0 +1,114 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+//
+// The rules of a hook, compiled into a flat program when the configuration is loaded.
+//
+#ifndef __PROGRAM_H__
+#define __PROGRAM_H__ 1
+
+#include <string>
+#include <vector>
+
+#include "ts/ts.h"
+
+#include "ruleset.h"
+#include "resources.h"
+#include "regex_helper.h"
+#include "lulu.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// A RuleProgram runs the same rules as walking the RuleSet list, and their
+// condition lists, would. When compiling:
+//
+//   - The conditions of all rules are laid out in one array, and evaluated in
+//     a loop rather than by recursion.
+//   - Constant conditions (TRUE / FALSE) are folded, rules which can never
+//     match are dropped, and rules which always match are not evaluated.
+//   - The regular expressions of conditions which match the same value (e.g.
+//     all the %{PATH} /.../ conditions of the hook) are combined into one
+//     alternation. Until an operator runs, and possibly changes the value,
+//     one scan of it tells whether any of them can match, so most of the
+//     non matching rules are rejected without running their own expression.
+//
+// The RuleSets still own the conditions and operators.
+//
+class RuleProgram
+{
+public:
+  RuleProgram()
+    : _n_regex_conds(0)
+  { }
+
+  ~RuleProgram() { clear(); }
+
+  void compile(const RuleSet* rules);
+  void clear();
+
+  // Returns the number of rules whose operators ran
+  int run(const Resources& res) const;
+
+  bool empty() const { return _rules.empty(); }
+  int rule_count() const { return _rules.size(); }
+
+  // The state of a RegexGroup during run()
+  struct GroupState {
+    GroupState() : state(UNKNOWN) { }
+
+    enum { UNKNOWN, NO_MATCH, MAYBE } state;
+    std::string value;
+  };
+
+private:
+  DISALLOW_COPY_AND_ASSIGN(RuleProgram);
+
+  struct CondStep {
+    Condition* cond; // NULL for a constant
+    int group; // RegexGroup, or -1 to evaluate cond as usual
+    const regexHelper* regex; // Of cond, when in a group
+    bool value; // For constants
+    bool negate;
+    bool or_next;
+  };
+
+  struct RuleStep {
+    const RuleSet* rule;
+    int first; // CondStep
+    int count;
+  };
+
+  struct RegexGroup {
+    Condition* subject; // Any of the conditions, they all append the same value
+    pcre* regex;
+    pcre_extra* extra;
+  };
+
+  static std::vector<GroupState>& scratch(size_t size);
+  bool eval(const RuleStep& rule, GroupState* groups, const Resources& res) const;
+  void add_conditions(Condition* cond);
+  void combine_regexes();
+
+  std::vector<CondStep> _conds;
+  std::vector<RuleStep> _rules;
+  std::vector<RegexGroup> _groups;
+  int _n_regex_conds;
+};
+
+
+#endif // __PROGRAM_H
@@ -49,6 +49,7 @@ bool setRegexMatch(const std::string &s);
 const std::string& getRegexString() const;
 int getRegexCcount() const;
 int regexMatch(const char*,int,int ovector[]) const;
+bool compiled() const { return regex != NULL; }
 
 private:
   pcre* regex;
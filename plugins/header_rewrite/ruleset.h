@@ -49,6 +49,7 @@ public:
   void add_operator(Parser& p);
   bool has_operator() const { return NULL != _oper; }
   bool has_condition() const { return NULL != _cond; }
+  Condition* get_condition() const { return _cond; }
 
   void set_hook(TSHttpHookID hook) { _hook = hook; }
   const TSHttpHookID get_hook() const { return _hook; }
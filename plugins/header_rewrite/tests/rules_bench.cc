@@ -0,0 +1,274 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+// rules_bench.cc: run a large configuration against a few requests, by walking the rule
+// list and with the compiled program, and print the rules evaluated per second. Both must
+// run the same rules, and leave the same headers behind.
+//
+//   rules_bench [rules] [iterations]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "ts/ts.h"
+
+#include "lulu.h"
+#include "parser.h"
+#include "ruleset.h"
+#include "resources.h"
+#include "program.h"
+#include "stubs.h"
+
+
+const char PLUGIN_NAME[] = "header_rewrite";
+const char PLUGIN_NAME_DBG[] = "dbg_header_rewrite";
+
+const char* HOOK_NAMES[] = {
+  "TS_HTTP_READ_REQUEST_HDR_HOOK",
+  "TS_HTTP_OS_DNS_HOOK",
+  "TS_HTTP_SEND_REQUEST_HDR_HOOK",
+  "TS_HTTP_READ_CACHE_HDR_HOOK",
+  "TS_HTTP_READ_RESPONSE_HDR_HOOK",
+  "TS_HTTP_SEND_RESPONSE_HDR_HOOK",
+  "TS_HTTP_REQUEST_TRANSFORM_HOOK",
+  "TS_HTTP_RESPONSE_TRANSFORM_HOOK",
+  "TS_HTTP_SELECT_ALT_HOOK",
+  "TS_HTTP_TXN_START_HOOK",
+  "TS_HTTP_TXN_CLOSE_HOOK",
+  "TS_HTTP_SSN_START_HOOK",
+  "TS_HTTP_SSN_CLOSE_HOOK",
+  "TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK",
+  "TS_HTTP_READ_REQUEST_PRE_REMAP_HOOK",
+  "TS_HTTP_POST_REMAP_HOOK",
+  "TS_HTTP_RESPONSE_CLIENT_HOOK",
+  "TS_HTTP_LAST_HOOK"
+};
+
+
+struct BenchRequest {
+  const char* name;
+  const char* path;
+  const char* host;
+  const char* user_agent;
+};
+
+
+// Four kinds of rules, in turn. Note that the parser eats backslashes.
+static void
+add_lines(int i, std::vector<std::string>& lines)
+{
+  char buf[256];
+
+  switch (i % 4) {
+  case 0:
+    snprintf(buf, sizeof(buf), "cond %%{PATH} /^api/v[0-9]+/svc%d/", i);
+    lines.push_back(buf);
+    break;
+  case 1:
+    snprintf(buf, sizeof(buf), "cond %%{CLIENT-HEADER:Host} /^www%d[.]example[.]com$/ [AND]", i);
+    lines.push_back(buf);
+    lines.push_back("cond %{PATH} /[.]jpg$/");
+    break;
+  case 2:
+    snprintf(buf, sizeof(buf), "cond %%{CLIENT-HEADER:User-Agent} /Bot%d[ /]/", i);
+    lines.push_back(buf);
+    break;
+  default:
+    snprintf(buf, sizeof(buf), "cond %%{CLIENT-HEADER:X-Debug} =on%d", i);
+    lines.push_back("cond %{TRUE} [AND]");
+    lines.push_back(buf);
+    break;
+  }
+  snprintf(buf, sizeof(buf), "set-header X-Rule-%d matched", i);
+  lines.push_back(buf);
+}
+
+
+// Rules with modifiers and constants, which the program folds or groups differently than
+// the list evaluates them. They go after the generated rules, one per NULL terminated entry.
+static const char* EXTRA_RULES[][4] = {
+  // An OR chain on PATH, with a capture in the combined alternation
+  { "cond %{PATH} /^(blog|news)// [OR]", "cond %{PATH} /^press//", "set-header X-Extra-0 matched", NULL },
+  // FALSE folds away, and a conditional on a group number can't be combined
+  { "cond %{FALSE} [OR]", "cond %{PATH} /^(s)?(?(1)hop|cart)/", "set-header X-Extra-1 matched", NULL },
+  // Never matches, dropped
+  { "cond %{TRUE} [NOT]", "set-header X-Extra-2 matched", NULL, NULL },
+  // NOT TRUE folds away, and a negated expression in the PATH group
+  { "cond %{TRUE} [NOT,OR]", "cond %{PATH} /[.]css$/ [NOT]", "set-header X-Extra-3 matched", NULL },
+  { "cond %{PATH} /^shop// [NOT,AND]", "cond %{CLIENT-HEADER:User-Agent} /^curl//", "set-header X-Extra-4 matched", NULL },
+  // Never matches, whatever the PATH
+  { "cond %{FALSE} [AND]", "cond %{PATH} /^news//", "set-header X-Extra-5 matched", NULL },
+};
+
+
+// Same as the configuration parser, for the one hook
+static RuleSet*
+build_rules(int n_rules)
+{
+  int n_extra = sizeof(EXTRA_RULES) / sizeof(EXTRA_RULES[0]);
+  RuleSet* rules = NULL;
+
+  for (int i = 0; i < n_rules + n_extra; ++i) {
+    std::vector<std::string> lines;
+    RuleSet* rule = new RuleSet();
+
+    rule->set_hook(TS_HTTP_READ_REQUEST_HDR_HOOK);
+    if (i < n_rules) {
+      add_lines(i, lines);
+    } else {
+      for (const char* const* line = EXTRA_RULES[i - n_rules]; *line; ++line) {
+        lines.push_back(*line);
+      }
+    }
+    for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it) {
+      Parser p(*it);
+
+      if (p.is_cond()) {
+        rule->add_condition(p);
+      } else {
+        rule->add_operator(p);
+      }
+    }
+
+    if (NULL == rules) {
+      rules = rule;
+    } else {
+      rules->append(rule);
+    }
+  }
+
+  return rules;
+}
+
+
+static void
+reset_request(const BenchRequest& req)
+{
+  stub_path = req.path;
+  stub_fields.clear();
+  stub_fields.push_back(StubField("Host", req.host));
+  stub_fields.push_back(StubField("User-Agent", req.user_agent));
+  stub_fields.push_back(StubField("Accept", "*/*"));
+}
+
+
+// What the continuation did before the rules were compiled
+static int
+run_list(const RuleSet* rule, const Resources& res)
+{
+  int n_exec = 0;
+
+  while (rule) {
+    if (rule->eval(res)) {
+      OperModifiers rt = rule->exec(res);
+
+      ++n_exec;
+      if (rule->last() || (rt & OPER_LAST)) {
+        break;
+      }
+    }
+    rule = rule->next;
+  }
+
+  return n_exec;
+}
+
+
+static double
+now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  int n_rules = (argc > 1) ? atoi(argv[1]) : 400;
+  int iterations = (argc > 2) ? atoi(argv[2]) : 200;
+  int last_host = ((n_rules - 2) / 4) * 4 + 1; // The last Host rule
+  char host[64];
+  int failed = 0;
+
+  snprintf(host, sizeof(host), "www%d.example.com", last_host);
+
+  const BenchRequest requests[] = {
+    { "no match", "static/css/site.css", "www.example.org", "Mozilla/5.0 (X11; Linux x86_64)" },
+    { "last Host rule", "images/logo.jpg", host, "Mozilla/5.0 (X11; Linux x86_64)" },
+    { "first rule", "api/v2/svc0/users", "www.example.org", "curl/7.29.0" },
+    { "OR chain", "news/2014/index.html", "www.example.org", "curl/7.29.0" },
+    { "conditional", "shopfront/index.html", "www.example.org", "curl/7.29.0" },
+  };
+
+  RuleSet* rules = build_rules(n_rules);
+  RuleProgram program;
+
+  program.compile(rules);
+  printf("%d rules, %d iterations\n", n_rules, iterations);
+
+  for (size_t r = 0; r < sizeof(requests) / sizeof(requests[0]); ++r) {
+    const BenchRequest& req = requests[r];
+    Resources res(reinterpret_cast<TSHttpTxn>(&stub_fields), (TSCont)NULL);
+    std::vector<StubField> list_fields;
+    int list_exec = 0, program_exec = 0;
+    double start, list_secs, program_secs;
+
+    res.bufp = res.client_bufp = stub_bufp;
+    res.hdr_loc = res.client_hdr_loc = stub_hdr_loc;
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+      reset_request(req);
+      list_exec = run_list(rules, res);
+    }
+    list_secs = now() - start;
+    list_fields = stub_fields;
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+      reset_request(req);
+      program_exec = program.run(res);
+    }
+    program_secs = now() - start;
+
+    printf("%-16s list: %10.0f rules/s   program: %10.0f rules/s   (%d rules ran)\n", req.name,
+           (double)n_rules * iterations / list_secs, (double)n_rules * iterations / program_secs, program_exec);
+
+    if (list_exec != program_exec || list_fields.size() != stub_fields.size()) {
+      printf("  FAILED: the list ran %d rules, the program %d\n", list_exec, program_exec);
+      ++failed;
+    } else {
+      for (size_t i = 0; i < stub_fields.size(); ++i) {
+        if (list_fields[i].name != stub_fields[i].name || list_fields[i].value != stub_fields[i].value) {
+          printf("  FAILED: header %s differs\n", stub_fields[i].name.c_str());
+          ++failed;
+        }
+      }
+    }
+    res.bufp = res.client_bufp = NULL; // Nothing to release
+  }
+
+  return failed ? 1 : 0;
+}
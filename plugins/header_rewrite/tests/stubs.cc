@@ -0,0 +1,501 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+// stubs.cc: just enough of the API to run the rules outside of the server. There is one
+// request, with a path and a list of (client request) header fields. Everything else is a
+// no-op.
+//
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <netinet/in.h>
+
+#include "ts/ts.h"
+
+#include "stubs.h"
+
+
+std::string stub_path;
+std::vector<StubField> stub_fields;
+
+TSMBuffer stub_bufp = reinterpret_cast<TSMBuffer>(&stub_fields);
+TSMLoc stub_hdr_loc = reinterpret_cast<TSMLoc>(&stub_path);
+
+static struct sockaddr_in stub_addr;
+
+// Field locations are the index in stub_fields, plus one
+static TSMLoc
+field_loc(size_t ix)
+{
+  return reinterpret_cast<TSMLoc>(ix + 1);
+}
+
+static StubField*
+field(TSMLoc loc)
+{
+  size_t ix = reinterpret_cast<size_t>(loc) - 1;
+
+  return (ix < stub_fields.size()) ? &stub_fields[ix] : NULL;
+}
+
+
+// The well known strings
+#define WKS(NAME, str) \
+  const char* TS_MIME_FIELD_##NAME = str; \
+  int TS_MIME_LEN_##NAME = sizeof(str) - 1;
+
+WKS(ACCEPT, "Accept")
+WKS(ACCEPT_CHARSET, "Accept-Charset")
+WKS(ACCEPT_ENCODING, "Accept-Encoding")
+WKS(ACCEPT_LANGUAGE, "Accept-Language")
+WKS(ACCEPT_RANGES, "Accept-Ranges")
+WKS(AGE, "Age")
+WKS(ALLOW, "Allow")
+WKS(APPROVED, "Approved")
+WKS(AUTHORIZATION, "Authorization")
+WKS(BYTES, "Bytes")
+WKS(CACHE_CONTROL, "Cache-Control")
+WKS(CLIENT_IP, "Client-Ip")
+WKS(CONNECTION, "Connection")
+WKS(CONTENT_BASE, "Content-Base")
+WKS(CONTENT_ENCODING, "Content-Encoding")
+WKS(CONTENT_LANGUAGE, "Content-Language")
+WKS(CONTENT_LENGTH, "Content-Length")
+WKS(CONTENT_LOCATION, "Content-Location")
+WKS(CONTENT_MD5, "Content-MD5")
+WKS(CONTENT_RANGE, "Content-Range")
+WKS(CONTENT_TYPE, "Content-Type")
+WKS(CONTROL, "Control")
+WKS(COOKIE, "Cookie")
+WKS(DATE, "Date")
+WKS(DISTRIBUTION, "Distribution")
+WKS(ETAG, "ETag")
+WKS(EXPECT, "Expect")
+WKS(EXPIRES, "Expires")
+WKS(FOLLOWUP_TO, "Followup-To")
+WKS(FROM, "From")
+WKS(HOST, "Host")
+WKS(IF_MATCH, "If-Match")
+WKS(IF_MODIFIED_SINCE, "If-Modified-Since")
+WKS(IF_NONE_MATCH, "If-None-Match")
+WKS(IF_RANGE, "If-Range")
+WKS(IF_UNMODIFIED_SINCE, "If-Unmodified-Since")
+WKS(KEEP_ALIVE, "Keep-Alive")
+WKS(KEYWORDS, "Keywords")
+WKS(LAST_MODIFIED, "Last-Modified")
+WKS(LINES, "Lines")
+WKS(LOCATION, "Location")
+WKS(MAX_FORWARDS, "Max-Forwards")
+WKS(MESSAGE_ID, "Message-ID")
+WKS(NEWSGROUPS, "Newsgroups")
+WKS(ORGANIZATION, "Organization")
+WKS(PATH, "Path")
+WKS(PRAGMA, "Pragma")
+WKS(PROXY_AUTHENTICATE, "Proxy-Authenticate")
+WKS(PROXY_AUTHORIZATION, "Proxy-Authorization")
+WKS(PROXY_CONNECTION, "Proxy-Connection")
+WKS(PUBLIC, "Public")
+WKS(RANGE, "Range")
+WKS(REFERENCES, "References")
+WKS(REFERER, "Referer")
+WKS(REPLY_TO, "Reply-To")
+WKS(RETRY_AFTER, "Retry-After")
+WKS(SENDER, "Sender")
+WKS(SERVER, "Server")
+WKS(SET_COOKIE, "Set-Cookie")
+WKS(STRICT_TRANSPORT_SECURITY, "Strict-Transport-Security")
+WKS(SUBJECT, "Subject")
+WKS(SUMMARY, "Summary")
+WKS(TE, "TE")
+WKS(TRANSFER_ENCODING, "Transfer-Encoding")
+WKS(UPGRADE, "Upgrade")
+WKS(USER_AGENT, "User-Agent")
+WKS(VARY, "Vary")
+WKS(VIA, "Via")
+WKS(WARNING, "Warning")
+WKS(WWW_AUTHENTICATE, "WWW-Authenticate")
+WKS(XREF, "Xref")
+WKS(X_FORWARDED_FOR, "X-Forwarded-For")
+
+#undef WKS
+
+const TSMLoc TS_NULL_MLOC = NULL;
+
+
+// Debugging and errors
+void
+TSDebug(const char*, const char*, ...)
+{
+}
+
+void
+TSError(const char* fmt, ...)
+{
+  va_list args;
+
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+
+void
+_TSReleaseAssert(const char* txt, const char* f, int l)
+{
+  fprintf(stderr, "%s:%d: failed assert `%s`\n", f, l, txt);
+  abort();
+}
+
+
+// Memory
+void
+_TSfree(void* ptr)
+{
+  free(ptr);
+}
+
+
+// Headers
+TSReturnCode
+TSHttpTxnClientReqGet(TSHttpTxn, TSMBuffer* bufp, TSMLoc* offset)
+{
+  *bufp = stub_bufp;
+  *offset = stub_hdr_loc;
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSHttpTxnClientRespGet(TSHttpTxn, TSMBuffer*, TSMLoc*)
+{
+  return TS_ERROR;
+}
+
+TSReturnCode
+TSHttpTxnServerReqGet(TSHttpTxn, TSMBuffer*, TSMLoc*)
+{
+  return TS_ERROR;
+}
+
+TSReturnCode
+TSHttpTxnServerRespGet(TSHttpTxn, TSMBuffer*, TSMLoc*)
+{
+  return TS_ERROR;
+}
+
+TSReturnCode
+TSHandleMLocRelease(TSMBuffer, TSMLoc, TSMLoc)
+{
+  return TS_SUCCESS;
+}
+
+TSMLoc
+TSMimeHdrFieldFind(TSMBuffer, TSMLoc, const char* name, int length)
+{
+  for (size_t i = 0; i < stub_fields.size(); ++i) {
+    const std::string& n = stub_fields[i].name;
+
+    if ((n.size() == static_cast<size_t>(length)) && (0 == strncasecmp(n.data(), name, length))) {
+      return field_loc(i);
+    }
+  }
+
+  return TS_NULL_MLOC;
+}
+
+TSMLoc
+TSMimeHdrFieldNextDup(TSMBuffer, TSMLoc, TSMLoc)
+{
+  return TS_NULL_MLOC;
+}
+
+const char*
+TSMimeHdrFieldValueStringGet(TSMBuffer, TSMLoc, TSMLoc loc, int, int* value_len_ptr)
+{
+  StubField* f = field(loc);
+
+  if (NULL == f) {
+    *value_len_ptr = 0;
+    return NULL;
+  }
+  *value_len_ptr = f->value.size();
+  return f->value.data();
+}
+
+TSReturnCode
+TSMimeHdrFieldValueStringSet(TSMBuffer, TSMLoc, TSMLoc loc, int, const char* value, int length)
+{
+  StubField* f = field(loc);
+
+  if (NULL == f) {
+    return TS_ERROR;
+  }
+  f->value.assign(value, length < 0 ? strlen(value) : length);
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMimeHdrFieldCreateNamed(TSMBuffer, TSMLoc, const char* name, int name_len, TSMLoc* locp)
+{
+  stub_fields.push_back(StubField(std::string(name, name_len), ""));
+  *locp = field_loc(stub_fields.size() - 1);
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMimeHdrFieldAppend(TSMBuffer, TSMLoc, TSMLoc)
+{
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSMimeHdrFieldDestroy(TSMBuffer, TSMLoc, TSMLoc loc)
+{
+  StubField* f = field(loc);
+
+  if (f) {
+    f->name.clear();
+  }
+  return TS_SUCCESS;
+}
+
+int
+TSHttpHdrLengthGet(TSMBuffer, TSMLoc)
+{
+  int len = 0;
+
+  for (size_t i = 0; i < stub_fields.size(); ++i) {
+    len += stub_fields[i].name.size() + stub_fields[i].value.size() + 4;
+  }
+  return len;
+}
+
+const char*
+TSHttpHdrMethodGet(TSMBuffer, TSMLoc, int* length)
+{
+  *length = 3;
+  return "GET";
+}
+
+TSHttpStatus
+TSHttpHdrStatusGet(TSMBuffer, TSMLoc)
+{
+  return TS_HTTP_STATUS_NONE;
+}
+
+TSReturnCode
+TSHttpHdrStatusSet(TSMBuffer, TSMLoc, TSHttpStatus)
+{
+  return TS_SUCCESS;
+}
+
+const char*
+TSHttpHdrReasonLookup(TSHttpStatus)
+{
+  return "OK";
+}
+
+TSReturnCode
+TSHttpHdrReasonSet(TSMBuffer, TSMLoc, const char*, int)
+{
+  return TS_SUCCESS;
+}
+
+
+// URLs, there's only the path
+TSReturnCode
+TSHttpHdrUrlGet(TSMBuffer, TSMLoc, TSMLoc* locp)
+{
+  *locp = stub_hdr_loc;
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSHttpTxnPristineUrlGet(TSHttpTxn, TSMBuffer* bufp, TSMLoc* url_loc)
+{
+  *bufp = stub_bufp;
+  *url_loc = stub_hdr_loc;
+  return TS_SUCCESS;
+}
+
+const char*
+TSUrlPathGet(TSMBuffer, TSMLoc, int* length)
+{
+  *length = stub_path.size();
+  return stub_path.data();
+}
+
+TSReturnCode
+TSUrlPathSet(TSMBuffer, TSMLoc, const char* value, int length)
+{
+  stub_path.assign(value, length < 0 ? strlen(value) : length);
+  return TS_SUCCESS;
+}
+
+const char*
+TSUrlSchemeGet(TSMBuffer, TSMLoc, int* length)
+{
+  *length = 4;
+  return "http";
+}
+
+int
+TSUrlPortGet(TSMBuffer, TSMLoc)
+{
+  return 80;
+}
+
+const char*
+TSUrlHttpQueryGet(TSMBuffer, TSMLoc, int* length)
+{
+  *length = 0;
+  return NULL;
+}
+
+TSReturnCode
+TSUrlHttpQuerySet(TSMBuffer, TSMLoc, const char*, int)
+{
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSUrlHostSet(TSMBuffer, TSMLoc, const char*, int)
+{
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSUrlPortSet(TSMBuffer, TSMLoc, int)
+{
+  return TS_SUCCESS;
+}
+
+TSParseResult
+TSUrlParse(TSMBuffer, TSMLoc, const char**, const char*)
+{
+  return TS_PARSE_DONE;
+}
+
+
+// Transactions
+struct sockaddr const*
+TSHttpTxnClientAddrGet(TSHttpTxn)
+{
+  stub_addr.sin_family = AF_INET;
+  stub_addr.sin_addr.s_addr = htonl(0x0a000001); // 10.0.0.1
+  return reinterpret_cast<struct sockaddr const*>(&stub_addr);
+}
+
+struct sockaddr const*
+TSHttpTxnIncomingAddrGet(TSHttpTxn txnp)
+{
+  return TSHttpTxnClientAddrGet(txnp);
+}
+
+TSReturnCode
+TSHttpIsInternalRequest(TSHttpTxn)
+{
+  return TS_ERROR;
+}
+
+void
+TSHttpTxnSetHttpRetStatus(TSHttpTxn, TSHttpStatus)
+{
+}
+
+void
+TSSkipRemappingSet(TSHttpTxn, int)
+{
+}
+
+TSReturnCode
+TSHttpTxnClientPacketTosSet(TSHttpTxn, int)
+{
+  return TS_SUCCESS;
+}
+
+void
+TSHttpTxnActiveTimeoutSet(TSHttpTxn, int)
+{
+}
+
+void
+TSHttpTxnConnectTimeoutSet(TSHttpTxn, int)
+{
+}
+
+void
+TSHttpTxnDNSTimeoutSet(TSHttpTxn, int)
+{
+}
+
+void
+TSHttpTxnNoActivityTimeoutSet(TSHttpTxn, int)
+{
+}
+
+TSReturnCode
+TSHttpTxnConfigFind(const char*, int, TSOverridableConfigKey*, TSRecordDataType*)
+{
+  return TS_ERROR;
+}
+
+TSReturnCode
+TSHttpTxnConfigIntSet(TSHttpTxn, TSOverridableConfigKey, TSMgmtInt)
+{
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSHttpTxnConfigFloatSet(TSHttpTxn, TSOverridableConfigKey, TSMgmtFloat)
+{
+  return TS_SUCCESS;
+}
+
+TSReturnCode
+TSHttpTxnConfigStringSet(TSHttpTxn, TSOverridableConfigKey, const char*, int)
+{
+  return TS_SUCCESS;
+}
+
+
+// Stats and mutexes
+int
+TSStatCreate(const char*, TSRecordDataType, TSStatPersistence, TSStatSync)
+{
+  return 0;
+}
+
+TSReturnCode
+TSStatFindName(const char*, int*)
+{
+  return TS_ERROR;
+}
+
+void
+TSStatIntIncrement(int, TSMgmtInt)
+{
+}
+
+TSMutex
+TSMutexCreate(void)
+{
+  return NULL;
+}
@@ -0,0 +1,46 @@
+/*
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+  http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+//////////////////////////////////////////////////////////////////////////////////////////////
+//
+// The request seen by the stubbed out API, see stubs.cc
+//
+#ifndef __STUBS_H__
+#define __STUBS_H__ 1
+
+#include <string>
+#include <vector>
+
+#include "ts/ts.h"
+
+
+struct StubField {
+  StubField(const std::string& n, const std::string& v) : name(n), value(v) { }
+
+  std::string name; // Empty once destroyed
+  std::string value;
+};
+
+extern std::string stub_path;
+extern std::vector<StubField> stub_fields;
+
+// What the API hands out for the request header, and its URL
+extern TSMBuffer stub_bufp;
+extern TSMLoc stub_hdr_loc;
+
+
+#endif // __STUBS_H
@@ -31,6 +31,7 @@
 #include "condition.h"
 #include "factory.h"
 #include "parser.h"
+#include "expander.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -43,11 +44,16 @@ class Value : Statement
 {
 public:
   Value()
-    : _need_expander(false), _value(""), _int_value(0), _float_value(0.0), _cond_val(NULL)
+    : _need_expander(false), _value(""), _int_value(0), _float_value(0.0), _cond_val(NULL), _expander(NULL)
   {
     TSDebug(PLUGIN_NAME_DBG, "Calling CTOR for Value");
   }
 
+  ~Value()
+  {
+    delete _expander;
+  }
+
   void
   set_value(const std::string& val)
   {
@@ -61,8 +67,7 @@ public:
       }
     } else if (_value.find("%<") != std::string::npos) { // It has a Variable to expand
       _need_expander = true; // And this is clearly not an integer or float ...
-      // TODO: This is still not optimal, we should pre-parse the _value string here,
-      // and perhaps populate a per-Value VariableExpander that holds state.
+      _expander = new VariableExpander(_value);
     } else {
       _int_value = strtol(_value.c_str(), NULL, 10);
       _float_value = strtod(_value.c_str(), NULL);
@@ -79,6 +84,17 @@ public:
     }
   }
 
+  // Same as append_value(), with the variables expanded (if there are any)
+  void
+  append_expanded_value(std::string& s, const Resources& res) const
+  {
+    if (_expander) {
+      s += _expander->expand(res);
+    } else {
+      append_value(s, res);
+    }
+  }
+
   const std::string& get_value() const { return _value; }
   size_t size() const { return _value.size(); }
   int get_int_value() const { return _int_value; }
@@ -95,6 +111,7 @@ private:
   int _int_value;
   double _float_value;
   Condition* _cond_val;
+  VariableExpander* _expander;
 };
 
 
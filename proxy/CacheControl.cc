@@ -125,7 +125,7 @@ int
 cacheControlFile_CB(const char * /* name ATS_UNUSED */, RecDataT /* data_type ATS_UNUSED */,
                     RecData /* data ATS_UNUSED */, void * /* cookie ATS_UNUSED */)
 {
-  eventProcessor.schedule_imm(new CC_UpdateContinuation(reconfig_mutex), ET_CACHE);
+  eventProcessor.schedule_imm(new CC_UpdateContinuation(reconfig_mutex), ET_TASK);
   return 0;
 }
 
@@ -157,7 +157,8 @@ initCacheControl()
 //
 //  Called when the cache.conf file changes.  Since it called
 //   infrequently, we do the load of new file as blocking I/O and
-//   lock aquire is also blocking
+//   lock aquire is also blocking. This runs on a task thread; the
+//   new table is only published once it is completely built.
 //
 void
 reloadCacheControl()
@@ -165,9 +166,8 @@ reloadCacheControl()
   CC_table *newTable;
 
   Debug("cache_control", "cache.config updated, reloading");
-  eventProcessor.schedule_in(new CC_FreerContinuation(CacheControlTable), CACHE_CONTROL_TIMEOUT, ET_CACHE);
   newTable = new CC_table("proxy.config.cache.control.filename", modulePrefix, &http_dest_tags);
-  ink_atomic_swap(&CacheControlTable, newTable);
+  eventProcessor.schedule_in(new CC_FreerContinuation(ink_atomic_swap(&CacheControlTable, newTable)), CACHE_CONTROL_TIMEOUT, ET_TASK);
 }
 
 void
@@ -48,6 +48,49 @@
  *   Place all template instantiations at the bottom of the file
  ****************************************************************/
 
+enum
+{
+  matcher_host_lookups_stat,
+  matcher_host_lookup_time_stat,
+  matcher_regex_lookups_stat,
+  matcher_regex_lookup_time_stat,
+  matcher_url_lookups_stat,
+  matcher_url_lookup_time_stat,
+  matcher_ip_lookups_stat,
+  matcher_ip_lookup_time_stat,
+  matcher_host_regex_lookups_stat,
+  matcher_host_regex_lookup_time_stat,
+  matcher_stat_count
+};
+
+static RecRawStatBlock *matcher_rsb = NULL;
+static int32_t matcher_lookup_time = 0;
+
+//
+// void initControlMatcherStats()
+//
+//   Registers the lookup count and the total lookup time (in
+//     nanoseconds) for each kind of matcher table. The stats are
+//     shared by every configuration file that uses a ControlMatcher.
+//     Timing a lookup costs two clock reads per table, so it is only
+//     done when proxy.config.stats.matcher_lookup_time is set.
+//
+void
+initControlMatcherStats()
+{
+  static const char *tables[] = { "host", "regex", "url", "ip", "host_regex" };
+  char name[128];
+
+  matcher_rsb = RecAllocateRawStatBlock((int) matcher_stat_count);
+  for (unsigned i = 0; i < countof(tables); i++) {
+    snprintf(name, sizeof(name), "proxy.process.matcher.%s.lookups", tables[i]);
+    RecRegisterRawStat(matcher_rsb, RECT_PROCESS, name, RECD_INT, RECP_PERSISTENT, 2 * i, RecRawStatSyncSum);
+    snprintf(name, sizeof(name), "proxy.process.matcher.%s.lookup_time", tables[i]);
+    RecRegisterRawStat(matcher_rsb, RECT_PROCESS, name, RECD_INT, RECP_PERSISTENT, 2 * i + 1, RecRawStatSyncSum);
+  }
+  REC_EstablishStaticConfigInt32(matcher_lookup_time, "proxy.config.stats.matcher_lookup_time");
+}
+
 
 
 // HttpRequestData accessors
@@ -366,7 +409,9 @@ template<class Data, class Result> void UrlMatcher<Data, Result>::Match(RequestD
 // RegexMatcher<Data,Result>::RegexMatcher()
 //
 template<class Data, class Result> RegexMatcher<Data, Result>::RegexMatcher(const char *name, const char *filename)
-  : re_array(NULL),
+  : re_combined(NULL),
+    re_combined_extra(NULL),
+    re_array(NULL),
     re_str(NULL),
     data_array(NULL),
     array_len(-1),
@@ -381,6 +426,16 @@ template<class Data, class Result> RegexMatcher<Data, Result>::RegexMatcher(cons
 //
 template<class Data, class Result> RegexMatcher<Data, Result>::~RegexMatcher()
 {
+  if (re_combined_extra) {
+#ifdef PCRE_CONFIG_JIT
+    pcre_free_study(re_combined_extra);
+#else
+    pcre_free(re_combined_extra);
+#endif
+  }
+  if (re_combined) {
+    pcre_free(re_combined);
+  }
   for (int i = 0; i < num_el; i++) {
     pcre_free(re_array[i]);
     ats_free(re_str[i]);
@@ -480,16 +535,131 @@ template<class Data, class Result> char *RegexMatcher<Data, Result>::NewEntry(ma
   return errBuf;
 }
 
+//
+// static bool regex_is_combinable(const char* pattern)
+//
+//   Returns false for patterns that can not be safely wrapped in
+//     a group and joined with others: numbered or named back
+//     references and recursion depend on group numbering, and
+//     quoting, extended mode comments or leading verbs can swallow
+//     the closing parenthesis.
+//
+static bool
+regex_is_combinable(const char *pattern)
+{
+  for (const char *p = pattern; *p; ++p) {
+    if (p[0] == '\\' && p[1]) {
+      char c = p[1];
+      if ((c >= '1' && c <= '9') || c == 'g' || c == 'k' || c == 'Q') {
+        return false;
+      }
+      ++p;
+    } else if (p[0] == '(' && (p[1] == '*' || (p[1] == '?' && p[2] && strchr("PR&0123456789+-x", p[2])))) {
+      return false;
+    } else if (p[0] == '(' && p[1] == '?') {
+      // Inline option settings, look for extended mode.
+      for (const char *q = p + 2; *q && (isalpha(*q) || *q == '-'); ++q) {
+        if (*q == 'x') {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+//
+// void RegexMatcher<Data,Result>::Compile()
+//
+//   Called once all entries are added. Builds a single alternation
+//     of every regex in the table so that a request that matches
+//     none of them (the common case) costs one scan instead of one
+//     per rule. Each rule still has to be run when the combined
+//     expression matches because every matching rule updates the
+//     result.
+//
+template<class Data, class Result> void RegexMatcher<Data, Result>::Compile()
+{
+  const char *error;
+  int erroffset;
+  int study_opts = 0;
+  size_t len = 0;
+
+  if (num_el <= 1) {
+    return;
+  }
+
+  for (int i = 0; i < num_el; i++) {
+    if (!regex_is_combinable(re_str[i])) {
+      Debug("matcher", "%s regex at line %d can not be combined, scanning linearly", matcher_name, data_array[i].line_num);
+      return;
+    }
+    len += strlen(re_str[i]) + 6;
+  }
+
+  ats_scoped_str combined((char *)ats_malloc(len + 1));
+  char *p = combined;
+
+  for (int i = 0; i < num_el; i++) {
+    p += snprintf(p, len + 1 - (p - combined), "%s(?:%s)", i ? "|" : "", re_str[i]);
+  }
+
+  re_combined = pcre_compile(combined, 0, &error, &erroffset, NULL);
+  if (!re_combined) {
+    Debug("matcher", "%s failed to compile combined regex : %s", matcher_name, error);
+    return;
+  }
+
+#ifdef PCRE_CONFIG_JIT
+  study_opts |= PCRE_STUDY_JIT_COMPILE;
+#endif
+  re_combined_extra = pcre_study(re_combined, study_opts, &error);
+  Debug("matcher", "%s combined %d regexs", matcher_name, num_el);
+}
+
+//
+// void RegexMatcher<Data,Result>::MatchString(const char* str, RequestData* rdata, Result* result)
+//
+//   Conducts a linear search through the regex array and
+//     updates arg result for each regex that matches arg str.
+//     The linear search is skipped if the combined regex does
+//     not match.
+//
+template<class Data, class Result> void RegexMatcher<Data, Result>::MatchString(const char *str, RequestData * rdata, Result * result)
+{
+  int len = strlen(str);
+  int r;
+
+  if (re_combined) {
+    r = pcre_exec(re_combined, re_combined_extra, str, len, 0, 0, NULL, 0);
+    if (r == PCRE_ERROR_NOMATCH) {
+      return;
+    }
+    // On a match or an error (e.g. a resource limit) fall through to the per rule scan.
+  }
+
+  for (int i = 0; i < num_el; i++) {
+
+    r = pcre_exec(re_array[i], NULL, str, len, 0, 0, NULL, 0);
+    if (r > -1) {
+      Debug("matcher", "%s Matched %s with regex at line %d", matcher_name, str, data_array[i].line_num);
+      data_array[i].UpdateMatch(result, rdata);
+    } else if (r < -1) {
+      // An error has occured
+      Warning("Error [%d] matching regex at line %d.", r, data_array[i].line_num);
+    } // else it's -1 which means no match was found.
+
+  }
+}
+
 //
 // void RegexMatcher<Data,Result>::Match(RequestData* rdata, Result* result)
 //
-//   Coduncts a linear search through the regex array and
-//     updates arg result for each regex that matches arg URL
+//   Matches the regex array against the URL
 //
 template<class Data, class Result> void RegexMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
   char *url_str;
-  int r;
 
   // Check to see there is any work to before we copy the
   //   URL
@@ -509,18 +679,7 @@ template<class Data, class Result> void RegexMatcher<Data, Result>::Match(Reques
   // HttpRequestData::get_string(); therefore, no need to call again here.
   // unescapifyStr(url_str);
 
-  for (int i = 0; i < num_el; i++) {
-
-    r = pcre_exec(re_array[i], NULL, url_str, strlen(url_str), 0, 0, NULL, 0);
-    if (r > -1) {
-      Debug("matcher", "%s Matched %s with regex at line %d", matcher_name, url_str, data_array[i].line_num);
-      data_array[i].UpdateMatch(result, rdata);
-    } else if (r < -1) {
-      // An error has occured
-      Warning("Error [%d] matching regex at line %d.", r, data_array[i].line_num);
-    } // else it's -1 which means no match was found.
-
-  }
+  MatchString(url_str, rdata, result);
   ats_free(url_str);
 }
 
@@ -536,13 +695,11 @@ HostRegexMatcher<Data, Result>::HostRegexMatcher(const char *name, const char *f
 //
 // void HostRegexMatcher<Data,Result>::Match(RequestData* rdata, Result* result)
 //
-//   Conducts a linear search through the regex array and
-//     updates arg result for each regex that matches arg host_regex
+//   Matches the regex array against the host
 //
 template<class Data, class Result> void HostRegexMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
   const char *url_str;
-  int r;
 
   // Check to see there is any work to before we copy the
   //   URL
@@ -557,17 +714,7 @@ template<class Data, class Result> void HostRegexMatcher<Data, Result>::Match(Re
   if (url_str == NULL) {
     url_str = "";
   }
-  for (int i = 0; i < this->num_el; i++) {
-    r = pcre_exec(this->re_array[i], NULL, url_str, strlen(url_str), 0, 0, NULL, 0);
-    if (r != -1) {
-      Debug("matcher", "%s Matched %s with regex at line %d",
-            const_cast<char*>(this->matcher_name), url_str, this->data_array[i].line_num);
-      this->data_array[i].UpdateMatch(result, rdata);
-    } else {
-      // An error has occured
-      Warning("error matching regex at line %d", this->data_array[i].line_num);
-    }
-  }
+  this->MatchString(url_str, rdata, result);
 }
 
 //
@@ -763,22 +910,54 @@ template<class Data, class Result> void ControlMatcher<Data, Result>::Print()
 //
 //   Queries each table for the Result*
 //
+static inline ink_hrtime
+matcher_stat_start(EThread *ethread)
+{
+  return (ethread && matcher_lookup_time) ? ink_get_hrtime_internal() : 0;
+}
+
+static inline void
+matcher_stat_update(EThread *ethread, int stat, ink_hrtime start)
+{
+  // Lookups made before the event system is running (or the stats
+  //   are registered) are not counted.
+  if (ethread) {
+    RecIncrRawStat(matcher_rsb, ethread, stat, 1);
+    if (start) {
+      RecIncrRawStat(matcher_rsb, ethread, stat + 1, ink_get_hrtime_internal() - start);
+    }
+  }
+}
+
 template<class Data, class Result> void ControlMatcher<Data, Result>::Match(RequestData * rdata, Result * result)
 {
+  EThread *ethread = matcher_rsb ? this_ethread() : NULL;
+  ink_hrtime start;
+
   if (hostMatch != NULL) {
+    start = matcher_stat_start(ethread);
     hostMatch->Match(rdata, result);
+    matcher_stat_update(ethread, matcher_host_lookups_stat, start);
   }
   if (reMatch != NULL) {
+    start = matcher_stat_start(ethread);
     reMatch->Match(rdata, result);
+    matcher_stat_update(ethread, matcher_regex_lookups_stat, start);
   }
   if (urlMatch != NULL) {
+    start = matcher_stat_start(ethread);
     urlMatch->Match(rdata, result);
+    matcher_stat_update(ethread, matcher_url_lookups_stat, start);
   }
   if (ipMatch != NULL) {
+    start = matcher_stat_start(ethread);
     ipMatch->Match(rdata->get_ip(), rdata, result);
+    matcher_stat_update(ethread, matcher_ip_lookups_stat, start);
   }
   if (hrMatch != NULL) {
+    start = matcher_stat_start(ethread);
     hrMatch->Match(rdata, result);
+    matcher_stat_update(ethread, matcher_host_regex_lookups_stat, start);
   }
 }
 
@@ -948,6 +1127,13 @@ template<class Data, class Result> int ControlMatcher<Data, Result>::BuildTableF
 
   ink_assert(second_pass == numEntries);
 
+  if (reMatch != NULL) {
+    reMatch->Compile();
+  }
+  if (hrMatch != NULL) {
+    hrMatch->Compile();
+  }
+
   if (is_debug_tag_set("matcher")) {
     Print();
   }
@@ -192,12 +192,17 @@ public:
   void Match(RequestData * rdata, Result * result);
   void AllocateSpace(int num_entries);
   char *NewEntry(matcher_line * line_info);
+  void Compile();
   void Print();
 
   int getNumElements() { return num_el; }
   Data *getDataArray() { return data_array; }
 
 protected:
+  void MatchString(const char *str, RequestData * rdata, Result * result);
+
+  pcre *re_combined;            // all regexs as one alternation, used to skip the table
+  pcre_extra *re_combined_extra;
   pcre** re_array;              // array of compiled regexs
   char **re_str;                // array of uncompiled regex strings
   Data *data_array;             // data array.  Corresponds to re_array
@@ -265,6 +270,9 @@ public:
 #define ALLOW_URL_TABLE 1 << 4
 #define DONT_BUILD_TABLE     1 << 5     // for testing
 
+// Register the per table lookup statistics.
+void initControlMatcherStats();
+
 template<class Data, class Result> class ControlMatcher {
 public:
   // Parameter name must not be deallocated before this
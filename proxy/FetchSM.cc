@@ -613,10 +613,7 @@ FetchSM::ext_read_data(char *buf, size_t len)
   if (!header_done)
     return 0;
 
-  if (check_chunked() && (fetch_flags & TS_FETCH_FLAGS_DECHUNK))
-    reader = (tsapi_bufferreader*)chunked_handler.dechunked_reader;
-  else
-    reader = (TSIOBufferReader)resp_reader;
+  reader = (TSIOBufferReader)ext_get_body_reader();
 
   already = 0;
   blk = TSIOBufferReaderStart(reader);
@@ -646,6 +643,46 @@ FetchSM::ext_read_data(char *buf, size_t len)
   return already;
 }
 
+//
+// The reader of the response body, dechunked if the fetch was created
+// with TS_FETCH_FLAGS_DECHUNK, or NULL until the header is done. The
+// blocks it holds are those PluginVC passed over, so callers can walk
+// them and consume what they used with ext_consume_data(), rather than
+// having them copied by ext_read_data().
+//
+IOBufferReader *
+FetchSM::ext_get_body_reader()
+{
+  if (!header_done)
+    return NULL;
+
+  if (check_chunked() && (fetch_flags & TS_FETCH_FLAGS_DECHUNK))
+    return chunked_handler.dechunked_reader;
+
+  return resp_reader;
+}
+
+int64_t
+FetchSM::ext_consume_data(int64_t len)
+{
+  if (fetch_flags & TS_FETCH_FLAGS_NEWLOCK) {
+    MUTEX_TRY_LOCK(lock, mutex, this_ethread());
+    if (!lock.is_locked())
+      return 0;
+  }
+
+  IOBufferReader *reader = ext_get_body_reader();
+
+  if (!reader || len <= 0)
+    return 0;
+
+  ink_assert(len <= reader->read_avail());
+  reader->consume(len);
+  resp_received_body_len += len;
+  read_vio->reenable();
+  return len;
+}
+
 void
 FetchSM::ext_destroy()
 {
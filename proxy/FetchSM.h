@@ -118,6 +118,8 @@ public:
   void ext_lanuch();
   void ext_destroy();
   ssize_t ext_read_data(char *buf, size_t len);
+  IOBufferReader *ext_get_body_reader();
+  int64_t ext_consume_data(int64_t len);
   void ext_write_data(const void *data, size_t len);
   void ext_set_user_data(void *data);
   void* ext_get_user_data();
@@ -118,6 +118,7 @@ void
 IpAllow::Print() {
   std::ostringstream s;
   s << _map.getCount() << " ACL entries";
+  s << " (" << _lookup.getMemorySize() << " bytes)";
   s << '.';
   for ( IpMap::iterator spot(_map.begin()), limit(_map.end())
       ; spot != limit
@@ -314,6 +315,7 @@ IpAllow::BuildTable()
       spot->setData(&_acls[reinterpret_cast<size_t>(spot->data())]);
     }
   }
+  _lookup.freeze(_map);
 
   if (is_debug_tag_set("ip-allow")) {
     Print();
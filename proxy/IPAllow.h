@@ -34,6 +34,7 @@
 #include "Main.h"
 #include "hdrs/HTTP.h"
 #include "ts/IpMap.h"
+#include "ts/IpMapFrozen.h"
 #include "ts/Vec.h"
 #include "ProxyConfig.h"
 
@@ -130,6 +131,7 @@ private:
   const char *module_name;
   const char *action;
   IpMap _map;
+  IpMapFrozen _lookup; ///< Read optimized copy of @a _map used by @c match.
   Vec<AclRecord> _acls;
 };
 
@@ -141,7 +143,7 @@ IpAllow::match(IpEndpoint const* ip) const {
 inline AclRecord *
 IpAllow::match(sockaddr const* ip) const {
   void *raw;
-  if (_map.contains(ip, &raw)) {
+  if (_lookup.contains(ip, &raw)) {
     return static_cast<AclRecord*>(raw);
   }
   return NULL;
@@ -636,6 +636,27 @@ sdk_sanity_check_hook_id(TSHttpHookID id)
   return TS_SUCCESS;
 }
 
+TSReturnCode
+sdk_sanity_check_inline_hook_id(TSHttpHookID id)
+{
+  switch (id) {
+  case TS_HTTP_TXN_START_HOOK:
+  case TS_HTTP_PRE_REMAP_HOOK:
+  case TS_HTTP_POST_REMAP_HOOK:
+  case TS_HTTP_READ_REQUEST_HDR_HOOK:
+  case TS_HTTP_OS_DNS_HOOK:
+  case TS_HTTP_SEND_REQUEST_HDR_HOOK:
+  case TS_HTTP_READ_CACHE_HDR_HOOK:
+  case TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK:
+  case TS_HTTP_READ_RESPONSE_HDR_HOOK:
+  case TS_HTTP_SEND_RESPONSE_HDR_HOOK:
+  case TS_HTTP_TXN_CLOSE_HOOK:
+    return TS_SUCCESS;
+  default:
+    return TS_ERROR;
+  }
+}
+
 TSReturnCode
 sdk_sanity_check_lifecycle_hook_id(TSLifecycleHookID id)
 {
@@ -1227,6 +1248,18 @@ APIHook::invoke(int event, void *edata)
   return m_cont->handleEvent(event, edata);
 }
 
+int
+APIHook::invoke_inline(int event, void *edata)
+{
+  // The plain call of handle_event(), without the event counting and
+  // deferred deletion, which only concern scheduled events.
+  ink_release_assert(m_cont->m_free_magic != INKCONT_INTERN_MAGIC_DEAD);
+  if (m_cont->m_deleted) {
+    return TS_EVENT_HTTP_CONTINUE;
+  }
+  return m_cont->m_event_func((TSCont) m_cont, (TSEvent) event, edata);
+}
+
 APIHook *
 APIHook::next() const
 {
@@ -1235,23 +1268,25 @@ APIHook::next() const
 
 
 void
-APIHooks::prepend(INKContInternal *cont)
+APIHooks::prepend(INKContInternal *cont, bool inline_p)
 {
   APIHook *api_hook;
 
   api_hook = apiHookAllocator.alloc();
   api_hook->m_cont = cont;
+  api_hook->m_inline = inline_p;
 
   m_hooks.push(api_hook);
 }
 
 void
-APIHooks::append(INKContInternal *cont)
+APIHooks::append(INKContInternal *cont, bool inline_p)
 {
   APIHook *api_hook;
 
   api_hook = apiHookAllocator.alloc();
   api_hook->m_cont = cont;
+  api_hook->m_inline = inline_p;
 
   m_hooks.enqueue(api_hook);
 }
@@ -4416,6 +4451,15 @@ TSHttpHookAdd(TSHttpHookID id, TSCont contp)
   }
 }
 
+void
+TSHttpHookAddInline(TSHttpHookID id, TSCont contp)
+{
+  sdk_assert(sdk_sanity_check_continuation(contp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_inline_hook_id(id) == TS_SUCCESS);
+
+  http_global_hooks->append(id, reinterpret_cast<INKContInternal*>(contp), true);
+}
+
 void
 TSLifecycleHookAdd(TSLifecycleHookID id, TSCont contp)
 {
@@ -4518,6 +4562,27 @@ TSHttpTxnHookAdd(TSHttpTxn txnp, TSHttpHookID id, TSCont contp)
   sm->txn_hook_append(id, (INKContInternal *) contp);
 }
 
+void
+TSHttpTxnHookAddInline(TSHttpTxn txnp, TSHttpHookID id, TSCont contp)
+{
+  sdk_assert(sdk_sanity_check_txn(txnp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_continuation(contp) == TS_SUCCESS);
+  sdk_assert(sdk_sanity_check_inline_hook_id(id) == TS_SUCCESS);
+
+  HttpSM *sm = (HttpSM *) txnp;
+  sm->txn_hook_append(id, (INKContInternal *) contp, true);
+}
+
+int
+TSEventThreadIndexGet(void)
+{
+  EThread *ethread = this_ethread();
+
+  if (!ethread || ethread->tt != REGULAR)
+    return -1;
+  return ethread->id;
+}
+
 
 // Private api function for gzip plugin.
 //  This function should only appear in TsapiPrivate.h
@@ -6678,6 +6743,23 @@ TSCacheScan(TSCont contp, TSCacheKey key, int KB_per_second)
   return reinterpret_cast<TSAction>(cacheProcessor.scan(i, 0, 0, KB_per_second));
 }
 
+TSAction
+TSCacheScanParallel(TSCont contp, TSCacheKey key, int KB_per_second)
+{
+  sdk_assert(sdk_sanity_check_iocore_structure(contp) == TS_SUCCESS);
+  // NOTE: key can be NULl here, so don't check for it.
+
+  FORCE_PLUGIN_MUTEX(contp);
+
+  INKContInternal *i = (INKContInternal *) contp;
+
+  if (key) {
+    CacheInfo *info = (CacheInfo *) key;
+    return (TSAction)cacheProcessor.scan_parallel(i, info->hostname, info->len, KB_per_second);
+  }
+  return reinterpret_cast<TSAction>(cacheProcessor.scan_parallel(i, 0, 0, KB_per_second));
+}
+
 
 /************************   REC Stats API    **************************/
 int
@@ -7357,6 +7439,22 @@ TSFetchReadData(TSFetchSM fetch_sm, void *buf, size_t len)
   return ((FetchSM*)fetch_sm)->ext_read_data((char *)buf, len);
 }
 
+TSIOBufferReader
+TSFetchBodyReaderGet(TSFetchSM fetch_sm)
+{
+  sdk_assert(sdk_sanity_check_fetch_sm(fetch_sm) == TS_SUCCESS);
+
+  return (TSIOBufferReader)((FetchSM*)fetch_sm)->ext_get_body_reader();
+}
+
+int64_t
+TSFetchBodyConsume(TSFetchSM fetch_sm, int64_t len)
+{
+  sdk_assert(sdk_sanity_check_fetch_sm(fetch_sm) == TS_SUCCESS);
+
+  return ((FetchSM*)fetch_sm)->ext_consume_data(len);
+}
+
 void
 TSFetchLaunch(TSFetchSM fetch_sm)
 {
@@ -139,7 +139,11 @@ class APIHook
 {
 public:
   INKContInternal * m_cont;
+  bool m_inline; ///< Called synchronously, see TSHttpHookAddInline.
   int invoke(int event, void *edata);
+  /// Call the handler of an inline hook directly.
+  /// @return the event the handler returned.
+  int invoke_inline(int event, void *edata);
   APIHook *next() const;
   LINK(APIHook, m_link);
 };
@@ -148,8 +152,8 @@ public:
 class APIHooks
 {
 public:
-  void prepend(INKContInternal * cont);
-  void append(INKContInternal * cont);
+  void prepend(INKContInternal * cont, bool inline_p = false);
+  void append(INKContInternal * cont, bool inline_p = false);
   APIHook *get() const;
   void clear();
   bool is_empty() const;
@@ -179,6 +183,8 @@ APIHooks::invoke(int event, void* data) {
 
     @note The minimum value for a hook ID is zero. Therefore the template parameter @a N_ID should be one more than the
     maximum hook ID so the valid ids are 0..(N-1) in the standard C array style.
+
+    @note The container keeps a mask of the ids with hooks, so @a N must not exceed 64.
  */
 template <
   typename ID, ///< Type of hook ID
@@ -193,9 +199,9 @@ public:
   /// Remove all hooks.
   void clear();
   /// Add the hook @a cont to the front of the hooks for @a id.
-  void prepend(ID id, INKContInternal * cont);
+  void prepend(ID id, INKContInternal * cont, bool inline_p = false);
   /// Add the hook @a cont to the end of the hooks for @a id.
-  void append(ID id, INKContInternal * cont);
+  void append(ID id, INKContInternal * cont, bool inline_p = false);
   /// Get the list of hooks for @a id.
   APIHook *get(ID id) const;
   /// @return @c true if @a id is a valid id, @c false otherwise.
@@ -214,15 +220,22 @@ public:
   /// @return @c true if any hooks of type @a id are present.
   bool has_hooks_for(ID id) const;
 
+  /// The ids with hooks, bit @c 1<<id being set for each.
+  /// The masks of several containers can be or'ed to check them all at once.
+  uint64_t hooks_mask() const;
+
+  /// The bit of @a id in hooks_mask().
+  static uint64_t hook_bit(ID id);
+
 private:
-  bool hooks_p; ///< Flag for (not) empty container.
+  uint64_t m_hooks_mask; ///< Bits of the (not) empty lists.
   /// The array of hooks lists.
   APIHooks m_hooks[N];
 };
 
 template < typename ID, ID N >
 FeatureAPIHooks<ID,N>::FeatureAPIHooks():
-hooks_p(false)
+m_hooks_mask(0)
 {
 }
 
@@ -239,23 +252,23 @@ FeatureAPIHooks<ID,N>::clear()
   for (int i = 0; i < N; ++i) {
     m_hooks[i].clear();
   }
-  hooks_p = false;
+  m_hooks_mask = 0;
 }
 
 template < typename ID, ID N >
 void
-FeatureAPIHooks<ID,N>::prepend(ID id, INKContInternal *cont)
+FeatureAPIHooks<ID,N>::prepend(ID id, INKContInternal *cont, bool inline_p)
 {
-  hooks_p = true;
-  m_hooks[id].prepend(cont);
+  m_hooks_mask |= hook_bit(id);
+  m_hooks[id].prepend(cont, inline_p);
 }
 
 template < typename ID, ID N >
 void
-FeatureAPIHooks<ID,N>::append(ID id, INKContInternal *cont)
+FeatureAPIHooks<ID,N>::append(ID id, INKContInternal *cont, bool inline_p)
 {
-  hooks_p = true;
-  m_hooks[id].append(cont);
+  m_hooks_mask |= hook_bit(id);
+  m_hooks[id].append(cont, inline_p);
 }
 
 template < typename ID, ID N >
@@ -276,7 +289,28 @@ template < typename ID, ID N >
 bool
 FeatureAPIHooks<ID,N>::has_hooks() const
 {
-  return hooks_p;
+  return m_hooks_mask != 0;
+}
+
+template < typename ID, ID N >
+bool
+FeatureAPIHooks<ID,N>::has_hooks_for(ID id) const
+{
+  return (m_hooks_mask & hook_bit(id)) != 0;
+}
+
+template < typename ID, ID N >
+uint64_t
+FeatureAPIHooks<ID,N>::hooks_mask() const
+{
+  return m_hooks_mask;
+}
+
+template < typename ID, ID N >
+uint64_t
+FeatureAPIHooks<ID,N>::hook_bit(ID id)
+{
+  return static_cast<uint64_t>(1) << id;
 }
 
 template < typename ID, ID N >
@@ -7675,3 +7675,95 @@ REGRESSION_TEST(SDK_API_DEBUG_NAME_LOOKUPS) (RegressionTest * test, int /* atype
 
   return;
 }
+
+
+////////////////////////////////////////////////
+// SDK_API_HOOK_DISPATCH
+//
+// Unit Test for API: TSHttpHookAddInline
+//
+// Walks the hooks of a transaction the way HttpSM::state_api_callout
+// does, and reports the cost per transaction with and without the
+// hook masks.
+////////////////////////////////////////////////
+
+static int
+hook_dispatch_handler(TSCont contp, TSEvent /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */)
+{
+  ++*(int64_t *) TSContDataGet(contp);
+  return TS_EVENT_HTTP_CONTINUE;
+}
+
+REGRESSION_TEST(SDK_API_HOOK_DISPATCH) (RegressionTest * test, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const TSHttpHookID txn_hook_ids[] = {
+    TS_HTTP_TXN_START_HOOK, TS_HTTP_PRE_REMAP_HOOK, TS_HTTP_POST_REMAP_HOOK, TS_HTTP_READ_REQUEST_HDR_HOOK,
+    TS_HTTP_OS_DNS_HOOK, TS_HTTP_SEND_REQUEST_HDR_HOOK, TS_HTTP_READ_CACHE_HDR_HOOK,
+    TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK, TS_HTTP_READ_RESPONSE_HDR_HOOK, TS_HTTP_SEND_RESPONSE_HDR_HOOK,
+    TS_HTTP_TXN_CLOSE_HOOK
+  };
+  const int n_txn = 1000000;
+  const int n_ids = sizeof(txn_hook_ids) / sizeof(txn_hook_ids[0]);
+  HttpAPIHooks global_hooks, ssn_hooks, txn_hooks;
+  HttpAPIHooks *lists[3] = { &global_hooks, &ssn_hooks, &txn_hooks };
+  TSCont contp = TSContCreate(hook_dispatch_handler, NULL);
+  int64_t calls = 0;
+  ink_hrtime elapsed[2];
+  bool success = true;
+
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+
+  TSContDataSet(contp, &calls);
+  global_hooks.append(TS_HTTP_READ_RESPONSE_HDR_HOOK, (INKContInternal *) contp);
+  txn_hooks.append(TS_HTTP_SEND_RESPONSE_HDR_HOOK, (INKContInternal *) contp, true);
+
+  if (!global_hooks.has_hooks_for(TS_HTTP_READ_RESPONSE_HDR_HOOK) || global_hooks.has_hooks_for(TS_HTTP_OS_DNS_HOOK) ||
+      ssn_hooks.has_hooks() || txn_hooks.hooks_mask() != HttpAPIHooks::hook_bit(TS_HTTP_SEND_RESPONSE_HDR_HOOK)) {
+    SDK_RPRINT(test, "HttpAPIHooks", "TestCase1", TC_FAIL, "hook masks do not match the hooks");
+    success = false;
+  } else {
+    SDK_RPRINT(test, "HttpAPIHooks", "TestCase1", TC_PASS, "ok");
+  }
+
+  for (int masked = 0; masked < 2; masked++) {
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    for (int txn = 0; txn < n_txn; txn++) {
+      for (int i = 0; i < n_ids; i++) {
+        TSHttpHookID id = txn_hook_ids[i];
+
+        if (masked && !((global_hooks.hooks_mask() | ssn_hooks.hooks_mask() | txn_hooks.hooks_mask()) & HttpAPIHooks::hook_bit(id))) {
+          continue;
+        }
+        for (int l = 0; l < 3; l++) {
+          for (APIHook *hook = lists[l]->get(id); hook; hook = hook->next()) {
+            if (hook->m_inline) {
+              hook->invoke_inline(TS_EVENT_HTTP_READ_REQUEST_HDR + id, NULL);
+            } else {
+              hook->invoke(TS_EVENT_HTTP_READ_REQUEST_HDR + id, NULL);
+            }
+          }
+        }
+      }
+    }
+    elapsed[masked] = ink_get_hrtime_internal() - start;
+  }
+
+  if (calls != 2 * 2 * n_txn) {
+    SDK_RPRINT(test, "TSHttpHookAddInline", "TestCase1", TC_FAIL, "%" PRId64 " hook calls, expected %d", calls, 4 * n_txn);
+    success = false;
+  } else {
+    SDK_RPRINT(test, "TSHttpHookAddInline", "TestCase1", TC_PASS, "ok");
+  }
+
+  rprintf(test, "%d hook points, 2 hooks: %.1f ns per transaction with the hook masks, %.1f ns without\n", n_ids,
+          (double) elapsed[1] / n_txn, (double) elapsed[0] / n_txn);
+
+  global_hooks.clear();
+  txn_hooks.clear();
+  TSContDestroy(contp);
+
+  *pstatus = success ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+
+  return;
+}
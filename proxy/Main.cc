@@ -403,6 +403,17 @@ CB_After_Cache_Init()
     }
   }
 
+  if (cache_config_url_hash == CACHE_URL_HASH_SIP) {
+    if (cacheProcessor.stripe_url_hash == cache_config_url_hash_stamp) {
+      URLHashContext::SipKey[0] = cache_config_url_hash_key[0];
+      URLHashContext::SipKey[1] = cache_config_url_hash_key[1];
+      URLHashContext::Setting = URLHashContext::SIP;
+    } else {
+      Warning("proxy.config.cache.url_hash changed but the cache was built with another URL hash (or key), "
+              "keeping the old hash until the cache is cleared");
+    }
+  }
+
   if (1 == start) {
     Debug("http_listen", "Delayed listen enable, cache initialization finished");
     start_HttpProxyServer();
@@ -1470,6 +1481,7 @@ main(int /* argc ATS_UNUSED */, char **argv)
   } else {
     remapProcessor.start(num_remap_threads, stacksize);
     RecProcessStart();
+    initControlMatcherStats();
     initCacheControl();
     initCongestionControl();
     IpAllow::startup();
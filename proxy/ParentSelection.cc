@@ -101,7 +101,7 @@ int ParentConfig::m_id = 0;
 void
 ParentConfig::startup()
 {
-  parentConfigUpdate = new ConfigUpdateHandler<ParentConfig>();
+  parentConfigUpdate = new ConfigUpdateHandler<ParentConfig>(&ET_TASK);
 
   // Load the initial configuration
   reconfigure();
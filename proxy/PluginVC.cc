@@ -408,13 +408,42 @@ PluginVC::do_io_shutdown(ShutdownHowTo_t howto)
   }
 }
 
+// static bool extend_tail_block(MIOBuffer* transfer_to,
+//                               IOBufferReader* transfer_from, int64_t len)
+//
+//   A writer filling a block a little at a time leaves each transfer
+//      with a piece of the same block, which directly follows the piece
+//      moved by the previous transfer.  When the last block of transfer_to
+//      is the reference made by that transfer, it is extended over the new
+//      piece rather than adding another reference or copying the bytes
+//
+static bool
+extend_tail_block(MIOBuffer * transfer_to, IOBufferReader * transfer_from, int64_t len)
+{
+  IOBufferBlock *tail = transfer_to->_writer;
+  IOBufferBlock *b = transfer_from->block;
+
+  // a block with write space belongs to the writer of transfer_to
+  if (!tail || !b || tail->write_avail() != 0 || tail->data.m_ptr != b->data.m_ptr) {
+    return false;
+  }
+  if (tail->end() != b->start() + transfer_from->start_offset) {
+    return false;
+  }
+
+  tail->_end += len;
+  tail->_buf_end = tail->_end;
+  return true;
+}
+
 // int PluginVC::transfer_bytes(MIOBuffer* transfer_to,
 //                              IOBufferReader* transfer_from, int act_on)
 //
 //   Takes care of transfering bytes from a reader to another buffer
 //      In the case of large transfers, we move blocks.  In the case
 //      of small transfers we copy data so as to not build too many
-//      buffer blocks
+//      buffer blocks, unless the bytes follow those of the last block
+//      moved, which is then extended
 //
 // Args:
 //   transfer_to:  buffer to copy to
@@ -441,7 +470,9 @@ PluginVC::transfer_bytes(MIOBuffer * transfer_to, IOBufferReader * transfer_from
       break;
     }
 
-    if (to_move >= MIN_BLOCK_TRANSFER_BYTES) {
+    if (extend_tail_block(transfer_to, transfer_from, to_move)) {
+      moved = to_move;
+    } else if (to_move >= MIN_BLOCK_TRANSFER_BYTES) {
       moved = transfer_to->write(transfer_from, to_move, 0);
     } else {
       // We have a really small amount of data.  To make
@@ -1307,4 +1338,134 @@ EXCLUSIVE_REGRESSION_TEST(PVC) (RegressionTest * t, int /* atype ATS_UNUSED */,
   PVCTestDriver *driver = new PVCTestDriver;
   driver->start_tests(t, pstatus);
 }
+
+#define PVC_THROUGHPUT_BYTES (64 * 1024 * 1024)
+#define PVC_THROUGHPUT_WRITE_SIZE 1024
+
+// Moves PVC_THROUGHPUT_BYTES from the active side to the passive side,
+//   written a small piece at a time the way intercepts and fetches
+//   produce responses, and reports the throughput of the data path
+class PVCThroughputTest:public Continuation
+{
+public:
+  PVCThroughputTest(RegressionTest * t, int *pstatus_arg);
+
+  void start();
+  int main_handler(int event, void *data);
+
+private:
+  void fill();
+  void finish(bool passed);
+
+  RegressionTest *r;
+  int *pstatus;
+  PluginVC *active_vc;
+  NetVConnection *passive_vc;
+  VIO *write_vio;
+  VIO *read_vio;
+  MIOBuffer *write_buffer;
+  MIOBuffer *read_buffer;
+  IOBufferReader *read_reader;
+  int64_t written;
+  int64_t received;
+  ink_hrtime start_time;
+  char piece[PVC_THROUGHPUT_WRITE_SIZE];
+};
+
+PVCThroughputTest::PVCThroughputTest(RegressionTest * t, int *pstatus_arg)
+  : Continuation(new_ProxyMutex()), r(t), pstatus(pstatus_arg), active_vc(NULL), passive_vc(NULL),
+    write_vio(NULL), read_vio(NULL), write_buffer(NULL), read_buffer(NULL), read_reader(NULL),
+    written(0), received(0), start_time(0)
+{
+  memset(piece, 'x', sizeof(piece));
+  SET_HANDLER(&PVCThroughputTest::main_handler);
+}
+
+void
+PVCThroughputTest::start()
+{
+  MUTEX_TRY_LOCK(lock, mutex, this_ethread());
+
+  write_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  read_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  read_reader = read_buffer->alloc_reader();
+
+  PluginVCCore *core = PluginVCCore::alloc();
+  core->set_accept_cont(this);
+  active_vc = core->connect();
+
+  start_time = ink_get_hrtime();
+  write_vio = active_vc->do_io_write(this, PVC_THROUGHPUT_BYTES, write_buffer->alloc_reader());
+  fill();
+}
+
+void
+PVCThroughputTest::fill()
+{
+  while (written < PVC_THROUGHPUT_BYTES && write_vio->get_reader()->read_avail() < PVC_DEFAULT_MAX_BYTES) {
+    int64_t n = MIN((int64_t) sizeof(piece), PVC_THROUGHPUT_BYTES - written);
+    write_buffer->write(piece, n);
+    written += n;
+  }
+  write_vio->reenable();
+}
+
+void
+PVCThroughputTest::finish(bool passed)
+{
+  ink_hrtime elapsed = ink_get_hrtime() - start_time;
+  int64_t msecs = MAX(elapsed / HRTIME_MSECOND, (ink_hrtime) 1);
+
+  rprintf(r, "PVC_THROUGHPUT %" PRId64 " bytes in %" PRId64 " ms, %" PRId64 " MB/s\n",
+          received, msecs, received / 1024 / 1024 * 1000 / msecs);
+
+  if (passive_vc) {
+    passive_vc->do_io_close();
+  }
+  active_vc->do_io_close();
+  free_MIOBuffer(write_buffer);
+  free_MIOBuffer(read_buffer);
+
+  *pstatus = passed ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+  delete this;
+}
+
+int
+PVCThroughputTest::main_handler(int event, void *data)
+{
+  switch (event) {
+  case NET_EVENT_ACCEPT:
+    passive_vc = (NetVConnection *) data;
+    read_vio = passive_vc->do_io_read(this, PVC_THROUGHPUT_BYTES, read_buffer);
+    break;
+  case VC_EVENT_WRITE_READY:
+    fill();
+    break;
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+    received += read_reader->read_avail();
+    read_reader->consume(read_reader->read_avail());
+    if (received == PVC_THROUGHPUT_BYTES) {
+      finish(true);
+    } else {
+      read_vio->reenable();
+    }
+    break;
+  default:
+    rprintf(r, "PVC_THROUGHPUT unexpected event %d\n", event);
+    finish(false);
+    break;
+  }
+
+  return 0;
+}
+
+EXCLUSIVE_REGRESSION_TEST(PVC_THROUGHPUT) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  PVCThroughputTest *test = new PVCThroughputTest(t, pstatus);
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+  test->start();
+}
 #endif
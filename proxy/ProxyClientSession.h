@@ -55,6 +55,10 @@ public:
     return this->api_hooks.get(id);
   }
 
+  uint64_t ssn_hooks_mask() const {
+    return this->api_hooks.hooks_mask();
+  }
+
   void * get_user_arg(unsigned ix) const {
     ink_assert(ix < countof(user_args));
     return this->user_args[ix];
@@ -79,6 +79,29 @@ extern "C"
   tsapi int TSMimeHdrFieldEqual(TSMBuffer bufp, TSMLoc hdr_obj, TSMLoc field1, TSMLoc field2);
   tsapi TSReturnCode TSHttpTxnHookRegisteredFor(TSHttpTxn txnp, TSHttpHookID id, TSEventFunc funcp);
 
+  /**
+     Add @a contp as an inline hook.  The handler of an inline hook is
+     called synchronously, on the thread of the transaction and with its
+     lock held, without taking the lock of @a contp.  It must not block,
+     nor call TSHttpTxnReenable(); instead it returns TS_EVENT_HTTP_CONTINUE
+     or TS_EVENT_HTTP_ERROR, and the transaction goes on at once.  This
+     saves the reenable round trip for plugins which never wait.
+
+     Only the hooks called in the course of the transaction can be added
+     inline: the TXN_START, PRE_REMAP, POST_REMAP, READ_REQUEST_HDR,
+     OS_DNS, SEND_REQUEST_HDR, READ_CACHE_HDR, CACHE_LOOKUP_COMPLETE,
+     READ_RESPONSE_HDR, SEND_RESPONSE_HDR and TXN_CLOSE hooks.
+   */
+  tsapi void TSHttpHookAddInline(TSHttpHookID id, TSCont contp);
+  tsapi void TSHttpTxnHookAddInline(TSHttpTxn txnp, TSHttpHookID id, TSCont contp);
+
+  /**
+     The index of the calling event thread, unique among the event threads
+     of all the thread pools, or -1 if the caller is not an event thread.
+     Plugins can use it to keep data of their own for each thread.
+   */
+  tsapi int TSEventThreadIndexGet(void);
+
   /* for Media-IXT mms over http */
   typedef enum
     {
@@ -671,6 +694,28 @@ extern "C"
    */
   tsapi ssize_t TSFetchReadData(TSFetchSM fetch_sm, void *buf, size_t len);
 
+  /*
+   * Get the reader of the response body, so it can be read a block at a
+   * time without copying. Returns NULL until the response header is done.
+   * The body is dechunked if the fetch was created with
+   * TS_FETCH_FLAGS_DECHUNK. Data read this way must be consumed with
+   * TSFetchBodyConsume(), not TSIOBufferReaderConsume().
+   *
+   * @param fetch_sm: returned value of TSFetchCreate().
+   */
+  tsapi TSIOBufferReader TSFetchBodyReaderGet(TSFetchSM fetch_sm);
+
+  /*
+   * Consume *len* bytes of the body reader, and let FetchSM read more.
+   * Returns *len*, or 0 if the fetch was created with
+   * TS_FETCH_FLAGS_NEWLOCK and its lock is busy, as TSFetchReadData()
+   * does; nothing is consumed then and the call must be retried.
+   *
+   * @param fetch_sm: returned value of TSFetchCreate().
+   * @param len: bytes consumed, at most what the body reader has available.
+   */
+  tsapi int64_t TSFetchBodyConsume(TSFetchSM fetch_sm, int64_t len);
+
   /*
    * Lanuch FetchSM to do http request, before calling this API,
    * you should append http request header into fetch sm through
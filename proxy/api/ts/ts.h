@@ -1830,6 +1830,21 @@ extern "C"
   tsapi TSAction TSCacheRemove(TSCont contp, TSCacheKey key);
   tsapi TSReturnCode TSCacheReady(int* is_ready);
   tsapi TSAction TSCacheScan(TSCont contp, TSCacheKey key, int KB_per_second);
+  /**
+      Like TSCacheScan(), but scans all the stripes at the same time.
+      contp is called back with the same events, once for each object of
+      any stripe, and TS_EVENT_CACHE_SCAN_DONE is sent once all the
+      stripes are done. The callbacks are serialized by the mutex of contp.
+
+      @param contp continuation called back with the scanned objects.
+      @param key cache key with the host name of the objects to scan, or
+        NULL for all objects.
+      @param KB_per_second limit of the reads of all the stripes together,
+        0 for no limit.
+      @return the action of the scan, for canceling it.
+
+   */
+  tsapi TSAction TSCacheScanParallel(TSCont contp, TSCacheKey key, int KB_per_second);
 
   /* --------------------------------------------------------------------------
      VIOs */
@@ -363,7 +363,7 @@ initCongestionControl()
 // register the stats variables
   register_congest_stats();
 
-  CongestionControlUpdate = new ConfigUpdateHandler<CongestionMatcherTable>();
+  CongestionControlUpdate = new ConfigUpdateHandler<CongestionMatcherTable>(&ET_TASK);
 
 // register config variables
   REC_EstablishStaticConfigInt32(congestionControlEnabled, "proxy.config.http.congestion_control.enabled");
@@ -92,12 +92,11 @@ int URL_LEN_MMS;
 int URL_LEN_MMSU;
 int URL_LEN_MMST;
 
-int url_hash_method = 0;
-
 
 /*-------------------------------------------------------------------------
   -------------------------------------------------------------------------*/
 URLHashContext::HashType URLHashContext::Setting = URLHashContext::MMH;
+uint64_t URLHashContext::SipKey[2] = { 0, 0 };
 
 URLHashContext::URLHashContext() {
   switch (Setting) {
@@ -108,6 +107,9 @@ URLHashContext::URLHashContext() {
   case MMH:
     new(_obj) MMHContext;
     break;
+  case SIP:
+    new(_obj) SipContext(SipKey[0], SipKey[1]);
+    break;
   default: ink_assert("Invalid global URL hash context");
   };
 }
@@ -209,6 +211,7 @@ url_init()
 
     ink_assert(URLHashContext::OBJ_SIZE >= sizeof(MD5Context));
     ink_assert(URLHashContext::OBJ_SIZE >= sizeof(MMHContext));
+    ink_assert(URLHashContext::OBJ_SIZE >= sizeof(SipContext));
 
   }
 }
@@ -1596,137 +1599,152 @@ memcpy_tolower(char *d, const char *s, int n)
 
 #define BUFSIZE 512
 
-// fast path for MD5, HTTP, no user/password/params/query,
-// no buffer overflow, no unescaping needed
+/** Staging buffer for the canonical URL fed to the hash context.
 
-static inline void
-url_MD5_get_fast(URLImpl * url, CryptoContext& ctx, CryptoHash* hash)
+    The canonical form is produced in a single pass over the URL
+    components and handed to the context a buffer at a time, so a URL
+    of any length is hashed without being copied in full.
+*/
+struct URLHashBuffer
 {
-  char buffer[BUFSIZE];
-  char *p;
-
-  p = buffer;
-  memcpy_tolower(p, url->m_ptr_scheme, url->m_len_scheme);
-  p += url->m_len_scheme;
-  *p++ = ':';
-  *p++ = '/';
-  *p++ = '/';
-  // no user
-  *p++ = ':';
-  // no password
-  *p++ = '@';
-  memcpy_tolower(p, url->m_ptr_host, url->m_len_host);
-  p += url->m_len_host;
-  *p++ = '/';
-  memcpy(p, url->m_ptr_path, url->m_len_path);
-  p += url->m_len_path;
-  *p++ = ';';
-  // no params
-  *p++ = '?';
-  // no query
-
-  ink_assert(sizeof(url->m_port) == 2);
-  uint16_t port = (uint16_t) url_canonicalize_port(url->m_url_type, url->m_port);
-  *p++ = ((char *) &port)[0];
-  *p++ = ((char *) &port)[1];
-
-  ctx.update(buffer, p - buffer);
-  ctx.finalize(hash);
-}
+  URLHashBuffer(CryptoContext & ctx) : _ctx(ctx), _p(_buffer) { }
 
+  void flush()
+  {
+    if (_p != _buffer) {
+      _ctx.update(_buffer, _p - _buffer);
+      _p = _buffer;
+    }
+  }
 
-static inline void
-url_MD5_get_general(URLImpl * url, CryptoContext& ctx, CryptoHash& hash)
-{
-  char buffer[BUFSIZE];
-  char *p, *e;
-  const char *strs[13], *ends[13];
-  const char *t;
-  in_port_t port;
-  int i, s;
-
-  strs[0] = url->m_ptr_scheme;
-  strs[1] = "://";
-  strs[2] = url->m_ptr_user;
-  strs[3] = ":";
-  strs[4] = url->m_ptr_password;
-  strs[5] = "@";
-  strs[6] = url->m_ptr_host;
-  strs[7] = "/";
-  strs[8] = url->m_ptr_path;
-
-  ends[0] = strs[0] + url->m_len_scheme;
-  ends[1] = strs[1] + 3;
-  ends[2] = strs[2] + url->m_len_user;
-  ends[3] = strs[3] + 1;
-  ends[4] = strs[4] + url->m_len_password;
-  ends[5] = strs[5] + 1;
-  ends[6] = strs[6] + url->m_len_host;
-  ends[7] = strs[7] + 1;
-  ends[8] = strs[8] + url->m_len_path;
-
-  strs[9] = ";";
-  strs[10] = url->m_ptr_params;
-  strs[11] = "?";
-  strs[12] = url->m_ptr_query;
-  ends[9] = strs[9] + 1;
-  ends[10] = strs[10] + url->m_len_params;
-  ends[11] = strs[11] + 1;
-  ends[12] = strs[12] + url->m_len_query;
-
-  p = buffer;
-  e = buffer + BUFSIZE;
-
-  for (i = 0; i < 13; i++) {
-    if (strs[i]) {
-      t = strs[i];
-      s = 0;
-
-      while (t < ends[i]) {
-        if ((i == 0) || (i == 6)) {           // scheme and host
-          unescape_str_tolower(p, e, t, ends[i], s);
-        } else {
-          unescape_str(p, e, t, ends[i], s);
-        }
+  void put(char c)
+  {
+    if (_p == _buffer + BUFSIZE) {
+      this->flush();
+    }
+    *_p++ = c;
+  }
 
-        if (p == e) {
-          ctx.update(buffer, BUFSIZE);
-          p = buffer;
-        }
+  /// Append @a n literal bytes of @a s, lower cased if @a lower.
+  void put(const char *s, int n, bool lower)
+  {
+    while (n > 0) {
+      int room = (int) (_buffer + BUFSIZE - _p);
+
+      if (room == 0) {
+        this->flush();
+        room = BUFSIZE;
+      }
+      if (room > n) {
+        room = n;
+      }
+      if (lower) {
+        memcpy_tolower(_p, s, room);
+      } else {
+        memcpy(_p, s, room);
       }
+      _p += room;
+      s += room;
+      n -= room;
     }
   }
 
-  if (p != buffer) ctx.update(buffer, p-buffer);
+  /// Append the unescaped form of the component [@a s, @a e).
+  void put_unescaped(const char *s, const char *e, bool lower);
 
-  port = url_canonicalize_port(url->m_url_type, url->m_port);
+  CryptoContext & _ctx;
+  char *_p;
+  char _buffer[BUFSIZE];
+};
 
-  ctx.update(&port, sizeof(port));
-  ctx.finalize(hash);
+// Literal runs between escapes are located with memchr and copied in
+// bulk. The escape handling matches unescape_str(): a '%' that is not
+// followed by two hex digits is kept literally, and an incomplete
+// escape at the end of a component is dropped. The canonical form must
+// not change or existing cache entries would no longer be found.
+void
+URLHashBuffer::put_unescaped(const char *s, const char *e, bool lower)
+{
+  while (s < e) {
+    const char *pct = static_cast<const char *>(memchr(s, '%', e - s));
+
+    if (pct == NULL) {
+      this->put(s, e - s, lower);
+      return;
+    }
+    this->put(s, pct - s, lower);
+    s = pct;
+
+    // An incomplete escape at the end of the component is dropped.
+    if (s + 1 >= e) {
+      return;
+    }
+    if (!ParseRules::is_hex(s[1])) {
+      this->put('%');
+      s += 1;
+    } else if (s + 2 >= e) {
+      return;
+    } else if (!ParseRules::is_hex(s[2])) {
+      this->put('%');
+      this->put(lower ? ParseRules::ink_tolower(s[1]) : s[1]);
+      s += 2;
+    } else {
+      int hi = ParseRules::is_alpha(s[1]) ? ParseRules::ink_toupper(s[1]) - 'A' + 10 : s[1] - '0';
+      int lo = ParseRules::is_alpha(s[2]) ? ParseRules::ink_toupper(s[2]) - 'A' + 10 : s[2] - '0';
+
+      this->put(static_cast<char>(hi * 16 + lo));
+      s += 3;
+    }
+  }
 }
 
+/** Compute the cache key hash of @a url.
+
+    The canonical form is the scheme and host (lower cased), user,
+    password, path, params and query, unescaped, with the fixed
+    separators "://", ":", "@", "/", ";" and "?" (always present), then
+    the canonical port in host byte order.
+*/
 void
 url_MD5_get(URLImpl * url, CryptoHash* hash)
 {
   URLHashContext ctx;
-  if ((url_hash_method != 0) &&
-      (url->m_url_type == URL_TYPE_HTTP) &&
-      ((url->m_len_user + url->m_len_password + url->m_len_params + url->m_len_query) == 0) &&
-      (3 + 1 + 1 + 1 + 1 + 1 + 2 +
-       url->m_len_scheme +
-       url->m_len_host +
-       url->m_len_path < BUFSIZE) &&
-      (memchr(url->m_ptr_host, '%', url->m_len_host) == NULL) &&
-      (memchr(url->m_ptr_path, '%', url->m_len_path) == NULL)) {
-    url_MD5_get_fast(url, ctx, hash);
-#ifdef DEBUG
-    CryptoHash md5_general;
-    url_MD5_get_general(url, ctx, md5_general);
-    ink_assert(*hash == md5_general);
-#endif
-  } else {
-    url_MD5_get_general(url, ctx, *hash);
+  URLHashBuffer buf(ctx);
+  in_port_t port;
+
+  if (url->m_ptr_scheme) {
+    buf.put_unescaped(url->m_ptr_scheme, url->m_ptr_scheme + url->m_len_scheme, true);
   }
+  buf.put("://", 3, false);
+  if (url->m_ptr_user) {
+    buf.put_unescaped(url->m_ptr_user, url->m_ptr_user + url->m_len_user, false);
+  }
+  buf.put(':');
+  if (url->m_ptr_password) {
+    buf.put_unescaped(url->m_ptr_password, url->m_ptr_password + url->m_len_password, false);
+  }
+  buf.put('@');
+  if (url->m_ptr_host) {
+    buf.put_unescaped(url->m_ptr_host, url->m_ptr_host + url->m_len_host, true);
+  }
+  buf.put('/');
+  if (url->m_ptr_path) {
+    buf.put_unescaped(url->m_ptr_path, url->m_ptr_path + url->m_len_path, false);
+  }
+  buf.put(';');
+  if (url->m_ptr_params) {
+    buf.put_unescaped(url->m_ptr_params, url->m_ptr_params + url->m_len_params, false);
+  }
+  buf.put('?');
+  if (url->m_ptr_query) {
+    buf.put_unescaped(url->m_ptr_query, url->m_ptr_query + url->m_len_query, false);
+  }
+  buf.flush();
+
+  port = url_canonicalize_port(url->m_url_type, url->m_port);
+
+  ctx.update(&port, sizeof(port));
+  ctx.finalize(*hash);
 }
 
 #undef BUFSIZE
@@ -29,6 +29,7 @@
 #include "HdrHeap.h"
 #include "INK_MD5.h"
 #include "MMH.h"
+#include "HashSip.h"
 #include "MIME.h"
 
 #include "ink_apidefs.h"
@@ -99,8 +100,10 @@ public:
   /// Finalize and extract the @a hash.
   virtual bool finalize(CryptoHash& hash);
 
-  enum HashType { UNSPECIFIED, MD5, MMH }; ///< What type of hash we really are.
+  enum HashType { UNSPECIFIED, MD5, MMH, SIP }; ///< What type of hash we really are.
   static HashType Setting;
+  /// Key for the @c SIP hash. This must not change while a cache built with it is in use.
+  static uint64_t SipKey[2];
 
   /// Size of storage for placement @c new of hashing context.
   static size_t const OBJ_SIZE = 256;
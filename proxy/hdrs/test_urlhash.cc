@@ -36,8 +36,6 @@
 static void
 test_url()
 {
-  url_hash_method = 1;
-
   static const char *strs[] = {
     "http://npdev:19080/1.6664000000/4000",
     "http://npdev:19080/1.8666000000/4000"
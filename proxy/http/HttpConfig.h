@@ -786,6 +786,9 @@ public:
   MgmtByte send_100_continue_response;
   MgmtByte send_408_post_timeout_response;
 
+  // move the body of plain transfers between sockets with splice()
+  MgmtByte splice_enabled;
+
   OverridableHttpConfigParams oride;
 
   ////////////////////
@@ -940,6 +943,7 @@ HttpConfigParams::HttpConfigParams()
     ignore_accept_charset_mismatch(0),
     send_100_continue_response(0),
     send_408_post_timeout_response(0),
+    splice_enabled(0),
     autoconf_port(0),
     autoconf_localhost_only(0)
 {
@@ -1327,7 +1327,12 @@ HttpSM::state_api_callout(int event, void *data)
     // FALLTHROUGH
   case EVENT_NONE:
   case HTTP_API_CONTINUE:
+Lnext_hook:
     if ((cur_hook_id >= 0) && (cur_hook_id < TS_HTTP_LAST_HOOK)) {
+      // Most hooks have no callbacks at all, skip looking them up
+      if (cur_hooks == 0 && !hooks_set_for(cur_hook_id)) {
+        cur_hooks = 3;
+      }
       if (!cur_hook) {
         if (cur_hooks == 0) {
           cur_hook = http_global_hooks->get(cur_hook_id);
@@ -1356,6 +1361,21 @@ HttpSM::state_api_callout(int event, void *data)
           callout_state = HTTP_API_IN_CALLOUT;
         }
 
+        // Inline hooks return at once, under our lock only, with the
+        //  event they would have reenabled the transaction with
+        if (cur_hook->m_inline) {
+          APIHook *hook = cur_hook;
+          cur_hook = cur_hook->next();
+
+          DebugSM("http", "[%" PRId64 "] calling plugin inline on hook %s at hook %p",
+                sm_id, HttpDebugNames::get_api_hook_name(cur_hook_id), hook);
+
+          if (hook->invoke_inline(TS_EVENT_HTTP_READ_REQUEST_HDR + cur_hook_id, this) == TS_EVENT_HTTP_ERROR) {
+            goto Lapi_error;
+          }
+          goto Lnext_hook;
+        }
+
         /* The MUTEX_TRY_LOCK macro was changed so
            that it can't handle NULL mutex'es.  The plugins
            can use null mutexes so we have to do this manually.
@@ -1416,6 +1436,7 @@ HttpSM::state_api_callout(int event, void *data)
     break;
 
   case HTTP_API_ERROR:
+Lapi_error:
     if (callout_state == HTTP_API_DEFERED_CLOSE) {
       api_next = API_RETURN_DEFERED_CLOSE;
     } else if (cur_hook_id == TS_HTTP_TXN_CLOSE_HOOK) {
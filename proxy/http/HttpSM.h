@@ -255,7 +255,7 @@ public:
   void dump_state_hdr(HTTPHdr *h, const char *s);
 
   // Functions for manipulating api hooks
-  void txn_hook_append(TSHttpHookID id, INKContInternal * cont);
+  void txn_hook_append(TSHttpHookID id, INKContInternal * cont, bool inline_p = false);
   void txn_hook_prepend(TSHttpHookID id, INKContInternal * cont);
   APIHook *txn_hook_get(TSHttpHookID id);
 
@@ -499,6 +499,10 @@ public:
   //  do_api_callout_internal()
   bool hooks_set;
 
+  // hooks_set_for(id) checks whether there is a global, session
+  //  or transaction hook for id, from the masks of the hooks
+  bool hooks_set_for(TSHttpHookID id) const;
+
 protected:
   TSHttpHookID cur_hook_id;
   APIHook *cur_hook;
@@ -598,9 +602,9 @@ HttpSM::find_server_buffer_size()
 }
 
 inline void
-HttpSM::txn_hook_append(TSHttpHookID id, INKContInternal * cont)
+HttpSM::txn_hook_append(TSHttpHookID id, INKContInternal * cont, bool inline_p)
 {
-  api_hooks.append(id, cont);
+  api_hooks.append(id, cont, inline_p);
   hooks_set = 1;
 }
 
@@ -611,6 +615,17 @@ HttpSM::txn_hook_prepend(TSHttpHookID id, INKContInternal * cont)
   hooks_set = 1;
 }
 
+inline bool
+HttpSM::hooks_set_for(TSHttpHookID id) const
+{
+  uint64_t mask = http_global_hooks->hooks_mask() | api_hooks.hooks_mask();
+
+  if (ua_session) {
+    mask |= ua_session->ssn_hooks_mask();
+  }
+  return (mask & HttpAPIHooks::hook_bit(id)) != 0;
+}
+
 inline APIHook *
 HttpSM::txn_hook_get(TSHttpHookID id)
 {
@@ -34,11 +34,15 @@
 #include "HttpConfig.h"
 #include "HttpTunnel.h"
 #include "HttpSM.h"
+#include "HttpServerSession.h"
 #include "HttpDebugNames.h"
 #include "ParseRules.h"
 
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+#endif
+
 static const int min_block_transfer_bytes = 256;
-static char const * const CHUNK_HEADER_FMT = "%" PRIx64"\r\n";
 // This should be as small as possible because it will only hold the
 // header and trailer per chunk - the chunk body will be a reference to
 // a block in the input stream.
@@ -128,69 +132,109 @@ ChunkedHandler::clear()
   return;
 }
 
+// Format the header of a chunk of @a size bytes, the size in hex and a
+// CRLF, into @a buf, which must hold 18 bytes.  Returns its length.
+static int
+chunk_header(char *buf, int64_t size)
+{
+  static char const digits[] = "0123456789abcdef";
+  int n = 0;
+
+  ink_assert(size >= 0);
+  do {
+    n++;
+  } while (n < 16 && (size >> (4 * n)));
+  for (int i = n - 1; i >= 0; i--, size >>= 4)
+    buf[i] = digits[size & 0xf];
+  buf[n] = '\r';
+  buf[n + 1] = '\n';
+  return n + 2;
+}
+
 void
 ChunkedHandler::set_max_chunk_size(int64_t size)
 {
   max_chunk_size = size ? size : DEFAULT_MAX_CHUNK_SIZE;
-  max_chunk_header_len = snprintf(max_chunk_header, sizeof(max_chunk_header), CHUNK_HEADER_FMT, max_chunk_size);
+  max_chunk_header_len = chunk_header(max_chunk_header, max_chunk_size);
+}
+
+// The value of the hex digit @a c, -1 if it is not one.
+static inline int
+hex_value(char c)
+{
+  unsigned int d = (unsigned char) c - '0';
+
+  if (d < 10)
+    return d;
+  d = ((unsigned char) c | 0x20) - 'a';
+  return d < 6 ? d + 10 : -1;
 }
 
 void
 ChunkedHandler::read_size()
 {
-  int64_t bytes_used;
   bool done = false;
 
-  while (chunked_reader->read_avail() > 0 && !done) {
-    const char *tmp = chunked_reader->start();
-    int64_t data_size = chunked_reader->block_read_avail();
+  // Whole blocks are scanned at once: the digits in a tight loop, the
+  // line ends with memchr(), which is vectorized by the C library.
+  while (!done && chunked_reader->is_read_avail_more_than(0)) {
+    const char *start = chunked_reader->start();
+    const char *end = chunked_reader->end();
+    const char *tmp = start;
 
-    ink_assert(data_size > 0);
-    bytes_used = 0;
+    ink_assert(end > start);
 
-    while (data_size > 0) {
-      bytes_used++;
+    while (tmp < end && !done) {
       if (state == CHUNK_READ_SIZE) {
         // The http spec says the chunked size is always in hex
-        if (ParseRules::is_hex(*tmp)) {
-          num_digits++;
-          running_sum *= 16;
+        int v;
 
-          if (ParseRules::is_digit(*tmp)) {
-            running_sum += *tmp - '0';
-          } else {
-            running_sum += ParseRules::ink_tolower(*tmp) - 'a' + 10;
+        while (tmp < end && (v = hex_value(*tmp)) >= 0) {
+          if (running_sum > (INT_MAX >> 4)) {
+            running_sum = -1;
+            break;
           }
-        } else {
-          // We are done parsing size
+          running_sum = running_sum * 16 + v;
+          num_digits++;
+          tmp++;
+        }
+        if (tmp < end) {
+          // We are done parsing size, a bare LF is left for the scan below
+          if (*tmp != '\n')
+            tmp++;
           if (num_digits == 0 || running_sum < 0) {
             // Bogus chunk size
             state = CHUNK_READ_ERROR;
             done = true;
-            break;
           } else {
             state = CHUNK_READ_SIZE_CRLF;       // now look for CRLF
           }
         }
-      } else if (state == CHUNK_READ_SIZE_CRLF) {       // Scan for a linefeed
-        if (ParseRules::is_lf(*tmp)) {
-          Debug("http_chunk", "read chunk size of %d bytes", running_sum);
-          bytes_left = (cur_chunk_size = running_sum);
-          state = (running_sum == 0) ? CHUNK_READ_TRAILER_BLANK : CHUNK_READ_CHUNK;
-          done = true;
-          break;
-        }
-      } else if (state == CHUNK_READ_SIZE_START) {
-        if (ParseRules::is_lf(*tmp)) {
-          running_sum = 0;
-          num_digits = 0;
-          state = CHUNK_READ_SIZE;
+      } else if (state == CHUNK_READ_SIZE_CRLF || state == CHUNK_READ_SIZE_START) {
+        // Scan for a linefeed, skipping any chunk extension
+        const char *lf = static_cast<const char *>(memchr(tmp, '\n', end - tmp));
+
+        if (!lf) {
+          tmp = end;
+        } else {
+          tmp = lf + 1;
+          if (state == CHUNK_READ_SIZE_START) {
+            running_sum = 0;
+            num_digits = 0;
+            state = CHUNK_READ_SIZE;
+          } else {
+            Debug("http_chunk", "read chunk size of %d bytes", running_sum);
+            bytes_left = (cur_chunk_size = running_sum);
+            state = (running_sum == 0) ? CHUNK_READ_TRAILER_BLANK : CHUNK_READ_CHUNK;
+            done = true;
+          }
         }
+      } else {
+        ink_assert(!"unexpected chunk size state");
+        done = true;
       }
-      tmp++;
-      data_size--;
     }
-    chunked_reader->consume(bytes_used);
+    chunked_reader->consume(tmp - start);
   }
 }
 
@@ -268,6 +312,18 @@ ChunkedHandler::read_trailer()
 
     ink_assert(data_size > 0);
     for (bytes_used = 0; data_size > 0; data_size--) {
+      if (state == CHUNK_READ_TRAILER_LINE) {
+        // Skip the rest of a trailer line at once
+        const char *lf = static_cast<const char *>(memchr(tmp, '\n', data_size));
+
+        if (!lf) {
+          bytes_used += data_size;
+          break;
+        }
+        bytes_used += lf - tmp;
+        data_size -= lf - tmp;
+        tmp = lf;
+      }
       bytes_used++;
 
       if (ParseRules::is_cr(*tmp)) {
@@ -329,7 +385,7 @@ bool ChunkedHandler::process_chunked_content()
 
 bool ChunkedHandler::generate_chunked_content()
 {
-  char tmp[16];
+  char tmp[18];
   bool server_done = false;
   int64_t r_avail;
 
@@ -351,7 +407,7 @@ bool ChunkedHandler::generate_chunked_content()
 
     // Output the chunk size.
     if (write_val != max_chunk_size) {
-      int len = snprintf(tmp, sizeof(tmp), CHUNK_HEADER_FMT, write_val);
+      int len = chunk_header(tmp, write_val);
       chunked_buffer->write(tmp, len);
       chunked_size += len;
     } else {
@@ -986,6 +1042,8 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
       }
       else {
         p->read_vio = p->vc->do_io_read(this, producer_n, p->read_buffer);
+        if (sm->t_state.http_config_param->splice_enabled)
+          producer_splice(p);
       }
     }
   }
@@ -997,6 +1055,51 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
 
 }
 
+static NetVConnection *
+session_netvc(VConnection * vc, HttpTunnelType_t vc_type)
+{
+  switch (vc_type) {
+  case HT_HTTP_SERVER:
+    return static_cast<HttpServerSession *>(vc)->get_netvc();
+  case HT_HTTP_CLIENT:
+    return static_cast<HttpClientSession *>(vc)->get_netvc();
+  default:
+    return NULL;
+  }
+}
+
+// void HttpTunnel::producer_splice(HttpTunnelProducer* p)
+//
+//   A producer which only copies the bytes of a client or server
+//    connection to the other one (blind tunnels, and responses and
+//    POST bodies which are neither cached nor transformed) has the
+//    net processor splice them, so they never reach the buffer.  The
+//    consumer still gets the bytes in the buffer first, then it is
+//    only signalled.
+//
+void
+HttpTunnel::producer_splice(HttpTunnelProducer * p)
+{
+  HttpTunnelConsumer *c = p->consumer_list.head;
+
+  if (p->vc_type != HT_HTTP_SERVER && p->vc_type != HT_HTTP_CLIENT)
+    return;
+  if (p->num_consumers != 1 || !c->alive || !c->write_vio || c->self_producer ||
+      (c->vc_type != HT_HTTP_SERVER && c->vc_type != HT_HTTP_CLIENT))
+    return;
+  if (p->do_chunking || p->do_dechunking || p->do_chunked_passthru)
+    return;
+  // the POST body is copied from the buffer for redirects
+  if (p->vc_type == HT_HTTP_CLIENT && sm->enable_redirection)
+    return;
+
+  NetVConnection *src = session_netvc(p->vc, p->vc_type);
+  NetVConnection *dst = session_netvc(c->vc, c->vc_type);
+
+  if (src && dst && src->splice_to(dst))
+    Debug("http_tunnel", "[%" PRId64 "] [producer_splice] %s spliced to %s", sm->sm_id, p->name, c->name);
+}
+
 int
 HttpTunnel::producer_handler_dechunked(int event, HttpTunnelProducer * p)
 {
@@ -1652,3 +1755,102 @@ HttpTunnel::deallocate_redirect_postdata_buffers()
     postbuf = NULL;
   }
 }
+
+#if TS_HAS_TESTS
+
+// Read all of @a r and compare it to @a expected of @a len bytes.
+static bool
+chunked_test_compare(IOBufferReader * r, const char *expected, int64_t len)
+{
+  char buf[4096];
+  int64_t off = 0, n;
+
+  if (r->read_avail() != len)
+    return false;
+  while ((n = r->read(buf, sizeof(buf))) > 0) {
+    if (memcmp(buf, expected + off, n))
+      return false;
+    off += n;
+  }
+  return off == len;
+}
+
+static double
+chunked_test_mbps(int64_t bytes, ink_hrtime elapsed)
+{
+  return elapsed > 0 ? (double) bytes / (1024 * 1024) / ((double) elapsed / HRTIME_SECOND) : 0;
+}
+
+REGRESSION_TEST(HttpTunnel_Chunked)(RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  const int64_t body_len = 16 * 1024 * 1024;
+  char *body = (char *)ats_malloc(body_len);
+  MIOBuffer *in = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  IOBufferReader *in_reader = in->alloc_reader();
+  ChunkedHandler dechunk, chunk, rechunk;
+  IOBufferReader *out, *check, *chunked;
+  int64_t off, n, chunked_len;
+  ink_hrtime start, elapsed;
+  uint32_t seed = 1;
+  char hdr[64];
+
+  box = REGRESSION_TEST_PASSED;
+
+  for (off = 0; off < body_len; off++) {
+    seed = seed * 1103515245 + 12345;
+    body[off] = (char)(seed >> 16);
+  }
+
+  // origin style chunks of assorted sizes, some with extensions, and a trailer
+  for (off = 0, n = 0; off < body_len; off += n) {
+    seed = seed * 1103515245 + 12345;
+    n = MIN((int64_t)((seed >> 8) % 24576) + 1, body_len - off);
+    in->write(hdr, snprintf(hdr, sizeof(hdr), "%" PRIx64 "%s\r\n", n, (seed & 0x700) ? "" : ";ext=1"));
+    in->write(body + off, n);
+    in->write("\r\n", 2);
+  }
+  in->write("0\r\nX-Trailer: 1\r\n\r\n", sizeof("0\r\nX-Trailer: 1\r\n\r\n") - 1);
+  chunked_len = in_reader->read_avail();
+
+  // dechunk
+  dechunk.init_by_action(in_reader, ChunkedHandler::ACTION_DECHUNK);
+  out = dechunk.dechunked_buffer->alloc_reader();
+  dechunk.state = ChunkedHandler::CHUNK_READ_SIZE;
+  start = ink_get_hrtime();
+  dechunk.process_chunked_content();
+  elapsed = ink_get_hrtime() - start;
+  box.check(dechunk.state == ChunkedHandler::CHUNK_READ_DONE, "dechunking ended in state %d", dechunk.state);
+  box.check(dechunk.dechunked_size == body_len, "dechunked %" PRId64 " bytes, expected %" PRId64,
+            dechunk.dechunked_size, body_len);
+  rprintf(t, "dechunked %" PRId64 " bytes at %.0f MB/s\n", chunked_len, chunked_test_mbps(chunked_len, elapsed));
+
+  // chunk the result again
+  check = out->clone();
+  chunk.init_by_action(out, ChunkedHandler::ACTION_DOCHUNK);
+  chunk.set_max_chunk_size(0);
+  chunked = chunk.chunked_buffer->alloc_reader();
+  chunk.last_server_event = VC_EVENT_READ_COMPLETE;
+  start = ink_get_hrtime();
+  chunk.generate_chunked_content();
+  elapsed = ink_get_hrtime() - start;
+  box.check(chunk.state == ChunkedHandler::CHUNK_WRITE_DONE, "chunking ended in state %d", chunk.state);
+  rprintf(t, "chunked %" PRId64 " bytes at %.0f MB/s\n", body_len, chunked_test_mbps(body_len, elapsed));
+  box.check(chunked_test_compare(check, body, body_len), "dechunked data differs from the body");
+
+  // and check it dechunks to the body
+  rechunk.init_by_action(chunked, ChunkedHandler::ACTION_DECHUNK);
+  rechunk.state = ChunkedHandler::CHUNK_READ_SIZE;
+  out = rechunk.dechunked_buffer->alloc_reader();
+  rechunk.process_chunked_content();
+  box.check(rechunk.state == ChunkedHandler::CHUNK_READ_DONE, "dechunking the chunked data ended in state %d", rechunk.state);
+  box.check(chunked_test_compare(out, body, body_len), "chunked data does not dechunk to the body");
+
+  rechunk.clear();
+  chunk.clear();
+  dechunk.clear();
+  free_MIOBuffer(in);
+  ats_free(body);
+}
+
+#endif
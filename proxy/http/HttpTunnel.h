@@ -139,7 +139,7 @@ struct ChunkedHandler
   /// Caching members to avoid using printf on every chunk.
   /// It holds the header for a maximal sized chunk which will cover
   /// almost all output chunks.
-  char max_chunk_header[16];
+  char max_chunk_header[18];
   int max_chunk_header_len;
   //@}
   ChunkedHandler();
@@ -370,6 +370,7 @@ private:
   void finish_all_internal(HttpTunnelProducer * p, bool chain);
   void update_stats_after_abort(HttpTunnelType_t t);
   void producer_run(HttpTunnelProducer * p);
+  void producer_splice(HttpTunnelProducer * p);
 
   HttpTunnelProducer *get_producer(VIO * vio);
   HttpTunnelConsumer *get_consumer(VIO * vio);
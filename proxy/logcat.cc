@@ -40,6 +40,7 @@
 #include "LogObject.h"
 #include "LogConfig.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogUtils.h"
 #include "LogSock.h"
 #include "LogPredefined.h"
@@ -53,6 +54,7 @@ static int elf_flag = 0;
 static int elf2_flag = 0;
 static int auto_filenames = 0;
 static int overwrite_existing_file = 0;
+static int columnar_flag = 0;
 static char output_file[1024];
 int auto_clear_cache_flag = 0;
 
@@ -67,16 +69,80 @@ static const ArgumentDescription argument_descriptions[] = {
   {"debug_tags", 'T', "Colon-Separated Debug Tags", "S1023", error_tags, NULL, NULL},
   {"overwrite_output", 'w', "Overwrite existing output file(s)", "T", &overwrite_existing_file, NULL, NULL},
   {"elf2", '2', "Convert to Extended2 Logging Format", "T", &elf2_flag, NULL, NULL},
+  {"columnar", '-', "Convert to the columnar binary format", "T", &columnar_flag, NULL, NULL},
   HELP_ARGUMENT_DESCRIPTION(),
   VERSION_ARGUMENT_DESCRIPTION()
 };
 
+static int
+write_segment(LogBufferHeader * header, int out_fd)
+{
+  // see if there is an alternate format request from the command
+  // line
+  //
+  const char * alt_format = NULL;
+  if (squid_flag)
+    alt_format = PreDefinedFormatInfo::squid;
+  if (clf_flag)
+    alt_format = PreDefinedFormatInfo::common;
+  if (elf_flag)
+    alt_format = PreDefinedFormatInfo::extended;
+  if (elf2_flag)
+    alt_format = PreDefinedFormatInfo::extended2;
+
+  if (columnar_flag) {
+    char *block = NULL;
+    int len = LogColumnar::encode(header, &block);
+    int rc;
+
+    if (len > 0) {
+      rc = write(out_fd, block, len);
+      ats_free(block);
+    } else {
+      len = header->byte_count;
+      rc = write(out_fd, header, len);
+    }
+    if (rc != len) {
+      perror("Error writing output");
+      return 1;
+    }
+    return 0;
+  }
+
+  // convert the buffer to ascii entries and place onto stdout
+  //
+  if (header->fmt_fieldlist()) {
+    LogFile::write_ascii_logbuffer(header, out_fd, ".", alt_format);
+  } else {
+    // TODO investigate why this buffer goes wonky
+  }
+  return 0;
+}
+
+// Read a regular file through a mapping, which is faster than reading it
+// buffer by buffer.
+static int
+process_mapped_file(LogSegmentReader & reader, int out_fd)
+{
+  LogBufferHeader *header;
+
+  while ((header = reader.next())) {
+    if (write_segment(header, out_fd) != 0)
+      return 1;
+  }
+  if (reader.error()) {
+    fprintf(stderr, "Bad LogBuffer!\n");
+    return 1;
+  }
+  return 0;
+}
+
 static int
 process_file(int in_fd, int out_fd)
 {
   char buffer[MAX_LOGBUFFER_SIZE];
   int nread, buffer_bytes;
-  unsigned bytes = 0;
+  LogColumnarDecoder decoder;
 
   while (true) {
     // read the next buffer from file descriptor
@@ -95,9 +161,12 @@ process_file(int in_fd, int out_fd)
     if (!nread || nread == EOF)
       return 0;
 
-    // ensure that this is a valid logbuffer header
+    // ensure that this is a valid logbuffer header, or a columnar block
+    // (which starts like one)
     //
-    if (header->cookie != LOG_SEGMENT_COOKIE) {
+    if (header->cookie == LOG_COLUMNAR_COOKIE) {
+      header_size = sizeof(LogColumnarHeader);
+    } else if (header->cookie != LOG_SEGMENT_COOKIE) {
       fprintf(stderr, "Bad LogBuffer!\n");
       return 1;
     }
@@ -146,26 +215,17 @@ process_file(int in_fd, int out_fd)
       fprintf(stderr, "Read too many bytes!\n");
       return 1;
     }
-    // see if there is an alternate format request from the command
-    // line
-    //
-    const char * alt_format = NULL;
-    if (squid_flag)
-      alt_format = PreDefinedFormatInfo::squid;
-    if (clf_flag)
-      alt_format = PreDefinedFormatInfo::common;
-    if (elf_flag)
-      alt_format = PreDefinedFormatInfo::extended;
-    if (elf2_flag)
-      alt_format = PreDefinedFormatInfo::extended2;
-
-    // convert the buffer to ascii entries and place onto stdout
-    //
-    if (header->fmt_fieldlist()) {
-      bytes += LogFile::write_ascii_logbuffer(header, out_fd, ".", alt_format);
-    } else {
-      // TODO investigate why this buffer goes wonky
+
+    if (header->cookie == LOG_COLUMNAR_COOKIE) {
+      header = decoder.decode((LogColumnarHeader *) & buffer[0]);
+      if (!header) {
+        fprintf(stderr, "Bad columnar block!\n");
+        return 1;
+      }
     }
+
+    if (write_segment(header, out_fd) != 0)
+      return 1;
   }
 }
 
@@ -291,8 +351,18 @@ main(int /* argc ATS_UNUSED */, char *argv[])
             continue;
           }
         }
-        if (follow_flag)
+        if (follow_flag) {
           lseek(in_fd, 0, SEEK_END);
+        } else {
+          LogSegmentReader reader;
+
+          if (reader.open(in_fd, 0)) {
+            if (process_mapped_file(reader, out_fd) != 0)
+              error = DATA_PROCESSING_ERROR;
+            close(in_fd);
+            continue;
+          }
+        }
 
         while (true) {
           if (process_file(in_fd, out_fd) != 0) {
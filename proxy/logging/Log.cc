@@ -1274,6 +1274,18 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
     // process each flush data
     //
     while ((fdata = invert_link.pop())) {
+      if (fdata->m_spool) {
+        // a collation spool write or read ahead, see LogSpool
+        LogSpool *spool = fdata->m_spool;
+
+        spool->flush((LogBuffer *)fdata->m_data);
+        if (spool->refcount_dec() == 0) {
+          spool->free();
+        }
+        delete fdata;
+        continue;
+      }
+
       buf = NULL;
       bytes_written = 0;
       logfile = fdata->m_logfile;
@@ -1287,7 +1299,8 @@ Log::flush_thread_main(void * /* args ATS_UNUSED */)
         total_bytes = buffer_header->byte_count;
 
       } else if (logfile->m_file_format == LOG_FILE_ASCII
-                 || logfile->m_file_format == LOG_FILE_PIPE){
+                 || logfile->m_file_format == LOG_FILE_PIPE
+                 || logfile->m_file_format == LOG_FILE_COLUMNAR){
 
         buf = (char *)fdata->m_data;
         total_bytes = fdata->m_len;
@@ -1505,7 +1518,8 @@ Log::match_logobject(LogBufferHeader * header)
 
     if (fmt->valid()) {
       LogFileFormat file_format = header->log_object_flags & LogObject::BINARY ? LOG_FILE_BINARY :
-        (header->log_object_flags & LogObject::WRITES_TO_PIPE ? LOG_FILE_PIPE : LOG_FILE_ASCII);
+        (header->log_object_flags & LogObject::COLUMNAR ? LOG_FILE_COLUMNAR :
+         (header->log_object_flags & LogObject::WRITES_TO_PIPE ? LOG_FILE_PIPE : LOG_FILE_ASCII));
 
       obj = new LogObject(fmt, Log::config->logfile_dir,
                           header->log_filename(), file_format, NULL,
@@ -311,23 +311,35 @@ class LogFormat;
 class LogObject;
 class LogConfig;
 class TextLogObject;
+class LogSpool;
 
 class LogFlushData
 {
 public:
   LINK(LogFlushData, link);
   Ptr<LogFile> m_logfile;
+  LogSpool *m_spool;            // set instead of m_logfile for a collation spool
   LogBuffer *logbuffer;
   void *m_data;
   int m_len;
 
   LogFlushData(LogFile *logfile, void *data, int len = -1):
-    m_logfile(logfile), m_data(data), m_len(len)
+    m_logfile(logfile), m_spool(NULL), m_data(data), m_len(len)
+  {
+  }
+
+  // a LogBuffer to write to the spool, or NULL to read ahead
+  LogFlushData(LogSpool *spool, LogBuffer *lb):
+    m_logfile(NULL), m_spool(spool), m_data(lb), m_len(-1)
   {
   }
 
   ~LogFlushData()
   {
+    if (m_spool) {
+      // the spool took the buffer
+      return;
+    }
     switch (m_logfile->m_file_format) {
     case LOG_FILE_BINARY:
       logbuffer = (LogBuffer *)m_data;
@@ -335,6 +347,7 @@ public:
       break;
     case LOG_FILE_ASCII:
     case LOG_FILE_PIPE:
+    case LOG_FILE_COLUMNAR:
       free(m_data);
       break;
     case N_LOGFILE_TYPES:
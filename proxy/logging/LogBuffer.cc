@@ -59,6 +59,9 @@ enum
 
 FieldListCacheElement fieldlist_cache[FIELDLIST_CACHE_SIZE];
 int fieldlist_cache_entries = 0;
+LogFormatProgram *format_program_cache[FIELDLIST_CACHE_SIZE];
+int format_program_cache_entries = 0;
+static ink_mutex format_program_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 vint32 LogBuffer::M_ID = 0;
 
 /*-------------------------------------------------------------------------
@@ -170,7 +173,7 @@ LogBuffer::LogBuffer(LogObject * owner, LogBufferHeader * header):
   m_id = (uint32_t) ink_atomic_increment((pvint32) & M_ID, 1);
 
   Debug("log-logbuffer","[%p] Created repurposed buffer %u for %s at address %p",
-        this_ethread(), m_id, m_owner->get_base_filename(), m_buffer);
+        this_ethread(), m_id, m_owner ? m_owner->get_base_filename() : "(spool)", m_buffer);
 }
 
 LogBuffer::~LogBuffer()
@@ -617,6 +620,39 @@ LogBuffer::resolve_custom_entry(LogFieldList * fieldlist,
   return bytes_written;
 }
 
+/*-------------------------------------------------------------------------
+  LogBuffer::format_program
+
+  Return the compiled form of the format given by the symbol and printf
+  strings of a buffer header, compiling it on first use.  Returns NULL if
+  the format does not compile or the cache is full, in which case the
+  entries are formatted by resolve_custom_entry.
+  -------------------------------------------------------------------------*/
+LogFormatProgram *
+LogBuffer::format_program(const char *symbol_str, const char *printf_str)
+{
+  int i;
+  LogFormatProgram *program = NULL;
+
+  // several preproc threads format buffers at once
+  ink_mutex_acquire(&format_program_cache_mutex);
+  for (i = 0; i < format_program_cache_entries; i++) {
+    if (format_program_cache[i]->matches(symbol_str, printf_str)) {
+      program = format_program_cache[i];
+      break;
+    }
+  }
+
+  if (!program && format_program_cache_entries < FIELDLIST_CACHE_SIZE) {
+    Debug("log-fieldlist", "Compiling format for %s as entry %d", symbol_str, format_program_cache_entries);
+    program = new LogFormatProgram(symbol_str, printf_str);
+    format_program_cache[format_program_cache_entries++] = program;
+  }
+  ink_mutex_release(&format_program_cache_mutex);
+
+  return (program && program->valid()) ? program : NULL;
+}
+
 /*-------------------------------------------------------------------------
   LogBuffer::to_ascii
 
@@ -657,6 +693,13 @@ LogBuffer::to_ascii(LogEntryHeader * entry, LogFormatType type,
   // these stored plans.
   //
 
+  if (!alt_format) {
+    LogFormatProgram *program = format_program(symbol_str, printf_str);
+    if (program) {
+      return program->run(entry, buf, buf_len, buffer_version);
+    }
+  }
+
   int i;
   LogFieldList *fieldlist = NULL;
   bool delete_fieldlist_p = false; // need to free the fieldlist?
@@ -183,6 +183,7 @@ public:
   static int to_ascii(LogEntryHeader * entry, LogFormatType type,
                       char *buf, int max_len, const char *symbol_str, char *printf_str,
                       unsigned buffer_version, const char *alt_format = NULL);
+  static LogFormatProgram *format_program(const char *symbol_str, const char *printf_str);
   static int resolve_custom_entry(LogFieldList * fieldlist,
                                   char *printf_str, char *read_from, char *write_to,
                                   int write_to_len, long timestamp, long timestamp_us,
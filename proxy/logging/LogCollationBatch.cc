@@ -0,0 +1,215 @@
+/** @file
+
+  Batched, compressed frames of the log collation protocol.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#if TS_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Error.h"
+#include "LogBuffer.h"
+#include "LogCollationBatch.h"
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+#endif
+
+// the links are usually WAN links, favor speed over ratio
+#define LOG_COLLATION_BATCH_ZSTD_LEVEL 1
+
+LogCollationBatch::LogCollationBatch()
+  : m_data(NULL), m_data_len(0), m_data_size(0), m_count(0)
+{
+}
+
+LogCollationBatch::~LogCollationBatch()
+{
+  ats_free(m_data);
+}
+
+void
+LogCollationBatch::add(LogBufferHeader * segment)
+{
+  int len = segment->byte_count;
+
+  if (m_data_len + len > m_data_size) {
+    m_data_size = MAX(m_data_size * 2, m_data_len + len);
+    m_data = (char *)ats_realloc(m_data, m_data_size);
+  }
+  memcpy(m_data + m_data_len, segment, len);
+  m_data_len += len;
+  m_count++;
+}
+
+int
+LogCollationBatch::pack(char **frame)
+{
+  size_t bound = m_data_len;
+  LogCollationBatchHeader *h;
+
+#if TS_HAS_ZSTD
+  bound = ZSTD_compressBound(m_data_len);
+#endif
+  *frame = (char *)ats_malloc(sizeof(LogCollationBatchHeader) + bound);
+  h = (LogCollationBatchHeader *) *frame;
+  h->cookie = LOG_COLLATION_BATCH_COOKIE;
+  h->version = LOG_COLLATION_BATCH_VERSION;
+  h->codec = LOG_COLLATION_BATCH_RAW;
+  h->buffer_count = m_count;
+  h->data_len = m_data_len;
+  h->payload_len = m_data_len;
+
+#if TS_HAS_ZSTD
+  size_t c = ZSTD_compress(*frame + sizeof(LogCollationBatchHeader), bound, m_data, m_data_len,
+                           LOG_COLLATION_BATCH_ZSTD_LEVEL);
+  if (!ZSTD_isError(c) && c < (size_t)m_data_len) {
+    h->codec = LOG_COLLATION_BATCH_ZSTD;
+    h->payload_len = c;
+  }
+#endif
+  if (h->codec == LOG_COLLATION_BATCH_RAW) {
+    memcpy(*frame + sizeof(LogCollationBatchHeader), m_data, m_data_len);
+  }
+
+  clear();
+  return sizeof(LogCollationBatchHeader) + h->payload_len;
+}
+
+char *
+LogCollationBatch::unpack(const char *frame, int len, int *data_len, int *count)
+{
+  const LogCollationBatchHeader *h = (const LogCollationBatchHeader *)frame;
+  char *data = NULL;
+  uint32_t off, n;
+
+  if (len < (int)sizeof(LogCollationBatchHeader) || h->cookie != LOG_COLLATION_BATCH_COOKIE ||
+      h->version != LOG_COLLATION_BATCH_VERSION || h->payload_len != len - sizeof(LogCollationBatchHeader) ||
+      h->data_len > LOG_COLLATION_BATCH_MAX_BYTES) {
+    return NULL;
+  }
+
+  data = (char *)ats_malloc(MAX(h->data_len, 1));
+  switch (h->codec) {
+  case LOG_COLLATION_BATCH_RAW:
+    if (h->payload_len != h->data_len)
+      goto Lerror;
+    memcpy(data, frame + sizeof(LogCollationBatchHeader), h->data_len);
+    break;
+#if TS_HAS_ZSTD
+  case LOG_COLLATION_BATCH_ZSTD: {
+    size_t l = ZSTD_decompress(data, h->data_len, frame + sizeof(LogCollationBatchHeader), h->payload_len);
+    if (ZSTD_isError(l) || l != h->data_len)
+      goto Lerror;
+    break;
+  }
+#endif
+  default:
+    goto Lerror;
+  }
+
+  for (off = 0, n = 0; off < h->data_len; n++) {
+    LogBufferHeader *segment = (LogBufferHeader *)(data + off);
+
+    if (h->data_len - off < sizeof(LogBufferHeader) || segment->cookie != LOG_SEGMENT_COOKIE ||
+        segment->byte_count < sizeof(LogBufferHeader) || segment->byte_count > h->data_len - off) {
+      goto Lerror;
+    }
+    off += segment->byte_count;
+  }
+  if (n != h->buffer_count)
+    goto Lerror;
+
+  *data_len = h->data_len;
+  *count = n;
+  return data;
+
+Lerror:
+  ats_free(data);
+  return NULL;
+}
+
+#if TS_HAS_TESTS
+
+static LogBufferHeader *
+make_test_segment(uint32_t byte_count, char fill)
+{
+  LogBufferHeader *h = (LogBufferHeader *)ats_malloc(byte_count);
+
+  memset(h, fill, byte_count);
+  h->cookie = LOG_SEGMENT_COOKIE;
+  h->version = LOG_SEGMENT_VERSION;
+  h->byte_count = byte_count;
+  h->entry_count = 1;
+  return h;
+}
+
+REGRESSION_TEST(LogCollation_BatchFrames)(RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  TestBox box(t, pstatus);
+  LogCollationBatch batch;
+  LogBufferHeader *seg[3];
+  char *frame = NULL, *data;
+  int frame_len, data_len = 0, count = 0;
+
+  box = REGRESSION_TEST_PASSED;
+
+  seg[0] = make_test_segment(sizeof(LogBufferHeader) + 1024, 'a');
+  seg[1] = make_test_segment(sizeof(LogBufferHeader) + 8, 'b');
+  seg[2] = make_test_segment(sizeof(LogBufferHeader) + 4096, 'c');
+  for (int i = 0; i < 3; i++)
+    batch.add(seg[i]);
+  box.check(batch.count() == 3, "batch holds %d segments, expected 3", batch.count());
+
+  frame_len = batch.pack(&frame);
+  box.check(batch.count() == 0 && batch.data_len() == 0, "batch not cleared by pack");
+
+  data = LogCollationBatch::unpack(frame, frame_len, &data_len, &count);
+  box.check(data != NULL, "frame of %d bytes does not unpack", frame_len);
+  if (data) {
+    char *p = data;
+
+    box.check(count == 3, "unpacked %d segments, expected 3", count);
+    for (int i = 0; i < 3 && p < data + data_len; i++) {
+      box.check(memcmp(p, seg[i], seg[i]->byte_count) == 0, "segment %d differs", i);
+      p += seg[i]->byte_count;
+    }
+    box.check(p == data + data_len, "unpacked %d bytes, not the length of the segments", data_len);
+    ats_free(data);
+  }
+#if TS_HAS_ZSTD
+  box.check(((LogCollationBatchHeader *)frame)->codec == LOG_COLLATION_BATCH_ZSTD, "repetitive segments not compressed");
+  rprintf(t, "%d bytes of segments packed into %d bytes\n", ((LogCollationBatchHeader *)frame)->data_len, frame_len);
+#endif
+
+  // truncated and corrupted frames are rejected
+  box.check(LogCollationBatch::unpack(frame, frame_len - 1, &data_len, &count) == NULL, "truncated frame unpacked");
+  ((LogCollationBatchHeader *)frame)->buffer_count = 2;
+  box.check(LogCollationBatch::unpack(frame, frame_len, &data_len, &count) == NULL, "frame with a bad count unpacked");
+  ats_free(frame);
+
+  for (int i = 0; i < 3; i++)
+    ats_free(seg[i]);
+}
+
+#endif
@@ -0,0 +1,109 @@
+/** @file
+
+  Batched, compressed frames of the log collation protocol.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef LOG_COLLATION_BATCH_H
+#define LOG_COLLATION_BATCH_H
+
+#include "libts.h"
+
+struct LogBufferHeader;
+
+#define LOG_COLLATION_BATCH_COOKIE 0xba7cface
+#define LOG_COLLATION_BATCH_VERSION 1
+
+// upper bound of the uncompressed data of a frame
+#define LOG_COLLATION_BATCH_MAX_BYTES (16 * 1024 * 1024)
+
+// upper bound of collation_window, the frames a client may have unacknowledged
+#define LOG_COLLATION_MAX_WINDOW 64
+
+enum LogCollationBatchCodec
+{
+  LOG_COLLATION_BATCH_RAW = 0,
+  LOG_COLLATION_BATCH_ZSTD = 1
+};
+
+/*-------------------------------------------------------------------------
+  LogCollationBatchHeader
+
+  A collation client configured to batch (see collation_batch_buffers)
+  sends frames holding several LogBuffer segments instead of a single
+  segment per message.  The message body is this header, followed by the
+  concatenated segments, compressed as a whole.  The cookie lets the host
+  tell frames from plain segments, so it accepts both.
+
+  The host acknowledges each frame with a uint32_t count of frames once
+  their buffers are queued for flushing.  The client keeps at most
+  collation_window frames unacknowledged, and the buffers of those frames
+  until they are acknowledged, so they can be orphaned if the connection
+  is lost.  Hosts never write to clients which do not batch.
+  -------------------------------------------------------------------------*/
+
+struct LogCollationBatchHeader
+{
+  uint32_t cookie;              // LOG_COLLATION_BATCH_COOKIE
+  uint32_t version;             // LOG_COLLATION_BATCH_VERSION
+  uint32_t codec;               // LogCollationBatchCodec of the data
+  uint32_t buffer_count;
+  uint32_t data_len;            // of the segments, uncompressed
+  uint32_t payload_len;         // of the segments as sent
+};
+
+class LogCollationBatch
+{
+public:
+  LogCollationBatch();
+  ~LogCollationBatch();
+
+  void add(LogBufferHeader * segment);
+  void clear() { m_data_len = 0; m_count = 0; }
+  int count() const { return m_count; }
+  int data_len() const { return m_data_len; }
+
+  /**
+     Compress the segments added so far into a frame, which is allocated
+     with ats_malloc and returned in @a frame, and clear the batch.
+     Returns the length of the frame.
+  */
+  int pack(char **frame);
+
+  /**
+     Check and uncompress the frame @a frame of @a len bytes.  Returns the
+     concatenated segments, allocated with ats_malloc, whose length and
+     number are returned in @a data_len and @a count, or NULL if the frame
+     is not valid.  The segments are checked to fill the data exactly.
+  */
+  static char *unpack(const char *frame, int len, int *data_len, int *count);
+
+private:
+  char *m_data;
+  int m_data_len;
+  int m_data_size;
+  int m_count;
+
+  // -- member functions that are not allowed --
+  LogCollationBatch(const LogCollationBatch &);
+  LogCollationBatch & operator=(const LogCollationBatch &);
+};
+
+#endif // LOG_COLLATION_BATCH_H
@@ -55,6 +55,10 @@
 
 int LogCollationClientSM::ID = 0;
 
+// how often to look for buffers the flush thread has read back from the
+// spool, while there is nothing else to send
+static const int SPOOL_POLL_MSEC = 100;
+
 //-------------------------------------------------------------------------
 // LogCollationClientSM::LogCollationClientSM
 //-------------------------------------------------------------------------
@@ -71,10 +75,15 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host)
     m_pending_event(NULL),
     m_abort_vio(NULL),
     m_abort_buffer(NULL),
+    m_abort_reader(NULL),
     m_host_is_up(false),
     m_buffer_send_list(NULL),
     m_buffer_in_iocore(NULL),
     m_flow(LOG_COLL_FLOW_ALLOW),
+    m_buffer_unacked_list(NULL),
+    m_frames_head(0),
+    m_frames_in_flight(0),
+    m_frame_in_iocore(false),
     m_log_host(log_host),
     m_id(ID++)
 {
@@ -86,6 +95,7 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host)
   // we can accept logs to send before we're fully initialized
   m_buffer_send_list = new LogBufferList();
   ink_assert(m_buffer_send_list != NULL);
+  m_buffer_unacked_list = new LogBufferList();
 
   SET_HANDLER((LogCollationClientSMHandler) & LogCollationClientSM::client_handler);
   client_init(LOG_COLL_EVENT_SWITCH, NULL);
@@ -120,6 +130,12 @@ LogCollationClientSM::~LogCollationClientSM()
 int
 LogCollationClientSM::client_handler(int event, void *data)
 {
+  // frame acknowledgements may arrive in any state
+  if (event == VC_EVENT_READ_READY && data == m_abort_vio) {
+    receive_acks();
+    return EVENT_CONT;
+  }
+
   switch (m_client_state) {
   case LOG_COLL_CLIENT_AUTH:
     return client_auth(event, (VIO *) data);
@@ -181,6 +197,7 @@ LogCollationClientSM::send(LogBuffer * log_buffer)
   ink_assert(log_buffer != NULL);
   ink_assert(m_buffer_send_list != NULL);
   m_buffer_send_list->add(log_buffer);
+  RecIncrRawStat(log_rsb, this_ethread(), log_stat_collation_send_queue_depth_stat, 1);
   Debug("log-coll", "[%d]client::send - new log_buffer to send_list", m_id);
 
   // disable m_flow if there's too much work to do now
@@ -372,11 +389,17 @@ LogCollationClientSM::client_done(int event, void * /* data ATS_UNUSED */)
       free_MIOBuffer(m_send_buffer);
     }
     if (m_abort_buffer) {
+      if (m_abort_reader) {
+        m_abort_buffer->dealloc_reader(m_abort_reader);
+      }
       free_MIOBuffer(m_abort_buffer);
     }
     if (m_buffer_send_list) {
       delete m_buffer_send_list;
     }
+    if (m_buffer_unacked_list) {
+      delete m_buffer_unacked_list;
+    }
 
     return EVENT_DONE;
 
@@ -424,8 +447,13 @@ LogCollationClientSM::client_fail(int event, void * /* data ATS_UNUSED */)
     // flush unsent logs to orphan
     flush_to_orphan();
 
+    // drop a pending spool poll, see wait_for_spool
+    if (m_pending_event != NULL) {
+      m_pending_event->cancel();
+      m_pending_event = NULL;
+    }
+
     // call back in collation_retry_sec seconds
-    ink_assert(m_pending_event == NULL);
     m_pending_event = eventProcessor.schedule_in(this, HRTIME_SECONDS(Log::config->collation_retry_sec));
 
     return EVENT_CONT;
@@ -455,6 +483,11 @@ LogCollationClientSM::client_idle(int event, void * /* data ATS_UNUSED */)
   switch (event) {
   case LOG_COLL_EVENT_SWITCH:
     m_client_state = LOG_COLL_CLIENT_IDLE;
+    // nothing left for a pending send or spool poll to do
+    if (m_pending_event != NULL) {
+      m_pending_event->cancel();
+      m_pending_event = NULL;
+    }
     return EVENT_CONT;
 
   case VC_EVENT_EOS:
@@ -503,6 +536,7 @@ LogCollationClientSM::client_init(int event, void * /* data ATS_UNUSED */)
     ink_assert(m_send_reader != NULL);
     m_abort_buffer = new_MIOBuffer();
     ink_assert(m_abort_buffer != NULL);
+    m_abort_reader = m_abort_buffer->alloc_reader();
 
     // if we don't have an ip already, switch to client_dns
     if (! m_log_host->ip_addr().isValid()) {
@@ -559,9 +593,11 @@ LogCollationClientSM::client_open(int event, NetVConnection * net_vc)
     ink_assert(net_vc != NULL);
     m_host_vc = net_vc;
 
-    // setup a client reader just for detecting a host disconnnect
-    // (iocore should call back this function with and EOS/ERROR)
-    m_abort_vio = m_host_vc->do_io_read(this, 1, m_abort_buffer);
+    // setup a client reader for detecting a host disconnnect
+    // (iocore should call back this function with and EOS/ERROR), which
+    // also reads the acknowledgements of batched frames
+    m_abort_reader->consume(m_abort_reader->read_avail());
+    m_abort_vio = m_host_vc->do_io_read(this, INT64_MAX, m_abort_buffer);
 
     // change states
     return client_auth(LOG_COLL_EVENT_SWITCH, NULL);
@@ -593,6 +629,7 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
 
   switch (event) {
   case EVENT_IMMEDIATE:
+  case EVENT_INTERVAL:
     Debug("log-coll", "[%d]client::client_send - EVENT_IMMEDIATE", m_id);
     // callback complete, reset m_pending_event
     m_pending_event = NULL;
@@ -604,10 +641,26 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
       Debug("log-coll", "[%d]client::client_send - SWITCH", m_id);
       m_client_state = LOG_COLL_CLIENT_SEND;
 
+      // a frame is being written, its completion sends the next one
+      if (m_frame_in_iocore) {
+        return EVENT_CONT;
+      }
+
+      if (m_buffer_send_list->get_size() == 0) {
+        refill_from_spool();
+      }
+
+      if (Log::config->collation_batch_buffers > 0) {
+        return send_batch();
+      }
+
       // get a buffer off our queue
       ink_assert(m_buffer_send_list != NULL);
       ink_assert(m_buffer_in_iocore == NULL);
       if ((m_buffer_in_iocore = m_buffer_send_list->get()) == NULL) {
+        if (m_log_host->spool_pending()) {
+          return wait_for_spool();
+        }
         return client_idle(LOG_COLL_EVENT_SWITCH, NULL);
       }
       Debug("log-coll", "[%d]client::client_send - send_list to m_buffer_in_iocore", m_id);
@@ -645,6 +698,9 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
       RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
                      log_buffer_header->byte_count);
 
+      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_collation_wire_bytes_stat,
+                     bytes_to_send + sizeof(NetMsgHeader));
+
       // copy into m_send_buffer
       ink_assert(m_send_buffer != NULL);
       m_send_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
@@ -666,6 +722,12 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
   case VC_EVENT_WRITE_COMPLETE:
     Debug("log-coll", "[%d]client::client_send - WRITE_COMPLETE", m_id);
 
+    // the buffers of a frame are kept until it is acknowledged
+    if (m_frame_in_iocore) {
+      m_frame_in_iocore = false;
+      return client_send(LOG_COLL_EVENT_SWITCH, NULL);
+    }
+
     ink_assert(m_buffer_in_iocore != NULL);
 #if defined(LOG_BUFFER_TRACKING)
     Debug("log-buftrak", "[%d]client::client_send - network write complete", m_buffer_in_iocore->header()->id);
@@ -675,6 +737,7 @@ LogCollationClientSM::client_send(int event, VIO * /* vio ATS_UNUSED */)
     Debug("log-coll", "[%d]client::client_send - m_buffer_in_iocore[%p] to delete_list", m_id, m_buffer_in_iocore);
     LogBuffer::destroy(m_buffer_in_iocore);
     m_buffer_in_iocore = NULL;
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_collation_send_queue_depth_stat, -1);
 
     // switch back to client_send
     return client_send(LOG_COLL_EVENT_SWITCH, NULL);
@@ -716,6 +779,21 @@ LogCollationClientSM::flush_to_orphan()
 {
   Debug("log-coll", "[%d]client::flush_to_orphan", m_id);
 
+  LogBuffer *log_buffer;
+  int orphaned = 0;
+
+  // the buffers of unacknowledged frames may not have reached the host,
+  // so they are orphaned too
+  ink_assert(m_buffer_unacked_list != NULL);
+  while ((log_buffer = m_buffer_unacked_list->get()) != NULL) {
+    m_log_host->orphan_write_and_try_delete(log_buffer);
+    orphaned++;
+  }
+  m_batch.clear();
+  m_frames_head = 0;
+  m_frames_in_flight = 0;
+  m_frame_in_iocore = false;
+
   // if in middle of a write, flush buffer_in_iocore to orphan
   if (m_buffer_in_iocore != NULL) {
     Debug("log-coll", "[%d]client::flush_to_orphan - m_buffer_in_iocore to oprhan", m_id);
@@ -723,16 +801,162 @@ LogCollationClientSM::flush_to_orphan()
     // m_buffer_in_iocore->convert_to_host_order();
     m_log_host->orphan_write_and_try_delete(m_buffer_in_iocore);
     m_buffer_in_iocore = NULL;
+    orphaned++;
   }
   // flush buffers in send_list to orphan
-  LogBuffer *log_buffer;
   ink_assert(m_buffer_send_list != NULL);
   while ((log_buffer = m_buffer_send_list->get()) != NULL) {
     Debug("log-coll", "[%d]client::flush_to_orphan - send_list to orphan", m_id);
     m_log_host->orphan_write_and_try_delete(log_buffer);
+    orphaned++;
   }
+  RecIncrRawStat(log_rsb, this_ethread(), log_stat_collation_send_queue_depth_stat, -orphaned);
 
   // Now send_list is empty, let's update m_flow to ALLOW status
   Debug("log-coll", "[%d]client::client_send - m_flow = ALLOW", m_id);
   m_flow = LOG_COLL_FLOW_ALLOW;
 }
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::send_batch
+//
+// Sends the next frame of buffers, if the window allows it.  Called in
+// place of the single buffer send of client_send when batching.
+//-------------------------------------------------------------------------
+int
+LogCollationClientSM::send_batch()
+{
+  ip_port_text_buffer ipb;
+  LogBuffer *log_buffer;
+
+  if (m_frames_in_flight >= Log::config->collation_window) {
+    Debug("log-coll", "[%d]client::send_batch - window full (%d frames)", m_id, m_frames_in_flight);
+    return EVENT_CONT;
+  }
+
+  while (m_batch.count() < Log::config->collation_batch_buffers && m_batch.data_len() < LOG_COLLATION_BATCH_MAX_BYTES / 2 &&
+         (log_buffer = m_buffer_send_list->get()) != NULL) {
+    LogBufferHeader *log_buffer_header = log_buffer->header();
+
+    m_batch.add(log_buffer_header);
+    m_buffer_unacked_list->add(log_buffer);
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_sent_to_network_stat,
+                   log_buffer_header->entry_count);
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
+                   log_buffer_header->byte_count);
+  }
+  if (m_batch.count() == 0) {
+    if (m_log_host->spool_pending()) {
+      return wait_for_spool();
+    }
+    return client_idle(LOG_COLL_EVENT_SWITCH, NULL);
+  }
+
+  // enable m_flow if we're out of work to do
+  if (m_flow == LOG_COLL_FLOW_DENY && m_buffer_send_list->get_size() == 0) {
+    Debug("log-coll", "[%d]client::send_batch - m_flow = ALLOW", m_id);
+    Note("[log-coll] send-queue clear; resuming collation [%s:%u]",
+         m_log_host->ip_addr().toString(ipb, sizeof ipb), m_log_host->port());
+    m_flow = LOG_COLL_FLOW_ALLOW;
+  }
+
+  int buffers = m_batch.count();
+  char *frame = NULL;
+  NetMsgHeader nmh;
+
+  nmh.msg_bytes = m_batch.pack(&frame);
+  m_send_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
+  m_send_buffer->write(frame, nmh.msg_bytes);
+  ats_free(frame);
+
+  m_frame_buffers[(m_frames_head + m_frames_in_flight) % LOG_COLLATION_MAX_WINDOW] = buffers;
+  m_frames_in_flight++;
+  m_frame_in_iocore = true;
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_collation_wire_bytes_stat,
+                 nmh.msg_bytes + sizeof(NetMsgHeader));
+
+  Debug("log-coll", "[%d]client::send_batch - do_io_write(%d), %d buffers, %d frames in flight", m_id,
+        (int)(nmh.msg_bytes + sizeof(NetMsgHeader)), buffers, m_frames_in_flight);
+  ink_assert(m_host_vc != NULL);
+  m_host_vio = m_host_vc->do_io_write(this, nmh.msg_bytes + sizeof(NetMsgHeader), m_send_reader);
+  ink_assert(m_host_vio != NULL);
+  return EVENT_CONT;
+}
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::receive_acks
+//
+// Releases the buffers of the frames acknowledged by the host, and sends
+// more if the window was full.
+//-------------------------------------------------------------------------
+void
+LogCollationClientSM::receive_acks()
+{
+  uint32_t acked;
+
+  while (m_abort_reader->read_avail() >= (int64_t)sizeof(acked)) {
+    m_abort_reader->read((char *) &acked, sizeof(acked));
+    Debug("log-coll", "[%d]client::receive_acks - %u frames acknowledged", m_id, acked);
+
+    for (; acked > 0 && m_frames_in_flight > 0; acked--) {
+      int buffers = m_frame_buffers[m_frames_head];
+
+      for (int i = 0; i < buffers; i++) {
+        LogBuffer *log_buffer = m_buffer_unacked_list->get();
+
+        ink_assert(log_buffer != NULL);
+        if (log_buffer) {
+          LogBuffer::destroy(log_buffer);
+        }
+      }
+      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_collation_send_queue_depth_stat, -buffers);
+      m_frames_head = (m_frames_head + 1) % LOG_COLLATION_MAX_WINDOW;
+      m_frames_in_flight--;
+    }
+  }
+  m_abort_vio->reenable();
+
+  if (m_client_state == LOG_COLL_CLIENT_SEND && !m_frame_in_iocore && m_buffer_in_iocore == NULL) {
+    client_send(LOG_COLL_EVENT_SWITCH, NULL);
+  }
+}
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::refill_from_spool
+//
+// Queues the buffers spooled while the host was down or too slow, once
+// the queue is empty, a frame's worth at a time.  Only the buffers the
+// flush thread has read back already are taken, see LogSpool.
+//-------------------------------------------------------------------------
+void
+LogCollationClientSM::refill_from_spool()
+{
+  int n = MAX(Log::config->collation_batch_buffers, 1);
+  LogBuffer *log_buffer;
+
+  while (n-- > 0 && (log_buffer = m_log_host->spool_read()) != NULL) {
+    Debug("log-coll", "[%d]client::refill_from_spool - spool to send_list", m_id);
+    m_buffer_send_list->add(log_buffer);
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_collation_send_queue_depth_stat, 1);
+  }
+}
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::wait_for_spool
+//
+// There is nothing to send yet, but the spool is still being read back;
+// look again shortly rather than going idle, since no new buffer may come
+// along to wake us up.
+//-------------------------------------------------------------------------
+int
+LogCollationClientSM::wait_for_spool()
+{
+  Debug("log-coll", "[%d]client::wait_for_spool", m_id);
+  if (m_pending_event == NULL) {
+    m_pending_event = eventProcessor.schedule_in(this, HRTIME_MSECONDS(SPOOL_POLL_MSEC));
+  }
+  return EVENT_CONT;
+}
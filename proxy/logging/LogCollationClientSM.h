@@ -30,6 +30,7 @@
 #include "P_HostDB.h"
 #include "P_Net.h"
 #include "LogCollationBase.h"
+#include "LogCollationBatch.h"
 
 //-------------------------------------------------------------------------
 // pre-declarations
@@ -90,6 +91,10 @@ private:
 
   // support functions
   void flush_to_orphan();
+  int send_batch();
+  void receive_acks();
+  void refill_from_spool();
+  int wait_for_spool();
 
   // iocore stuff (two buffers to avoid races)
   NetVConnection *m_host_vc;
@@ -102,8 +107,10 @@ private:
   Event *m_pending_event;
 
   // to detect server closes (there's got to be a better way to do this)
+  // (also reads the frame acknowledgements of the host when batching)
   VIO *m_abort_vio;
   MIOBuffer *m_abort_buffer;
+  IOBufferReader *m_abort_reader;
   bool m_host_is_up;
 
   // send stuff
@@ -111,6 +118,15 @@ private:
   LogBuffer *m_buffer_in_iocore;
   ClientFlowControl m_flow;
 
+  // batch stuff: the buffers of the unacknowledged frames, in order, and
+  // the number of buffers of each frame
+  LogCollationBatch m_batch;
+  LogBufferList *m_buffer_unacked_list;
+  int m_frame_buffers[LOG_COLLATION_MAX_WINDOW];
+  int m_frames_head;
+  int m_frames_in_flight;
+  bool m_frame_in_iocore;
+
   // back pointer to LogHost container
   LogHost *m_log_host;
 
@@ -48,6 +48,7 @@
 #include "Log.h"
 
 #include "LogCollationHostSM.h"
+#include "LogCollationBatch.h"
 
 //-------------------------------------------------------------------------
 // statics
@@ -67,6 +68,9 @@ m_client_vio(NULL),
 m_client_buffer(NULL),
 m_client_reader(NULL),
 m_pending_event(NULL),
+m_ack_vio(NULL),
+m_ack_buffer(NULL),
+m_ack_reader(NULL),
 m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0), m_client_ip(0), m_client_port(0), m_id(ID++)
 {
 
@@ -102,6 +106,10 @@ m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0), m_client_
 int
 LogCollationHostSM::host_handler(int event, void *data)
 {
+  // nothing to do when acknowledgements are written
+  if (data != NULL && data == m_ack_vio && (event == VC_EVENT_WRITE_READY || event == VC_EVENT_WRITE_COMPLETE)) {
+    return EVENT_CONT;
+  }
 
   switch (m_host_state) {
   case LOG_COLL_HOST_AUTH:
@@ -126,6 +134,9 @@ LogCollationHostSM::host_handler(int event, void *data)
 int
 LogCollationHostSM::read_handler(int event, void *data)
 {
+  if (data != NULL && data == m_ack_vio && (event == VC_EVENT_WRITE_READY || event == VC_EVENT_WRITE_COMPLETE)) {
+    return EVENT_CONT;
+  }
 
   switch (m_read_state) {
   case LOG_COLL_READ_BODY:
@@ -226,6 +237,12 @@ LogCollationHostSM::host_done(int /* event ATS_UNUSED */, void * /* data ATS_UNU
     }
     free_MIOBuffer(m_client_buffer);
   }
+  if (m_ack_buffer) {
+    if (m_ack_reader) {
+      m_ack_buffer->dealloc_reader(m_ack_reader);
+    }
+    free_MIOBuffer(m_ack_buffer);
+  }
   // delete this state machine and return
   delete this;
   return EVENT_DONE;
@@ -285,56 +302,18 @@ LogCollationHostSM::host_recv(int event, void * /* data ATS_UNUSED */)
   case LOG_COLL_EVENT_READ_COMPLETE:
     Debug("log-coll", "[%d]host::host_recv - READ_COMPLETE", m_id);
     {
-      // grab the log_buffer
-      LogBufferHeader *log_buffer_header;
-      LogBuffer *log_buffer;
-      LogFormat *log_format;
-      LogObject *log_object;
-      unsigned version;
-
       ink_assert(m_read_buffer != NULL);
-      ink_assert(m_read_bytes_received >= (int64_t)sizeof(LogBufferHeader));
-      log_buffer_header = (LogBufferHeader *) m_read_buffer;
-
-      // convert the buffer we just received to host order
-      // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-      // LogBuffer::convert_to_host_order(log_buffer_header);
+      ink_assert(m_read_bytes_received >= (int64_t)sizeof(uint32_t));
 
-      version = log_buffer_header->version;
-      if (version != LOG_SEGMENT_VERSION) {
-        Note("[log-coll] invalid LogBuffer received; invalid version - "
-             "buffer = %u, current = %u", version, LOG_SEGMENT_VERSION);
+      // a frame of batched buffers starts with its own cookie
+      if (*(uint32_t *) m_read_buffer == LOG_COLLATION_BATCH_COOKIE) {
+        receive_batch();
         delete[]m_read_buffer;
-
       } else {
-        log_object = Log::match_logobject(log_buffer_header);
-        if (!log_object) {
-          Note("[log-coll] LogObject not found with fieldlist id; " "writing LogBuffer to scrap file");
-          log_object = Log::global_scrap_object;
-        }
-        log_format = log_object->m_format;
-        Debug("log-coll", "[%d]host::host_recv - using format '%s'", m_id, log_format->name());
-
-        // make a new LogBuffer (log_buffer_header plus subsequent
-        // buffer already converted to host order) and add it to the
-        // object's flush queue
-        //
-        log_buffer = new LogBuffer(log_object, log_buffer_header);
-
-	RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_received_from_network_stat,
-                       log_buffer_header->entry_count);
-
-	RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_received_from_network_stat,
-                       log_buffer_header->byte_count);
-
-        int idx = log_object->add_to_flush_queue(log_buffer);
-        Log::preproc_notify[idx].signal();
+        ink_assert(m_read_bytes_received >= (int64_t)sizeof(LogBufferHeader));
+        receive_buffer((LogBufferHeader *) m_read_buffer);
       }
 
-#if defined(LOG_BUFFER_TRACKING)
-      Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
-#endif // defined(LOG_BUFFER_TRACKING)
-
       // get ready for next read (memory may not be freed!!!)
       m_read_buffer = 0;
 
@@ -354,6 +333,105 @@ LogCollationHostSM::host_recv(int event, void * /* data ATS_UNUSED */)
 
 }
 
+//-------------------------------------------------------------------------
+// LogCollationHostSM::receive_buffer
+//
+// Queues a buffer received from the client for flushing.  The buffer was
+// allocated with new char[], and is owned by the LogBuffer from here.
+//-------------------------------------------------------------------------
+
+void
+LogCollationHostSM::receive_buffer(LogBufferHeader * log_buffer_header)
+{
+  LogBuffer *log_buffer;
+  LogFormat *log_format;
+  LogObject *log_object;
+  unsigned version;
+
+  // convert the buffer we just received to host order
+  // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
+  // LogBuffer::convert_to_host_order(log_buffer_header);
+
+#if defined(LOG_BUFFER_TRACKING)
+  Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
+#endif // defined(LOG_BUFFER_TRACKING)
+
+  version = log_buffer_header->version;
+  if (version != LOG_SEGMENT_VERSION) {
+    Note("[log-coll] invalid LogBuffer received; invalid version - "
+         "buffer = %u, current = %u", version, LOG_SEGMENT_VERSION);
+    delete[](char *) log_buffer_header;
+    return;
+  }
+
+  log_object = Log::match_logobject(log_buffer_header);
+  if (!log_object) {
+    Note("[log-coll] LogObject not found with fieldlist id; " "writing LogBuffer to scrap file");
+    log_object = Log::global_scrap_object;
+  }
+  log_format = log_object->m_format;
+  Debug("log-coll", "[%d]host::host_recv - using format '%s'", m_id, log_format->name());
+
+  // make a new LogBuffer (log_buffer_header plus subsequent
+  // buffer already converted to host order) and add it to the
+  // object's flush queue
+  //
+  log_buffer = new LogBuffer(log_object, log_buffer_header);
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_received_from_network_stat,
+                 log_buffer_header->entry_count);
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_received_from_network_stat,
+                 log_buffer_header->byte_count);
+
+  int idx = log_object->add_to_flush_queue(log_buffer);
+  Log::preproc_notify[idx].signal();
+}
+
+//-------------------------------------------------------------------------
+// LogCollationHostSM::receive_batch
+//
+// Queues the buffers of the frame in m_read_buffer, and acknowledges it.
+//-------------------------------------------------------------------------
+
+void
+LogCollationHostSM::receive_batch()
+{
+  int data_len = 0, count = 0;
+  uint32_t acked = 1;
+  char *data = LogCollationBatch::unpack(m_read_buffer, m_read_bytes_received, &data_len, &count);
+
+  if (data == NULL) {
+    Note("[log-coll] invalid batch of LogBuffers received; discarding it");
+  } else {
+    Debug("log-coll", "[%d]host::receive_batch - %d buffers, %d bytes in %" PRId64 " bytes", m_id, count, data_len,
+          m_read_bytes_received);
+    for (int off = 0; off < data_len;) {
+      LogBufferHeader *segment = (LogBufferHeader *) (data + off);
+      char *buf = new char[segment->byte_count];
+
+      memcpy(buf, segment, segment->byte_count);
+      off += segment->byte_count;
+      receive_buffer((LogBufferHeader *) buf);
+    }
+    ats_free(data);
+  }
+
+  // acknowledge the frame, even if it was invalid: it would not be any
+  // better if it was sent again
+  if (m_ack_buffer == NULL) {
+    m_ack_buffer = new_MIOBuffer();
+    m_ack_reader = m_ack_buffer->alloc_reader();
+  }
+  m_ack_buffer->write((char *) &acked, sizeof(acked));
+  ink_assert(m_client_vc != NULL);
+  if (m_ack_vio == NULL) {
+    m_ack_vio = m_client_vc->do_io_write(this, INT64_MAX, m_ack_reader);
+  } else {
+    m_ack_vio->reenable();
+  }
+}
+
 //-------------------------------------------------------------------------
 //-------------------------------------------------------------------------
 //
@@ -89,6 +89,10 @@ private:
   // helper for read states
   void read_partial(VIO * vio);
 
+  // helpers for host_recv
+  void receive_buffer(LogBufferHeader * log_buffer_header);
+  void receive_batch();
+
   // iocore stuff
   NetVConnection *m_client_vc;
   VIO *m_client_vio;
@@ -96,6 +100,11 @@ private:
   IOBufferReader *m_client_reader;
   Event *m_pending_event;
 
+  // acknowledgements of batched frames
+  VIO *m_ack_vio;
+  MIOBuffer *m_ack_buffer;
+  IOBufferReader *m_ack_reader;
+
   // read_state stuff
   NetMsgHeader m_net_msg_header;
   char *m_read_buffer;
@@ -0,0 +1,779 @@
+/** @file
+
+  Columnar, compressed encoding of binary log segments.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#include <sys/mman.h>
+
+#include "Error.h"
+#include "LogField.h"
+#include "LogFormat.h"
+#include "LogAccess.h"
+#include "LogLimits.h"
+#include "LogColumnar.h"
+
+#define LOG_COLUMNAR_ZSTD_LEVEL 3
+#define LOG_COLUMNAR_PLAN_CACHE_SIZE 64
+
+// How a column is stored
+enum
+{
+  LOG_COLUMN_INT = 0,           // 8 byte integers, delta encoded
+  LOG_COLUMN_STR = 1,           // padded strings, stored without the padding
+  LOG_COLUMN_BYTES = 2          // anything else
+};
+
+// How the size of a field in an entry is found
+enum
+{
+  LOG_MEASURE_INT,
+  LOG_MEASURE_STR,
+  LOG_MEASURE_IP,
+  LOG_MEASURE_UNMARSHAL         // by running its unmarshal routine
+};
+
+/*-------------------------------------------------------------------------
+  Varints
+  -------------------------------------------------------------------------*/
+
+static inline char *
+put_varint(char *p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *p++ = (char)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (char)v;
+  return p;
+}
+
+static inline uint64_t
+zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t
+unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+struct LogColumnarReader
+{
+  const unsigned char *p;
+  const unsigned char *end;
+  bool ok;
+
+  LogColumnarReader(const char *data, uint32_t len)
+    : p((const unsigned char *)data), end((const unsigned char *)data + len), ok(true)
+  { }
+
+  uint64_t varint()
+  {
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+      unsigned char c = *p++;
+      v |= (uint64_t)(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return v;
+    }
+    ok = false;
+    return 0;
+  }
+
+  const char *bytes(uint32_t len)
+  {
+    if ((uint32_t)(end - p) < len) {
+      ok = false;
+      return NULL;
+    }
+    const char *b = (const char *)p;
+    p += len;
+    return b;
+  }
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarDict
+
+  The distinct values of a column in a block, found by an open addressing
+  hash table.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnarDict
+{
+  int32_t *slots;
+  uint32_t mask;
+  const char **value;
+  uint32_t *len;
+  uint32_t count;
+
+  explicit LogColumnarDict(uint32_t n)
+    : count(0)
+  {
+    uint32_t nslots = 16;
+    while (nslots < 2 * n)
+      nslots <<= 1;
+    mask = nslots - 1;
+    slots = (int32_t *)ats_malloc(nslots * sizeof(int32_t));
+    value = (const char **)ats_malloc(n * sizeof(char *));
+    len = (uint32_t *)ats_malloc(n * sizeof(uint32_t));
+  }
+
+  ~LogColumnarDict()
+  {
+    ats_free(slots);
+    ats_free(value);
+    ats_free(len);
+  }
+
+  void clear()
+  {
+    memset(slots, 0xff, (mask + 1) * sizeof(int32_t));
+    count = 0;
+  }
+
+  // Returns the index of the value, adding it if it is new.
+  uint32_t lookup(const char *v, uint32_t l, bool *added)
+  {
+    uint32_t h = 2166136261U;   // FNV-1a
+    for (uint32_t i = 0; i < l; i++)
+      h = (h ^ (unsigned char)v[i]) * 16777619U;
+
+    for (uint32_t s = h & mask;; s = (s + 1) & mask) {
+      int32_t idx = slots[s];
+      if (idx < 0) {
+        slots[s] = count;
+        value[count] = v;
+        len[count] = l;
+        *added = true;
+        return count++;
+      }
+      if (len[idx] == l && memcmp(value[idx], v, l) == 0) {
+        *added = false;
+        return idx;
+      }
+    }
+  }
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarPlan
+
+  How the fields of a format are split into columns, cached by the symbol
+  string of the format.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnarPlan
+{
+  char *fieldlist_str;
+  LogFieldList field_list;
+  int nfields;
+  LogField **field;
+  int *measure;
+  bool valid;
+
+  explicit LogColumnarPlan(const char *fieldlist);
+};
+
+LogColumnarPlan::LogColumnarPlan(const char *fieldlist)
+  : fieldlist_str(ats_strdup(fieldlist)), nfields(0), field(NULL), measure(NULL), valid(false)
+{
+  bool contains_aggregates = false;
+  LogField *f;
+  int i = 0;
+
+  LogFormat::parse_symbol_string(fieldlist_str, &field_list, &contains_aggregates);
+  nfields = field_list.count();
+  if (nfields == 0)
+    return;
+  field = (LogField **)ats_malloc(nfields * sizeof(LogField *));
+  measure = (int *)ats_malloc(nfields * sizeof(int));
+
+  for (f = field_list.first(); f; f = field_list.next(f), ++i) {
+    LogField::UnmarshalFunc func = f->unmarshal_func();
+
+    field[i] = f;
+    if (f->aggregate() != LogField::NO_AGGREGATE || f->is_time_field() || f->map() != NULL ||
+        func == (LogField::UnmarshalFunc)LogAccess::unmarshal_int_to_str ||
+        func == (LogField::UnmarshalFunc)LogAccess::unmarshal_int_to_str_hex ||
+        func == (LogField::UnmarshalFunc)LogAccess::unmarshal_http_status ||
+        func == (LogField::UnmarshalFunc)LogAccess::unmarshal_ttmsf) {
+      measure[i] = LOG_MEASURE_INT;
+    } else if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_str ||
+               func == (LogField::UnmarshalFunc)LogAccess::unmarshal_http_text) {
+      // unmarshal_http_text is a single string too, unlike the http_text
+      // containers (cqtx)
+      measure[i] = f->type() == LogField::STRING && strcmp(f->symbol(), "cqtx") ? LOG_MEASURE_STR : LOG_MEASURE_UNMARSHAL;
+    } else if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_ip_to_str ||
+               func == (LogField::UnmarshalFunc)LogAccess::unmarshal_ip_to_hex) {
+      measure[i] = LOG_MEASURE_IP;
+    } else if (func != NULL) {
+      measure[i] = LOG_MEASURE_UNMARSHAL;
+    } else {
+      Debug("log-columnar", "no unmarshal routine for field %s, format %s not encoded", f->symbol(), fieldlist_str);
+      return;
+    }
+  }
+  valid = true;
+}
+
+static LogColumnarPlan *plan_cache[LOG_COLUMNAR_PLAN_CACHE_SIZE];
+static int plan_cache_entries = 0;
+static ink_mutex plan_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static LogColumnarPlan *
+find_plan(const char *fieldlist)
+{
+  LogColumnarPlan *plan = NULL;
+
+  ink_mutex_acquire(&plan_cache_mutex);
+  for (int i = 0; i < plan_cache_entries; i++) {
+    if (strcmp(plan_cache[i]->fieldlist_str, fieldlist) == 0) {
+      plan = plan_cache[i];
+      break;
+    }
+  }
+  if (!plan && plan_cache_entries < LOG_COLUMNAR_PLAN_CACHE_SIZE) {
+    plan = new LogColumnarPlan(fieldlist);
+    plan_cache[plan_cache_entries++] = plan;
+  }
+  ink_mutex_release(&plan_cache_mutex);
+
+  return plan && plan->valid ? plan : NULL;
+}
+
+#if TS_HAS_ZSTD
+static ink_thread_key zstd_cctx_key;
+static pthread_once_t zstd_cctx_once = PTHREAD_ONCE_INIT;
+
+static void
+free_zstd_cctx(void *cctx)
+{
+  ZSTD_freeCCtx((ZSTD_CCtx *)cctx);
+}
+
+static void
+init_zstd_cctx_key()
+{
+  ink_thread_key_create(&zstd_cctx_key, free_zstd_cctx);
+}
+
+// one compression context per (preproc) thread
+static ZSTD_CCtx *
+zstd_cctx()
+{
+  pthread_once(&zstd_cctx_once, init_zstd_cctx_key);
+  ZSTD_CCtx *cctx = (ZSTD_CCtx *)ink_thread_getspecific(zstd_cctx_key);
+  if (!cctx) {
+    cctx = ZSTD_createCCtx();
+    ink_thread_setspecific(zstd_cctx_key, cctx);
+  }
+  return cctx;
+}
+#endif
+
+/*-------------------------------------------------------------------------
+  LogColumnar::encode
+  -------------------------------------------------------------------------*/
+
+int
+LogColumnar::encode(LogBufferHeader * segment, char **block)
+{
+  if (segment->version != LOG_SEGMENT_VERSION || segment->format_type != LOG_FORMAT_CUSTOM ||
+      segment->entry_count == 0 || segment->data_offset < sizeof(LogBufferHeader) ||
+      segment->data_offset > segment->byte_count || !segment->fmt_fieldlist()) {
+    return 0;
+  }
+
+  LogColumnarPlan *plan = find_plan(segment->fmt_fieldlist());
+  if (!plan) {
+    return 0;
+  }
+
+  uint32_t n = segment->entry_count;
+  LogEntryHeader **entry = (LogEntryHeader **)ats_malloc(n * sizeof(LogEntryHeader *));
+  char **cursor = (char **)ats_malloc(n * sizeof(char *));
+  char *segment_end = (char *)segment + segment->byte_count;
+  char *scratch = NULL;
+  char *data = NULL;
+  char *out = NULL;
+  char *p;
+  int64_t prev;
+  uint32_t i = 0;
+  int block_len = 0;
+  LogEntryHeader *e;
+  LogBufferIterator iter(segment);
+  LogColumnarDict dict(n);
+
+  while (i < n && (e = iter.next())) {
+    if (e->entry_len < sizeof(LogEntryHeader) || (char *)e + e->entry_len > segment_end) {
+      break;
+    }
+    entry[i] = e;
+    cursor[i] = (char *)e + sizeof(LogEntryHeader);
+    ++i;
+  }
+  if (i != n) {
+    Debug("log-columnar", "bad entry %u of %u in segment, not encoded", i, n);
+    goto Ldone;
+  }
+
+  // every value takes at most 10 bytes of varints besides its own bytes
+  data = (char *)ats_malloc(segment->byte_count + 16 + n * 25 + plan->nfields * (1 + n * 10));
+  p = data;
+  memcpy(p, segment, segment->data_offset);
+  p += segment->data_offset;
+  p = put_varint(p, plan->nfields);
+
+  prev = 0;
+  for (i = 0; i < n; i++) {
+    p = put_varint(p, zigzag((int64_t)entry[i]->entry_len - prev));
+    prev = entry[i]->entry_len;
+  }
+  prev = 0;
+  for (i = 0; i < n; i++) {
+    p = put_varint(p, zigzag(entry[i]->timestamp - prev));
+    prev = entry[i]->timestamp;
+  }
+  for (i = 0; i < n; i++) {
+    p = put_varint(p, (uint32_t)entry[i]->timestamp_usec);
+  }
+
+  for (int f = 0; f < plan->nfields; f++) {
+    int measure = plan->measure[f];
+
+    if (measure == LOG_MEASURE_INT) {
+      *p++ = LOG_COLUMN_INT;
+      prev = 0;
+      for (i = 0; i < n; i++) {
+        int64_t v;
+
+        if ((char *)entry[i] + entry[i]->entry_len - cursor[i] < INK_MIN_ALIGN) {
+          goto Lbad_field;
+        }
+        memcpy(&v, cursor[i], sizeof(v));
+        p = put_varint(p, zigzag(v - prev));
+        prev = v;
+        cursor[i] += INK_MIN_ALIGN;
+      }
+      continue;
+    }
+
+    *p++ = measure == LOG_MEASURE_STR ? LOG_COLUMN_STR : LOG_COLUMN_BYTES;
+    dict.clear();
+    for (i = 0; i < n; i++) {
+      int avail = (int)((char *)entry[i] + entry[i]->entry_len - cursor[i]);
+      int size, len;
+      bool added;
+
+      switch (measure) {
+      case LOG_MEASURE_STR:
+        // like LogAccess::strlen, without reading past the entry
+        len = (int)strnlen(cursor[i], avail);
+        size = LogAccess::round_strlen(MAX(len, DEFAULT_STR_LEN) + 1);
+        break;
+      case LOG_MEASURE_IP:
+        size = sizeof(LogFieldIp);
+        if (avail >= (int)sizeof(LogFieldIp)) {
+          uint16_t family = reinterpret_cast<LogFieldIp *>(cursor[i])->_family;
+          if (family == AF_INET)
+            size = sizeof(LogFieldIp4);
+          else if (family == AF_INET6)
+            size = sizeof(LogFieldIp6);
+        }
+        len = size = INK_ALIGN_DEFAULT(size);
+        break;
+      default: {
+        char *q = cursor[i];
+
+        if (!scratch)
+          scratch = (char *)ats_malloc(LOG_MAX_FORMATTED_LINE);
+        plan->field[f]->unmarshal(&q, scratch, LOG_MAX_FORMATTED_LINE);
+        len = size = (int)(q - cursor[i]);
+        break;
+      }
+      }
+      if (size <= 0 || size > avail || len > size) {
+        goto Lbad_field;
+      }
+
+      uint32_t idx = dict.lookup(cursor[i], len, &added);
+      p = put_varint(p, idx);
+      if (added) {
+        p = put_varint(p, len);
+        memcpy(p, cursor[i], len);
+        p += len;
+      }
+      cursor[i] += size;
+    }
+    continue;
+
+  Lbad_field:
+    Debug("log-columnar", "field %s of entry %u overruns the entry, not encoded", plan->field[f]->symbol(), i);
+    goto Ldone;
+  }
+
+  {
+    LogColumnarHeader *h;
+    uint32_t data_len = (uint32_t)(p - data);
+    uint32_t payload_len = data_len;
+    uint32_t codec = LOG_COLUMNAR_RAW;
+    size_t bound = data_len;
+
+#if TS_HAS_ZSTD
+    bound = ZSTD_compressBound(data_len);
+#endif
+    out = (char *)ats_malloc(sizeof(LogColumnarHeader) + INK_ALIGN_DEFAULT(bound));
+#if TS_HAS_ZSTD
+    size_t c = ZSTD_compressCCtx(zstd_cctx(), out + sizeof(LogColumnarHeader), bound, data, data_len,
+                                 LOG_COLUMNAR_ZSTD_LEVEL);
+    if (!ZSTD_isError(c) && c < data_len) {
+      codec = LOG_COLUMNAR_ZSTD;
+      payload_len = (uint32_t)c;
+    }
+#endif
+    if (codec == LOG_COLUMNAR_RAW) {
+      memcpy(out + sizeof(LogColumnarHeader), data, data_len);
+    }
+
+    // keep the blocks aligned in the file
+    block_len = (int)INK_ALIGN_DEFAULT(sizeof(LogColumnarHeader) + payload_len);
+    memset(out + sizeof(LogColumnarHeader) + payload_len, 0, block_len - sizeof(LogColumnarHeader) - payload_len);
+
+    h = (LogColumnarHeader *)out;
+    h->cookie = LOG_COLUMNAR_COOKIE;
+    h->version = LOG_COLUMNAR_VERSION;
+    h->codec = codec;
+    h->byte_count = block_len;
+    h->entry_count = n;
+    h->low_timestamp = segment->low_timestamp;
+    h->high_timestamp = segment->high_timestamp;
+    h->data_len = data_len;
+    h->segment_bytes = segment->byte_count;
+    h->payload_len = payload_len;
+
+    Debug("log-columnar", "encoded %u entries, %u bytes into %d bytes", n, segment->byte_count, block_len);
+    *block = out;
+  }
+
+Ldone:
+  ats_free(entry);
+  ats_free(cursor);
+  ats_free(scratch);
+  ats_free(data);
+  return block_len;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnarDecoder
+  -------------------------------------------------------------------------*/
+
+LogColumnarDecoder::LogColumnarDecoder()
+  : m_data(NULL), m_data_size(0), m_segment(NULL), m_segment_size(0), m_cursor(NULL), m_end(NULL),
+    m_dict_value(NULL), m_dict_len(NULL), m_entries_size(0)
+#if TS_HAS_ZSTD
+  , m_dctx(NULL)
+#endif
+{
+}
+
+LogColumnarDecoder::~LogColumnarDecoder()
+{
+  ats_free(m_data);
+  ats_free(m_segment);
+  ats_free(m_cursor);
+  ats_free(m_end);
+  ats_free(m_dict_value);
+  ats_free(m_dict_len);
+#if TS_HAS_ZSTD
+  if (m_dctx)
+    ZSTD_freeDCtx(m_dctx);
+#endif
+}
+
+LogBufferHeader *
+LogColumnarDecoder::decode(LogColumnarHeader * block)
+{
+  const char *data = (const char *)(block + 1);
+  uint32_t n = block->entry_count;
+  uint32_t seg_bytes = block->segment_bytes;
+  uint32_t hdr_len, off, i;
+  LogBufferHeader *seg;
+  int64_t prev;
+
+  if (block->cookie != LOG_COLUMNAR_COOKIE || block->version != LOG_COLUMNAR_VERSION ||
+      block->byte_count < sizeof(LogColumnarHeader) + block->payload_len ||
+      block->data_len < sizeof(LogBufferHeader) || seg_bytes < sizeof(LogBufferHeader)) {
+    Debug("log-columnar", "bad columnar block header");
+    return NULL;
+  }
+
+  switch (block->codec) {
+  case LOG_COLUMNAR_RAW:
+    if (block->payload_len != block->data_len)
+      return NULL;
+    break;
+#if TS_HAS_ZSTD
+  case LOG_COLUMNAR_ZSTD: {
+    if (m_data_size < block->data_len) {
+      m_data_size = block->data_len;
+      m_data = (char *)ats_realloc(m_data, m_data_size);
+    }
+    if (!m_dctx)
+      m_dctx = ZSTD_createDCtx();
+    size_t l = ZSTD_decompressDCtx(m_dctx, m_data, block->data_len, data, block->payload_len);
+    if (ZSTD_isError(l) || l != block->data_len) {
+      Debug("log-columnar", "columnar block does not decompress");
+      return NULL;
+    }
+    data = m_data;
+    break;
+  }
+#endif
+  default:
+    Debug("log-columnar", "columnar block codec %u not supported", block->codec);
+    return NULL;
+  }
+
+  if (m_segment_size < seg_bytes) {
+    m_segment_size = seg_bytes;
+    m_segment = (char *)ats_realloc(m_segment, m_segment_size);
+  }
+  if (m_entries_size < n) {
+    m_entries_size = n;
+    m_cursor = (uint32_t *)ats_realloc(m_cursor, n * sizeof(uint32_t));
+    m_end = (uint32_t *)ats_realloc(m_end, n * sizeof(uint32_t));
+    m_dict_value = (const char **)ats_realloc(m_dict_value, n * sizeof(char *));
+    m_dict_len = (uint32_t *)ats_realloc(m_dict_len, n * sizeof(uint32_t));
+  }
+  memset(m_segment, 0, seg_bytes);
+
+  // the header area of the segment
+  memcpy(&hdr_len, data + offsetof(LogBufferHeader, data_offset), sizeof(hdr_len));
+  if (hdr_len < sizeof(LogBufferHeader) || hdr_len > seg_bytes || hdr_len > block->data_len)
+    return NULL;
+  memcpy(m_segment, data, hdr_len);
+  seg = (LogBufferHeader *)m_segment;
+  if (seg->byte_count != seg_bytes || seg->entry_count != n || seg->version != LOG_SEGMENT_VERSION)
+    return NULL;
+
+  LogColumnarReader r(data + hdr_len, block->data_len - hdr_len);
+  uint64_t nfields = r.varint();
+
+  // entry lengths, which place the entries in the segment
+  off = hdr_len;
+  prev = 0;
+  for (i = 0; i < n; i++) {
+    int64_t len = prev + unzigzag(r.varint());
+
+    if (len < (int64_t)sizeof(LogEntryHeader) || off + len > seg_bytes)
+      return NULL;
+    ((LogEntryHeader *)(m_segment + off))->entry_len = (uint32_t)len;
+    m_cursor[i] = off + sizeof(LogEntryHeader);
+    m_end[i] = off + (uint32_t)len;
+    off += (uint32_t)len;
+    prev = len;
+  }
+  prev = 0;
+  for (i = 0; i < n; i++) {
+    prev += unzigzag(r.varint());
+    ((LogEntryHeader *)(m_segment + m_cursor[i] - sizeof(LogEntryHeader)))->timestamp = prev;
+  }
+  for (i = 0; i < n; i++) {
+    ((LogEntryHeader *)(m_segment + m_cursor[i] - sizeof(LogEntryHeader)))->timestamp_usec = (int32_t)r.varint();
+  }
+
+  for (uint64_t f = 0; f < nfields && r.ok; f++) {
+    const char *kind = r.bytes(1);
+    uint32_t count = 0;
+
+    if (!kind)
+      return NULL;
+
+    switch (*kind) {
+    case LOG_COLUMN_INT:
+      prev = 0;
+      for (i = 0; i < n; i++) {
+        prev += unzigzag(r.varint());
+        if (m_end[i] - m_cursor[i] < INK_MIN_ALIGN)
+          return NULL;
+        memcpy(m_segment + m_cursor[i], &prev, sizeof(prev));
+        m_cursor[i] += INK_MIN_ALIGN;
+      }
+      break;
+
+    case LOG_COLUMN_STR:
+    case LOG_COLUMN_BYTES:
+      for (i = 0; i < n; i++) {
+        uint64_t idx = r.varint();
+        uint32_t size;
+
+        if (idx == count && count < n) {
+          m_dict_len[count] = (uint32_t)r.varint();
+          m_dict_value[count] = r.bytes(m_dict_len[count]);
+          count++;
+        } else if (idx >= count) {
+          return NULL;
+        }
+        if (!r.ok)
+          return NULL;
+        // strings get back their nul and padding, which are zero
+        size = *kind == LOG_COLUMN_STR ? LogAccess::round_strlen(m_dict_len[idx] + 1) : m_dict_len[idx];
+        if (m_end[i] - m_cursor[i] < size)
+          return NULL;
+        memcpy(m_segment + m_cursor[i], m_dict_value[idx], m_dict_len[idx]);
+        m_cursor[i] += size;
+      }
+      break;
+
+    default:
+      return NULL;
+    }
+  }
+
+  return r.ok ? seg : NULL;
+}
+
+/*-------------------------------------------------------------------------
+  LogSegmentReader
+  -------------------------------------------------------------------------*/
+
+LogSegmentReader::LogSegmentReader()
+  : m_base(NULL), m_size(0), m_end(0), m_offset(0), m_realign(false), m_error(false)
+{
+}
+
+LogSegmentReader::~LogSegmentReader()
+{
+  if (m_base)
+    munmap(m_base, m_size);
+}
+
+bool
+LogSegmentReader::open(int fd, off_t offset, bool realign)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return false;
+
+  m_size = m_end = st.st_size;
+  m_offset = offset;
+  m_realign = realign;
+  m_error = false;
+  if (m_size > 0) {
+    // private and writable, the readers modify the entries in place
+    void *base = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      m_size = m_end = 0;
+      return false;
+    }
+    m_base = (char *)base;
+#if HAVE_POSIX_MADVISE
+    posix_madvise(m_base, m_size, POSIX_MADV_SEQUENTIAL);
+#endif
+  }
+  return true;
+}
+
+void
+LogSegmentReader::seek(off_t offset, off_t end)
+{
+  m_offset = offset;
+  m_end = MIN((size_t)end, m_size);
+  m_realign = false;
+  m_error = false;
+}
+
+LogBufferHeader *
+LogSegmentReader::next()
+{
+  LogBufferHeader *h = NULL;
+
+  return advance(&h) ? h : NULL;
+}
+
+bool
+LogSegmentReader::skip()
+{
+  return advance(NULL);
+}
+
+// Move past the next segment or block, decoded into @a segment unless it
+// is NULL, in which case a block is only checked by its header.
+bool
+LogSegmentReader::advance(LogBufferHeader ** segment)
+{
+  while (!m_error && m_offset + 2 * sizeof(uint32_t) <= m_end) {
+    char *p = m_base + m_offset;
+    size_t left = m_end - m_offset;
+    uint32_t cookie;
+
+    memcpy(&cookie, p, sizeof(cookie));
+    if (cookie == LOG_SEGMENT_COOKIE) {
+      LogBufferHeader *h = (LogBufferHeader *)p;
+
+      if (left < sizeof(LogBufferHeader))
+        return false;
+      if (h->version == LOG_SEGMENT_VERSION && h->byte_count >= sizeof(LogBufferHeader)) {
+        if (h->byte_count > left)
+          return false;
+        m_offset += h->byte_count;
+        m_realign = false;
+        if (segment)
+          *segment = h;
+        return true;
+      }
+      Debug("log-columnar", "bad segment at offset %" PRId64, (int64_t)m_offset);
+    } else if (cookie == LOG_COLUMNAR_COOKIE) {
+      LogColumnarHeader *b = (LogColumnarHeader *)p;
+
+      if (left < sizeof(LogColumnarHeader))
+        return false;
+      if (b->version == LOG_COLUMNAR_VERSION && b->byte_count >= sizeof(LogColumnarHeader)) {
+        if (b->byte_count > left)
+          return false;
+        LogBufferHeader *h = segment ? m_decoder.decode(b) : NULL;
+        if (h || !segment) {
+          m_offset += b->byte_count;
+          m_realign = false;
+          if (segment)
+            *segment = h;
+          return true;
+        }
+      }
+      Debug("log-columnar", "bad columnar block at offset %" PRId64, (int64_t)m_offset);
+    } else if (cookie == 0 && !m_realign) {
+      return false;
+    }
+
+    if (m_realign)
+      ++m_offset;
+    else
+      m_error = true;
+  }
+  return false;
+}
@@ -0,0 +1,178 @@
+/** @file
+
+  Columnar, compressed encoding of binary log segments.
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef LOG_COLUMNAR_H
+#define LOG_COLUMNAR_H
+
+#include "libts.h"
+#include "LogBuffer.h"
+
+#if TS_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#define LOG_COLUMNAR_COOKIE 0xc01face
+#define LOG_COLUMNAR_VERSION 1
+
+enum LogColumnarCodec
+{
+  LOG_COLUMNAR_RAW = 0,
+  LOG_COLUMNAR_ZSTD = 1
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarHeader
+
+  A columnar block holds the entries of one LogBuffer segment, stored
+  field by field rather than entry by entry:
+
+  - the header area of the segment (the LogBufferHeader and its strings),
+  - the entry lengths and timestamps, delta encoded,
+  - a column per field of the format: integers delta encoded, strings and
+    other values dictionary encoded, each distinct value of the block
+    being stored once.
+
+  All values are varints, and the column data is compressed as a whole.
+  The leading fields are laid out like those of LogBufferHeader, so the
+  readers can tell blocks and segments apart by the cookie, and skip
+  either by byte_count.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnarHeader
+{
+  uint32_t cookie;              // LOG_COLUMNAR_COOKIE
+  uint32_t version;             // LOG_COLUMNAR_VERSION
+  uint32_t codec;               // LogColumnarCodec of the column data
+  uint32_t byte_count;          // of the block, this header included
+  uint32_t entry_count;
+  uint32_t low_timestamp;
+  uint32_t high_timestamp;
+  uint32_t data_len;            // of the column data, uncompressed
+  uint32_t segment_bytes;       // of the segment the block decodes to
+  uint32_t payload_len;         // of the column data as stored
+};
+
+class LogColumnar
+{
+public:
+  /**
+     Encode @a segment as a columnar block.
+
+     @return the length of the block, which is allocated with ats_malloc
+     and returned in @a block, or 0 if the segment can not be encoded
+     (a text log, or a field whose size can not be determined), in which
+     case the segment should be written as is.
+  */
+  static int encode(LogBufferHeader * segment, char **block);
+};
+
+/*-------------------------------------------------------------------------
+  LogColumnarDecoder
+
+  Decodes columnar blocks back into LogBuffer segments, which are valid
+  until the next block is decoded.
+  -------------------------------------------------------------------------*/
+
+class LogColumnarDecoder
+{
+public:
+  LogColumnarDecoder();
+  ~LogColumnarDecoder();
+
+  LogBufferHeader *decode(LogColumnarHeader * block);
+
+private:
+  char *m_data;
+  uint32_t m_data_size;
+  char *m_segment;
+  uint32_t m_segment_size;
+  uint32_t *m_cursor;           // per entry, where its next field goes
+  uint32_t *m_end;
+  const char **m_dict_value;
+  uint32_t *m_dict_len;
+  uint32_t m_entries_size;
+#if TS_HAS_ZSTD
+  ZSTD_DCtx *m_dctx;
+#endif
+
+  // -- member functions that are not allowed --
+  LogColumnarDecoder(const LogColumnarDecoder &);
+  LogColumnarDecoder & operator=(const LogColumnarDecoder &);
+};
+
+/*-------------------------------------------------------------------------
+  LogSegmentReader
+
+  Maps a binary log file and iterates over its segments, decoding the
+  columnar blocks.  A segment or block cut short by the end of the file
+  ends the iteration, and offset() is then its start, so a log which is
+  still being written can be read again from there later.
+  -------------------------------------------------------------------------*/
+
+class LogSegmentReader
+{
+public:
+  LogSegmentReader();
+  ~LogSegmentReader();
+
+  /**
+     Map @a fd, and start reading at @a offset.  If @a realign, the
+     reader first skips to the next segment or block, for offsets which
+     are not known to be at one.  Returns false if @a fd can not be
+     mapped, e.g. if it is not a regular file.
+  */
+  bool open(int fd, off_t offset, bool realign = false);
+
+  /**
+     Read the segments between @a offset and @a end only, which must be
+     the bounds of segments or blocks.  This lets several readers of the
+     same file share the work.
+  */
+  void seek(off_t offset, off_t end);
+
+  /// The next segment, NULL at the end of the file or on error().
+  LogBufferHeader *next();
+
+  /// Move past the next segment or block without decoding it, false at the end.
+  bool skip();
+
+  off_t offset() const { return m_offset; }
+  bool error() const { return m_error; }
+
+private:
+  bool advance(LogBufferHeader ** segment);
+
+  char *m_base;
+  size_t m_size;
+  size_t m_end;
+  off_t m_offset;
+  bool m_realign;
+  bool m_error;
+  LogColumnarDecoder m_decoder;
+
+  // -- member functions that are not allowed --
+  LogSegmentReader(const LogSegmentReader &);
+  LogSegmentReader & operator=(const LogSegmentReader &);
+};
+
+#endif
@@ -48,6 +48,7 @@
 #include "SimpleTokenizer.h"
 
 #include "LogCollationAccept.h"
+#include "LogCollationBatch.h"
 #include "LogPredefined.h"
 
 #define DISK_IS_CONFIG_FULL_MESSAGE \
@@ -78,6 +79,7 @@ LogConfig::setup_default_values()
 
   log_buffer_size = (int) (10 * LOG_KILOBYTE);
   max_secs_per_buffer = 5;
+  per_thread_buffers = true;
   max_space_mb_for_logs = 100;
   max_space_mb_for_orphan_logs = 25;
   max_space_mb_headroom = 10;
@@ -115,6 +117,9 @@ LogConfig::setup_default_values()
   collation_secret = ats_strdup("foobar");
   collation_retry_sec = 0;
   collation_max_send_buffers = 0;
+  collation_batch_buffers = 0;
+  collation_window = 4;
+  collation_spool_max_mb = 0;
 
   rolling_enabled = Log::NO_ROLLING;
   rolling_interval_sec = 86400; // 24 hours
@@ -184,6 +189,9 @@ LogConfig::read_configuration_variables()
     max_secs_per_buffer = val;
   }
 
+  val = (int) REC_ConfigReadInteger("proxy.config.log.per_thread_buffers");
+  per_thread_buffers = (val > 0);
+
   val = (int) REC_ConfigReadInteger("proxy.config.log.max_space_mb_for_logs");
   if (val > 0) {
     max_space_mb_for_logs = val;
@@ -395,6 +403,21 @@ LogConfig::read_configuration_variables()
     collation_max_send_buffers = val;
   }
 
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_batch_buffers");
+  if (val >= 0) {
+    collation_batch_buffers = val;
+  }
+
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_window");
+  if (val > 0 && val <= LOG_COLLATION_MAX_WINDOW) {
+    collation_window = val;
+  }
+
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_spool_max_mb");
+  if (val >= 0) {
+    collation_spool_max_mb = val;
+  }
+
 
   // ROLLING
 
@@ -710,6 +733,7 @@ LogConfig::display(FILE * fd)
   fprintf(fd, "Config variables:\n");
   fprintf(fd, "   log_buffer_size = %d\n", log_buffer_size);
   fprintf(fd, "   max_secs_per_buffer = %d\n", max_secs_per_buffer);
+  fprintf(fd, "   per_thread_buffers = %d\n", per_thread_buffers);
   fprintf(fd, "   max_space_mb_for_logs = %d\n", max_space_mb_for_logs);
   fprintf(fd, "   max_space_mb_for_orphan_logs = %d\n", max_space_mb_for_orphan_logs);
   fprintf(fd, "   use_orphan_log_space_value = %d\n", use_orphan_log_space_value);
@@ -823,6 +847,7 @@ LogConfig::create_predefined_object(const PreDefinedFormatInfo * pdi, size_t num
         ink_string_append(obj_filt_fname, (char *)LOG_FILE_ASCII_OBJECT_FILENAME_EXTENSION, PATH_NAME_MAX);
         break;
       case LOG_FILE_BINARY:
+      case LOG_FILE_COLUMNAR:
         ink_string_append(obj_filt_fname, (char *)LOG_FILE_BINARY_OBJECT_FILENAME_EXTENSION, PATH_NAME_MAX);
         break;
       default:
@@ -1118,6 +1143,7 @@ LogConfig::register_config_callbacks()
   static const char * names[] = {
     "proxy.config.log.log_buffer_size",
     "proxy.config.log.max_secs_per_buffer",
+    "proxy.config.log.per_thread_buffers",
     "proxy.config.log.max_space_mb_for_logs",
     "proxy.config.log.max_space_mb_for_orphan_logs",
     "proxy.config.log.max_space_mb_headroom",
@@ -1247,6 +1273,18 @@ LogConfig::register_stat_callbacks()
   RecRegisterRawStat(log_rsb, RECT_PROCESS,
                      "proxy.process.log.bytes_received_from_network",
                      RECD_INT, RECP_PERSISTENT, (int) log_stat_bytes_received_from_network_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.collation_wire_bytes",
+                     RECD_INT, RECP_PERSISTENT, (int) log_stat_collation_wire_bytes_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.collation_send_queue_depth",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) log_stat_collation_send_queue_depth_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.collation_bytes_spooled",
+                     RECD_INT, RECP_PERSISTENT, (int) log_stat_collation_bytes_spooled_stat, RecRawStatSyncSum);
+  RecRegisterRawStat(log_rsb, RECT_PROCESS,
+                     "proxy.process.log.collation_bytes_replayed",
+                     RECD_INT, RECP_PERSISTENT, (int) log_stat_collation_bytes_replayed_stat, RecRawStatSyncSum);
   RecRegisterRawStat(log_rsb, RECT_PROCESS,
                      "proxy.process.log.bytes_flush_to_disk",
                      RECD_INT, RECP_PERSISTENT, (int) log_stat_bytes_flush_to_disk_stat, RecRawStatSyncSum);
@@ -2067,7 +2105,8 @@ LogConfig::read_xml_log_config(int from_memory)
         char *mode_str = mode.dequeue();
         file_type = (strncasecmp(mode_str, "bin", 3) == 0 ||
                      (mode_str[0] == 'b' && mode_str[1] == 0) ?
-                     LOG_FILE_BINARY : (strcasecmp(mode_str, "ascii_pipe") == 0 ? LOG_FILE_PIPE : LOG_FILE_ASCII));
+                     LOG_FILE_BINARY : (strcasecmp(mode_str, "ascii_pipe") == 0 ? LOG_FILE_PIPE :
+                                        (strcasecmp(mode_str, "columnar") == 0 ? LOG_FILE_COLUMNAR : LOG_FILE_ASCII)));
       }
       // rolling
       //
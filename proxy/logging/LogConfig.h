@@ -59,6 +59,10 @@ enum
   log_stat_bytes_sent_to_network_stat,
   log_stat_bytes_lost_before_sent_to_network_stat,
   log_stat_bytes_received_from_network_stat,
+  log_stat_collation_wire_bytes_stat,
+  log_stat_collation_send_queue_depth_stat,
+  log_stat_collation_bytes_spooled_stat,
+  log_stat_collation_bytes_replayed_stat,
 
   log_stat_bytes_flush_to_disk_stat,
   log_stat_bytes_lost_before_flush_to_disk_stat,
@@ -164,6 +168,7 @@ public:
 
   int log_buffer_size;
   int max_secs_per_buffer;
+  bool per_thread_buffers;
   int max_space_mb_for_logs;
   int max_space_mb_for_orphan_logs;
   int max_space_mb_headroom;
@@ -184,6 +189,9 @@ public:
   int collation_preproc_threads;
   int collation_retry_sec;
   int collation_max_send_buffers;
+  int collation_batch_buffers;
+  int collation_window;
+  int collation_spool_max_mb;
   Log::RollingEnabledValues rolling_enabled;
   int rolling_interval_sec;
   int rolling_offset_hr;
@@ -152,6 +152,10 @@ public:
   Ptr<LogFieldAliasMap> map() {
     return m_alias_map;
   };
+  UnmarshalFunc unmarshal_func()
+  {
+    return m_unmarshal_func;
+  }
   Aggregate aggregate()
   {
     return m_agg_op;
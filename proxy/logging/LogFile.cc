@@ -44,6 +44,7 @@
 #include "LogFilter.h"
 #include "LogFormat.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogFile.h"
 #include "LogHost.h"
 #include "LogObject.h"
@@ -241,7 +242,7 @@ LogFile::open_file()
   // file.
   //
   if (!file_exists) {
-    if (m_file_format != LOG_FILE_BINARY && m_header != NULL) {
+    if (m_file_format != LOG_FILE_BINARY && m_file_format != LOG_FILE_COLUMNAR && m_header != NULL) {
       Debug("log-file", "writing header to LogFile %s", m_name);
       writeln(m_header, strlen(m_header), m_fd, m_name);
     }
@@ -502,6 +503,33 @@ LogFile::preproc_and_try_delete(LogBuffer * lb)
     //
     return 0;
   }
+  else if (m_file_format == LOG_FILE_COLUMNAR) {
+    //
+    // The buffer is encoded here, in the preproc thread, so the flush
+    // thread only writes.  A buffer which can not be encoded is written
+    // as is, the readers handle both.
+    //
+    char *block = NULL;
+    int len = LogColumnar::encode(buffer_header, &block);
+
+    if (len == 0) {
+      len = buffer_header->byte_count;
+      block = (char *)ats_malloc(len);
+      memcpy(block, buffer_header, len);
+    }
+
+    ProxyMutex *mutex = this_thread()->mutex;
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_flush_to_disk_stat,
+                   buffer_header->entry_count);
+
+    RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_flush_to_disk_stat, len);
+
+    ink_atomiclist_push(Log::flush_data_list, new LogFlushData(this, block, len));
+
+    Log::flush_notify->signal();
+    ret = 0;
+  }
   else if (m_file_format == LOG_FILE_ASCII || m_file_format == LOG_FILE_PIPE) {
     write_ascii_logbuffer3(buffer_header);
     ret = 0;
@@ -558,10 +586,20 @@ LogFile::write_ascii_logbuffer(LogBufferHeader * buffer_header, int fd, const ch
     return 0;
   }
 
+  // look the compiled format up once for the whole buffer
+  LogFormatProgram *program = NULL;
+  if (format_type == LOG_FORMAT_CUSTOM && !alt_format) {
+    program = LogBuffer::format_program(fieldlist_str, printf_str);
+  }
+
   while ((entry_header = iter.next())) {
-    fmt_line_bytes = LogBuffer::to_ascii(entry_header, format_type,
-                                         &fmt_line[0], LOG_MAX_FORMATTED_LINE,
-                                         fieldlist_str, printf_str, buffer_header->version, alt_format);
+    if (program) {
+      fmt_line_bytes = program->run(entry_header, &fmt_line[0], LOG_MAX_FORMATTED_LINE, buffer_header->version);
+    } else {
+      fmt_line_bytes = LogBuffer::to_ascii(entry_header, format_type,
+                                           &fmt_line[0], LOG_MAX_FORMATTED_LINE,
+                                           fieldlist_str, printf_str, buffer_header->version, alt_format);
+    }
     ink_assert(fmt_line_bytes > 0);
 
     if (fmt_line_bytes > 0) {
@@ -621,6 +659,12 @@ LogFile::write_ascii_logbuffer3(LogBufferHeader * buffer_header, const char *alt
     return 0;
   }
 
+  // look the compiled format up once for the whole buffer
+  LogFormatProgram *program = NULL;
+  if (format_type == LOG_FORMAT_CUSTOM && !alt_format) {
+    program = LogBuffer::format_program(fieldlist_str, printf_str);
+  }
+
   while ((entry_header = iter.next())) {
     fmt_entry_count = 0;
     fmt_buf_bytes = 0;
@@ -638,12 +682,18 @@ LogFile::write_ascii_logbuffer3(LogBufferHeader * buffer_header, const char *alt
                 entry_header->entry_len, m_max_line_size);
       }
 
-      int bytes = LogBuffer::to_ascii(entry_header, format_type,
-                                      &ascii_buffer[fmt_buf_bytes],
-                                      m_max_line_size - 1,
-                                      fieldlist_str, printf_str,
-                                      buffer_header->version,
-                                      alt_format);
+      int bytes;
+
+      if (program) {
+        bytes = program->run(entry_header, &ascii_buffer[fmt_buf_bytes], m_max_line_size - 1, buffer_header->version);
+      } else {
+        bytes = LogBuffer::to_ascii(entry_header, format_type,
+                                    &ascii_buffer[fmt_buf_bytes],
+                                    m_max_line_size - 1,
+                                    fieldlist_str, printf_str,
+                                    buffer_header->version,
+                                    alt_format);
+      }
 
       if (bytes > 0) {
         fmt_buf_bytes += bytes;
@@ -151,7 +151,8 @@ public:
 
   LogFileFormat get_format() const { return m_file_format; }
   const char *get_format_name() const {
-    return (m_file_format == LOG_FILE_BINARY ? "binary" : (m_file_format == LOG_FILE_PIPE ? "ascii_pipe" : "ascii"));
+    return (m_file_format == LOG_FILE_BINARY ? "binary" : (m_file_format == LOG_FILE_PIPE ? "ascii_pipe" :
+                                                           (m_file_format == LOG_FILE_COLUMNAR ? "columnar" : "ascii")));
   }
 
   static int write_ascii_logbuffer(LogBufferHeader * buffer_header, int fd, const char *path, const char *alt_format = NULL);
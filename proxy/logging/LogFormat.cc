@@ -47,6 +47,7 @@
 #include "LogObject.h"
 #include "LogConfig.h"
 #include "Log.h"
+#include "ts/TestBox.h"
 
 // class variables
 //
@@ -849,3 +850,346 @@ LogFormatList::display(FILE * fd)
     f->display(fd);
   }
 }
+
+/*-------------------------------------------------------------------------
+  LogFormatProgram
+  -------------------------------------------------------------------------*/
+
+static const char digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Same output as LogAccess::unmarshal_itoa (non-positive values are "0"),
+// two digits at a time, backwards from end.
+static inline char *
+format_int(int64_t val, char *end)
+{
+  char *p = end;
+
+  if (val <= 0) {
+    *--p = '0';
+    return p;
+  }
+  uint64_t v = (uint64_t)val;
+  while (v >= 100) {
+    unsigned i = (unsigned)(v % 100) * 2;
+    v /= 100;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  if (v >= 10) {
+    *--p = digit_pairs[v * 2 + 1];
+    *--p = digit_pairs[v * 2];
+  } else {
+    *--p = '0' + (char)v;
+  }
+  return p;
+}
+
+static inline char *
+format_octet(unsigned v, char *to)
+{
+  if (v >= 100) {
+    *to++ = '0' + v / 100;
+    v %= 100;
+    *to++ = digit_pairs[v * 2];
+    *to++ = digit_pairs[v * 2 + 1];
+  } else if (v >= 10) {
+    *to++ = digit_pairs[v * 2];
+    *to++ = digit_pairs[v * 2 + 1];
+  } else {
+    *to++ = '0' + v;
+  }
+  return to;
+}
+
+LogFormatProgram::LogFormatProgram(const char *fieldlist_str, const char *printf_str)
+  : m_fieldlist_str(ats_strdup(fieldlist_str)), m_printf_str(ats_strdup(printf_str)), m_ops(NULL), m_n_ops(0),
+    m_valid(false)
+{
+  bool contains_aggregates = false;
+  int printf_len = (int)::strlen(m_printf_str);
+  LogField *field;
+
+  LogFormat::parse_symbol_string(m_fieldlist_str, &m_field_list, &contains_aggregates);
+  field = m_field_list.first();
+
+  // each operation consumes at least one character of the printf string
+  m_ops = (Op *)ats_malloc(sizeof(Op) * (printf_len + 1));
+  for (int i = 0; i < printf_len;) {
+    Op *op = &m_ops[m_n_ops++];
+
+    op->len = 0;
+    op->text = NULL;
+    op->field = NULL;
+    if (m_printf_str[i] == LOG_FIELD_MARKER) {
+      if (field == NULL) {
+        Note("There are more field markers than fields; cannot compile log format");
+        return;
+      }
+      op->code = field_op(field);
+      op->field = field;
+      field = m_field_list.next(field);
+      ++i;
+    } else {
+      int start = i;
+
+      while (i < printf_len && m_printf_str[i] != LOG_FIELD_MARKER)
+        ++i;
+      op->code = OP_TEXT;
+      op->text = &m_printf_str[start];
+      op->len = i - start;
+    }
+  }
+  Debug("log-format", "compiled format %s into %d operations", m_fieldlist_str, m_n_ops);
+  m_valid = true;
+}
+
+LogFormatProgram::~LogFormatProgram()
+{
+  ats_free(m_ops);
+  ats_free(m_fieldlist_str);
+  ats_free(m_printf_str);
+}
+
+LogFormatProgram::OpCode
+LogFormatProgram::field_op(LogField * field)
+{
+  // for timestamps that are not aggregates, the value is taken from the
+  // entry header rather than from the entry
+  if (field->aggregate() == LogField::NO_AGGREGATE && field->is_time_field()) {
+    const char *sym = field->symbol();
+
+    if (strcmp(sym, "cqts") == 0)
+      return OP_TS_SEC;
+    if (strcmp(sym, "cqth") == 0)
+      return OP_TS_HEX;
+    if (strcmp(sym, "cqtq") == 0)
+      return OP_TS_SQUID;
+    if (strcmp(sym, "cqtn") == 0)
+      return OP_TS_NETSCAPE;
+    if (strcmp(sym, "cqtd") == 0)
+      return OP_TS_DATE;
+    if (strcmp(sym, "cqtt") == 0)
+      return OP_TS_TIME;
+  }
+  if (field->map() == NULL) {
+    LogField::UnmarshalFunc func = field->unmarshal_func();
+
+    if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_int_to_str)
+      return OP_INT;
+    if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_ip_to_str)
+      return OP_IP;
+    if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_str && !field->m_slice.m_enable)
+      return OP_STR;
+  }
+  return OP_FIELD;
+}
+
+/*-------------------------------------------------------------------------
+  LogFormatProgram::run
+
+  Format @a entry into @a buf, like LogBuffer::resolve_custom_entry.
+  Returns the length of the line, or 0 if it does not fit in @a buf_len.
+  -------------------------------------------------------------------------*/
+
+int
+LogFormatProgram::run(LogEntryHeader * entry, char *buf, int buf_len, unsigned buffer_version)
+{
+  char *read_from = (char *)entry + sizeof(LogEntryHeader);
+  char *to = buf;
+  char *end = buf + buf_len;    // a field must leave room for a nul, like the unmarshal routines
+  char tmp[32];
+  char *p;
+  const char *str;
+  int res;
+
+  for (Op *op = m_ops, *last = m_ops + m_n_ops; op < last; ++op) {
+    switch (op->code) {
+    case OP_TEXT:
+      if (op->len >= end - to)
+        goto Loverflow;
+      memcpy(to, op->text, op->len);
+      to += op->len;
+      break;
+
+    case OP_INT:
+      p = format_int(*(int64_t *)read_from, tmp + sizeof(tmp));
+      read_from += INK_MIN_ALIGN;
+      res = (int)(tmp + sizeof(tmp) - p);
+      if (res >= end - to)
+        goto Loverflow;
+      memcpy(to, p, res);
+      to += res;
+      break;
+
+    case OP_IP: {
+      LogFieldIp *ip = reinterpret_cast<LogFieldIp *>(read_from);
+
+      if (ip->_family == AF_INET && end - to > INET_ADDRSTRLEN) {
+        unsigned char *octets = (unsigned char *)&static_cast<LogFieldIp4 *>(ip)->_addr;
+
+        to = format_octet(octets[0], to);
+        *to++ = '.';
+        to = format_octet(octets[1], to);
+        *to++ = '.';
+        to = format_octet(octets[2], to);
+        *to++ = '.';
+        to = format_octet(octets[3], to);
+        read_from += INK_ALIGN_DEFAULT(sizeof(LogFieldIp4));
+      } else {
+        res = LogAccess::unmarshal_ip_to_str(&read_from, to, (int)(end - to));
+        if (res < 0)
+          goto Loverflow;
+        to += res;
+      }
+      break;
+    }
+
+    case OP_STR:
+      res = (int)::strlen(read_from);
+      if (res >= end - to)
+        goto Loverflow;
+      memcpy(to, read_from, res);
+      to += res;
+      read_from += LogAccess::strlen(read_from);
+      break;
+
+    case OP_FIELD:
+      res = op->field->unmarshal(&read_from, to, (int)(end - to));
+      if (res < 0)
+        goto Loverflow;
+      to += res;
+      break;
+
+    default:
+      // the timestamps come from the entry header; space was reserved for
+      // them in the entry
+      switch (op->code) {
+      case OP_TS_SEC:
+        p = format_int(entry->timestamp, tmp + sizeof(tmp));
+        res = (int)(tmp + sizeof(tmp) - p);
+        if (res >= end - to)
+          goto Loverflow;
+        memcpy(to, p, res);
+        break;
+      case OP_TS_HEX:
+        p = (char *)&entry->timestamp;
+        res = LogAccess::unmarshal_int_to_str_hex(&p, to, (int)(end - to));
+        break;
+      case OP_TS_SQUID:
+        res = squid_timestamp_to_buf(to, (unsigned)(end - to), entry->timestamp, entry->timestamp_usec);
+        break;
+      default:
+        if (op->code == OP_TS_NETSCAPE)
+          str = LogUtils::timestamp_to_netscape_str(entry->timestamp);
+        else if (op->code == OP_TS_DATE)
+          str = LogUtils::timestamp_to_date_str(entry->timestamp);
+        else
+          str = LogUtils::timestamp_to_time_str(entry->timestamp);
+        res = (int)::strlen(str);
+        if (res >= end - to)
+          goto Loverflow;
+        memcpy(to, str, res);
+        break;
+      }
+      if (res < 0)
+        goto Loverflow;
+      to += res;
+      if (buffer_version > 1)
+        read_from += INK_MIN_ALIGN;
+      break;
+    }
+  }
+  return (int)(to - buf);
+
+Loverflow:
+  Note("Traffic Server is skipping the current log entry because its size "
+       "exceeds the maximum line (entry) size for an ascii log buffer");
+  return 0;
+}
+
+#if TS_HAS_TESTS
+
+// Formatted lines per second of a squid like format, interpreting the
+// printf string per entry and running the compiled format.
+REGRESSION_TEST(LogFormat_CompiledFormat)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  const char *fieldlist_str = "chi,cqtq,cqu,pssc,psql,sshl,ttms";
+  char printf_str[64];
+  int64_t entry_space[64];
+  char line[2][LOG_MAX_FORMATTED_LINE];
+  int len[2];
+  const int lines = 200000;
+  IpEndpoint ip;
+  LogFieldList fieldlist;
+  bool contains_aggregates = false;
+
+  snprintf(printf_str, sizeof(printf_str), "%c %c %c %c %c %c %c",
+           LOG_FIELD_MARKER, LOG_FIELD_MARKER, LOG_FIELD_MARKER, LOG_FIELD_MARKER,
+           LOG_FIELD_MARKER, LOG_FIELD_MARKER, LOG_FIELD_MARKER);
+  LogFormat::parse_symbol_string(fieldlist_str, &fieldlist, &contains_aggregates);
+
+  // lay an entry down the way LogFieldList::marshal would
+  LogEntryHeader *entry = (LogEntryHeader *)entry_space;
+  const char *url = "http://www.example.com/compiled/format/benchmark.html";
+  char *p = (char *)entry + sizeof(LogEntryHeader);
+
+  memset(entry_space, 0, sizeof(entry_space));
+  entry->timestamp = 1400000000;
+  entry->timestamp_usec = 123456;
+  ats_ip_pton("192.168.10.201", &ip);
+  p += LogAccess::marshal_ip(p, &ip.sa);
+  p += INK_MIN_ALIGN;           // cqtq
+  LogAccess::marshal_str(p, url, LogAccess::strlen(url));
+  p += LogAccess::strlen(url);
+  LogAccess::marshal_int(p, 200);
+  p += INK_MIN_ALIGN;
+  LogAccess::marshal_int(p, 1234567);
+  p += INK_MIN_ALIGN;
+  LogAccess::marshal_int(p, 312);
+  p += INK_MIN_ALIGN;
+  LogAccess::marshal_int(p, 42);
+  p += INK_MIN_ALIGN;
+  entry->entry_len = p - (char *)entry;
+
+  LogFormatProgram program(fieldlist_str, printf_str);
+  box = REGRESSION_TEST_PASSED;
+  box.check(program.valid(), "format did not compile");
+
+  len[0] = LogBuffer::resolve_custom_entry(&fieldlist, printf_str, (char *)entry + sizeof(LogEntryHeader), line[0],
+                                           LOG_MAX_FORMATTED_LINE, entry->timestamp, entry->timestamp_usec,
+                                           LOG_SEGMENT_VERSION);
+  len[1] = program.run(entry, line[1], LOG_MAX_FORMATTED_LINE, LOG_SEGMENT_VERSION);
+  box.check(len[0] > 0 && len[0] == len[1] && memcmp(line[0], line[1], len[0]) == 0,
+            "compiled format output '%.*s' differs from '%.*s'", len[1], line[1], len[0], line[0]);
+
+  for (int compiled = 0; compiled < 2; ++compiled) {
+    ink_hrtime start = ink_get_hrtime_internal();
+
+    for (int i = 0; i < lines; ++i) {
+      if (compiled) {
+        program.run(entry, line[1], LOG_MAX_FORMATTED_LINE, LOG_SEGMENT_VERSION);
+      } else {
+        LogBuffer::resolve_custom_entry(&fieldlist, printf_str, (char *)entry + sizeof(LogEntryHeader), line[0],
+                                        LOG_MAX_FORMATTED_LINE, entry->timestamp, entry->timestamp_usec,
+                                        LOG_SEGMENT_VERSION);
+      }
+    }
+
+    ink_hrtime elapsed = ink_get_hrtime_internal() - start;
+    rprintf(t, "%s: %.0f lines/sec\n", compiled ? "compiled" : "interpreted",
+            lines / ((double)elapsed / HRTIME_SECOND));
+  }
+}
+
+#endif
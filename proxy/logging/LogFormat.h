@@ -30,6 +30,8 @@
 #include "LogField.h"
 #include "InkXml.h"
 
+struct LogEntryHeader;
+
 enum LogFormatType
 {
   // We start the numbering at 4 to compatibility with Traffic Server 4.x, which used
@@ -43,6 +45,7 @@ enum LogFileFormat
   LOG_FILE_BINARY,
   LOG_FILE_ASCII,
   LOG_FILE_PIPE, // ie. ASCII pipe
+  LOG_FILE_COLUMNAR, // binary, in compressed columnar blocks
   N_LOGFILE_TYPES
 };
 
@@ -158,4 +161,68 @@ private:
   LogFormatList & operator=(const LogFormatList & rhs);
 };
 
+/*-------------------------------------------------------------------------
+  LogFormatProgram
+
+  A custom format compiled into a flat list of operations.  Each operation
+  either copies a run of the constant text of the printf string, or
+  formats one field of an entry.  The common field types (integers, IP
+  addresses, plain strings and the timestamps) have operations of their
+  own, so formatting an entry is a single loop which neither rescans the
+  printf string nor goes through the generic unmarshal routines.
+  -------------------------------------------------------------------------*/
+
+class LogFormatProgram
+{
+public:
+  LogFormatProgram(const char *fieldlist_str, const char *printf_str);
+  ~LogFormatProgram();
+
+  bool valid() const { return m_valid; }
+  bool matches(const char *fieldlist_str, const char *printf_str) const
+  {
+    return strcmp(fieldlist_str, m_fieldlist_str) == 0 && strcmp(printf_str, m_printf_str) == 0;
+  }
+
+  int run(LogEntryHeader * entry, char *buf, int buf_len, unsigned buffer_version);
+
+private:
+  enum OpCode
+  {
+    OP_TEXT,
+    OP_INT,
+    OP_IP,
+    OP_STR,
+    OP_FIELD,
+    OP_TS_SEC,                  // cqts
+    OP_TS_HEX,                  // cqth
+    OP_TS_SQUID,                // cqtq
+    OP_TS_NETSCAPE,             // cqtn
+    OP_TS_DATE,                 // cqtd
+    OP_TS_TIME                  // cqtt
+  };
+
+  struct Op
+  {
+    OpCode code;
+    int len;                    // of the text
+    const char *text;
+    LogField *field;
+  };
+
+  static OpCode field_op(LogField * field);
+
+  char *m_fieldlist_str;
+  char *m_printf_str;
+  LogFieldList m_field_list;
+  Op *m_ops;
+  int m_n_ops;
+  bool m_valid;
+
+  // -- member functions that are not allowed --
+  LogFormatProgram();
+  LogFormatProgram(const LogFormatProgram & rhs);
+  LogFormatProgram & operator=(const LogFormatProgram & rhs);
+};
+
 #endif
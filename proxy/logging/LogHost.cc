@@ -42,6 +42,7 @@
 #include "Log.h"
 
 #include "LogCollationClientSM.h"
+#include "LogCollationBatch.h"
 
 #define PING 	true
 #define NOPING 	false
@@ -243,6 +244,13 @@ LogHost::create_orphan_LogFile_object()
   m_orphan_file = new LogFile(name_buf, NULL, LOG_FILE_ASCII, m_object_signature);
   ink_assert(m_orphan_file != NULL);
   ats_free(name_buf);
+
+  name_len = (unsigned) (strlen(m_object_filename) + strlen(name()) + 32);
+  name_buf = (char *)ats_malloc(name_len);
+  snprintf(name_buf, name_len, "%s%s%s-%u.spool",
+               m_object_filename, LOGFILE_SEPARATOR_STRING, name(), port());
+  m_spool = new LogSpool(name_buf);
+  ats_free(name_buf);
 }
 
 //
@@ -293,6 +301,10 @@ done:
 void
 LogHost::orphan_write_and_try_delete(LogBuffer * lb)
 {
+  if (spool_write(lb)) {
+    return;
+  }
+
   RecIncrRawStat(log_rsb, this_thread()->mutex->thread_holding,
                  log_stat_num_lost_before_sent_to_network_stat,
                  lb->header()->entry_count);
@@ -311,6 +323,236 @@ LogHost::orphan_write_and_try_delete(LogBuffer * lb)
   }
 }
 
+/*-------------------------------------------------------------------------
+  LogSpool
+
+  The spool is a file of raw LogBuffer segments next to the orphan file,
+  appended to while the host is down or too slow, and read back from the
+  start once it is up.  It is truncated whenever it has been read back
+  entirely, and a spool left by a previous run is sent first.
+
+  Callers only touch the counters and the read ahead queue, under
+  m_mutex; the file, and its positions, belong to the flush thread, which
+  gets a LogFlushData for each buffer to write and for each read ahead.
+  A few frames worth of buffers are kept read ahead, so that a client has
+  something to send as soon as its host is back.
+  -------------------------------------------------------------------------*/
+
+static int
+spool_read_ahead_buffers()
+{
+  return 2 * MAX(Log::config->collation_batch_buffers, 1);
+}
+
+LogSpool::LogSpool(const char *name)
+  : m_name(ats_strdup(name)),
+    m_fd(-1),
+    m_read_pos(0),
+    m_write_pos(0),
+    m_ready_count(0),
+    m_bytes(0),
+    m_disk_bytes(0),
+    m_opened(false),
+    m_read_ahead_queued(false)
+{
+  ink_mutex_init(&m_mutex, "LogSpool");
+}
+
+LogSpool::~LogSpool()
+{
+  LogBuffer *lb;
+
+  while ((lb = m_ready.dequeue()) != NULL) {
+    LogBuffer::destroy(lb);
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+  ink_mutex_destroy(&m_mutex);
+  ats_free(m_name);
+}
+
+void
+LogSpool::queue(LogBuffer * lb)
+{
+  // the flush data holds a reference, released by the flush thread
+  refcount_inc();
+  ink_atomiclist_push(Log::flush_data_list, new LogFlushData(this, lb));
+  Log::flush_notify->signal();
+}
+
+bool
+LogSpool::write(LogBuffer * lb)
+{
+  int64_t max_bytes = (int64_t)Log::config->collation_spool_max_mb * 1024 * 1024;
+  int64_t bytes = lb->header()->byte_count;
+  bool ok = false;
+
+  if (max_bytes <= 0 || Log::config->logging_space_exhausted)
+    return false;
+
+  ink_mutex_acquire(&m_mutex);
+  if (m_bytes + bytes <= max_bytes) {
+    m_bytes += bytes;
+    ok = true;
+  }
+  ink_mutex_release(&m_mutex);
+
+  if (ok) {
+    queue(lb);
+    RecIncrRawStat(log_rsb, this_thread()->mutex->thread_holding, log_stat_collation_bytes_spooled_stat, bytes);
+  }
+  return ok;
+}
+
+LogBuffer *
+LogSpool::read()
+{
+  LogBuffer *lb;
+  bool want;
+
+  ink_mutex_acquire(&m_mutex);
+  if ((lb = m_ready.dequeue()) != NULL) {
+    m_ready_count--;
+    m_bytes -= lb->header()->byte_count;
+  }
+  // the first read also picks up a spool left by a previous run
+  want = !m_read_ahead_queued && m_ready_count < spool_read_ahead_buffers() &&
+         (m_disk_bytes > 0 || (!m_opened && Log::config->collation_spool_max_mb > 0));
+  if (want) {
+    m_read_ahead_queued = true;
+  }
+  ink_mutex_release(&m_mutex);
+
+  if (want) {
+    queue(NULL);
+  }
+  if (lb) {
+    RecIncrRawStat(log_rsb, this_thread()->mutex->thread_holding, log_stat_collation_bytes_replayed_stat,
+                   lb->header()->byte_count);
+  }
+  return lb;
+}
+
+bool
+LogSpool::pending()
+{
+  bool pending;
+
+  ink_mutex_acquire(&m_mutex);
+  pending = m_bytes > 0;
+  ink_mutex_release(&m_mutex);
+  return pending;
+}
+
+bool
+LogSpool::open()
+{
+  if (m_fd >= 0)
+    return true;
+  if (m_opened)
+    return false;
+
+  struct stat st;
+  int64_t size = 0;
+
+  m_fd = ::open(m_name, O_RDWR | O_CREAT, Log::config->logfile_perm);
+  if (m_fd < 0) {
+    Warning("cannot open collation spool %s: %s", m_name, strerror(errno));
+  } else if (fstat(m_fd, &st) == 0) {
+    size = st.st_size;
+  }
+  m_read_pos = 0;
+  m_write_pos = size;
+
+  ink_mutex_acquire(&m_mutex);
+  m_opened = true;
+  m_bytes += size;
+  m_disk_bytes += size;
+  ink_mutex_release(&m_mutex);
+
+  Debug("log-host", "opened collation spool %s, %" PRId64 " bytes", m_name, size);
+  return m_fd >= 0;
+}
+
+void
+LogSpool::flush(LogBuffer * lb)
+{
+  if (lb) {
+    LogBufferHeader *h = lb->header();
+    bool written = open() && pwrite(m_fd, h, h->byte_count, m_write_pos) == (ssize_t)h->byte_count;
+
+    ink_mutex_acquire(&m_mutex);
+    if (written) {
+      m_write_pos += h->byte_count;
+      m_disk_bytes += h->byte_count;
+    } else {
+      m_bytes -= h->byte_count;
+    }
+    ink_mutex_release(&m_mutex);
+
+    if (!written && m_fd >= 0) {
+      Warning("cannot write collation spool %s: %s", m_name, strerror(errno));
+    }
+    LogBuffer::destroy(lb);
+  }
+  read_ahead();
+}
+
+void
+LogSpool::read_ahead()
+{
+  LogBufferHeader hdr;
+  int want;
+
+  ink_mutex_acquire(&m_mutex);
+  m_read_ahead_queued = false;
+  want = spool_read_ahead_buffers() - m_ready_count;
+  ink_mutex_release(&m_mutex);
+
+  if (!open())
+    return;
+
+  while (want-- > 0 && m_read_pos < m_write_pos) {
+    if (pread(m_fd, &hdr, sizeof(hdr), m_read_pos) != sizeof(hdr) || hdr.cookie != LOG_SEGMENT_COOKIE ||
+        hdr.byte_count < sizeof(hdr) || m_read_pos + hdr.byte_count > m_write_pos ||
+        hdr.byte_count > LOG_COLLATION_BATCH_MAX_BYTES) {
+      int64_t lost = m_write_pos - m_read_pos;
+
+      Warning("collation spool %s is corrupted, discarding %" PRId64 " bytes", m_name, lost);
+      m_read_pos = m_write_pos;
+      ink_mutex_acquire(&m_mutex);
+      m_bytes -= lost;
+      m_disk_bytes -= lost;
+      ink_mutex_release(&m_mutex);
+      break;
+    }
+
+    char *buf = new char[hdr.byte_count];
+    if (pread(m_fd, buf, hdr.byte_count, m_read_pos) != (ssize_t)hdr.byte_count) {
+      delete[] buf;
+      break;
+    }
+    m_read_pos += hdr.byte_count;
+
+    // owned by whoever destroys it
+    LogBuffer *lb = new LogBuffer(NULL, (LogBufferHeader *)buf);
+    lb->m_references = 1;
+
+    ink_mutex_acquire(&m_mutex);
+    m_ready.enqueue(lb);
+    m_ready_count++;
+    m_disk_bytes -= hdr.byte_count;
+    ink_mutex_release(&m_mutex);
+  }
+
+  if (m_read_pos >= m_write_pos && m_write_pos > 0) {
+    if (ftruncate(m_fd, 0) == 0) {
+      m_read_pos = m_write_pos = 0;
+    }
+  }
+}
+
 void
 LogHost::display(FILE * fd)
 {
@@ -327,6 +569,7 @@ LogHost::clear()
   ats_free(m_name);
   delete m_sock;
   m_orphan_file.clear();
+  m_spool.clear();
 
   ink_zero(m_ip);
   m_port = 0;
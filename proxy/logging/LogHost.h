@@ -29,6 +29,53 @@ class LogCollationClientSM;
 
 #include "LogBufferSink.h"
 
+/*-------------------------------------------------------------------------
+  LogSpool
+  The buffers a LogHost could not send, kept on disk until the host is up
+  again.  The disk I/O is done by the log flush thread; write and read only
+  queue work for it, and hand out the buffers it has read ahead, so that
+  the net thread of a collation client never waits on the disk.
+  -------------------------------------------------------------------------*/
+class LogSpool : public RefCountObj
+{
+public:
+  LogSpool(const char *name);
+  ~LogSpool();
+
+  // write returns false if the spool is disabled or full, read NULL if
+  // nothing has been read ahead yet, pending whether anything is spooled
+  bool write(LogBuffer * lb);
+  LogBuffer *read();
+  bool pending();
+
+  // the flush thread's part: writes lb, or reads ahead if lb is NULL
+  void flush(LogBuffer * lb);
+
+private:
+  bool open();
+  void queue(LogBuffer * lb);
+  void read_ahead();
+
+  char *m_name;
+
+  // used by the flush thread only
+  int m_fd;
+  off_t m_read_pos;
+  off_t m_write_pos;
+
+  ink_mutex m_mutex;
+  Queue<LogBuffer> m_ready;     // read ahead, oldest first
+  int m_ready_count;
+  int64_t m_bytes;              // spooled and not yet handed out by read
+  int64_t m_disk_bytes;         // on disk and not yet read ahead
+  bool m_opened;                // open was tried
+  bool m_read_ahead_queued;
+
+  // -- member functions not allowed --
+  LogSpool(const LogSpool &);
+  LogSpool & operator=(const LogSpool &);
+};
+
 /*-------------------------------------------------------------------------
   LogHost
   This object corresponds to a named log collation host.
@@ -62,6 +109,15 @@ public:
   //
   void orphan_write_and_try_delete(LogBuffer * lb);
 
+  //
+  // the spool keeps the buffers which could not be sent on disk, and
+  // gives them back once the host is up again, see LogSpool.  spool_write
+  // takes the buffer unless it returns false.
+  //
+  bool spool_write(LogBuffer * lb) { return m_spool && m_spool->write(lb); }
+  LogBuffer *spool_read() { return m_spool ? m_spool->read() : NULL; }
+  bool spool_pending() { return m_spool && m_spool->pending(); }
+
   char const* name() const { return m_name ? m_name : "UNKNOWN"; }
   IpAddr const& ip_addr() const { return m_ip; }
   in_port_t port() const { return m_port; }
@@ -90,6 +146,7 @@ private:
   bool m_connected;
   Ptr<LogFile> m_orphan_file;
   LogCollationClientSM *m_log_collation_client_sm;
+  Ptr<LogSpool> m_spool;
 
 public:
   LINK(LogHost, link);
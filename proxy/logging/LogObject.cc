@@ -110,6 +110,8 @@ LogObject::LogObject(const LogFormat *format, const char *log_dir,
         m_flags |= BINARY;
     } else if (file_format == LOG_FILE_PIPE) {
         m_flags |= WRITES_TO_PIPE;
+    } else if (file_format == LOG_FILE_COLUMNAR) {
+        m_flags |= COLUMNAR;
     }
 
     generate_filenames(log_dir, basename, file_format);
@@ -128,6 +130,7 @@ LogObject::LogObject(const LogFormat *format, const char *log_dir,
     LogBuffer *b = new LogBuffer (this, Log::config->log_buffer_size);
     ink_assert(b);
     SET_FREELIST_POINTER_VERSION(m_log_buffer, b, 0);
+    _init_thread_buffers();
 
     _setup_rolling(rolling_enabled, rolling_interval_sec, rolling_offset_hr, rolling_size_mb);
 
@@ -171,6 +174,7 @@ LogObject::LogObject(LogObject& rhs)
     LogBuffer *b = new LogBuffer (this, Log::config->log_buffer_size);
     ink_assert(b);
     SET_FREELIST_POINTER_VERSION(m_log_buffer, b, 0);
+    _init_thread_buffers();
 
     Debug("log-config", "exiting LogObject copy constructor, "
           "filename=%s this=%p", m_filename, this);
@@ -180,7 +184,9 @@ LogObject::~LogObject()
 {
   Debug("log-config", "entering LogObject destructor, this=%p", this);
 
-  preproc_buffers();
+  for (int i = 0; i < m_flush_threads; i++) {
+    preproc_buffers(i);
+  }
 
   // here we need to free LogHost if it is remote logging.
   if (is_collation_client()) {
@@ -194,6 +200,24 @@ LogObject::~LogObject()
   delete m_format;
   delete[] m_buffer_manager;
   delete (LogBuffer*)FREELIST_POINTER(m_log_buffer);
+  for (int i = 0; i < m_thread_buffer_count; i++) {
+    delete (LogBuffer*)FREELIST_POINTER(m_thread_buffers[i].buffer);
+  }
+  ats_memalign_free(m_thread_buffers);
+}
+
+void
+LogObject::_init_thread_buffers()
+{
+  // Event threads are started before the logging configuration is
+  // loaded. Threads spawned later (and standalone tools, which have no
+  // event threads) use the shared buffer.
+  m_thread_buffer_count = eventProcessor.n_ethreads;
+  m_thread_buffers = NULL;
+  if (m_thread_buffer_count > 0) {
+    m_thread_buffers = (ThreadBuffer *)ats_memalign(sizeof(ThreadBuffer), m_thread_buffer_count * sizeof(ThreadBuffer));
+    memset(m_thread_buffers, 0, m_thread_buffer_count * sizeof(ThreadBuffer));
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -234,6 +258,7 @@ LogObject::generate_filenames(const char *log_dir, const char *basename, LogFile
       ext_len = 4;
       break;
     case LOG_FILE_BINARY:
+    case LOG_FILE_COLUMNAR:
       ext = LOG_FILE_BINARY_OBJECT_FILENAME_EXTENSION;
       ext_len = 5;
       break;
@@ -335,7 +360,8 @@ uint64_t LogObject::compute_signature(LogFormat * format, char *filename, unsign
     char *buffer = (char *)ats_malloc(buf_size);
 
     ink_string_concatenate_strings(buffer, fl, ps, filename, flags & LogObject::BINARY ? "B" :
-                                   (flags & LogObject::WRITES_TO_PIPE ? "P" : "A"), NULL);
+                                   (flags & LogObject::COLUMNAR ? "C" :
+                                    (flags & LogObject::WRITES_TO_PIPE ? "P" : "A")), NULL);
 
     CryptoHash hash;
     MD5Context().hash_immediate(hash, buffer, buf_size - 1);
@@ -377,7 +403,7 @@ LogObject::displayAsXML(FILE * fd, bool extended)
           "<LogObject>\n"
           "  <Mode        = \"%s\"/>\n"
           "  <Format      = \"%s\"/>\n"
-          "  <Filename    = \"%s\"/>\n", (m_flags & BINARY ? "binary" : "ascii"), m_format->name(), m_filename);
+          "  <Filename    = \"%s\"/>\n", (m_flags & BINARY ? "binary" : (m_flags & COLUMNAR ? "columnar" : "ascii")), m_format->name(), m_filename);
 
   LogFilter *filter;
   for (filter = m_filter_list.first(); filter != NULL; filter = m_filter_list.next(filter)) {
@@ -393,11 +419,48 @@ LogObject::displayAsXML(FILE * fd, bool extended)
 }
 
 
+static inline bool
+log_buffer_cas(volatile head_p *slot, head_p old_h, head_p new_h)
+{
+#if TS_HAS_128BIT_CAS
+  return ink_atomic_cas((__int128_t*) &slot->data, old_h.data, new_h.data);
+#else
+  return ink_atomic_cas((int64_t *) &slot->data, old_h.data, new_h.data);
+#endif
+}
+
+volatile head_p *
+LogObject::_thread_buffer()
+{
+  EThread *t = this_ethread();
+
+  if (t && t->tt == REGULAR && t->id >= 0 && t->id < m_thread_buffer_count && Log::config->per_thread_buffers) {
+    return &m_thread_buffers[t->id].buffer;
+  }
+  return &m_log_buffer;
+}
+
+void
+LogObject::force_new_buffer()
+{
+  _checkout_write(&m_log_buffer, NULL, 0);
+  for (int i = 0; i < m_thread_buffer_count; i++) {
+    _checkout_write(&m_thread_buffers[i].buffer, NULL, 0);
+  }
+}
+
+// Checkout space for a write from the buffer in @a slot, which is either
+// the shared m_log_buffer or one of the per-thread slots. A NULL
+// write_offset seals the current buffer instead and hands it to the
+// preproc thread; if expire_before is set, only a buffer that expired
+// before that time is sealed.
+//
 LogBuffer *
-LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
+LogObject::_checkout_write(volatile head_p * slot, size_t * write_offset, size_t bytes_needed, long expire_before) {
   LogBuffer::LB_ResultCode result_code;
   LogBuffer *buffer;
   LogBuffer *new_buffer;
+  bool shared = (slot == &m_log_buffer);
   bool retry = true;
 
   do {
@@ -406,17 +469,34 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
     head_p h;
     int result = 0;
     do {
-      INK_QUEUE_LD(h, m_log_buffer);
+      INK_QUEUE_LD(h, *slot);
+      if (FREELIST_POINTER(h) == NULL)
+        break;
       head_p new_h;
       SET_FREELIST_POINTER_VERSION(new_h, FREELIST_POINTER(h), FREELIST_VERSION(h) + 1);
-#if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, h.data, new_h.data);
-#else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, h.data, new_h.data);
-#endif
+      result = log_buffer_cas(slot, h, new_h);
     } while (!result);
     buffer = (LogBuffer*)FREELIST_POINTER(h);
-    result_code = buffer->checkout_write(write_offset, bytes_needed);
+
+    if (buffer == NULL) {
+      // a per-thread slot that was sealed, only a writer refills it
+      if (!write_offset)
+        return NULL;
+      new_buffer = new LogBuffer(this, Log::config->log_buffer_size);
+      head_p tmp_h;
+      SET_FREELIST_POINTER_VERSION(tmp_h, new_buffer, 0);
+      if (!log_buffer_cas(slot, h, tmp_h))
+        delete new_buffer;
+      continue;
+    }
+
+    if (!write_offset && expire_before && buffer->expiration_time() >= expire_before) {
+      // not expired yet, just drop our reference
+      result_code = LogBuffer::LB_OK;
+      retry = false;
+    } else {
+      result_code = buffer->checkout_write(write_offset, bytes_needed);
+    }
     bool decremented = false;
 
     switch (result_code) {
@@ -428,14 +508,15 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
 
     case LogBuffer::LB_FULL_ACTIVE_WRITERS:
     case LogBuffer::LB_FULL_NO_WRITERS:
-      // no more room in current buffer, create a new one
-      new_buffer = new LogBuffer(this, Log::config->log_buffer_size);
+      // no more room in current buffer, create a new one. A sealed
+      // per-thread slot stays empty until its thread writes again.
+      new_buffer = (write_offset || shared) ? new LogBuffer(this, Log::config->log_buffer_size) : NULL;
 
       // swap the new buffer for the old one
       INK_WRITE_MEMORY_BARRIER;
       head_p old_h;
       do {
-        INK_QUEUE_LD(old_h, m_log_buffer);
+        INK_QUEUE_LD(old_h, *slot);
         if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h)) {
           ink_atomic_increment(&buffer->m_references, -1);
 
@@ -446,20 +527,25 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
         }
         head_p tmp_h;
         SET_FREELIST_POINTER_VERSION(tmp_h, new_buffer, 0);
-#if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, old_h.data, tmp_h.data);
-#else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, old_h.data, tmp_h.data);
-#endif
+        result = log_buffer_cas(slot, old_h, tmp_h);
       } while (!result);
       if (FREELIST_POINTER(old_h) == FREELIST_POINTER(h)) {
         ink_atomic_increment(&buffer->m_references, FREELIST_VERSION(old_h) - 1);
 
-        int idx = m_buffer_manager_idx++ % m_flush_threads;
+        // Keep each thread on one preproc queue so its entries stay in
+        // order. Buffers a thread fills itself are signalled in batches.
+        int idx;
+        int queued;
+        if (shared) {
+          idx = m_buffer_manager_idx++ % m_flush_threads;
+        } else {
+          idx = ((ThreadBuffer *)slot - m_thread_buffers) % m_flush_threads;
+        }
         Debug("log-logbuffer", "adding buffer %d to flush list after checkout", buffer->get_id());
-        m_buffer_manager[idx].add_to_flush_queue(buffer);
-        Log::preproc_notify[idx].signal();
-
+        queued = m_buffer_manager[idx].add_to_flush_queue(buffer);
+        if (shared || !write_offset || queued >= LOG_FLUSH_BATCH_SIZE) {
+          Log::preproc_notify[idx].signal();
+        }
       }
       decremented = true;
       break;
@@ -485,16 +571,12 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
     if (!decremented) {
       head_p old_h;
       do {
-        INK_QUEUE_LD(old_h, m_log_buffer);
+        INK_QUEUE_LD(old_h, *slot);
         if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h))
           break;
         head_p tmp_h;
         SET_FREELIST_POINTER_VERSION(tmp_h, FREELIST_POINTER(h), FREELIST_VERSION(old_h) - 1);
-#if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) &m_log_buffer.data, old_h.data, tmp_h.data);
-#else
-       result = ink_atomic_cas((int64_t *) &m_log_buffer.data, old_h.data, tmp_h.data);
-#endif
+        result = log_buffer_cas(slot, old_h, tmp_h);
       } while (!result);
       if (FREELIST_POINTER(old_h) != FREELIST_POINTER(h))
         ink_atomic_increment(&buffer->m_references, -1);
@@ -614,7 +696,7 @@ LogObject::log(LogAccess * lad, const char *text_entry)
   }
 
   // Now try to place this entry in the current LogBuffer.
-  buffer = _checkout_write(&offset, bytes_needed);
+  buffer = _checkout_write(_thread_buffer(), &offset, bytes_needed);
 
   if (!buffer) {
     Note("Skipping the current log entry for %s because its size (%zu) exceeds "
@@ -801,9 +883,9 @@ LogObject::_roll_files(long last_roll_time, long time_now)
 void
 LogObject::check_buffer_expiration(long time_now)
 {
-  LogBuffer *b = (LogBuffer*)FREELIST_POINTER(m_log_buffer);
-  if (b && time_now > b->expiration_time()) {
-    force_new_buffer();
+  _checkout_write(&m_log_buffer, NULL, 0, time_now);
+  for (int i = 0; i < m_thread_buffer_count; i++) {
+    _checkout_write(&m_thread_buffers[i].buffer, NULL, 0, time_now);
   }
 }
 
@@ -1441,4 +1523,77 @@ REGRESSION_TEST(LogObjectManager_Transfer)(RegressionTest * t, int /* atype ATS_
   box = REGRESSION_TEST_PASSED;
 }
 
+struct LogBufferBench
+{
+  LogObject *object;
+  int id;
+  int entries;
+  ink_hrtime elapsed;
+};
+
+static void *
+log_buffer_bench_thread(void *arg)
+{
+  LogBufferBench *bench = (LogBufferBench *)arg;
+  EThread *thread = new EThread(REGULAR, bench->id);
+  char entry[128];
+
+  thread->set_specific();
+  snprintf(entry, sizeof(entry), "GET http://www.example.com/benchmark/thread/%d 200 1234", bench->id);
+
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int i = 0; i < bench->entries; ++i) {
+    bench->object->log(NULL, entry);
+  }
+  bench->elapsed = ink_get_hrtime_internal() - start;
+
+  ink_thread_setspecific(Thread::thread_data_key, NULL);
+  delete thread;
+  return NULL;
+}
+
+// Logging throughput with the shared buffer and with per-thread buffers.
+REGRESSION_TEST(LogObject_ThreadBuffers)(RegressionTest * t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  const char * tmpdir = getenv("TMPDIR");
+  bool saved = Log::config->per_thread_buffers;
+  int nthreads = MIN(ink_number_of_processors(), 8);
+  LogBufferBench bench[8];
+  ink_thread threads[8];
+
+  if (!tmpdir) {
+    tmpdir = "/tmp";
+  }
+
+  // Each bench thread takes the buffer slot of one event thread, and is its
+  // only user, like the event thread would be.
+  if (eventProcessor.n_ethreads > 0) {
+    nthreads = MIN(nthreads, eventProcessor.n_ethreads);
+  }
+
+  box = REGRESSION_TEST_PASSED;
+  for (int mode = 0; mode < 2; ++mode) {
+    TextLogObject *object = new TextLogObject("log_buffer_bench", tmpdir, false, NULL, Log::NO_ROLLING, 1, 0, 0, 0);
+    double rate = 0;
+
+    Log::config->per_thread_buffers = mode;
+    for (int i = 0; i < nthreads; ++i) {
+      bench[i].object = object;
+      bench[i].id = i;
+      bench[i].entries = 20000;
+      threads[i] = ink_thread_create(log_buffer_bench_thread, &bench[i]);
+    }
+    for (int i = 0; i < nthreads; ++i) {
+      ink_thread_join(threads[i]);
+      rate += bench[i].entries / ((double)bench[i].elapsed / HRTIME_SECOND);
+    }
+
+    rprintf(t, "%s buffers: %d threads, %.0f entries/sec/core\n", mode ? "per-thread" : "shared", nthreads, rate / nthreads);
+    object->force_new_buffer();
+    delete object;
+  }
+  Log::config->per_thread_buffers = saved;
+}
+
 #endif
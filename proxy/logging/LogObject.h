@@ -55,6 +55,10 @@
 
 #define FLUSH_ARRAY_SIZE (512*4)
 
+// Buffers filled by a per-thread slot are handed to the preproc thread in
+// batches of this many, the periodic wakeup picks up any stragglers.
+#define LOG_FLUSH_BATCH_SIZE 8
+
 #define LOG_OBJECT_ARRAY_DELTA 8
 
 #define ACQUIRE_API_MUTEX(_f) \
@@ -74,9 +78,10 @@ class LogBufferManager
   public:
     LogBufferManager() : _num_flush_buffers(0) { }
 
-    void add_to_flush_queue(LogBuffer *buffer) {
+    // returns the number of buffers waiting for preproc, including this one
+    int add_to_flush_queue(LogBuffer *buffer) {
       write_list.push(buffer);
-      ink_atomic_increment(&_num_flush_buffers, 1);
+      return ink_atomic_increment(&_num_flush_buffers, 1) + 1;
     }
 
     size_t preproc_buffers(LogBufferSink *sink);
@@ -93,12 +98,14 @@ public:
     REMOTE_DATA = 2,
     WRITES_TO_PIPE = 4,
     LOG_OBJECT_FMT_TIMESTAMP = 8, // always format a timestamp into each log line (for raw text logs)
+    COLUMNAR = 16,
   };
 
   // BINARY: log is written in binary format (rather than ascii)
   // REMOTE_DATA: object receives data from remote collation clients, so
   //              it should not be destroyed during a reconfiguration
   // WRITES_TO_PIPE: object writes to a named pipe rather than to a file
+  // COLUMNAR: log is written in compressed columnar blocks (see LogColumnar.h)
 
   LogObject(const LogFormat *format, const char *log_dir, const char *basename,
                  LogFileFormat file_format, const char *header,
@@ -196,9 +203,7 @@ public:
 
   const char *get_format_string() { return (m_format ? m_format->format_string() : "<none>"); }
 
-  void force_new_buffer() {
-    _checkout_write(NULL, 0);
-  }
+  void force_new_buffer();
 
   bool operator==(LogObject & rhs);
   int do_filesystem_checks();
@@ -237,11 +242,26 @@ private:
   unsigned m_buffer_manager_idx;
   LogBufferManager *m_buffer_manager;
 
+  // Work buffers private to each regular event thread, indexed by the
+  // thread id. The owning thread is the only writer so the atomics in
+  // _checkout_write() never contend; other threads only ever seal a
+  // slot (expiration, flush) which leaves it empty until the owner logs
+  // again. Threads without a slot share m_log_buffer.
+  struct ThreadBuffer
+  {
+    volatile head_p buffer;
+    char pad[64 - sizeof(head_p)];  // one slot per cache line
+  };
+  ThreadBuffer *m_thread_buffers;
+  int m_thread_buffer_count;
+
   void generate_filenames(const char *log_dir, const char *basename, LogFileFormat file_format);
   void _setup_rolling(Log::RollingEnabledValues rolling_enabled, int rolling_interval_sec, int rolling_offset_hr, int rolling_size_mb);
   unsigned _roll_files(long interval_start, long interval_end);
 
-  LogBuffer *_checkout_write(size_t * write_offset, size_t write_size);
+  void _init_thread_buffers();
+  volatile head_p *_thread_buffer();
+  LogBuffer *_checkout_write(volatile head_p * slot, size_t * write_offset, size_t write_size, long expire_before = 0);
 
 private:
   // -- member functions not allowed --
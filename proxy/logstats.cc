@@ -32,6 +32,7 @@
 #include "LogStandalone.cc"
 
 #include "LogObject.h"
+#include "LogColumnar.h"
 #include "hdrs/HTTP.h"
 
 #include <math.h>
@@ -610,13 +611,25 @@ private:
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+// The stats accumulated by one parsing thread, merged when all are done.
+struct LogStats
+{
+  OriginStats totals;
+  OriginStorage origins;
+  int parse_errors;
+  LogFieldList *fieldlist;
+
+  LogStats();
+  void merge(LogStats &other);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // Globals, holding the accumulated stats (ok, I'm lazy ...)
-static OriginStats totals;
-static OriginStorage origins;
+static LogStats stats;
 static OriginSet *origin_set;
 static UrlLru *urls;
-static int parse_errors;
+static int64_t bytes_parsed;
 
 // Command line arguments (parsing)
 struct CommandLineArgs
@@ -637,10 +650,12 @@ struct CommandLineArgs
   int urls;			// Produce JSON output of URL stats, arg is LRU size
   int show_urls;		// Max URLs to show
   int as_object;		// Show the URL stats as a single JSON object (not array)
+  int threads;                  // Parsing threads, 0 for one per CPU
+  int throughput;               // Report the parsing throughput
 
   CommandLineArgs()
     : max_origins(0), min_hits(0), max_age(0), line_len(DEFAULT_LINE_LEN), incremental(0),
-      tail(0), summary(0), json(0), cgi(0), urls(0), show_urls(0), as_object(0)
+      tail(0), summary(0), json(0), cgi(0), urls(0), show_urls(0), as_object(0), threads(0), throughput(0)
   {
     log_file[0] = '\0';
     origin_file[0] = '\0';
@@ -670,6 +685,8 @@ static ArgumentDescription argument_descriptions[] = {
   {"min_hits", 'm', "Minimum total hits for an Origin", "L", &cl.min_hits, NULL, NULL},
   {"max_age", 'a', "Max age for log entries to be considered", "I", &cl.max_age, NULL, NULL},
   {"line_len", 'l', "Output line length", "I", &cl.line_len, NULL, NULL},
+  {"threads", 'n', "Number of parsing threads (0 = one per CPU)", "I", &cl.threads, NULL, NULL},
+  {"throughput", 'r', "Report the parsing throughput on stderr", "T", &cl.throughput, NULL, NULL},
   {"debug_tags", 'T', "Colon-Separated Debug Tags", "S1023", &error_tags, NULL, NULL},
   HELP_ARGUMENT_DESCRIPTION(),
   VERSION_ARGUMENT_DESCRIPTION()
@@ -878,6 +895,72 @@ update_elapsed(ElapsedStats &stat, const int elapsed, const StatsCounter &counte
 
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Merge the elapsed stats of two sets of requests, of the given counts
+inline void
+merge_elapsed(ElapsedStats &stat, const StatsCounter &counter, const ElapsedStats &other, const StatsCounter &other_counter)
+{
+  double n = counter.count, m = other_counter.count;
+  double avg, var;
+
+  if (0 == m || -1 == other.min)
+    return;
+  if (0 == n || -1 == stat.min) {
+    stat = other;
+    return;
+  }
+
+  if (stat.min > other.min)
+    stat.min = other.min;
+  if (stat.max < other.max)
+    stat.max = other.max;
+
+  avg = (stat.avg * n + other.avg * m) / (n + m);
+  var = (n * (stat.stddev * stat.stddev + (stat.avg - avg) * (stat.avg - avg)) +
+         m * (other.stddev * other.stddev + (other.avg - avg) * (other.avg - avg))) / (n + m);
+  stat.avg = avg;
+  stat.stddev = sqrt(var);
+}
+
+inline void
+merge_counter(StatsCounter &counter, const StatsCounter &other)
+{
+  counter.count += other.count;
+  counter.bytes += other.bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Merge the stats of one Origin (or the totals) into another
+static void
+merge_origin_stats(OriginStats * stat, const OriginStats * other)
+{
+  // The elapsed stats first, they are weighted by the counts before the merge
+  merge_elapsed(stat->elapsed.hits.hit, stat->results.hits.hit, other->elapsed.hits.hit, other->results.hits.hit);
+  merge_elapsed(stat->elapsed.hits.ims, stat->results.hits.ims, other->elapsed.hits.ims, other->results.hits.ims);
+  merge_elapsed(stat->elapsed.hits.refresh, stat->results.hits.refresh, other->elapsed.hits.refresh,
+                other->results.hits.refresh);
+  merge_elapsed(stat->elapsed.hits.other, stat->results.hits.other, other->elapsed.hits.other, other->results.hits.other);
+  merge_elapsed(stat->elapsed.hits.total, stat->results.hits.total, other->elapsed.hits.total, other->results.hits.total);
+  merge_elapsed(stat->elapsed.misses.miss, stat->results.misses.miss, other->elapsed.misses.miss,
+                other->results.misses.miss);
+  merge_elapsed(stat->elapsed.misses.ims, stat->results.misses.ims, other->elapsed.misses.ims, other->results.misses.ims);
+  merge_elapsed(stat->elapsed.misses.refresh, stat->results.misses.refresh, other->elapsed.misses.refresh,
+                other->results.misses.refresh);
+  merge_elapsed(stat->elapsed.misses.other, stat->results.misses.other, other->elapsed.misses.other,
+                other->results.misses.other);
+  merge_elapsed(stat->elapsed.misses.total, stat->results.misses.total, other->elapsed.misses.total,
+                other->results.misses.total);
+
+  // Everything from the results on is a StatsCounter
+  StatsCounter *c = reinterpret_cast<StatsCounter *>(reinterpret_cast<char *>(stat) + offsetof(OriginStats, results));
+  const StatsCounter *o =
+    reinterpret_cast<const StatsCounter *>(reinterpret_cast<const char *>(other) + offsetof(OriginStats, results));
+
+  merge_counter(stat->total, other->total);
+  for (size_t i = 0; i < (sizeof(OriginStats) - offsetof(OriginStats, results)) / sizeof(StatsCounter); ++i)
+    merge_counter(c[i], o[i]);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Update the "result" and "elapsed" stats for a particular record
 inline void
@@ -1185,11 +1268,44 @@ update_schemes(OriginStats * stat, int scheme, int size)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Parse a log buffer
+// Per thread stats
+LogStats::LogStats()
+  : parse_errors(0), fieldlist(NULL)
+{
+  memset(&totals, 0, sizeof(totals));
+  init_elapsed(&totals);
+}
+
+// Move the stats of another thread into this one
+void
+LogStats::merge(LogStats &other)
+{
+  merge_origin_stats(&totals, &other.totals);
+
+  for (OriginStorage::iterator i = other.origins.begin(); i != other.origins.end(); ++i) {
+    OriginStorage::iterator o_iter = origins.find(i->first);
+
+    if (origins.end() == o_iter) {
+      origins[i->first] = i->second;
+    } else {
+      merge_origin_stats(o_iter->second, i->second);
+      ats_free(const_cast<char *>(i->second->server));
+      ats_free(i->second);
+    }
+  }
+  other.origins.clear();
+  parse_errors += other.parse_errors;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Parse a log buffer, into the stats of the calling thread
 int
-parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
+parse_log_buff(LogStats & stats, LogBufferHeader * buf_header, bool summary = false)
 {
-  static LogFieldList *fieldlist = NULL;
+  LogFieldList *&fieldlist = stats.fieldlist;
+  OriginStats &totals = stats.totals;
+  OriginStorage &origins = stats.origins;
 
   LogEntryHeader *entry;
   LogBufferIterator buf_iter(buf_header);
@@ -1640,7 +1756,7 @@ parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
       case P_STATE_END:
         // Nothing to do really
         if (flag) {
-          parse_errors++;
+          stats.parse_errors++;
         }
         break;
       }
@@ -1652,6 +1768,129 @@ parse_log_buff(LogBufferHeader * buf_header, bool summary = false)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// The work shared by the parsing threads of a mapped file. Each thread
+// claims the segments of the next chunk of the file from the scanner, and
+// parses them with its own reader, into its own stats.
+const off_t PARSE_CHUNK_SIZE = 4 * 1024 * 1024;
+
+struct ParseWork
+{
+  int fd;
+  unsigned max_age;
+  LogSegmentReader *scanner;
+  ink_mutex mutex;
+  bool failed;
+};
+
+struct ParseThread
+{
+  ParseWork *work;
+  LogStats *stats;
+  ink_thread tid;
+};
+
+static void *
+parse_thread(void *data)
+{
+  ParseThread *pt = static_cast<ParseThread *>(data);
+  ParseWork *work = pt->work;
+  LogSegmentReader reader;
+  LogBufferHeader *header;
+  off_t start, end;
+  bool failed = !reader.open(work->fd, 0);
+
+  while (!failed) {
+    ink_mutex_acquire(&work->mutex);
+    failed = work->failed;
+    start = work->scanner->offset();
+    while (!failed && work->scanner->offset() - start < PARSE_CHUNK_SIZE && work->scanner->skip())
+      ;
+    end = work->scanner->offset();
+    ink_mutex_release(&work->mutex);
+
+    if (failed || start == end)
+      break;
+
+    reader.seek(start, end);
+    while ((header = reader.next())) {
+      // Possibly skip too old entries (the entire buffer is skipped)
+      if (header->high_timestamp >= work->max_age) {
+        if (parse_log_buff(*pt->stats, header, cl.summary != 0) != 0) {
+          Debug("logstats", "Failed to parse log buffer.");
+          failed = true;
+          break;
+        }
+      } else {
+        Debug("logstats", "Skipping old buffer (age=%d, max=%d)", header->high_timestamp, work->max_age);
+      }
+    }
+    if (reader.error()) {
+      Debug("logstats", "Invalid segment at offset %" PRId64, (int64_t)reader.offset());
+      failed = true;
+    }
+  }
+
+  if (failed) {
+    ink_mutex_acquire(&work->mutex);
+    work->failed = true;
+    ink_mutex_release(&work->mutex);
+  }
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process a mapped file, which also reads the columnar format, with as many
+// threads as asked for. The URL stats are kept in LRU order, so they are
+// only collected by a single thread. The file offset is left after the last
+// complete segment, for the saved state.
+static int
+process_mapped_file(int in_fd, LogSegmentReader & reader, unsigned max_age)
+{
+  int nthreads = cl.threads > 0 ? cl.threads : ink_number_of_processors();
+  off_t start = reader.offset();
+  ParseWork work;
+  ParseThread *threads;
+
+  if (urls || nthreads < 1)
+    nthreads = 1;
+
+  work.fd = in_fd;
+  work.max_age = max_age;
+  work.scanner = &reader;
+  work.failed = false;
+  ink_mutex_init(&work.mutex, "logstats parse");
+
+  // The calling thread is the first one, and parses into the global stats
+  threads = new ParseThread[nthreads];
+  for (int i = 0; i < nthreads; ++i) {
+    threads[i].work = &work;
+    threads[i].stats = i ? new LogStats : &stats;
+    if (i)
+      threads[i].tid = ink_thread_create(parse_thread, &threads[i]);
+  }
+  parse_thread(&threads[0]);
+  for (int i = 1; i < nthreads; ++i) {
+    ink_thread_join(threads[i].tid);
+    stats.merge(*threads[i].stats);
+    delete threads[i].stats;
+  }
+  delete[] threads;
+  ink_mutex_destroy(&work.mutex);
+
+  Debug("logstats", "Parsed %" PRId64 " bytes with %d threads.", (int64_t)(reader.offset() - start), nthreads);
+  bytes_parsed += reader.offset() - start;
+
+  if (work.failed || reader.error()) {
+    Debug("logstats", "Invalid segment at offset %" PRId64, (int64_t)reader.offset());
+    return 1;
+  }
+  if (lseek(in_fd, reader.offset(), SEEK_SET) < 0) {
+    return 1;
+  }
+  return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Process a file (FD)
 int
@@ -1659,8 +1898,14 @@ process_file(int in_fd, off_t offset, unsigned max_age)
 {
   char buffer[MAX_LOGBUFFER_SIZE];
   int nread, buffer_bytes;
+  LogSegmentReader reader;
+  off_t start = offset > 0 ? offset : lseek(in_fd, 0, SEEK_CUR);
 
   Debug("logstats", "Processing file [offset=%" PRId64 "].", (int64_t)offset);
+  if (start >= 0 && reader.open(in_fd, start, offset > 0)) {
+    return process_mapped_file(in_fd, reader, max_age);
+  }
+
   while (true) {
     Debug("logstats", "Reading initial header.");
     buffer[0] = '\0';
@@ -1755,9 +2000,11 @@ process_file(int in_fd, off_t offset, unsigned max_age)
       }
     } while (total_read < buffer_bytes);
 
+    bytes_parsed += header->byte_count;
+
     // Possibly skip too old entries (the entire buffer is skipped)
     if (header->high_timestamp >= max_age) {
-      if (parse_log_buff(header, cl.summary != 0) != 0) {
+      if (parse_log_buff(stats, header, cl.summary != 0) != 0) {
         Debug("logstats", "Failed to parse log buffer.");
         return 1;
       }
@@ -2159,9 +2406,9 @@ my_exit(const ExitStatus& status)
     }
   }
 
-  if (!origins.empty()) {
+  if (!stats.origins.empty()) {
     // Sort the Origins by 'traffic'
-    for (OriginStorage::iterator i = origins.begin(); i != origins.end(); i++)
+    for (OriginStorage::iterator i = stats.origins.begin(); i != stats.origins.end(); i++)
       if (use_origin(i->second))
         vec.push_back(*i);
     sort(vec.begin(), vec.end());
@@ -2196,11 +2443,11 @@ my_exit(const ExitStatus& status)
     first = false;
     if (cl.json) {
       std::cout << "{ \"total\": {" << std::endl;
-      print_detail_stats(&totals, cl.json);
+      print_detail_stats(&stats.totals, cl.json);
       std::cout << "  }";
     } else {
       format_center("Totals (all Origins combined)");
-      print_detail_stats(&totals);
+      print_detail_stats(&stats.totals);
       std::cout << std::endl << std::endl << std::endl;
     }
   }
@@ -2276,6 +2523,7 @@ main(int /* argc ATS_UNUSED */, char *argv[])
   int main_fd;
   unsigned max_age;
   struct flock lck;
+  ink_hrtime start_time;
 
   // build the application information structure
   appVersionInfo.setup(PACKAGE_NAME, PROGRAM_NAME, PACKAGE_VERSION, __DATE__, __TIME__,
@@ -2284,11 +2532,7 @@ main(int /* argc ATS_UNUSED */, char *argv[])
   // Before accessing file system initialize Layout engine
   Layout::create();
 
-  memset(&totals, 0, sizeof(totals));
-  init_elapsed(&totals);
-
   origin_set = new OriginSet;
-  parse_errors = 0;
 
   // Command line parsing
   cl.parse_arguments(argv);
@@ -2366,6 +2610,8 @@ main(int /* argc ATS_UNUSED */, char *argv[])
       std::cout << "[" << std::endl;
   }
 
+  start_time = ink_get_hrtime_internal();
+
   // Do the incremental parse of the default squid log.
   if (cl.incremental) {
     // Change directory to the log dir
@@ -2561,6 +2807,15 @@ main(int /* argc ATS_UNUSED */, char *argv[])
     close(main_fd);
   }
 
+  if (cl.throughput) {
+    double secs = (double)(ink_get_hrtime_internal() - start_time) / HRTIME_SECOND;
+    double mb = (double)bytes_parsed / (1024 * 1024);
+
+    std::cerr << PROGRAM_NAME << ": parsed " << std::setiosflags(ios::fixed) << std::setprecision(1) << mb << " MB in "
+              << std::setprecision(2) << secs << " seconds, " << std::setprecision(1) << (secs > 0 ? mb / secs : 0.0)
+              << " MB/s" << std::endl;
+  }
+
   // All done.
   if (EXIT_OK == exit_status.level)
     exit_status.append(" OK");